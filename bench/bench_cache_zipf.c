@@ -0,0 +1,92 @@
+/**
+ * @file bench_cache_zipf.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_cache在Zipf分布访问下的命中率和吞吐量：未命中时插入，容量按元素个数计算
+ *        用法：bench_cache_zipf [键空间大小，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <math.h>
+#include "ut/ut_cache.h"
+#include "ut_bench.h"
+
+#define ACCESSES    4000000
+
+/**
+ * @brief 预先生成服从Zipf分布的访问序列，排名第k的键被访问的概率正比于 1 / k^s
+ */
+static void __zipf_sequence(uint32_t *seq, uint32_t num, uint32_t keys, double s, uint64_t *seed)
+{
+    double      *cdf = malloc(sizeof(double) * keys);
+    double      sum = 0;
+
+    for (uint32_t k = 0; k < keys; k++) {
+        sum += 1.0 / pow(k + 1, s);
+        cdf[k] = sum;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        double      target = (double)(bench_rand(seed) >> 11) / (double)(1ULL << 53) * sum;
+        uint32_t    lo = 0;
+        uint32_t    hi = keys - 1;
+
+        while (lo < hi) {
+            uint32_t    mid = (lo + hi) / 2;
+
+            if (cdf[mid] < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        /* 打散排名和键的对应关系，热点键不集中在同一段 */
+        seq[i] = (uint32_t)((lo * 2654435761ULL) % keys);
+    }
+    free(cdf);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        keys = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+    uint32_t        *seq = malloc(sizeof(uint32_t) * ACCESSES);
+    static const double skews[] = {0.8, 0.99, 1.2};
+    static const double ratios[] = {0.01, 0.05, 0.10};
+    uint64_t        seed = 1;
+    char            label[UT_LEN_64];
+
+    printf("keys: %u, accesses: %u\n", keys, ACCESSES);
+    for (uint32_t z = 0; z < sizeof(skews) / sizeof(skews[0]); z++) {
+        __zipf_sequence(seq, ACCESSES, keys, skews[z], &seed);
+
+        for (uint32_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+            ut_cache_t          *cache = NULL;
+            ut_cache_stats_t    stats;
+            uintptr_t           sum = 0;
+            int64_t             start = 0;
+
+            ut_cache_create(&cache, (size_t)(keys * ratios[r]), 0, NULL, NULL);
+            start = bench_now_ns();
+            for (uint32_t i = 0; i < ACCESSES; i++) {
+                uint32_t    key = seq[i];
+                void*       value = ut_cache_get_bin(cache, &key, sizeof(key));
+
+                if (value == NULL) {
+                    ut_cache_put_bin(cache, &key, sizeof(key), (void*)(uintptr_t)(key + 1), 1, UT_CACHE_TTL_DEFAULT);
+                }
+                sum += (uintptr_t)value;
+            }
+            start = bench_now_ns() - start;
+            ut_cache_stats(cache, &stats);
+            BENCH_KEEP(sum);
+
+            snprintf(label, sizeof(label), "zipf s=%.2f, cache %.0f%% of keys", skews[z], ratios[r] * 100);
+            BENCH_REPORT(label, "hit rate %.1f%%, %.2f Mops/s", stats.hits * 100.0 / (stats.hits + stats.misses), ACCESSES * 1e3 / start);
+            ut_cache_destroy(cache);
+        }
+    }
+
+    free(seq);
+    return 0;
+}
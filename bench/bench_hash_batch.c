@@ -0,0 +1,81 @@
+/**
+ * @file bench_hash_batch.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 哈希表远大于末级缓存时，ut_hash_peek_batch与逐个ut_hash_peek的对比
+ *        用法：bench_hash_batch [元素个数，默认8000000，保证哈希表大于末级缓存]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut/ut_hash.h"
+#include "ut_bench.h"
+
+#define LOOKUPS     4000000
+#define SLAB_SIZE   65536       /* 与ut_hash.c中的HASH_SLAB_SIZE一致 */
+
+static void __bench_batch(const char *name, uint32_t flags, uint32_t num, char (*keys)[UT_LEN_16], const char **order)
+{
+    static const uint32_t batches[] = {8, 16, 32, 64};
+    ut_hash_t       *ht = NULL;
+    ut_hash_stats_t stats;
+    size_t          heap_before = bench_heap_bytes();
+    void*           values[64];
+    uintptr_t       sum = 0;
+    int64_t         start = 0;
+    char            label[UT_LEN_64];
+
+    ut_hash_create_ex(&ht, num, NULL, flags);
+    for (uint32_t i = 0; i < num; i++) {
+        ut_hash_push(ht, keys[i], (void*)(uintptr_t)(i + 1));
+    }
+    ut_hash_stats(ht, &stats);
+    snprintf(label, sizeof(label), "%s table size", name);
+    BENCH_REPORT(label, "%.1f MiB", (bench_heap_bytes() - heap_before + (double)stats.slabs * SLAB_SIZE) / (1024 * 1024));
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        sum += (uintptr_t)ut_hash_peek(ht, order[i]);
+    }
+    snprintf(label, sizeof(label), "%s peek loop", name);
+    BENCH_REPORT(label, "%.2f Mops/s", LOOKUPS * 1e3 / (bench_now_ns() - start));
+
+    for (uint32_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        start = bench_now_ns();
+        for (uint32_t i = 0; i + batches[b] <= LOOKUPS; i += batches[b]) {
+            ut_hash_peek_batch(ht, &order[i], batches[b], values);
+            for (uint32_t j = 0; j < batches[b]; j++) {
+                sum += (uintptr_t)values[j];
+            }
+        }
+        snprintf(label, sizeof(label), "%s peek_batch(%u)", name, batches[b]);
+        BENCH_REPORT(label, "%.2f Mops/s", LOOKUPS * 1e3 / (bench_now_ns() - start));
+    }
+
+    BENCH_KEEP(sum);
+    ut_hash_destroy(ht);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        num = (uint32_t)bench_arg(argc, argv, 1, 8000000);
+    char            (*keys)[UT_LEN_16] = malloc((size_t)num * UT_LEN_16);
+    const char      **order = malloc(LOOKUPS * sizeof(char*));
+    uint64_t        seed = 1;
+
+    for (uint32_t i = 0; i < num; i++) {
+        snprintf(keys[i], UT_LEN_16, "%u", i * 7 + 3);
+    }
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        order[i] = keys[bench_rand(&seed) % num];
+    }
+
+    printf("entries: %u, lookups: %u\n", num, LOOKUPS);
+    __bench_batch("chained", UT_HASH_FLAG_NONE, num, keys, order);
+    __bench_batch("flat", UT_HASH_FLAG_FLAT, num, keys, order);
+
+    free(keys);
+    free(order);
+    return 0;
+}
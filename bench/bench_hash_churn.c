@@ -0,0 +1,85 @@
+/**
+ * @file bench_hash_churn.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 拉链法元素分配：每次插入的分配开销（与逐个calloc对比），以及大量插入删除之后的常驻内存
+ *        用法：bench_hash_churn [元素个数，默认2000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut_hash_inn.h"
+#include "ut_bench.h"
+
+int main(int argc, char **argv)
+{
+    uint32_t        num = (uint32_t)bench_arg(argc, argv, 1, 2000000);
+    char            (*keys)[UT_LEN_16] = malloc((size_t)num * UT_LEN_16);
+    hash_entry_t    **entries = malloc(sizeof(hash_entry_t*) * num);
+    ut_hash_t       *ht = NULL;
+    ut_hash_stats_t stats;
+    long            rss_base = 0;
+    int64_t         start = 0;
+
+    for (uint32_t i = 0; i < num; i++) {
+        snprintf(keys[i], UT_LEN_16, "%u", i * 7 + 3);
+    }
+    printf("entries: %u, entry size: %zu B\n", num, sizeof(hash_entry_t));
+
+    /* 原来的分配方式：每个元素单独calloc */
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < num; i++) {
+        entries[i] = calloc(1, sizeof(hash_entry_t));
+    }
+    BENCH_REPORT("calloc per entry (old allocator)", "%.1f ns/entry", (double)(bench_now_ns() - start) / num);
+    for (uint32_t i = 0; i < num; i++) {
+        free(entries[i]);
+    }
+    free(entries);
+    malloc_trim(0);
+
+    /* bucket数组预先分配好，插入的开销只剩下哈希、分配元素和挂链 */
+    rss_base = bench_rss_kb();
+    ut_hash_create(&ht, num, NULL);
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < num; i++) {
+        ut_hash_push(ht, keys[i], (void*)(uintptr_t)(i + 1));
+    }
+    BENCH_REPORT("chained insert, slab allocator", "%.1f ns/insert", (double)(bench_now_ns() - start) / num);
+
+    /* 删除后再插入，元素从空闲链表和slab中复用 */
+    for (uint32_t i = 0; i < num; i++) {
+        ut_hash_pop(ht, keys[i]);
+    }
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < num; i++) {
+        ut_hash_push(ht, keys[i], (void*)(uintptr_t)(i + 1));
+    }
+    BENCH_REPORT("chained re-insert after pop", "%.1f ns/insert", (double)(bench_now_ns() - start) / num);
+    for (uint32_t i = 0; i < num; i++) {
+        ut_hash_pop(ht, keys[i]);
+    }
+    ut_hash_destroy(ht);
+
+    /* 突发流量：先插入5%长期存在的元素，再插入其余的元素并全部删除 */
+    rss_base = bench_rss_kb();
+    ut_hash_create(&ht, 0, NULL);
+    for (uint32_t i = 0; i < num; i++) {
+        ut_hash_push(ht, keys[i], (void*)(uintptr_t)(i + 1));
+    }
+    BENCH_REPORT("RSS after burst", "%ld KB", bench_rss_kb() - rss_base);
+    for (uint32_t i = num / 20; i < num; i++) {
+        ut_hash_pop(ht, keys[i]);
+    }
+    ut_hash_stats(ht, &stats);
+    BENCH_REPORT("RSS after popping the burst", "%ld KB (%u slabs, %u on free list)", bench_rss_kb() - rss_base, stats.slabs, stats.free_count);
+
+    ut_hash_shrink(ht);
+    ut_hash_stats(ht, &stats);
+    BENCH_REPORT("RSS after ut_hash_shrink", "%ld KB (%u slabs, %u buckets)", bench_rss_kb() - rss_base, stats.slabs, stats.buckets);
+
+    ut_hash_destroy(ht);
+    free(keys);
+    return 0;
+}
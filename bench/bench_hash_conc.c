@@ -0,0 +1,133 @@
+/**
+ * @file bench_hash_conc.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 多线程读写混合：一把全局互斥锁保护的ut_hash与分片的ut_hash_conc对比
+ *        用法：bench_hash_conc [每个线程的操作次数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <pthread.h>
+#include "ut/ut_hash.h"
+#include "ut/ut_hash_conc.h"
+#include "ut_bench.h"
+
+#define KEYS            100000
+#define MAX_THREADS     8
+
+typedef struct {
+    ut_hash_t           *ht;
+    ut_hash_conc_t      *conc;
+    pthread_mutex_t     lock;
+    uint32_t            read_pct;
+    uint32_t            ops;
+} bench_ctx_t;
+
+typedef struct {
+    bench_ctx_t *ctx;
+    uint64_t    seed;
+} bench_thread_t;
+
+static char s_keys[KEYS][UT_LEN_16];
+
+static void* __mutex_worker(void* arg)
+{
+    bench_thread_t  *thread = arg;
+    bench_ctx_t     *ctx = thread->ctx;
+    uintptr_t       sum = 0;
+
+    for (uint32_t i = 0; i < ctx->ops; i++) {
+        uint64_t    rand = bench_rand(&thread->seed);
+        const char  *key = s_keys[rand % KEYS];
+
+        pthread_mutex_lock(&ctx->lock);
+        if ((rand >> 32) % 100 < ctx->read_pct) {
+            sum += (uintptr_t)ut_hash_peek(ctx->ht, key);
+        } else if (rand & (1ULL << 63)) {
+            ut_hash_push(ctx->ht, key, (void*)(uintptr_t)rand);
+        } else {
+            ut_hash_pop(ctx->ht, key);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    BENCH_KEEP(sum);
+    return NULL;
+}
+
+static void* __conc_worker(void* arg)
+{
+    bench_thread_t  *thread = arg;
+    bench_ctx_t     *ctx = thread->ctx;
+    uintptr_t       sum = 0;
+
+    for (uint32_t i = 0; i < ctx->ops; i++) {
+        uint64_t    rand = bench_rand(&thread->seed);
+        const char  *key = s_keys[rand % KEYS];
+
+        if ((rand >> 32) % 100 < ctx->read_pct) {
+            sum += (uintptr_t)ut_hash_conc_peek(ctx->conc, key);
+        } else if (rand & (1ULL << 63)) {
+            ut_hash_conc_push(ctx->conc, key, (void*)(uintptr_t)rand);
+        } else {
+            ut_hash_conc_pop(ctx->conc, key);
+        }
+    }
+    BENCH_KEEP(sum);
+    return NULL;
+}
+
+static double __run(bench_ctx_t *ctx, void* (*worker)(void*), uint32_t threads)
+{
+    pthread_t       tids[MAX_THREADS];
+    bench_thread_t  args[MAX_THREADS];
+    int64_t         start = bench_now_ns();
+
+    for (uint32_t i = 0; i < threads; i++) {
+        args[i].ctx = ctx;
+        args[i].seed = i + 1;
+        pthread_create(&tids[i], NULL, worker, &args[i]);
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return (double)ctx->ops * threads * 1e3 / (bench_now_ns() - start);
+}
+
+int main(int argc, char **argv)
+{
+    bench_ctx_t     ctx;
+    static const uint32_t read_pcts[] = {95, 50};
+    char            label[UT_LEN_64];
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.ops = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+    pthread_mutex_init(&ctx.lock, NULL);
+    for (uint32_t i = 0; i < KEYS; i++) {
+        snprintf(s_keys[i], UT_LEN_16, "%u", i * 7 + 3);
+    }
+
+    printf("keys: %u, ops/thread: %u, cpus: %ld\n", KEYS, ctx.ops, sysconf(_SC_NPROCESSORS_ONLN));
+    for (uint32_t r = 0; r < sizeof(read_pcts) / sizeof(read_pcts[0]); r++) {
+        ctx.read_pct = read_pcts[r];
+        for (uint32_t threads = 1; threads <= MAX_THREADS; threads <<= 1) {
+            ut_hash_create(&ctx.ht, KEYS, NULL);
+            ut_hash_conc_create(&ctx.conc, KEYS, 0, NULL);
+            for (uint32_t i = 0; i < KEYS; i += 2) {
+                ut_hash_push(ctx.ht, s_keys[i], (void*)1);
+                ut_hash_conc_push(ctx.conc, s_keys[i], (void*)1);
+            }
+
+            snprintf(label, sizeof(label), "%u%% read, %u threads, global mutex", ctx.read_pct, threads);
+            BENCH_REPORT(label, "%.2f Mops/s", __run(&ctx, __mutex_worker, threads));
+            snprintf(label, sizeof(label), "%u%% read, %u threads, ut_hash_conc", ctx.read_pct, threads);
+            BENCH_REPORT(label, "%.2f Mops/s", __run(&ctx, __conc_worker, threads));
+
+            ut_hash_destroy(ctx.ht);
+            ut_hash_conc_destroy(ctx.conc);
+        }
+    }
+    pthread_mutex_destroy(&ctx.lock);
+    return 0;
+}
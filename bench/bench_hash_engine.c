@@ -0,0 +1,77 @@
+/**
+ * @file bench_hash_engine.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 拉链法与开放寻址两种ut_hash引擎的对比：每秒查找次数（命中、未命中）和每个元素占用的字节数
+ *        用法：bench_hash_engine [元素个数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut/ut_hash.h"
+#include "ut_bench.h"
+
+#define LOOKUPS     4000000
+#define SLAB_SIZE   65536       /* 与ut_hash.c中的HASH_SLAB_SIZE一致，slab直接mmap，不在malloc统计内 */
+
+static void __bench_engine(const char *name, uint32_t flags, uint32_t num, char (*keys)[UT_LEN_16], const uint32_t *order)
+{
+    ut_hash_t       *ht = NULL;
+    ut_hash_stats_t stats;
+    size_t          heap_before = bench_heap_bytes();
+    int64_t         start = 0;
+    uintptr_t       sum = 0;
+    char            miss[UT_LEN_16];
+    char            label[UT_LEN_64];
+
+    ut_hash_create_ex(&ht, 0, NULL, flags);
+    for (uint32_t i = 0; i < num; i++) {
+        ut_hash_push(ht, keys[i], (void*)(uintptr_t)(i + 1));
+    }
+    snprintf(label, sizeof(label), "%s bytes/entry", name);
+    ut_hash_stats(ht, &stats);
+    BENCH_REPORT(label, "%.1f B", (double)(bench_heap_bytes() - heap_before + (size_t)stats.slabs * SLAB_SIZE) / num);
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        sum += (uintptr_t)ut_hash_peek(ht, keys[order[i]]);
+    }
+    snprintf(label, sizeof(label), "%s lookup hit", name);
+    BENCH_REPORT(label, "%.2f Mops/s", LOOKUPS * 1e3 / (bench_now_ns() - start));
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        snprintf(miss, sizeof(miss), "x%u", order[i]);
+        sum += (uintptr_t)ut_hash_peek(ht, miss);
+    }
+    snprintf(label, sizeof(label), "%s lookup miss (incl. key format)", name);
+    BENCH_REPORT(label, "%.2f Mops/s", LOOKUPS * 1e3 / (bench_now_ns() - start));
+
+    BENCH_KEEP(sum);
+    ut_hash_destroy(ht);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        num = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+    char            (*keys)[UT_LEN_16] = malloc((size_t)num * UT_LEN_16);
+    uint32_t        *order = malloc(LOOKUPS * sizeof(uint32_t));
+    uint64_t        seed = 1;
+
+    /* 键的形式与fd、对端地址表相同：短字符串 */
+    for (uint32_t i = 0; i < num; i++) {
+        snprintf(keys[i], UT_LEN_16, "%u", i * 7 + 3);
+    }
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        order[i] = bench_rand(&seed) % num;
+    }
+
+    printf("entries: %u, lookups: %u\n", num, LOOKUPS);
+    __bench_engine("chained", UT_HASH_FLAG_NONE, num, keys, order);
+    __bench_engine("flat", UT_HASH_FLAG_FLAT, num, keys, order);
+
+    free(keys);
+    free(order);
+    return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file bench_hash_func.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 内置哈希函数对比：原来的默认哈希(x33)、FNV-1a、wyhash。
+ *        分布质量按ut_hash的方式用低位选择bucket，统计最长链和空bucket比例；吞吐量按键长分别统计
+ *        用法：bench_hash_func [键个数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut_hash_inn.h"
+#include "ut_bench.h"
+
+#define HASH_ROUNDS     8
+
+typedef struct {
+    const char  *name;
+    uint32_t    (*func)(const void* key, uint32_t keylen);
+} bench_func_t;
+
+static uint64_t s_seed = 0;
+
+static uint32_t __func_x33(const void* key, uint32_t keylen)
+{
+    return __hashfunc_default(key, keylen);
+}
+
+static uint32_t __func_fnv1a(const void* key, uint32_t keylen)
+{
+    return __hashfunc_fnv1a(key, keylen, s_seed);
+}
+
+static uint32_t __func_wy(const void* key, uint32_t keylen)
+{
+    uint64_t    hash = __hashfunc_wy(key, keylen, s_seed);
+
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static const bench_func_t s_funcs[] = {
+    {"x33 (old default)", __func_x33},
+    {"fnv1a", __func_fnv1a},
+    {"wyhash", __func_wy},
+};
+
+/* 按ut_hash的方式用hash & mask选择bucket，bucket数量为不小于键个数的2的幂 */
+static void __quality(const char *set, char (*keys)[UT_LEN_64], uint32_t num)
+{
+    uint32_t    mask = 1;
+    uint32_t    *buckets = NULL;
+    char        label[UT_LEN_128];
+
+    while (mask < num) {
+        mask <<= 1;
+    }
+    buckets = malloc(sizeof(uint32_t) * mask);
+    mask -= 1;
+
+    for (uint32_t f = 0; f < sizeof(s_funcs) / sizeof(s_funcs[0]); f++) {
+        uint32_t    longest = 0;
+        uint32_t    empty = 0;
+
+        memset(buckets, 0, sizeof(uint32_t) * (mask + 1));
+        for (uint32_t i = 0; i < num; i++) {
+            uint32_t    *bucket = &buckets[s_funcs[f].func(keys[i], (uint32_t)strlen(keys[i])) & mask];
+
+            (*bucket)++;
+            longest = *bucket > longest ? *bucket : longest;
+        }
+        for (uint32_t i = 0; i <= mask; i++) {
+            empty += buckets[i] == 0;
+        }
+        snprintf(label, sizeof(label), "%s, %s", set, s_funcs[f].name);
+        BENCH_REPORT(label, "longest chain %u, empty buckets %.1f%%", longest, empty * 100.0 / (mask + 1));
+    }
+    free(buckets);
+}
+
+static void __throughput(uint32_t keylen)
+{
+    char        *key = malloc(keylen + 1);
+    uint32_t    sum = 0;
+    uint32_t    iters = 64 * 1024 * 1024 / (keylen + 16);
+    char        label[UT_LEN_64];
+
+    for (uint32_t i = 0; i < keylen; i++) {
+        key[i] = (char)('a' + i % 26);
+    }
+    key[keylen] = '\0';
+    for (uint32_t f = 0; f < sizeof(s_funcs) / sizeof(s_funcs[0]); f++) {
+        int64_t     start = bench_now_ns();
+
+        for (uint32_t i = 0; i < iters; i++) {
+            key[0] = (char)i;
+            sum += s_funcs[f].func(key, keylen);
+        }
+        snprintf(label, sizeof(label), "%u byte key, %s", keylen, s_funcs[f].name);
+        BENCH_REPORT(label, "%.1f ns/hash", (double)(bench_now_ns() - start) / iters);
+    }
+    BENCH_KEEP(sum);
+    free(key);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        num = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+    char            (*keys)[UT_LEN_64] = malloc((size_t)num * UT_LEN_64);
+    static const uint32_t lens[] = {4, 16, 64, 256, 1024};
+
+    s_seed = __hash_random_seed();
+    printf("keys: %u\n", num);
+
+    /* 连续的数字字符串，例如fd、序号 */
+    for (uint32_t i = 0; i < num; i++) {
+        snprintf(keys[i], UT_LEN_64, "%u", i);
+    }
+    __quality("sequential numbers", keys, num);
+    /* 同一网段的对端地址 */
+    for (uint32_t i = 0; i < num; i++) {
+        snprintf(keys[i], UT_LEN_64, "10.%u.%u.%u:%u", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff, 8000 + i % 16);
+    }
+    __quality("peer addresses", keys, num);
+    /* 只有结尾不同的长键 */
+    for (uint32_t i = 0; i < num; i++) {
+        snprintf(keys[i], UT_LEN_64, "/api/v1/objects/by-owner/default/items/%08u", i);
+    }
+    __quality("long paths", keys, num);
+
+    for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        __throughput(lens[i]);
+    }
+
+    free(keys);
+    return 0;
+}
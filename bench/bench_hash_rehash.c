@@ -0,0 +1,78 @@
+/**
+ * @file bench_hash_rehash.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 持续插入时push/peek的尾延迟：一次性扩容与渐进式扩容(UT_HASH_FLAG_INCREMENTAL)对比
+ *        用法：bench_hash_rehash [插入个数，默认2000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut/ut_hash.h"
+#include "ut_bench.h"
+
+/* 扩容在整个过程中只发生十几次，所以除百分位外还给出最大值和超过100us的次数 */
+static void __report(const char *name, const char *op, int64_t *samples, uint32_t num)
+{
+    int64_t         max = 0;
+    uint32_t        slow = 0;
+    char            label[UT_LEN_64];
+
+    for (uint32_t i = 0; i < num; i++) {
+        max = samples[i] > max ? samples[i] : max;
+        slow += samples[i] > 100 * 1000;
+    }
+    snprintf(label, sizeof(label), "%s %s p50/p99/p999", name, op);
+    BENCH_REPORT(label, "%ld/%ld/%ld ns", (long)bench_percentile(samples, num, 50), (long)bench_percentile(samples, num, 99),
+                 (long)bench_percentile(samples, num, 99.9));
+    snprintf(label, sizeof(label), "%s %s max", name, op);
+    BENCH_REPORT(label, "%.1f us (%u ops > 100 us)", max / 1e3, slow);
+}
+
+static void __bench_rehash(const char *name, uint32_t flags, uint32_t num, char (*keys)[UT_LEN_16])
+{
+    ut_hash_t       *ht = NULL;
+    int64_t         *push_ns = malloc(sizeof(int64_t) * num);
+    int64_t         *peek_ns = malloc(sizeof(int64_t) * num);
+    uint64_t        seed = 1;
+    uintptr_t       sum = 0;
+    int64_t         start = 0;
+
+    /* 从很小的表开始，插入过程中会经历多次扩容 */
+    ut_hash_create_ex(&ht, 16, NULL, flags);
+    for (uint32_t i = 0; i < num; i++) {
+        start = bench_now_ns();
+        ut_hash_push(ht, keys[i], (void*)(uintptr_t)(i + 1));
+        push_ns[i] = bench_now_ns() - start;
+
+        /* 每次插入之后查找一个已存在的键 */
+        start = bench_now_ns();
+        sum += (uintptr_t)ut_hash_peek(ht, keys[bench_rand(&seed) % (i + 1)]);
+        peek_ns[i] = bench_now_ns() - start;
+    }
+    BENCH_KEEP(sum);
+    ut_hash_destroy(ht);
+
+    __report(name, "push", push_ns, num);
+    __report(name, "peek", peek_ns, num);
+    free(push_ns);
+    free(peek_ns);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        num = (uint32_t)bench_arg(argc, argv, 1, 2000000);
+    char            (*keys)[UT_LEN_16] = malloc((size_t)num * UT_LEN_16);
+
+    for (uint32_t i = 0; i < num; i++) {
+        snprintf(keys[i], UT_LEN_16, "%u", i * 7 + 3);
+    }
+
+    printf("inserts: %u\n", num);
+    __bench_rehash("stop-the-world", UT_HASH_FLAG_NONE, num, keys);
+    __bench_rehash("incremental", UT_HASH_FLAG_INCREMENTAL, num, keys);
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file bench_hash_u64_udp.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief UDP按对端地址分发时，每个数据报一次查找的开销：
+ *        最初的sprintf格式化地址+sscanf解析哈希的字符串键、二进制键、ut_hash_u64整数键
+ *        用法：bench_hash_u64_udp [对端个数，默认1000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <netinet/in.h>
+#include "ut/ut_hash.h"
+#include "ut/ut_hash_u64.h"
+#include "ut_bench.h"
+
+#define DATAGRAMS   4000000
+
+/* 最初的哈希函数：把"地址:端口"字符串解析回整数 */
+static uint32_t __hash_sscanf(const char *key)
+{
+    uint32_t        addr = 0;
+    uint16_t        port = 0;
+
+    sscanf(key, "%u:%hu", &addr, &port);
+    return (addr << 16) | port;
+}
+
+typedef struct {
+    in_addr_t   addr;
+    in_port_t   port;
+    uint16_t    reserved;
+} peer_key_t;
+
+int main(int argc, char **argv)
+{
+    uint32_t        peers = (uint32_t)bench_arg(argc, argv, 1, 1000);
+    struct sockaddr_in  *from = malloc(sizeof(struct sockaddr_in) * DATAGRAMS);
+    ut_hash_t       *str_ht = NULL;
+    ut_hash_t       *bin_ht = NULL;
+    ut_hash_u64_t   *u64_ht = NULL;
+    uint64_t        seed = 1;
+    uintptr_t       sum = 0;
+    int64_t         start = 0;
+    char            key[UT_LEN_32];
+
+    ut_hash_create(&str_ht, peers, __hash_sscanf);
+    ut_hash_create(&bin_ht, peers, NULL);
+    ut_hash_u64_create(&u64_ht, peers);
+    for (uint32_t i = 0; i < peers; i++) {
+        in_addr_t   addr = htonl(0x0a000001 + i);
+        in_port_t   port = htons(4000 + i % 1000);
+        peer_key_t  bin = {addr, port, 0};
+
+        snprintf(key, sizeof(key), "%u:%hu", addr, port);
+        ut_hash_push(str_ht, key, (void*)(uintptr_t)(i + 1));
+        ut_hash_push_bin(bin_ht, &bin, sizeof(bin), (void*)(uintptr_t)(i + 1));
+        ut_hash_u64_push(u64_ht, ((uint64_t)addr << 16) | port, (void*)(uintptr_t)(i + 1));
+    }
+    /* 数据报随机来自各个对端 */
+    for (uint32_t i = 0; i < DATAGRAMS; i++) {
+        uint32_t    idx = bench_rand(&seed) % peers;
+
+        from[i].sin_addr.s_addr = htonl(0x0a000001 + idx);
+        from[i].sin_port = htons(4000 + idx % 1000);
+    }
+    printf("peers: %u, datagrams: %u\n", peers, DATAGRAMS);
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < DATAGRAMS; i++) {
+        snprintf(key, sizeof(key), "%u:%hu", from[i].sin_addr.s_addr, from[i].sin_port);
+        sum += (uintptr_t)ut_hash_peek(str_ht, key);
+    }
+    BENCH_REPORT("string key (sprintf + sscanf hash)", "%.1f ns/datagram", (double)(bench_now_ns() - start) / DATAGRAMS);
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < DATAGRAMS; i++) {
+        peer_key_t  bin = {from[i].sin_addr.s_addr, from[i].sin_port, 0};
+
+        sum += (uintptr_t)ut_hash_peek_bin(bin_ht, &bin, sizeof(bin));
+    }
+    BENCH_REPORT("binary key (ut_hash_peek_bin)", "%.1f ns/datagram", (double)(bench_now_ns() - start) / DATAGRAMS);
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < DATAGRAMS; i++) {
+        sum += (uintptr_t)ut_hash_u64_peek(u64_ht, ((uint64_t)from[i].sin_addr.s_addr << 16) | from[i].sin_port);
+    }
+    BENCH_REPORT("u64 key (ut_hash_u64_peek)", "%.1f ns/datagram", (double)(bench_now_ns() - start) / DATAGRAMS);
+
+    BENCH_KEEP(sum);
+    ut_hash_destroy(str_ht);
+    ut_hash_destroy(bin_ht);
+    ut_hash_u64_destroy(u64_ht);
+    free(from);
+    return 0;
+}
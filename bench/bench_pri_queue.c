@@ -0,0 +1,68 @@
+/**
+ * @file bench_pri_queue.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 比较函数优先级队列的入队、出队吞吐量。只使用最初就有的接口，可以直接用旧版本的源码编译做前后对比
+ *        用法：bench_pri_queue [最大元素个数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut/ut_pri_queue.h"
+#include "ut_bench.h"
+
+typedef struct {
+    int64_t     priority;
+} bench_item_t;
+
+static ut_bool_t __item_compare(void* elem1, void* elem2)
+{
+    return ((bench_item_t*)elem1)->priority < ((bench_item_t*)elem2)->priority;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        max = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+    bench_item_t    *items = malloc(sizeof(bench_item_t) * max);
+    uint64_t        seed = 1;
+    char            label[UT_LEN_64];
+
+    for (uint32_t i = 0; i < max; i++) {
+        items[i].priority = (int64_t)(bench_rand(&seed) >> 1);
+    }
+
+    for (uint32_t num = 1000; num <= max; num *= 10) {
+        ut_pri_queue_t  *queue = ut_pri_queue_create(num, UT_FALSE, __item_compare);
+        uint32_t        rounds = max / num;
+        int64_t         push_ns = 0;
+        int64_t         pop_ns = 0;
+        void*           data = NULL;
+
+        /* 小队列重复多轮，保证每个规模的总操作次数相同 */
+        for (uint32_t r = 0; r < rounds; r++) {
+            int64_t     start = bench_now_ns();
+
+            for (uint32_t i = 0; i < num; i++) {
+                ut_pri_queue_push(queue, &items[(r * num + i) % max]);
+            }
+            push_ns += bench_now_ns() - start;
+
+            start = bench_now_ns();
+            for (uint32_t i = 0; i < num; i++) {
+                ut_pri_queue_pop_trywait(queue, &data);
+            }
+            pop_ns += bench_now_ns() - start;
+            BENCH_KEEP(data);
+        }
+        ut_pri_queue_destroy(queue);
+
+        snprintf(label, sizeof(label), "%u elements, push", num);
+        BENCH_REPORT(label, "%.2f Mops/s", (double)rounds * num * 1e3 / push_ns);
+        snprintf(label, sizeof(label), "%u elements, pop", num);
+        BENCH_REPORT(label, "%.2f Mops/s", (double)rounds * num * 1e3 / pop_ns);
+    }
+
+    free(items);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file bench_pri_queue_arity.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 2叉、4叉、8叉堆在不同队列大小下的出队、入队开销。队列先填满，
+ *        之后每次取出一个元素再放入一个优先级更低的元素，队列大小保持不变，与定时器队列的用法相同
+ *        用法：bench_pri_queue_arity [每个规模的操作次数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut/ut_pri_queue.h"
+#include "ut_bench.h"
+
+#define MAX_ELEMS   (4 * 1024 * 1024)
+
+typedef struct {
+    const char  *name;
+    uint32_t    flags;
+} bench_arity_t;
+
+static const bench_arity_t s_arities[] = {
+    {"2-ary", UT_PRI_QUEUE_FLAG_NONE},
+    {"4-ary", UT_PRI_QUEUE_FLAG_4ARY},
+    {"8-ary", UT_PRI_QUEUE_FLAG_8ARY},
+};
+
+static void __bench_size(uint32_t num, uint32_t ops, const bench_arity_t *arity)
+{
+    ut_pri_queue_t  *queue = ut_pri_queue_create_key((int32_t)num, arity->flags);
+    uint64_t        seed = 1;
+    int64_t         key = 0;
+    int64_t         pop_ns = 0;
+    int64_t         push_ns = 0;
+    void*           data = NULL;
+    char            label[UT_LEN_64];
+
+    for (uint32_t i = 0; i < num; i++) {
+        ut_pri_queue_push_key(queue, (int64_t)(bench_rand(&seed) % (num * 16ULL)), NULL, NULL);
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        int64_t     start = bench_now_ns();
+
+        ut_pri_queue_pop_key(queue, &key, &data, 0);
+        pop_ns += bench_now_ns() - start;
+
+        start = bench_now_ns();
+        ut_pri_queue_push_key(queue, key + (int64_t)(bench_rand(&seed) % (num * 16ULL)), data, NULL);
+        push_ns += bench_now_ns() - start;
+    }
+    ut_pri_queue_destroy(queue);
+
+    snprintf(label, sizeof(label), "%u elements, %s", num, arity->name);
+    BENCH_REPORT(label, "pop %.1f ns, push %.1f ns", (double)pop_ns / ops, (double)push_ns / ops);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        ops = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+
+    printf("ops per size: %u\n", ops);
+    for (uint32_t num = 1024; num <= MAX_ELEMS; num *= 4) {
+        for (uint32_t a = 0; a < sizeof(s_arities) / sizeof(s_arities[0]); a++) {
+            __bench_size(num, ops, &s_arities[a]);
+        }
+    }
+    return 0;
+}
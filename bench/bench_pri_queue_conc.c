@@ -0,0 +1,104 @@
+/**
+ * @file bench_pri_queue_conc.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 吞吐量随线程数的变化：一把锁保护的ut_pri_queue与分片的ut_pri_queue_conc对比。
+ *        队列预先放入一批元素，每个线程交替入队、出队
+ *        用法：bench_pri_queue_conc [每个线程的操作次数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <pthread.h>
+#include "ut/ut_pri_queue.h"
+#include "ut/ut_pri_queue_conc.h"
+#include "ut_bench.h"
+
+#define PREFILL         100000
+#define MAX_THREADS     8
+
+typedef struct {
+    ut_pri_queue_t      *queue;
+    ut_pri_queue_conc_t *conc;
+    uint32_t            ops;
+    uint64_t            seed;
+} bench_thread_t;
+
+static ut_bool_t __value_compare(void* elem1, void* elem2)
+{
+    return (uintptr_t)elem1 < (uintptr_t)elem2;
+}
+
+static void* __queue_worker(void* arg)
+{
+    bench_thread_t  *thread = arg;
+    void*           data = NULL;
+
+    for (uint32_t i = 0; i < thread->ops; i++) {
+        ut_pri_queue_push(thread->queue, (void*)(uintptr_t)(bench_rand(&thread->seed) | 1));
+        ut_pri_queue_pop_trywait(thread->queue, &data);
+    }
+    return NULL;
+}
+
+static void* __conc_worker(void* arg)
+{
+    bench_thread_t  *thread = arg;
+    void*           data = NULL;
+
+    for (uint32_t i = 0; i < thread->ops; i++) {
+        ut_pri_queue_conc_push(thread->conc, (void*)(uintptr_t)(bench_rand(&thread->seed) | 1));
+        ut_pri_queue_conc_pop_trywait(thread->conc, &data);
+    }
+    return NULL;
+}
+
+static double __run(void* (*worker)(void*), ut_pri_queue_t *queue, ut_pri_queue_conc_t *conc, uint32_t threads, uint32_t ops)
+{
+    pthread_t       tids[MAX_THREADS];
+    bench_thread_t  args[MAX_THREADS];
+    int64_t         start = bench_now_ns();
+
+    for (uint32_t i = 0; i < threads; i++) {
+        args[i].queue = queue;
+        args[i].conc = conc;
+        args[i].ops = ops;
+        args[i].seed = i + 1;
+        pthread_create(&tids[i], NULL, worker, &args[i]);
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    /* 一次入队加一次出队算两次操作 */
+    return (double)ops * threads * 2 * 1e3 / (bench_now_ns() - start);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        ops = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+    uint64_t        seed = 100;
+    char            label[UT_LEN_64];
+
+    printf("prefill: %u, push+pop pairs/thread: %u, cpus: %ld\n", PREFILL, ops, sysconf(_SC_NPROCESSORS_ONLN));
+    for (uint32_t threads = 1; threads <= MAX_THREADS; threads <<= 1) {
+        ut_pri_queue_t      *queue = ut_pri_queue_create(PREFILL * 2, UT_TRUE, __value_compare);
+        ut_pri_queue_conc_t *conc = ut_pri_queue_conc_create(PREFILL * 2, 0, __value_compare);
+
+        for (uint32_t i = 0; i < PREFILL; i++) {
+            void*   data = (void*)(uintptr_t)(bench_rand(&seed) | 1);
+
+            ut_pri_queue_push(queue, data);
+            ut_pri_queue_conc_push(conc, data);
+        }
+
+        snprintf(label, sizeof(label), "%u threads, ut_pri_queue (one lock)", threads);
+        BENCH_REPORT(label, "%.2f Mops/s", __run(__queue_worker, queue, NULL, threads, ops));
+        snprintf(label, sizeof(label), "%u threads, ut_pri_queue_conc", threads);
+        BENCH_REPORT(label, "%.2f Mops/s", __run(__conc_worker, NULL, conc, threads, ops));
+
+        ut_pri_queue_destroy(queue);
+        ut_pri_queue_conc_destroy(conc);
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file bench_pri_queue_engine.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 基数堆、桶队列与二叉堆的对比。定时器场景：键单调递增，每次取出最早的键再放入一个更晚的键；
+ *        消息通道场景：只有8个优先级，每次取出一个再放入一个随机优先级
+ *        用法：bench_pri_queue_engine [每个规模的操作次数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut/ut_pri_queue.h"
+#include "ut_bench.h"
+
+#define BENCH_LEVELS    8
+
+/* 先放入num个元素，之后整个pop+push循环一起计时 */
+static void __bench_hold(ut_pri_queue_t *queue, uint32_t num, uint32_t ops, ut_bool_t monotone, const char *name)
+{
+    uint64_t        seed = 1;
+    int64_t         *keys = malloc(sizeof(int64_t) * ops);
+    int64_t         start = 0;
+    char            label[UT_LEN_64];
+
+    for (uint32_t i = 0; i < num; i++) {
+        ut_pri_queue_push_key(queue, monotone ? (int64_t)(bench_rand(&seed) % (num * 1000ULL)) : (int64_t)(bench_rand(&seed) % BENCH_LEVELS), NULL, NULL);
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        keys[i] = monotone ? (int64_t)(bench_rand(&seed) % (num * 1000ULL)) : (int64_t)(bench_rand(&seed) % BENCH_LEVELS);
+    }
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < ops; i++) {
+        int64_t     key = 0;
+        void*       data = NULL;
+
+        ut_pri_queue_pop_key(queue, &key, &data, 0);
+        ut_pri_queue_push_key(queue, monotone ? key + keys[i] : keys[i], data, NULL);
+    }
+    snprintf(label, sizeof(label), "%u elems, %s", num, name);
+    BENCH_REPORT(label, "%.1f ns/pop+push", (double)(bench_now_ns() - start) / ops);
+
+    ut_pri_queue_destroy(queue);
+    free(keys);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        ops = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+
+    printf("ops per size: %u\n", ops);
+    for (uint32_t num = 1024; num <= 1024 * 1024; num *= 32) {
+        __bench_hold(ut_pri_queue_create_key(num, UT_PRI_QUEUE_FLAG_NONE), num, ops, UT_TRUE, "timers, binary heap");
+        __bench_hold(ut_pri_queue_create_key(num, UT_PRI_QUEUE_FLAG_RADIX), num, ops, UT_TRUE, "timers, radix heap");
+        __bench_hold(ut_pri_queue_create_key(num, UT_PRI_QUEUE_FLAG_NONE), num, ops, UT_FALSE, "8 levels, binary heap");
+        __bench_hold(ut_pri_queue_create_bucket(num, BENCH_LEVELS, UT_PRI_QUEUE_FLAG_NONE), num, ops, UT_FALSE, "8 levels, bucket queue");
+    }
+    return 0;
+}
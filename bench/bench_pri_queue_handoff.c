@@ -0,0 +1,64 @@
+/**
+ * @file bench_pri_queue_handoff.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 生产者到消费者的交接延迟：消费者在空队列上等待，生产者间隔一段时间放入一个带有时间戳的元素，
+ *        统计从入队到消费者取出的时间。对比直接睡眠和UT_PRI_QUEUE_FLAG_SPIN先自旋再睡眠
+ *        用法：bench_pri_queue_handoff [交接次数，默认20000] [生产间隔us，默认20]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <pthread.h>
+#include "ut/ut_pri_queue.h"
+#include "ut_bench.h"
+
+typedef struct {
+    ut_pri_queue_t  *queue;
+    uint32_t        num;
+    int64_t         *latency;
+} bench_handoff_t;
+
+static void* __consumer(void* arg)
+{
+    bench_handoff_t *handoff = arg;
+    int64_t         stamp = 0;
+
+    for (uint32_t i = 0; i < handoff->num; i++) {
+        ut_pri_queue_pop_key(handoff->queue, &stamp, NULL, -1);
+        handoff->latency[i] = bench_now_ns() - stamp;
+    }
+    return NULL;
+}
+
+static void __bench_handoff(const char *name, uint32_t flags, uint32_t num, uint32_t gap_us)
+{
+    bench_handoff_t handoff = {ut_pri_queue_create_key(16, flags), num, malloc(sizeof(int64_t) * num)};
+    pthread_t       tid;
+    char            label[UT_LEN_64];
+
+    pthread_create(&tid, NULL, __consumer, &handoff);
+    for (uint32_t i = 0; i < num; i++) {
+        usleep(gap_us);
+        ut_pri_queue_push_key(handoff.queue, bench_now_ns(), NULL, NULL);
+    }
+    pthread_join(tid, NULL);
+
+    snprintf(label, sizeof(label), "%s p50/p99/p999", name);
+    BENCH_REPORT(label, "%.1f/%.1f/%.1f us", bench_percentile(handoff.latency, num, 50) / 1e3,
+                 bench_percentile(handoff.latency, num, 99) / 1e3, bench_percentile(handoff.latency, num, 99.9) / 1e3);
+    ut_pri_queue_destroy(handoff.queue);
+    free(handoff.latency);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        num = (uint32_t)bench_arg(argc, argv, 1, 20000);
+    uint32_t        gap_us = (uint32_t)bench_arg(argc, argv, 2, 20);
+
+    printf("handoffs: %u, gap: %u us, cpus: %ld\n", num, gap_us, sysconf(_SC_NPROCESSORS_ONLN));
+    __bench_handoff("park (condvar)", UT_PRI_QUEUE_FLAG_NONE, num, gap_us);
+    __bench_handoff("spin then park", UT_PRI_QUEUE_FLAG_SPIN, num, gap_us);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file bench_pri_queue_key.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 定时器队列的开销：原来以timeval比较函数排序的队列与整数键队列对比。
+ *        队列先填满，之后每次取出最早到期的定时器再放入一个更晚到期的定时器，主要开销在出队的下沉
+ *        用法：bench_pri_queue_key [每个规模的操作次数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <sys/time.h>
+#include "ut/ut_pri_queue.h"
+#include "ut_bench.h"
+
+/* 与原来select引擎中的定时事件相同 */
+typedef struct {
+    void*           cb;
+    void*           context;
+    struct timeval  time;
+} bench_event_t;
+
+/* 原来select引擎中的比较函数 */
+static ut_bool_t __event_compare(void* event1, void* event2)
+{
+    int64_t     tmp_s = ((bench_event_t*)event1)->time.tv_sec - ((bench_event_t*)event2)->time.tv_sec;
+    int64_t     tmp_us = ((bench_event_t*)event1)->time.tv_usec - ((bench_event_t*)event2)->time.tv_usec;
+
+    return (tmp_s < 0) || (!tmp_s && tmp_us <= 0);
+}
+
+static inline void __us_to_timeval(int64_t us, struct timeval *tv)
+{
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+}
+
+static void __bench_size(uint32_t num, uint32_t ops, uint32_t flags, const char *name)
+{
+    ut_pri_queue_t  *cmp_queue = ut_pri_queue_create_ex(num, flags, __event_compare);
+    ut_pri_queue_t  *key_queue = ut_pri_queue_create_key(num, flags);
+    bench_event_t   *events = malloc(sizeof(bench_event_t) * num);
+    int64_t         *delays = malloc(sizeof(int64_t) * ops);
+    uint64_t        seed = 1;
+    int64_t         start = 0;
+    char            label[UT_LEN_64];
+
+    /* 两个队列放入相同的到期时间，范围为队列大小的1000倍微秒 */
+    for (uint32_t i = 0; i < num; i++) {
+        int64_t     expire = (int64_t)(bench_rand(&seed) % (num * 1000ULL));
+
+        __us_to_timeval(expire, &events[i].time);
+        ut_pri_queue_push(cmp_queue, &events[i]);
+        ut_pri_queue_push_key(key_queue, expire, &events[i], NULL);
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        delays[i] = (int64_t)(bench_rand(&seed) % (num * 1000ULL));
+    }
+
+    /* 整个循环一起计时，避免每次操作读取时钟的开销 */
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < ops; i++) {
+        bench_event_t   *event = NULL;
+
+        ut_pri_queue_pop_trywait(cmp_queue, (void**)&event);
+        __us_to_timeval(event->time.tv_sec * 1000000 + event->time.tv_usec + delays[i], &event->time);
+        ut_pri_queue_push(cmp_queue, event);
+    }
+    snprintf(label, sizeof(label), "%u timers, %s, timeval comparator", num, name);
+    BENCH_REPORT(label, "%.1f ns/pop+push", (double)(bench_now_ns() - start) / ops);
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < ops; i++) {
+        int64_t     key = 0;
+        void*       data = NULL;
+
+        ut_pri_queue_pop_key(key_queue, &key, &data, 0);
+        ut_pri_queue_push_key(key_queue, key + delays[i], data, NULL);
+    }
+    snprintf(label, sizeof(label), "%u timers, %s, int64 key", num, name);
+    BENCH_REPORT(label, "%.1f ns/pop+push", (double)(bench_now_ns() - start) / ops);
+
+    ut_pri_queue_destroy(cmp_queue);
+    ut_pri_queue_destroy(key_queue);
+    free(events);
+    free(delays);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        ops = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+
+    printf("ops per size: %u\n", ops);
+    for (uint32_t num = 1024; num <= 1024 * 1024; num *= 8) {
+        __bench_size(num, ops, UT_PRI_QUEUE_FLAG_NONE, "2-ary");
+        __bench_size(num, ops, UT_PRI_QUEUE_FLAG_4ARY, "4-ary");
+    }
+    return 0;
+}
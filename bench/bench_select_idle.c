@@ -0,0 +1,99 @@
+/**
+ * @file bench_select_idle.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 大量空闲连接下每次唤醒的开销：注册N个从不可读的socket（未绑定的UDP socket，每个只占一个fd），只有一个socket在两个回调之间来回传递一个字节，
+ *        统计每次唤醒的平均时间。select每轮都要重建fd_set并遍历全部注册，epoll只处理就绪的fd。
+ *        select后端只能注册FD_SETSIZE以内的fd，超出的规模只测试epoll
+ *        用法：bench_select_idle [唤醒次数，默认20000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include "ut/ut_select.h"
+#include "ut_bench.h"
+
+typedef struct {
+    ut_select_engine_t  *engine;
+    int32_t             pair[2];
+    uint32_t            count;
+    uint32_t            wakeups;
+} bench_pingpong_t;
+
+static void __idle_cb(ut_fd_t fd, void* context)
+{
+}
+
+static void __active_cb(ut_fd_t fd, void* context)
+{
+    bench_pingpong_t    *pingpong = context;
+    char                byte = 0;
+
+    read(fd, &byte, 1);
+    if (++pingpong->count >= pingpong->wakeups) {
+        ut_select_engine_stop(pingpong->engine);
+        return;
+    }
+    write(pingpong->pair[1], &byte, 1);
+}
+
+static void __bench_idle(ut_select_backend_t backend, uint32_t idle, uint32_t wakeups)
+{
+    bench_pingpong_t    pingpong = {NULL, {-1, -1}, 0, wakeups};
+    int32_t             *idle_fds = malloc(sizeof(int32_t) * idle);
+    int64_t             start = 0;
+    char                label[UT_LEN_64];
+    char                byte = 'x';
+
+    ut_select_engine_create_ex(&pingpong.engine, backend);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, pingpong.pair);
+    ut_select_engine_fd_add_forever(pingpong.engine, pingpong.pair[0], __active_cb, &pingpong);
+
+    /* 空闲连接：没有数据到达，fd永远不可读 */
+    for (uint32_t i = 0; i < idle; i++) {
+        idle_fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        ut_select_engine_fd_add_forever(pingpong.engine, idle_fds[i], __idle_cb, NULL);
+    }
+
+    write(pingpong.pair[1], &byte, 1);
+    start = bench_now_ns();
+    ut_select_engine_run(pingpong.engine);
+    snprintf(label, sizeof(label), "%s, %u idle fds", backend == UT_SELECT_BACKEND_EPOLL ? "epoll" : "select", idle);
+    BENCH_REPORT(label, "%.2f us/wakeup", (double)(bench_now_ns() - start) / wakeups / 1e3);
+
+    for (uint32_t i = 0; i < idle; i++) {
+        ut_select_engine_fd_del(pingpong.engine, idle_fds[i]);
+        close(idle_fds[i]);
+    }
+    ut_select_engine_destroy(pingpong.engine);
+    close(pingpong.pair[0]);
+    close(pingpong.pair[1]);
+    free(idle_fds);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t        wakeups = (uint32_t)bench_arg(argc, argv, 1, 20000);
+    struct rlimit   limit;
+
+    /* 10000个连接超过默认的1024个fd */
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    printf("wakeups: %u, fd limit: %lu\n", wakeups, (unsigned long)limit.rlim_cur);
+    for (uint32_t idle = 10; idle <= 10000; idle *= 10) {
+        /* 再加上标准输入输出、管理管道和活跃的连接 */
+        if (idle + 16 < FD_SETSIZE) {
+            __bench_idle(UT_SELECT_BACKEND_SELECT, idle, wakeups);
+        }
+        if (idle + 16 < limit.rlim_cur) {
+            __bench_idle(UT_SELECT_BACKEND_EPOLL, idle, wakeups);
+        }
+    }
+    return 0;
+}
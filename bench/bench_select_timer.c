@@ -0,0 +1,76 @@
+/**
+ * @file bench_select_timer.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief select事件引擎定时器的开销：添加后立即删除（如请求超时），先添加N个再按随机顺序全部删除，
+ *        以及N个定时器全部到期的分发。到期时间分布在数秒到数十秒，覆盖时间轮的多个层
+ *        用法：bench_select_timer [定时器个数，默认1000000]
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut/ut_select.h"
+#include "ut_bench.h"
+
+typedef struct {
+    ut_select_engine_t  *engine;
+    uint32_t            fired;
+    uint32_t            num;
+} bench_timer_t;
+
+static void __timer_cb(void* context)
+{
+    bench_timer_t   *timer = context;
+
+    if (++timer->fired == timer->num) {
+        ut_select_engine_stop(timer->engine);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t            num = (uint32_t)bench_arg(argc, argv, 1, 1000000);
+    ut_select_timer_t   *ids = malloc(sizeof(ut_select_timer_t) * num);
+    bench_timer_t       timer = {NULL, 0, num};
+    uint64_t            seed = 1;
+    size_t              heap_before = 0;
+    int64_t             start = 0;
+
+    ut_select_engine_create_ex(&timer.engine, UT_SELECT_BACKEND_EPOLL);
+    printf("timers: %u\n", num);
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < num; i++) {
+        ut_select_engine_schedule_add_ex(timer.engine, __timer_cb, &timer, 1000000 + (int64_t)(bench_rand(&seed) % 30000000), &ids[i]);
+        ut_select_engine_schedule_del(timer.engine, ids[i]);
+    }
+    BENCH_REPORT("add then cancel at once", "%.1f ns/timer", (double)(bench_now_ns() - start) / num);
+
+    heap_before = bench_heap_bytes();
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < num; i++) {
+        ut_select_engine_schedule_add_ex(timer.engine, __timer_cb, &timer, 1000000 + (int64_t)(bench_rand(&seed) % 30000000), &ids[i]);
+    }
+    BENCH_REPORT("add with all live", "%.1f ns/timer", (double)(bench_now_ns() - start) / num);
+    BENCH_REPORT("memory with all live", "%.1f B/timer", (double)(bench_heap_bytes() - heap_before) / num);
+
+    /* 按与添加无关的顺序删除 */
+    start = bench_now_ns();
+    for (uint64_t i = 0; i < num; i++) {
+        ut_select_engine_schedule_del(timer.engine, ids[(i * 7919) % num]);
+    }
+    BENCH_REPORT("cancel all in random order", "%.1f ns/timer", (double)(bench_now_ns() - start) / num);
+
+    /* 到期时间分布在200ms内，计时包含等待的时间 */
+    for (uint32_t i = 0; i < num; i++) {
+        ut_select_engine_schedule_add(timer.engine, __timer_cb, &timer, 1000 + (int64_t)(bench_rand(&seed) % 200000));
+    }
+    start = bench_now_ns();
+    ut_select_engine_run(timer.engine);
+    BENCH_REPORT("fire all (incl. waiting up to 200 ms)", "%.1f ns/timer", (double)(bench_now_ns() - start) / num);
+
+    ut_select_engine_destroy(timer.engine);
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file ut_bench.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 性能测试共用的计时、内存统计和随机数。每个性能测试是一个独立的可执行文件，
+ *        第一个参数可以指定规模，结果每行一项，格式为"名称  数值 单位"
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_BENCH_H__
+#define __UTILS_BENCH_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <malloc.h>
+#include "ut/ut.h"
+
+#define BENCH_REPORT(name, fmt, ...)    printf("%-48s " fmt "\n", name, ##__VA_ARGS__)
+
+/* 阻止编译器把结果没有被使用的计算优化掉 */
+#define BENCH_KEEP(val)     __asm__ volatile("" : : "g"(val) : "memory")
+
+static inline int64_t bench_now_ns(void)
+{
+    struct timespec     now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 * 1000 * 1000 + now.tv_nsec;
+}
+
+/**
+ * @brief 当前通过malloc分配出去的字节数，前后两次相减得到一段代码占用的堆内存
+ */
+static inline size_t bench_heap_bytes(void)
+{
+    struct mallinfo2    info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+}
+
+/**
+ * @brief 进程的常驻内存，单位KB
+ */
+static inline long bench_rss_kb(void)
+{
+    long        pages = 0;
+    long        resident = 0;
+    FILE        *fp = fopen("/proc/self/statm", "r");
+
+    if (fp == NULL) {
+        return -1;
+    }
+    if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    fclose(fp);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @brief 可复现的伪随机数（splitmix64）
+ */
+static inline uint64_t bench_rand(uint64_t *state)
+{
+    uint64_t    z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static int __bench_cmp_i64(const void *a, const void *b)
+{
+    int64_t     x = *(const int64_t*)a;
+    int64_t     y = *(const int64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief 对样本排序后取百分位，会修改样本的顺序
+ *
+ * @param [inout] samples 样本
+ * @param [in] num 样本个数
+ * @param [in] pct 百分位，如99.9
+ * @return int64_t
+ */
+static inline int64_t bench_percentile(int64_t *samples, size_t num, double pct)
+{
+    size_t      idx = 0;
+
+    if (num == 0) {
+        return 0;
+    }
+    qsort(samples, num, sizeof(int64_t), __bench_cmp_i64);
+    idx = (size_t)(pct / 100.0 * (double)(num - 1) + 0.5);
+    return samples[min(idx, num - 1)];
+}
+
+/**
+ * @brief 从命令行取规模参数，没有指定时使用默认值
+ */
+static inline long bench_arg(int argc, char **argv, int idx, long def)
+{
+    return argc > idx ? atol(argv[idx]) : def;
+}
+
+#endif
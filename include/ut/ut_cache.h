@@ -0,0 +1,156 @@
+/**
+ * @file ut_cache.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 有容量上限的缓存。基于哈希表查找，按LRU顺序淘汰，支持每个元素单独的过期时间。
+ *        命中路径上只有一次哈希表查找和链表指针的调整，不会申请内存。非线程安全
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_CACHE_H__
+#define __UTILS_CACHE_H__
+
+#include "ut.h"
+
+#define UT_CACHE_TTL_DEFAULT    0           /* 使用创建缓存时指定的过期时间 */
+#define UT_CACHE_TTL_NONE       UINT32_MAX  /* 永不过期 */
+
+/**
+ * @brief 缓存的描述结构
+ *
+ */
+typedef struct ut_cache_t ut_cache_t;
+
+/**
+ * @brief 元素离开缓存的原因
+ *
+ */
+typedef enum {
+    UT_CACHE_EVICT_CAPACITY = 0,    /* 超出容量上限被淘汰 */
+    UT_CACHE_EVICT_EXPIRED,         /* 过期 */
+    UT_CACHE_EVICT_REPLACED,        /* 被同一个键的新值替换 */
+    UT_CACHE_EVICT_CLEAR,           /* 缓存被销毁 */
+} ut_cache_reason_t;
+
+/**
+ * @brief 缓存的统计信息
+ *
+ */
+typedef struct ut_cache_stats {
+    uint64_t hits;              /* 命中次数 */
+    uint64_t misses;            /* 未命中次数（包括已过期） */
+    uint64_t inserts;           /* 插入新元素次数 */
+    uint64_t evictions;         /* 超出容量被淘汰的次数 */
+    uint64_t expirations;       /* 过期被移除的次数 */
+    uint32_t count;             /* 当前元素数量 */
+    size_t usage;               /* 当前占用的容量 */
+    size_t budget;              /* 容量上限 */
+} ut_cache_stats_t;
+
+
+__BEGIN_DECLS
+
+/**
+ * @brief 元素被缓存移除时的回调函数，由调用者释放值占用的资源。调用ut_cache_del移除的元素不会回调
+ *
+ * @param [in] key 元素的键
+ * @param [in] keylen 键的长度
+ * @param [in] value 元素的值
+ * @param [in] reason 移除的原因
+ * @param [in] context 回调者依赖的上下文
+ */
+typedef void (*ut_cache_evict_cb)(const void *key, uint32_t keylen, void* value, ut_cache_reason_t reason, void* context);
+
+/**
+ * @brief 创建一个缓存
+ *
+ * @param [out] pcache 传出参数
+ * @param [in] budget 容量上限，所有元素的占用之和不会超过该值
+ * @param [in] ttl_ms 元素默认的过期时间（毫秒），传入0表示默认永不过期
+ * @param [in] evict 元素被移除时的回调函数，可以为NULL
+ * @param [in] context 回调者依赖的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_cache_create(ut_cache_t **pcache, size_t budget, uint32_t ttl_ms, ut_cache_evict_cb evict, void* context);
+
+/**
+ * @brief 销毁缓存，剩余的元素会以UT_CACHE_EVICT_CLEAR回调
+ *
+ * @param [in] cache 待销毁的缓存
+ * @return ut_errno_t
+ */
+ut_errno_t ut_cache_destroy(ut_cache_t *cache);
+
+/**
+ * @brief 将键值对放入缓存，占用按元素自身的大小计算，使用默认的过期时间
+ *
+ * @param [in] cache 缓存的描述结构
+ * @param [in] key 元素的键
+ * @param [in] value 元素的值，不能为NULL
+ * @return ut_errno_t
+ */
+ut_errno_t ut_cache_put(ut_cache_t *cache, const char *key, const void* value);
+
+/**
+ * @brief 将键值对放入缓存。键已经存在时替换旧值，旧值以UT_CACHE_EVICT_REPLACED回调。
+ *        占用超过容量上限时从最久未使用的元素开始淘汰
+ *
+ * @param [in] cache 缓存的描述结构
+ * @param [in] key 元素的键
+ * @param [in] keylen 键的长度
+ * @param [in] value 元素的值，不能为NULL
+ * @param [in] charge 元素的占用，传入0按元素自身的大小计算
+ * @param [in] ttl_ms 过期时间（毫秒），可以为UT_CACHE_TTL_DEFAULT或UT_CACHE_TTL_NONE
+ * @return ut_errno_t 占用超过容量上限时返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_cache_put_bin(ut_cache_t *cache, const void *key, uint32_t keylen, const void* value, size_t charge, uint32_t ttl_ms);
+
+/**
+ * @brief 获取与键相关联的值，命中的元素成为最近使用的元素。过期的元素会被移除并视为未命中
+ *
+ * @param [in] cache 缓存的描述结构
+ * @param [in] key 元素的键
+ * @return void* 元素的值，未命中返回NULL
+ */
+void* ut_cache_get(ut_cache_t *cache, const char *key);
+
+/**
+ * @brief 同ut_cache_get，使用二进制键
+ */
+void* ut_cache_get_bin(ut_cache_t *cache, const void *key, uint32_t keylen);
+
+/**
+ * @brief 从缓存中移除与键相关联的元素，不会回调
+ *
+ * @param [in] cache 缓存的描述结构
+ * @param [in] key 元素的键
+ * @return void* 元素的值，不存在返回NULL
+ */
+void* ut_cache_del(ut_cache_t *cache, const char *key);
+
+/**
+ * @brief 同ut_cache_del，使用二进制键
+ */
+void* ut_cache_del_bin(ut_cache_t *cache, const void *key, uint32_t keylen);
+
+/**
+ * @brief 移除所有已经过期的元素，会遍历整个缓存
+ *
+ * @param [in] cache 缓存的描述结构
+ * @return uint32_t 被移除的元素数量
+ */
+uint32_t ut_cache_purge(ut_cache_t *cache);
+
+/**
+ * @brief 获取缓存的统计信息
+ *
+ * @param [in] cache 缓存的描述结构
+ * @param [out] stats 统计信息
+ * @return ut_errno_t
+ */
+ut_errno_t ut_cache_stats(ut_cache_t *cache, ut_cache_stats_t *stats);
+
+__END_DECLS
+#endif
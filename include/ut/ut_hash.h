@@ -20,11 +20,48 @@
  */
 typedef struct ut_hash_t ut_hash_t;
 
+/**
+ * @brief 创建哈希表时使用的标志位，可以按位或组合
+ * 
+ */
+typedef enum {
+    UT_HASH_FLAG_NONE = 0,          /* 默认：拉链法哈希表 */
+    UT_HASH_FLAG_FLAT = 1 << 0,     /* 开放寻址引擎：元素平铺存放，按控制字节分组进行SIMD探测 */
+    UT_HASH_FLAG_INCREMENTAL = 1 << 1,  /* 渐进式扩容：新旧bucket数组同时存在，每次操作迁移少量bucket，仅拉链法有效 */
+    UT_HASH_FLAG_HASH_FNV1A = 1 << 2,   /* 内置哈希函数使用FNV-1a，逐字节计算，适合很短的键 */
+    UT_HASH_FLAG_HASH_WY = 1 << 3,      /* 内置哈希函数使用wyhash，每次读取8字节，适合较长的键 */
+    UT_HASH_FLAG_SEED = 1 << 4,         /* 每个哈希表使用随机种子，外部无法构造碰撞的键；未指定哈希函数时使用wyhash */
+} ut_hash_flag_t;
+
+#define UT_HASH_STATS_HIST  16  /* 链长/探测长度直方图的格数，最后一格包含所有更长的 */
+
+/**
+ * @brief 哈希表的统计信息
+ * 
+ */
+typedef struct ut_hash_stats {
+    uint32_t count;             /* 元素数量 */
+    uint32_t buckets;           /* bucket数量（开放寻址哈希表为槽位数量） */
+    double load_factor;         /* 负载因子 count / buckets */
+    uint32_t histogram[UT_HASH_STATS_HIST];    /* 拉链法：长度为i的链表数量；开放寻址：离起始组i个组的元素数量 */
+    uint32_t max_length;        /* 最长的链表长度/最远的探测距离 */
+    uint32_t free_count;        /* 空闲链表中的元素数量 */
+    uint32_t slabs;             /* 元素占用的slab数量 */
+    uint32_t deleted;           /* 开放寻址哈希表中已删除状态的槽位数量 */
+    ut_bool_t rehashing;        /* 是否正在渐进式扩容 */
+    ut_bool_t counter_enabled;  /* 是否开启了操作计数（编译时定义ENABLE_HASH_STATS） */
+    uint64_t hits;              /* 查找命中次数 */
+    uint64_t misses;            /* 查找未命中次数 */
+    uint64_t inserts;           /* 插入新元素次数 */
+    uint64_t deletes;           /* 删除元素次数 */
+    uint64_t resizes;           /* 扩容/收缩次数 */
+} ut_hash_stats_t;
+
 
 __BEGIN_DECLS
 
 /**
- * @brief 计算哈希值的哈希函数
+ * @brief 计算哈希值的哈希函数。只作用于字符串键，二进制键（*_bin接口）总是使用内置的哈希函数
  * 
  * @param [in] key 元素的键
  * @return 返回哈希值
@@ -42,6 +79,25 @@ typedef uint32_t (*ut_hash_func)(const char *key);
  */
 typedef ut_bool_t (*ut_hash_cb)(const char *key, const void* value, void* context);
 
+/**
+ * @brief 遍历哈希表所有元素使用的回调函数，键以二进制的形式给出
+ * 
+ * @param [in] key 存入哈希表的元素的键
+ * @param [in] keylen 键的长度
+ * @param [in] value 存入哈希表的元素的值
+ * @param [in] context 回调者依赖的上下文
+ * @return 返回CR_UT_FALSE将会停止遍历立即结束
+ */
+typedef ut_bool_t (*ut_hash_bin_cb)(const void *key, uint32_t keylen, const void* value, void* context);
+
+/**
+ * @brief 并行遍历结束后对每个线程的上下文依次调用的归并函数，在调用ut_hash_foreach_parallel的线程中执行
+ * 
+ * @param [in] local 线程私有的上下文
+ * @param [in] context 调用者传入的上下文
+ */
+typedef void (*ut_hash_reduce_cb)(void* local, void* context);
+
 /**
  * @brief 创建一个哈希表
  * 
@@ -52,6 +108,17 @@ typedef ut_bool_t (*ut_hash_cb)(const char *key, const void* value, void* contex
  */
 ut_errno_t ut_hash_create(ut_hash_t **pht, uint32_t size, ut_hash_func ut_hash_func);
 
+/**
+ * @brief 创建一个哈希表，并通过标志位选择哈希表的实现
+ * 
+ * @param [out] pht 传出参数
+ * @param [in] size 创建的哈希表的预期元素数量
+ * @param [in] ut_hash_func 计算哈希值的哈希函数，如果传入NULL则会使用内置的默认哈希函数
+ * @param [in] flags ut_hash_flag_t标志位的组合
+ * @return ut_errno_t 
+ */
+ut_errno_t ut_hash_create_ex(ut_hash_t **pht, uint32_t size, ut_hash_func ut_hash_func, uint32_t flags);
+
 
 /**
  * @brief 销毁一个哈希表
@@ -88,6 +155,165 @@ void* ut_hash_peek(ut_hash_t *ht, const char *key);
  */
 void* ut_hash_pop(ut_hash_t *ht, const char *key);
 
+/**
+ * @brief 将一个数据以及与他相关联的二进制键组成一个键值对放进哈希表中。
+ *        键的内容会被复制，短键直接存放在元素内，长键存放在哈希表自己管理的内存中，不会被截断
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 存入哈希表的元素的键
+ * @param [in] keylen 键的长度，不能超过UINT32_MAX - 1，超出时不存入并返回NULL
+ * @param [in] val 存入哈希表的元素的值，传入NULL等同于ut_hash_pop_bin
+ * @return void* 如果发生碰撞，将会返回碰撞的元素的值，否则返回NULL
+ */
+void* ut_hash_push_bin(ut_hash_t *ht, const void *key, uint32_t keylen, const void* val);
+
+/**
+ * @brief 获取在哈希表中与二进制键相关联的元素的值
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 哈希表中元素的键
+ * @param [in] keylen 键的长度
+ * @return void* 返回哈希表键元素对应的值
+ */
+void* ut_hash_peek_bin(ut_hash_t *ht, const void *key, uint32_t keylen);
+
+/**
+ * @brief 从哈希表中移除与二进制键相关联的元素
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 哈希表中元素的键
+ * @param [in] keylen 键的长度
+ * @return void* 返回哈希表键元素对应的值
+ */
+void* ut_hash_pop_bin(ut_hash_t *ht, const void *key, uint32_t keylen);
+
+/**
+ * @brief 计算字符串键在该哈希表中的哈希值，可以传给*_hashed接口，避免重复计算
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 元素的键
+ * @return uint32_t 哈希值
+ */
+uint32_t ut_hash_calc(ut_hash_t *ht, const char *key);
+
+/**
+ * @brief 计算二进制键在该哈希表中的哈希值，可以传给*_hashed接口，避免重复计算
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 元素的键
+ * @param [in] keylen 键的长度
+ * @return uint32_t 哈希值
+ */
+uint32_t ut_hash_calc_bin(ut_hash_t *ht, const void *key, uint32_t keylen);
+
+/**
+ * @brief 同ut_hash_push_bin，使用预先计算好的哈希值。
+ *        字符串键以strlen(key)作为长度、以ut_hash_calc的结果作为哈希值时，与ut_hash_push等价
+ * 
+ * @param [in] hash ut_hash_calc或ut_hash_calc_bin计算出的哈希值
+ */
+void* ut_hash_push_hashed(ut_hash_t *ht, const void *key, uint32_t keylen, uint32_t hash, const void* val);
+
+/**
+ * @brief 同ut_hash_peek_bin，使用预先计算好的哈希值
+ */
+void* ut_hash_peek_hashed(ut_hash_t *ht, const void *key, uint32_t keylen, uint32_t hash);
+
+/**
+ * @brief 同ut_hash_pop_bin，使用预先计算好的哈希值
+ */
+void* ut_hash_pop_hashed(ut_hash_t *ht, const void *key, uint32_t keylen, uint32_t hash);
+
+/**
+ * @brief 查找键对应的值的存放位置，键不存在时插入val，整个过程只查找一次。
+ *        调用者可以通过返回的指针直接修改值，但不能写入NULL（删除请使用ut_hash_pop）。
+ *        拉链法哈希表中该指针在元素被删除之前一直有效；开放寻址哈希表中该指针在下一次写入哈希表之前有效
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 元素的键
+ * @param [in] val 键不存在时插入的值，传入NULL则只查找不插入
+ * @param [out] inserted 是否插入了新元素，可以传入NULL
+ * @return void** 值的存放位置，键不存在且没有插入（或内存不足）时返回NULL
+ */
+void** ut_hash_find_or_insert(ut_hash_t *ht, const char *key, const void* val, ut_bool_t *inserted);
+
+/**
+ * @brief 同ut_hash_find_or_insert，使用二进制键
+ */
+void** ut_hash_find_or_insert_bin(ut_hash_t *ht, const void *key, uint32_t keylen, const void* val, ut_bool_t *inserted);
+
+/**
+ * @brief 同ut_hash_find_or_insert，使用二进制键和预先计算好的哈希值
+ */
+void** ut_hash_find_or_insert_hashed(ut_hash_t *ht, const void *key, uint32_t keylen, uint32_t hash,
+                                     const void* val, ut_bool_t *inserted);
+
+/**
+ * @brief 只在键不存在时插入，已经存在的值不会被替换
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 元素的键
+ * @param [in] val 插入的值，不能为NULL
+ * @return void* 键已经存在时返回已有的值，插入成功时返回NULL
+ */
+void* ut_hash_emplace(ut_hash_t *ht, const char *key, const void* val);
+
+/**
+ * @brief 同ut_hash_emplace，使用二进制键
+ */
+void* ut_hash_emplace_bin(ut_hash_t *ht, const void *key, uint32_t keylen, const void* val);
+
+/**
+ * @brief 同ut_hash_emplace，使用二进制键和预先计算好的哈希值
+ */
+void* ut_hash_emplace_hashed(ut_hash_t *ht, const void *key, uint32_t keylen, uint32_t hash, const void* val);
+
+/**
+ * @brief 批量获取与键相关联的元素的值。先计算所有键的哈希值并预取对应的bucket再逐个查找，
+ *        哈希表远大于CPU缓存时，多个键的访存延迟可以互相重叠
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] keys 键数组，其中为NULL的键查找结果为NULL
+ * @param [in] num 键的数量
+ * @param [out] values 查找结果，长度不小于num，values[i]对应keys[i]
+ */
+void ut_hash_peek_batch(ut_hash_t *ht, const char* const keys[], uint32_t num, void* values[]);
+
+/**
+ * @brief 同ut_hash_peek_batch，使用二进制键
+ * 
+ * @param [in] keylens 键长度数组，keylens[i]对应keys[i]
+ */
+void ut_hash_peek_batch_bin(ut_hash_t *ht, const void* const keys[], const uint32_t keylens[], uint32_t num, void* values[]);
+
+/**
+ * @brief 设置被删除元素的空闲链表的上限。空闲链表中的元素会被之后的写入直接复用，
+ *        超出上限的元素归还给所在的slab，slab中的元素全部归还后释放给系统。仅拉链法有效
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] free_max 空闲链表的上限，默认为256
+ */
+void ut_hash_set_free_max(ut_hash_t *ht, uint32_t free_max);
+
+/**
+ * @brief 收缩哈希表占用的内存：清空空闲链表并释放空出来的slab，
+ *        按当前元素数量缩小bucket数组（开放寻址哈希表缩小槽位数组并清理已删除的槽位）
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_shrink(ut_hash_t *ht);
+
+/**
+ * @brief 获取哈希表的统计信息，会遍历整个哈希表，不要在性能敏感的路径上频繁调用。
+ *        操作计数默认不编译，需要在编译时定义ENABLE_HASH_STATS
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [out] stats 统计信息
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_stats(ut_hash_t *ht, ut_hash_stats_t *stats);
+
 /**
  * @brief 获取哈希表中保存的元素的数量
  * 
@@ -105,5 +331,45 @@ int32_t ut_hash_count(ut_hash_t *ht);
  */
 void ut_hash_foreach(ut_hash_t *ht, ut_hash_cb callback, void* context);
 
+/**
+ * @brief 遍历整个哈希表，并依次将哈希表内元素（包括键的长度）传递给该回调函数
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] callback 遍历哈希表所有元素使用的回调函数（迭代器）
+ * @param [in] context 回调者依赖的上下文
+ */
+void ut_hash_foreach_bin(ut_hash_t *ht, ut_hash_bin_cb callback, void* context);
+
+/**
+ * @brief 多线程并行遍历整个哈希表。bucket（槽位）数组被平均分成threads段，每一段由一个线程遍历，
+ *        第i段的回调使用locals[i]作为上下文；全部完成后按顺序对每一段调用reduce。
+ *        遍历期间不能写入哈希表，回调返回UT_FALSE只会停止所在的那一段
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] threads 线程数量（包括调用线程）
+ * @param [in] callback 遍历使用的回调函数，会被多个线程同时调用
+ * @param [in] locals 每个线程私有的上下文，长度不小于threads，可以为NULL
+ * @param [in] reduce 归并函数，可以为NULL
+ * @param [in] context 传给归并函数的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_foreach_parallel(ut_hash_t *ht, uint32_t threads, ut_hash_bin_cb callback,
+                                    void* locals[], ut_hash_reduce_cb reduce, void* context);
+
+/**
+ * @brief 基于游标的分步遍历，可以把一次完整的遍历分散到多次事件循环中。
+ *        游标从0开始，每次调用访问大约budget个元素，返回UT_FALSE（游标回到0）表示遍历完成。
+ *        两次调用之间可以写入哈希表：拉链法哈希表即使扩容，遍历期间一直存在的元素也至少会被访问一次，
+ *        但可能被重复访问；开放寻址哈希表在两次调用之间发生扩容时可能遗漏元素。回调中不能写入哈希表
+ * 
+ * @param [in] ht 哈希表的描述结构
+ * @param [in,out] cursor 遍历游标
+ * @param [in] budget 本次调用大约访问的元素数量
+ * @param [in] callback 遍历使用的回调函数，返回值被忽略
+ * @param [in] context 回调者依赖的上下文
+ * @return ut_bool_t 还有未遍历的部分返回UT_TRUE
+ */
+ut_bool_t ut_hash_scan(ut_hash_t *ht, uint64_t *cursor, uint32_t budget, ut_hash_bin_cb callback, void* context);
+
 __END_DECLS
 #endif
\ No newline at end of file
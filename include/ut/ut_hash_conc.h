@@ -0,0 +1,123 @@
+/**
+ * @file ut_hash_conc.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 线程安全的哈希表。按键的哈希值分成2的幂个分片，每个分片有自己的写锁；
+ *        读操作不加锁，通过分片的顺序锁（seqlock）校验读到的数据是否一致
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_HASH_CONC_H__
+#define __UTILS_HASH_CONC_H__
+
+#include "ut.h"
+#include "ut_hash.h"
+
+
+/**
+ * @brief 线程安全哈希表的描述结构
+ *
+ */
+typedef struct ut_hash_conc_t ut_hash_conc_t;
+
+
+__BEGIN_DECLS
+
+/**
+ * @brief 创建一个线程安全的哈希表
+ *
+ * @param [out] pht 传出参数
+ * @param [in] size 预期存放的元素数量
+ * @param [in] shards 分片数量，会向上取整为2的幂，传入0使用默认的分片数量
+ * @param [in] ut_hash_func 计算哈希值的哈希函数，如果传入NULL则会使用内置的默认哈希函数
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_conc_create(ut_hash_conc_t **pht, uint32_t size, uint32_t shards, ut_hash_func ut_hash_func);
+
+/**
+ * @brief 创建一个线程安全的哈希表，并通过标志位选择内置的哈希函数
+ *
+ * @param [out] pht 传出参数
+ * @param [in] size 预期存放的元素数量
+ * @param [in] shards 分片数量，会向上取整为2的幂，传入0使用默认的分片数量
+ * @param [in] ut_hash_func 计算哈希值的哈希函数，如果传入NULL则会使用内置的哈希函数
+ * @param [in] flags ut_hash_flag_t标志位的组合，只有UT_HASH_FLAG_HASH_FNV1A、UT_HASH_FLAG_HASH_WY、
+ *                   UT_HASH_FLAG_SEED有效，含义与ut_hash_create_ex相同
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_conc_create_ex(ut_hash_conc_t **pht, uint32_t size, uint32_t shards, ut_hash_func ut_hash_func, uint32_t flags);
+
+/**
+ * @brief 销毁一个线程安全的哈希表，调用时不能有其他线程正在访问该哈希表
+ *
+ * @param [in] ht 待销毁的哈希表
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_conc_destroy(ut_hash_conc_t *ht);
+
+/**
+ * @brief 将一个数据以及与他相关联的键组成一个键值对放进哈希表中
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 存入哈希表的元素的键
+ * @param [in] val 存入哈希表的元素的值，传入NULL等同于ut_hash_conc_pop
+ * @return void* 如果发生碰撞，将会返回碰撞的元素的值，否则返回NULL
+ */
+void* ut_hash_conc_push(ut_hash_conc_t *ht, const char *key, const void* val);
+
+/**
+ * @brief 获取在哈希表中与键相关联的元素的值，不加锁。
+ *        返回的值可能同时被其他线程移除，值的生命周期需要调用者自己保证
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 哈希表中元素的键
+ * @return void* 返回哈希表键元素对应的值
+ */
+void* ut_hash_conc_peek(ut_hash_conc_t *ht, const char *key);
+
+/**
+ * @brief 从哈希表中移除与键相关联的元素
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 哈希表中元素的键
+ * @return void* 返回哈希表键元素对应的值
+ */
+void* ut_hash_conc_pop(ut_hash_conc_t *ht, const char *key);
+
+/**
+ * @brief 同ut_hash_conc_push，使用二进制键。键长度不能超过2GB - 1，超过时不存入并返回NULL，
+ *        同样的限制也适用于字符串键和其他_bin函数
+ */
+void* ut_hash_conc_push_bin(ut_hash_conc_t *ht, const void *key, uint32_t keylen, const void* val);
+
+/**
+ * @brief 同ut_hash_conc_peek，使用二进制键
+ */
+void* ut_hash_conc_peek_bin(ut_hash_conc_t *ht, const void *key, uint32_t keylen);
+
+/**
+ * @brief 同ut_hash_conc_pop，使用二进制键
+ */
+void* ut_hash_conc_pop_bin(ut_hash_conc_t *ht, const void *key, uint32_t keylen);
+
+/**
+ * @brief 获取哈希表中保存的元素的数量，其他线程同时写入时只是一个近似值
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @return int32_t 返回哈希表中键值对元素的数量，ht为NULL时返回0
+ */
+int32_t ut_hash_conc_count(ut_hash_conc_t *ht);
+
+/**
+ * @brief 遍历整个哈希表。遍历时依次持有每个分片的写锁，回调函数内不能写入该哈希表
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] callback 遍历哈希表所有元素使用的回调函数（迭代器）
+ * @param [in] context 回调者依赖的上下文
+ */
+void ut_hash_conc_foreach(ut_hash_conc_t *ht, ut_hash_bin_cb callback, void* context);
+
+__END_DECLS
+#endif
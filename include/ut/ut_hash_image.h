@@ -0,0 +1,96 @@
+/**
+ * @file ut_hash_image.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 哈希表的磁盘镜像。ut_hash_save将哈希表写成与地址无关的文件，
+ *        ut_hash_open_mmap直接映射该文件提供只读查找，不需要反序列化，多个进程映射同一个文件时共享页缓存。
+ *        文件使用本机字节序，不能在字节序不同的机器之间共享
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_HASH_IMAGE_H__
+#define __UTILS_HASH_IMAGE_H__
+
+#include "ut.h"
+#include "ut_hash.h"
+
+
+/**
+ * @brief 只读哈希表镜像的描述结构
+ *
+ */
+typedef struct ut_hash_image_t ut_hash_image_t;
+
+
+__BEGIN_DECLS
+
+/**
+ * @brief 获取值的长度的回调函数，值的内容会按该长度复制到镜像文件中
+ *
+ * @param [in] value 哈希表中元素的值
+ * @param [in] context 回调者依赖的上下文
+ * @return uint32_t 值的长度
+ */
+typedef uint32_t (*ut_hash_value_len)(const void* value, void* context);
+
+/**
+ * @brief 将哈希表保存为镜像文件。先写入临时文件再重命名，已经映射了旧文件的进程不受影响
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] path 镜像文件路径
+ * @param [in] value_len 获取值长度的回调函数。传入NULL时值本身（指针大小的整数）被保存，
+ *             查找时原样返回，适用于用PTR_CAST存放整数的哈希表
+ * @param [in] context 回调者依赖的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_save(ut_hash_t *ht, const char *path, ut_hash_value_len value_len, void* context);
+
+/**
+ * @brief 映射一个镜像文件
+ *
+ * @param [out] pimg 传出参数
+ * @param [in] path 镜像文件路径
+ * @return ut_errno_t 文件不是合法的镜像时返回UT_ERRNO_INVALID
+ */
+ut_errno_t ut_hash_open_mmap(ut_hash_image_t **pimg, const char *path);
+
+/**
+ * @brief 解除镜像文件的映射，之前查找返回的指针全部失效
+ *
+ * @param [in] img 镜像的描述结构
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_image_close(ut_hash_image_t *img);
+
+/**
+ * @brief 在镜像中查找字符串键
+ *
+ * @param [in] img 镜像的描述结构
+ * @param [in] key 元素的键
+ * @return const void* 指向映射内存中值的内容；保存时value_len为NULL则返回保存的值本身。找不到返回NULL
+ */
+const void* ut_hash_image_peek(ut_hash_image_t *img, const char *key);
+
+/**
+ * @brief 在镜像中查找二进制键
+ *
+ * @param [in] img 镜像的描述结构
+ * @param [in] key 元素的键
+ * @param [in] keylen 键的长度
+ * @param [out] vallen 值的长度，可以传入NULL
+ * @return const void* 同ut_hash_image_peek
+ */
+const void* ut_hash_image_peek_bin(ut_hash_image_t *img, const void *key, uint32_t keylen, uint32_t *vallen);
+
+/**
+ * @brief 获取镜像中元素的数量
+ *
+ * @param [in] img 镜像的描述结构
+ * @return int32_t img为NULL时返回0
+ */
+int32_t ut_hash_image_count(ut_hash_image_t *img);
+
+__END_DECLS
+#endif
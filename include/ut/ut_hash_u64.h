@@ -0,0 +1,99 @@
+/**
+ * @file ut_hash_u64.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 以整数为键的哈希表，适用于fd、地址等整数键，不需要将整数格式化成字符串
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_HASH_U64_H__
+#define __UTILS_HASH_U64_H__
+
+#include "ut.h"
+
+
+/**
+ * @brief 整数键哈希表的描述结构
+ *
+ */
+typedef struct ut_hash_u64_t ut_hash_u64_t;
+
+
+__BEGIN_DECLS
+
+/**
+ * @brief 遍历哈希表所有元素使用的回调函数。遍历过程中允许删除当前元素，不允许写入新元素
+ *
+ * @param [in] key 存入哈希表的元素的键
+ * @param [in] value 存入哈希表的元素的值
+ * @param [in] context 回调者依赖的上下文
+ * @return 返回UT_FALSE将会停止遍历立即结束
+ */
+typedef ut_bool_t (*ut_hash_u64_cb)(uint64_t key, const void* value, void* context);
+
+/**
+ * @brief 创建一个整数键哈希表
+ *
+ * @param [out] pht 传出参数
+ * @param [in] size 预期存放的元素数量
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_u64_create(ut_hash_u64_t **pht, uint32_t size);
+
+/**
+ * @brief 销毁一个整数键哈希表
+ *
+ * @param [in] ht 待销毁的哈希表
+ * @return ut_errno_t
+ */
+ut_errno_t ut_hash_u64_destroy(ut_hash_u64_t *ht);
+
+/**
+ * @brief 将一个数据以及与他相关联的键组成一个键值对放进哈希表中
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 存入哈希表的元素的键
+ * @param [in] val 存入哈希表的元素的值，传入NULL等同于ut_hash_u64_pop
+ * @return void* 如果发生碰撞，将会返回碰撞的元素的值，否则返回NULL
+ */
+void* ut_hash_u64_push(ut_hash_u64_t *ht, uint64_t key, const void* val);
+
+/**
+ * @brief 获取在哈希表中与键相关联的元素的值
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 哈希表中元素的键
+ * @return void* 返回哈希表键元素对应的值
+ */
+void* ut_hash_u64_peek(ut_hash_u64_t *ht, uint64_t key);
+
+/**
+ * @brief 从哈希表中移除与键相关联的元素
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] key 哈希表中元素的键
+ * @return void* 返回哈希表键元素对应的值
+ */
+void* ut_hash_u64_pop(ut_hash_u64_t *ht, uint64_t key);
+
+/**
+ * @brief 获取哈希表中保存的元素的数量
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @return int32_t 返回哈希表中键值对元素的数量
+ */
+int32_t ut_hash_u64_count(ut_hash_u64_t *ht);
+
+/**
+ * @brief 遍历整个哈希表，并依次将哈希表内元素传递给该回调函数
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] callback 遍历哈希表所有元素使用的回调函数（迭代器）
+ * @param [in] context 回调者依赖的上下文
+ */
+void ut_hash_u64_foreach(ut_hash_u64_t *ht, ut_hash_u64_cb callback, void* context);
+
+__END_DECLS
+#endif
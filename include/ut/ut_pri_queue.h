@@ -23,6 +23,20 @@ typedef struct {
     ut_pri_comp_func    priority_compare;   /* 优先级比较的回调函数 */
 } ut_pri_queue_cb_t;
 
+/* 创建优先级队列的标志位 */
+typedef enum {
+    UT_PRI_QUEUE_FLAG_NONE = 0,             /* 默认：二叉堆，大小固定 */
+    UT_PRI_QUEUE_FLAG_ADAPTION = 1 << 0,    /* 队列满时自动扩容为原来的2倍 */
+    UT_PRI_QUEUE_FLAG_4ARY = 1 << 1,        /* 4叉堆：层数减半，同一父节点的子节点正好占满一个缓存行，适合较大的队列 */
+    UT_PRI_QUEUE_FLAG_8ARY = 1 << 2,        /* 8叉堆：层数为二叉堆的1/3，子节点占两个相邻的缓存行，出队比较次数更多，入队更快 */
+    UT_PRI_QUEUE_FLAG_HANDLE = 1 << 3,      /* 跟踪元素的句柄，支持按句柄移除、调整优先级，堆中每次移动元素需要额外更新句柄表 */
+    UT_PRI_QUEUE_FLAG_SPIN = 1 << 4,        /* 队列为空时消费者先短暂自旋再睡眠，降低交接延迟，只有一个CPU时不生效 */
+    UT_PRI_QUEUE_FLAG_RADIX = 1 << 5,       /* 基数堆：只用于整数键队列，且入队的键不能小于最近一次取出的键（如定时器），出队均摊O(1)，不支持句柄 */
+} ut_pri_queue_flag_t;
+
+/* 元素的句柄，元素被取出或移除之后句柄失效 */
+typedef uint64_t ut_pri_handle_t;
+
 
 
 __BEGIN_DECLS
@@ -36,6 +50,46 @@ __BEGIN_DECLS
  */
 ut_pri_queue_t *ut_pri_queue_create(int32_t initial_size, ut_bool_t size_adaption, ut_pri_comp_func cb);
 
+/**
+ * 创建一个优先级队列，并通过标志位选择堆的实现
+ * @param [in] initial_size 初始大小
+ * @param [in] flags ut_pri_queue_flag_t标志位的组合，4叉和8叉不能同时指定
+ * @param [in] cb 需要注册的回调函数
+ * @retval ut_pri_queue_t* 优先级队列指针
+ */
+ut_pri_queue_t *ut_pri_queue_create_ex(int32_t initial_size, uint32_t flags, ut_pri_comp_func cb);
+
+/**
+ * 创建一个整数键优先级队列。优先级是与数据一起存放在堆中的int64_t整数，越小越优先，
+ * 不需要比较函数，也不会访问数据本身。只能使用ut_pri_queue_push_key入队
+ * @param [in] initial_size 初始大小
+ * @param [in] flags ut_pri_queue_flag_t标志位的组合
+ * @retval ut_pri_queue_t* 优先级队列指针
+ */
+ut_pri_queue_t *ut_pri_queue_create_key(int32_t initial_size, uint32_t flags);
+
+/**
+ * 创建一个桶队列。优先级是[0, levels)范围内的整数，越小越优先，入队出队都是O(1)，
+ * 同一优先级的数据先进先出。只能使用ut_pri_queue_push_key入队，不支持句柄
+ * @param [in] initial_size 初始大小
+ * @param [in] levels 优先级的个数
+ * @param [in] flags ut_pri_queue_flag_t标志位的组合
+ * @retval ut_pri_queue_t* 优先级队列指针
+ */
+ut_pri_queue_t *ut_pri_queue_create_bucket(int32_t initial_size, int32_t levels, uint32_t flags);
+
+/**
+ * 创建一个有界优先级队列，用于从数据流中保留优先级最高的max_size个数据。
+ * 堆按最小最大堆组织，可以同时查看优先级最高和最低的数据，容量固定不会扩容。
+ * 队列满时ut_pri_queue_push/ut_pri_queue_push_key返回UT_ERRNO_RESOURCE，
+ * ut_pri_queue_push_evict替换掉优先级最低的数据
+ * @param [in] max_size 最多保留的数据个数
+ * @param [in] flags 只能指定UT_PRI_QUEUE_FLAG_SPIN
+ * @param [in] cb 需要注册的回调函数，为NULL时创建整数键队列
+ * @retval ut_pri_queue_t* 优先级队列指针
+ */
+ut_pri_queue_t *ut_pri_queue_create_topk(int32_t max_size, uint32_t flags, ut_pri_comp_func cb);
+
 /**
  * 销毁一个优先级队列
  * @param [in] pri_queue 优先级队列指针优先级队列指针
@@ -59,6 +113,119 @@ ut_errno_t ut_pri_queue_peek(ut_pri_queue_t * pri_queue, void** pdata);
  */
 ut_errno_t ut_pri_queue_push(ut_pri_queue_t * pri_queue, void* data);
 
+/**
+ * 将数据存入优先级队列，并返回元素的句柄。队列必须以UT_PRI_QUEUE_FLAG_HANDLE创建
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] data 数据指针
+ * @param [out] handle 元素的句柄
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 其他失败
+ */
+ut_errno_t ut_pri_queue_push_handle(ut_pri_queue_t *pri_queue, void* data, ut_pri_handle_t *handle);
+
+/**
+ * 将数据以整数键存入整数键优先级队列
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] key 优先级，越小越优先
+ * @param [in] data 数据指针，可以为NULL
+ * @param [out] handle 元素的句柄，可以为NULL；不为NULL时队列必须以UT_PRI_QUEUE_FLAG_HANDLE创建
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 桶队列的键超出范围、基数堆的键小于最近一次取出的键时返回UT_ERRNO_INVALID
+ */
+ut_errno_t ut_pri_queue_push_key(ut_pri_queue_t *pri_queue, int64_t key, void* data, ut_pri_handle_t *handle);
+
+/**
+ * 查看整数键优先级队列首部的数据和键
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] key 首部数据的键，可以为NULL
+ * @param [out] pdata 首部的数据，可以为NULL
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 队列为空返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_pri_queue_peek_key(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata);
+
+/**
+ * 取出整数键优先级队列首部的数据和键
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] key 取出数据的键，可以为NULL
+ * @param [out] pdata 取出的数据，可以为NULL
+ * @param [in] timeout 队列为空时等待的时间，毫秒（ms），-1表示一直等待，0表示不等待
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 队列为空返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_pri_queue_pop_key(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata, int32_t timeout);
+
+/**
+ * 查看有界优先级队列中优先级最低的数据，O(1)
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] key 数据的键，可以为NULL，使用比较函数的队列没有意义
+ * @param [out] pdata 数据，可以为NULL
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 队列为空返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_pri_queue_peek_min(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata);
+
+/**
+ * 查看有界优先级队列中优先级最高的数据，O(1)
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] key 数据的键，可以为NULL，使用比较函数的队列没有意义
+ * @param [out] pdata 数据，可以为NULL
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 队列为空返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_pri_queue_peek_max(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata);
+
+/**
+ * 将数据存入有界优先级队列，队列已满时替换掉优先级最低的数据，O(log n)
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] key 整数键队列的优先级，使用比较函数的队列忽略
+ * @param [in] data 数据指针，使用比较函数的队列不能为NULL
+ * @param [out] evicted 被替换掉的数据，没有替换时为NULL，可以为NULL
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 队列已满且数据的优先级不高于队列中最低的数据时返回UT_ERRNO_RESOURCE，数据没有存入
+ */
+ut_errno_t ut_pri_queue_push_evict(ut_pri_queue_t *pri_queue, int64_t key, void* data, void** evicted);
+
+/**
+ * 通过句柄修改整数键优先级队列中元素的键，O(log n)
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] handle 元素的句柄
+ * @param [in] key 新的键
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 元素已经被取出或移除返回UT_ERRNO_NOTEXSIT
+ */
+ut_errno_t ut_pri_queue_update_key(ut_pri_queue_t *pri_queue, ut_pri_handle_t handle, int64_t key);
+
+/**
+ * 通过句柄移除队列中任意位置的元素，O(log n)
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] handle 元素的句柄
+ * @param [out] pdata 移除的数据，可以为NULL
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 元素已经被取出或移除返回UT_ERRNO_NOTEXSIT
+ */
+ut_errno_t ut_pri_queue_remove(ut_pri_queue_t *pri_queue, ut_pri_handle_t handle, void** pdata);
+
+/**
+ * 元素的优先级（比较函数依赖的字段）被修改之后，通过句柄调整它在队列中的位置，O(log n)。
+ * 修改优先级和调用本函数之间其他线程访问队列的结果是不确定的，需要调用者自己同步
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] handle 元素的句柄
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 元素已经被取出或移除返回UT_ERRNO_NOTEXSIT
+ */
+ut_errno_t ut_pri_queue_update(ut_pri_queue_t *pri_queue, ut_pri_handle_t handle);
+
+/**
+ * 将一批数据存入优先级队列，只加锁一次，整批数据只唤醒一次等待者。
+ * 队列放不下整批数据（且不允许扩容）时整批都不存入
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] datas 数据指针数组，不能包含NULL
+ * @param [in] num 数据的个数
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 其他失败
+ */
+ut_errno_t ut_pri_queue_push_n(ut_pri_queue_t *pri_queue, void* const datas[], int32_t num);
+
+/**
+ * 取出优先级队列首部最多max个数据，按优先级从高到低存放，只加锁一次
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] out 保存数据指针的数组
+ * @param [in] max 最多取出的个数
+ * @param [in] timeout 队列为空时等待的时间，毫秒（ms），-1表示一直等待，0表示不等待
+ * @retval int32_t 取出的个数，参数错误返回-1
+ */
+int32_t ut_pri_queue_pop_n(ut_pri_queue_t *pri_queue, void* out[], int32_t max, int32_t timeout);
+
 /**
  * 取出优先级队列的首个数据，如果不存在数据，阻塞等待
  * @param [in] pri_queue 优先级队列指针
@@ -79,7 +246,7 @@ ut_errno_t ut_pri_queue_pop_trywait(ut_pri_queue_t *pri_queue, void* *pdata);
  * 取出优先级队列的首个数据，如果不存在数据，阻塞等待指定时间
  * @param [in] pri_queue 优先级队列指针
  * @param [in] pdata 保存数据指针的指针
- * @param [in] timeout 阻塞等待的时间
+ * @param [in] timeout 阻塞等待的时间，毫秒（ms），按单调时钟计算，不受系统时间调整的影响
  * @retval ut_errno_t UT_ERRNO_OK : 成功, 其他失败
  */
 ut_errno_t ut_pri_queue_pop_timedwait(ut_pri_queue_t *pri_queue, void* *pdata, int32_t timeout);
@@ -0,0 +1,83 @@
+/**
+ * @file ut_pri_queue_conc.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 可扩展的线程安全优先级队列（MultiQueue）。元素分散在多个各自加锁的堆中，
+ *        入队随机选择一个堆，出队随机选择两个堆并取出其中堆顶优先级更高的元素。
+ *        出队顺序是近似的：取出的元素大概率在全局优先级最高的若干个元素之中，但不保证是最高的那一个；
+ *        同一个生产者先后放入的元素也不保证按顺序取出。适合大量生产者、消费者并发访问且能容忍近似顺序的场景
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_PRI_QUEUE_CONC_H__
+#define __UTILS_PRI_QUEUE_CONC_H__
+
+#include "ut.h"
+#include "ut_pri_queue.h"
+
+/* 线程安全优先级队列类型 */
+typedef struct pri_queue_conc ut_pri_queue_conc_t;
+
+
+__BEGIN_DECLS
+
+/**
+ * 创建一个线程安全的优先级队列，队列大小总是自动扩容
+ * @param [in] initial_size 初始大小，平均分配给每个分片
+ * @param [in] shards 分片数量，传入0使用CPU数量的2倍。分片越多竞争越少，出队顺序越松散
+ * @param [in] cb 需要注册的回调函数
+ * @retval ut_pri_queue_conc_t* 优先级队列指针
+ */
+ut_pri_queue_conc_t *ut_pri_queue_conc_create(int32_t initial_size, uint32_t shards, ut_pri_comp_func cb);
+
+/**
+ * 销毁一个优先级队列，调用时不能有其他线程正在访问该队列
+ * @param [in] pri_queue 优先级队列指针
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 其他失败
+ */
+ut_errno_t ut_pri_queue_conc_destroy(ut_pri_queue_conc_t *pri_queue);
+
+/**
+ * 将数据存入优先级队列，只有存在等待中的消费者时才会唤醒，且只唤醒一个
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] data 数据指针
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 其他失败
+ */
+ut_errno_t ut_pri_queue_conc_push(ut_pri_queue_conc_t *pri_queue, void* data);
+
+/**
+ * 取出优先级队列中一个优先级较高的数据，如果不存在数据，阻塞等待
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] pdata 保存数据指针的指针
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 其他失败
+ */
+ut_errno_t ut_pri_queue_conc_pop_wait(ut_pri_queue_conc_t *pri_queue, void* *pdata);
+
+/**
+ * 取出优先级队列中一个优先级较高的数据，如果不存在数据，直接返回
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] pdata 保存数据指针的指针
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 队列为空返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_pri_queue_conc_pop_trywait(ut_pri_queue_conc_t *pri_queue, void* *pdata);
+
+/**
+ * 取出优先级队列中一个优先级较高的数据，如果不存在数据，阻塞等待指定时间
+ * @param [in] pri_queue 优先级队列指针
+ * @param [out] pdata 保存数据指针的指针
+ * @param [in] timeout 阻塞等待的时间，毫秒（ms）
+ * @retval ut_errno_t UT_ERRNO_OK : 成功, 超时返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_pri_queue_conc_pop_timedwait(ut_pri_queue_conc_t *pri_queue, void* *pdata, int32_t timeout);
+
+/**
+ * 获取一个优先级队列内还有多少个数据，并发访问时只是一个近似值
+ * @param [in] pri_queue 优先级队列指针
+ * @retval int32_t 优先级队列内的数据个数
+ */
+int32_t ut_pri_queue_conc_get_size(const ut_pri_queue_conc_t *pri_queue);
+
+__END_DECLS
+#endif
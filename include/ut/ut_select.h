@@ -3,6 +3,9 @@
  * @author Zhong Qiaoning (691365572@qq.com)
  * @brief 一个基于select实现的事件引擎，通过select来实现
  *        对文件描述符fd、定时器事件event的处理。
+ *        也可以在创建时选择epoll后端：文件描述符注册一次之后一直有效，每次唤醒只处理就绪的文件描述符，
+ *        不受FD_SETSIZE的限制。
+ *        定时器放在分层时间轮中，增加和删除都是O(1)，按CLOCK_MONOTONIC的刻度到期，刻度默认为1ms。
  * @version 0.1
  * @date 2022-07-13
  * 
@@ -16,6 +19,15 @@
 
 typedef struct ut_select_engine_t ut_select_engine_t;
 
+/* 定时器的标识，用于删除还没有到期的定时器。定时器到期或被删除后标识失效 */
+typedef uint64_t ut_select_timer_t;
+
+/* 事件引擎等待文件描述符使用的系统调用 */
+typedef enum {
+    UT_SELECT_BACKEND_SELECT = 0,   /* select：每次等待前重新构造fd_set，fd不能超过FD_SETSIZE */
+    UT_SELECT_BACKEND_EPOLL,        /* epoll：注册一直有效，分发的开销只与就绪的fd数量有关 */
+} ut_select_backend_t;
+
 
 
 __BEGIN_DECLS
@@ -42,6 +54,15 @@ typedef void (*ut_select_fd_cb)(ut_fd_t fd, void* context);
  */
 ut_errno_t ut_select_engine_create(ut_select_engine_t **engine);
 
+/**
+ * @brief 创建一个事件引擎，并指定等待文件描述符使用的后端
+ * 
+ * @param [out] engine 传出参数，select事件引擎描述结构体
+ * @param [in] backend 后端类型
+ * @return ut_errno_t 后端类型不合法返回UT_ERRNO_INVALID，创建后端失败返回UT_ERRNO_UNKNOWN
+ */
+ut_errno_t ut_select_engine_create_ex(ut_select_engine_t **engine, ut_select_backend_t backend);
+
 /**
  * @brief 销毁select事件引擎
  * 
@@ -73,11 +94,41 @@ ut_errno_t ut_select_engine_stop(ut_select_engine_t* engine);
  * @param [in] engine select事件引擎描述结构体
  * @param [in] callback 定时器到期后，触发的回调函数
  * @param [in] context 传递给回调函数的上下文
- * @param [in] timeout_us 定时器时长，单位微秒us
+ * @param [in] timeout_us 定时器时长，单位微秒us，向上取整到刻度；为0时在事件循环的下一轮回调
  * @return ut_errno_t 
  */
 ut_errno_t ut_select_engine_schedule_add(ut_select_engine_t* engine, ut_select_schedule_cb callback, void* context, int64_t timeout_us);
 
+/**
+ * @brief 向select事件引擎中添加一个定时器事件，并传出定时器的标识
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] callback 定时器到期后，触发的回调函数
+ * @param [in] context 传递给回调函数的上下文
+ * @param [in] timeout_us 定时器时长，单位微秒us，向上取整到刻度；为0时在事件循环的下一轮回调
+ * @param [out] timer 定时器的标识
+ * @return ut_errno_t 
+ */
+ut_errno_t ut_select_engine_schedule_add_ex(ut_select_engine_t* engine, ut_select_schedule_cb callback, void* context, int64_t timeout_us, ut_select_timer_t *timer);
+
+/**
+ * @brief 删除一个还没有到期的定时器事件，回调不会再被调用
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] timer 定时器的标识
+ * @return ut_errno_t 定时器已经到期或已经删除时返回UT_ERRNO_NOTEXSIT
+ */
+ut_errno_t ut_select_engine_schedule_del(ut_select_engine_t* engine, ut_select_timer_t timer);
+
+/**
+ * @brief 设置定时器的刻度。刻度越大处理定时器的开销越小，到期的时间越粗糙。只能在没有定时器时设置
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] resolution_us 刻度，单位微秒us
+ * @return ut_errno_t 还有定时器时返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t ut_select_engine_set_resolution(ut_select_engine_t* engine, int64_t resolution_us);
+
 /**
  * @brief 设置一个一次性的文件描述符监视，在该文件描述符可读一次之后，就删除
  * 
@@ -0,0 +1,191 @@
+/**
+ * @file ut_uring.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 基于io_uring的完成式事件引擎。读、写、accept、recv和定时器都以操作的形式提交，
+ *        操作完成后调用回调。提交的操作先放在提交队列中，事件循环每次等待前一次io_uring_enter
+ *        提交全部积攒的操作；accept和recv可以提交一次、多次完成，recv的数据放在注册给内核的缓冲区中。
+ *        直接使用io_uring的系统调用，不依赖liburing。
+ *        内核不支持（低于6.0或被禁用）时回退到epoll后端的select事件引擎，接口和回调的语义不变。
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_URING_H__
+#define __UTILS_URING_H__
+
+#include "ut.h"
+
+
+/**
+ * @brief io_uring事件引擎的描述结构
+ *
+ */
+typedef struct ut_uring_t ut_uring_t;
+
+/* 创建io_uring事件引擎的标志位 */
+typedef enum {
+    UT_URING_FLAG_NONE = 0,
+    UT_URING_FLAG_FORCE_POLL = 1 << 0,      /* 不使用io_uring，直接使用回退的epoll实现 */
+    UT_URING_FLAG_SINGLE_SHOT = 1 << 1,     /* accept和recv每次完成后重新提交，不使用多次完成。内核不支持多次完成时自动使用这种方式 */
+} ut_uring_flag_t;
+
+
+__BEGIN_DECLS
+
+/**
+ * @brief 操作完成的回调函数
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] res 操作的结果：读写为字节数，accept为新连接的fd，定时器为0；失败时为负的errno，被取消时为-ECANCELED
+ * @param [in] buf recv时存放数据的缓冲区，用完之后需要通过ut_uring_buffer_release归还；其他操作为NULL
+ * @param [in] more 为UT_TRUE时该操作之后还会继续完成，为UT_FALSE时操作已经结束
+ * @param [in] context 提交操作时传入的上下文
+ */
+typedef void (*ut_uring_cb)(ut_uring_t* ring, int32_t res, void* buf, ut_bool_t more, void* context);
+
+/**
+ * @brief 创建一个io_uring事件引擎
+ *
+ * @param [out] ring 传出参数
+ * @param [in] entries 提交队列的大小，会向上取整为2的幂，一次io_uring_enter最多提交这么多操作
+ * @param [in] flags ut_uring_flag_t标志位的组合
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_create(ut_uring_t **ring, uint32_t entries, uint32_t flags);
+
+/**
+ * @brief 销毁事件引擎，未完成的操作不会再回调
+ *
+ * @param [in] ring 事件引擎
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_destroy(ut_uring_t *ring);
+
+/**
+ * @brief 事件引擎是否直接使用io_uring
+ *
+ * @param [in] ring 事件引擎
+ * @return ut_bool_t 回退到epoll时返回UT_FALSE
+ */
+ut_bool_t ut_uring_is_native(const ut_uring_t *ring);
+
+/**
+ * @brief 注册recv使用的缓冲区，只能注册一次。缓冲区由内核在数据到达时选择，
+ *        recv不需要为每个连接预留缓冲区
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] count 缓冲区的个数，会向上取整为2的幂
+ * @param [in] size 每个缓冲区的大小
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_buffer_register(ut_uring_t *ring, uint32_t count, uint32_t size);
+
+/**
+ * @brief 归还recv回调中传出的缓冲区
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] buf 缓冲区
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_buffer_release(ut_uring_t *ring, void* buf);
+
+/**
+ * @brief 提交一个读操作
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] fd 文件描述符
+ * @param [in] buf 存放数据的缓冲区，操作完成前必须保持有效
+ * @param [in] len 缓冲区的大小
+ * @param [in] offset 文件的偏移，-1表示使用文件当前的位置（socket、管道必须为-1）
+ * @param [in] callback 完成的回调
+ * @param [in] context 回调的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_read(ut_uring_t *ring, ut_fd_t fd, void* buf, uint32_t len, int64_t offset, ut_uring_cb callback, void* context);
+
+/**
+ * @brief 提交一个写操作。回退到epoll时写操作在事件循环中直接执行
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] fd 文件描述符
+ * @param [in] buf 待写入的数据，操作完成前必须保持有效
+ * @param [in] len 数据的长度
+ * @param [in] offset 文件的偏移，-1表示使用文件当前的位置（socket、管道必须为-1）
+ * @param [in] callback 完成的回调
+ * @param [in] context 回调的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_write(ut_uring_t *ring, ut_fd_t fd, const void* buf, uint32_t len, int64_t offset, ut_uring_cb callback, void* context);
+
+/**
+ * @brief 在监听的socket上提交一次多次完成的accept，每个新连接回调一次，直到被取消或出错
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] fd 监听的socket
+ * @param [in] callback 完成的回调，res为新连接的fd
+ * @param [in] context 回调的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_accept(ut_uring_t *ring, ut_fd_t fd, ut_uring_cb callback, void* context);
+
+/**
+ * @brief 在socket上提交一次多次完成的recv，每次收到数据回调一次，直到被取消、对端关闭或出错。
+ *        必须先注册缓冲区，缓冲区用完时以-ENOBUFS结束，归还缓冲区之后可以重新提交
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] fd socket
+ * @param [in] callback 完成的回调，res为数据的长度，为0表示对端关闭
+ * @param [in] context 回调的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_recv(ut_uring_t *ring, ut_fd_t fd, ut_uring_cb callback, void* context);
+
+/**
+ * @brief 提交一个定时器
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] timeout_us 定时器时长，单位微秒us
+ * @param [in] callback 到期的回调，res为0
+ * @param [in] context 回调的上下文
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_timeout(ut_uring_t *ring, int64_t timeout_us, ut_uring_cb callback, void* context);
+
+/**
+ * @brief 取消fd上所有未完成的操作，被取消的操作以-ECANCELED回调
+ *
+ * @param [in] ring 事件引擎
+ * @param [in] fd 文件描述符
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_cancel(ut_uring_t *ring, ut_fd_t fd);
+
+/**
+ * @brief 立即提交积攒的操作，不等待完成。事件循环每次等待前会自动提交
+ *
+ * @param [in] ring 事件引擎
+ * @return int32_t 提交的操作个数，失败返回-1
+ */
+int32_t ut_uring_submit(ut_uring_t *ring);
+
+/**
+ * @brief 闭合的死循环，提交操作、等待完成并调用回调，直到调用ut_uring_stop后停止。
+ *        除ut_uring_stop之外，其他接口只能在运行事件循环的线程中调用
+ *
+ * @param [in] ring 事件引擎
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_run(ut_uring_t *ring);
+
+/**
+ * @brief 停止事件循环，可以在其他线程中调用
+ *
+ * @param [in] ring 事件引擎
+ * @return ut_errno_t
+ */
+ut_errno_t ut_uring_stop(ut_uring_t *ring);
+
+__END_DECLS
+#endif
@@ -0,0 +1,316 @@
+/**
+ * @file ut_cache.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 有容量上限的LRU缓存。哈希表中存放元素节点，节点同时挂在LRU双向链表上，
+ *        链表头部是最近使用的元素，淘汰从链表尾部开始
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <time.h>
+#include "ut/ut_cache.h"
+#include "ut/ut_hash.h"
+
+typedef struct cache_node {
+    struct cache_node* prev;    /* LRU链表，靠近头部的是最近使用的元素 */
+    struct cache_node* next;
+    void* value;                /* 值 */
+    uint64_t expire;            /* 过期时间（毫秒，单调时钟），0表示永不过期 */
+    size_t charge;              /* 占用 */
+    uint32_t hash;              /* 键在哈希表中的哈希值 */
+    uint32_t keylen;            /* 键的长度 */
+    char key[0];                /* 键 */
+} cache_node_t;
+
+struct ut_cache_t {
+    ut_hash_t* index;           /* 键到节点的索引 */
+    cache_node_t lru;           /* LRU链表的哨兵节点 */
+    size_t budget;              /* 容量上限 */
+    size_t usage;               /* 当前占用 */
+    uint32_t ttl;               /* 默认的过期时间，0表示永不过期 */
+    ut_cache_evict_cb evict;    /* 元素被移除时的回调 */
+    void* context;              /* 回调的上下文 */
+    ut_cache_stats_t stats;     /* 统计信息 */
+};
+
+
+static inline uint64_t __cache_now_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static inline void __lru_unlink(cache_node_t *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+static inline void __lru_push_front(ut_cache_t *cache, cache_node_t *node)
+{
+    node->prev = &cache->lru;
+    node->next = cache->lru.next;
+    cache->lru.next->prev = node;
+    cache->lru.next = node;
+}
+
+static inline uint64_t __cache_expire(const ut_cache_t *cache, uint32_t ttl_ms)
+{
+    if (ttl_ms == UT_CACHE_TTL_DEFAULT) {
+        ttl_ms = cache->ttl;
+    }
+    if (ttl_ms == UT_CACHE_TTL_NONE || ttl_ms == 0) {
+        return 0;
+    }
+    return __cache_now_ms() + ttl_ms;
+}
+
+/**
+ * @brief 将节点从缓存中移除并释放，值通过回调交给调用者
+ *
+ * @param cache 缓存的描述结构
+ * @param node 被移除的节点
+ * @param reason 移除的原因，为负数时不回调
+ * @return void* 节点的值
+ */
+static void* __cache_remove(ut_cache_t *cache, cache_node_t *node, int32_t reason)
+{
+    void*   value = node->value;
+
+    ut_hash_pop_hashed(cache->index, node->key, node->keylen, node->hash);
+    __lru_unlink(node);
+    cache->usage -= node->charge;
+    if (reason >= 0 && cache->evict != NULL) {
+        cache->evict(node->key, node->keylen, value, (ut_cache_reason_t)reason, cache->context);
+    }
+    free(node);
+    return value;
+}
+
+/**
+ * @brief 从LRU链表尾部开始淘汰元素，直到能放下charge大小的新元素
+ */
+static void __cache_make_room(ut_cache_t *cache, size_t charge)
+{
+    while (cache->usage + charge > cache->budget && cache->lru.prev != &cache->lru) {
+        cache_node_t*   victim = cache->lru.prev;
+
+        /* 已经过期的元素按过期处理 */
+        if (victim->expire != 0 && victim->expire <= __cache_now_ms()) {
+            cache->stats.expirations++;
+            __cache_remove(cache, victim, UT_CACHE_EVICT_EXPIRED);
+        } else {
+            cache->stats.evictions++;
+            __cache_remove(cache, victim, UT_CACHE_EVICT_CAPACITY);
+        }
+    }
+}
+
+
+ut_errno_t ut_cache_create(ut_cache_t **out, size_t budget, uint32_t ttl_ms, ut_cache_evict_cb evict, void* context)
+{
+    ut_cache_t*     cache = NULL;
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(out, retval, UT_ERRNO_NULLPTR);
+    CHECK_VAL_EQ(budget, 0, retval = UT_ERRNO_INVALID, TAG_OUT);
+
+    cache = ut_zero_alloc(sizeof(ut_cache_t));
+    CHECK_PTR_RET(cache, retval, UT_ERRNO_OUTOFMEM);
+
+    /* 缓存的键通常来自外部，使用随机种子避免被构造碰撞 */
+    retval = ut_hash_create_ex(&cache->index, 0, NULL, UT_HASH_FLAG_SEED);
+    CHECK_VAL_NEQ(retval, UT_ERRNO_OK, free(cache), TAG_OUT);
+
+    cache->lru.prev = cache->lru.next = &cache->lru;
+    cache->budget = budget;
+    cache->ttl = ttl_ms;
+    cache->evict = evict;
+    cache->context = context;
+    *out = cache;
+
+TAG_OUT:
+    return retval;
+}
+
+ut_errno_t ut_cache_destroy(ut_cache_t *cache)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(cache, retval, UT_ERRNO_NULLPTR);
+
+    while (cache->lru.next != &cache->lru) {
+        __cache_remove(cache, cache->lru.next, UT_CACHE_EVICT_CLEAR);
+    }
+    ut_hash_destroy(cache->index);
+    free(cache);
+
+TAG_OUT:
+    return retval;
+}
+
+ut_errno_t ut_cache_put(ut_cache_t *cache, const char *key, const void* value)
+{
+    if (key == NULL) {
+        return UT_ERRNO_NULLPTR;
+    }
+    return ut_cache_put_bin(cache, key, strlen(key), value, 0, UT_CACHE_TTL_DEFAULT);
+}
+
+ut_errno_t ut_cache_put_bin(ut_cache_t *cache, const void *key, uint32_t keylen, const void* value, size_t charge, uint32_t ttl_ms)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+    cache_node_t*   node = NULL;
+    cache_node_t*   new_node = NULL;
+    void**          slot = NULL;
+    ut_bool_t       inserted = UT_FALSE;
+
+    CHECK_PTR_RET(cache, retval, UT_ERRNO_NULLPTR);
+    CHECK_PTR_RET(key, retval, UT_ERRNO_NULLPTR);
+    CHECK_PTR_RET(value, retval, UT_ERRNO_NULLPTR);
+
+    if (charge == 0) {
+        charge = sizeof(cache_node_t) + keylen;
+    }
+    CHECK_VAL_EQ(charge > cache->budget, UT_TRUE, retval = UT_ERRNO_RESOURCE, TAG_OUT);
+
+    /* 先按新元素申请节点，插入和查找只需要一次哈希表操作；键已经存在时释放新节点，原地复用旧节点 */
+    new_node = malloc(sizeof(cache_node_t) + keylen);
+    CHECK_PTR_RET(new_node, retval, UT_ERRNO_OUTOFMEM);
+    new_node->hash = ut_hash_calc_bin(cache->index, key, keylen);
+    new_node->keylen = keylen;
+    memcpy(new_node->key, key, keylen);
+
+    slot = ut_hash_find_or_insert_hashed(cache->index, new_node->key, keylen, new_node->hash, new_node, &inserted);
+    CHECK_VAL_EQ(slot, NULL, free(new_node); retval = UT_ERRNO_OUTOFMEM, TAG_OUT);
+    if (inserted) {
+        node = new_node;
+        node->value = (void*)value;
+        cache->stats.inserts++;
+    } else {
+        void*   old_value = NULL;
+
+        free(new_node);
+        node = *slot;
+        old_value = node->value;
+        __lru_unlink(node);
+        cache->usage -= node->charge;
+        node->value = (void*)value;
+        if (cache->evict != NULL && old_value != value) {
+            cache->evict(node->key, node->keylen, old_value, UT_CACHE_EVICT_REPLACED, cache->context);
+        }
+    }
+    node->charge = charge;
+    node->expire = __cache_expire(cache, ttl_ms);
+
+    __cache_make_room(cache, charge);
+    cache->usage += charge;
+    __lru_push_front(cache, node);
+
+TAG_OUT:
+    return retval;
+}
+
+void* ut_cache_get(ut_cache_t *cache, const char *key)
+{
+    if (key == NULL) {
+        return NULL;
+    }
+    return ut_cache_get_bin(cache, key, strlen(key));
+}
+
+void* ut_cache_get_bin(ut_cache_t *cache, const void *key, uint32_t keylen)
+{
+    cache_node_t*   node = NULL;
+
+    if (cache == NULL || key == NULL) {
+        return NULL;
+    }
+
+    node = ut_hash_peek_bin(cache->index, key, keylen);
+    if (node == NULL) {
+        cache->stats.misses++;
+        return NULL;
+    }
+    if (node->expire != 0 && node->expire <= __cache_now_ms()) {
+        cache->stats.expirations++;
+        cache->stats.misses++;
+        __cache_remove(cache, node, UT_CACHE_EVICT_EXPIRED);
+        return NULL;
+    }
+
+    cache->stats.hits++;
+    if (cache->lru.next != node) {
+        __lru_unlink(node);
+        __lru_push_front(cache, node);
+    }
+    return node->value;
+}
+
+void* ut_cache_del(ut_cache_t *cache, const char *key)
+{
+    if (key == NULL) {
+        return NULL;
+    }
+    return ut_cache_del_bin(cache, key, strlen(key));
+}
+
+void* ut_cache_del_bin(ut_cache_t *cache, const void *key, uint32_t keylen)
+{
+    cache_node_t*   node = NULL;
+
+    if (cache == NULL || key == NULL) {
+        return NULL;
+    }
+    node = ut_hash_peek_bin(cache->index, key, keylen);
+    if (node == NULL) {
+        return NULL;
+    }
+    return __cache_remove(cache, node, -1);
+}
+
+uint32_t ut_cache_purge(ut_cache_t *cache)
+{
+    cache_node_t*   node = NULL;
+    uint64_t        now = 0;
+    uint32_t        purged = 0;
+
+    if (cache == NULL) {
+        return 0;
+    }
+
+    now = __cache_now_ms();
+    node = cache->lru.prev;
+    while (node != &cache->lru) {
+        cache_node_t*   prev = node->prev;
+
+        if (node->expire != 0 && node->expire <= now) {
+            cache->stats.expirations++;
+            __cache_remove(cache, node, UT_CACHE_EVICT_EXPIRED);
+            purged++;
+        }
+        node = prev;
+    }
+    return purged;
+}
+
+ut_errno_t ut_cache_stats(ut_cache_t *cache, ut_cache_stats_t *stats)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(cache, retval, UT_ERRNO_NULLPTR);
+    CHECK_PTR_RET(stats, retval, UT_ERRNO_NULLPTR);
+
+    *stats = cache->stats;
+    stats->count = ut_hash_count(cache->index);
+    stats->usage = cache->usage;
+    stats->budget = cache->budget;
+
+TAG_OUT:
+    return retval;
+}
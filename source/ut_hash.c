@@ -9,265 +9,1486 @@
  * 
  */
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/mman.h>
+#include <pthread.h>
 #include "ut/ut_hash.h"
+#include "ut_hash_inn.h"
 
 #define INITIAL_MAX 15 /* 2^n - 1 */
 
 #define HASH_DEFAULT_MULTIPLER 33
 
-typedef struct hash_entry {
-    int32_t hash;               /* 哈希值 */
-    char key[UT_LEN_32];           /* 键 */
-    void* value;                /* 值 */
-    struct hash_entry* next;    /* 哈希链表下一个 */
-} hash_entry_t;
+#define HASH_FNV_OFFSET 2166136261U
+#define HASH_FNV_PRIME  16777619U
 
+/* wyhash使用的常数 */
+#define HASH_WY_S0  0xa0761d6478bd642fULL
+#define HASH_WY_S1  0xe7037ed1a0b428dbULL
+#define HASH_WY_S2  0x8ebc6af09c88c6e3ULL
+#define HASH_WY_S3  0x589965cc75374cc3ULL
 
-struct ut_hash_t {
-    hash_entry_t **array;       /* 哈希bucket */
-    uint32_t count;             /* 当前哈希表内的数据 */
-    uint32_t max;               /* 哈希表最大存储数据 */
-    ut_hash_func ut_hash_func;        /* 哈希函数 */
-    hash_entry_t *free;         /* 避免频繁free使用 */
-};
+#define HASH_REHASH_STEP            4   /* 渐进式扩容时每次操作迁移的bucket数量 */
+#define HASH_REHASH_EMPTY_VISITS    10  /* 每迁移一个bucket最多访问的空bucket数量 */
+
+#define HASH_SCAN_EMPTY_VISITS  10  /* 游标遍历时每个预算最多访问的空bucket数量 */
+
+#define HASH_BATCH_WIDTH    16  /* 批量查找时每一轮同时预取的键数量 */
+
+#define HASH_SLAB_SIZE          65536   /* slab大小，slab按此大小对齐 */
+#define HASH_SLAB_ENTRY_OFFSET  ((sizeof(hash_slab_t) + 63) & ~(size_t)63)  /* 只有第一个元素按缓存行对齐，元素之间不填充 */
+#define HASH_SLAB_ENTRIES       ((HASH_SLAB_SIZE - HASH_SLAB_ENTRY_OFFSET) / sizeof(hash_entry_t))
+#define HASH_FREE_DEFAULT_MAX   256     /* 空闲链表默认上限 */
+
+#define HASH_ARENA_CHUNK_SIZE   4096
+#define HASH_ARENA_MIN_BLOCK    16
 
 /**
- * @brief 默认的哈希函数
+ * @brief 默认的哈希函数，逐字节计算，对字符串键与逐字节计算结果相同
  * 
- * @param char_key 
+ * @param key 键
+ * @param keylen 键的长度
  * @return uint32_t 
  */
-static uint32_t hashfunc_default(const char* char_key)
+uint32_t __hashfunc_default(const void* key, uint32_t keylen)
 {
-    const char*     key = (const char *)char_key;
-    const char*     cur_pos = NULL;
+    const char*     cur_pos = (const char *)key;
+    const char*     end = cur_pos + keylen;
     uint32_t        hash = 0;
 
-    for (cur_pos = key; *cur_pos; cur_pos++) {
+    for (; cur_pos < end; cur_pos++) {
         hash = hash * HASH_DEFAULT_MULTIPLER + *cur_pos;
     }
     return hash;
 }
 
 /**
- * @brief 分配哈希bucket
+ * @brief FNV-1a哈希函数，种子混入初始值
  * 
- * @param hash_table 哈希表描述结构体
- * @param max 哈希表最大值
- * @return hash_entry_t** 
+ * @param key 键
+ * @param keylen 键的长度
+ * @param seed 种子
+ * @return uint32_t 
  */
-static hash_entry_t** __alloc_array(ut_hash_t *hash_table, uint32_t max)
+uint32_t __hashfunc_fnv1a(const void* key, uint32_t keylen, uint64_t seed)
 {
-    return ut_zero_alloc(sizeof(*hash_table->array) * (max + 1));
+    const uint8_t*  cur_pos = (const uint8_t *)key;
+    const uint8_t*  end = cur_pos + keylen;
+    uint32_t        hash = HASH_FNV_OFFSET ^ (uint32_t)seed ^ (uint32_t)(seed >> 32);
+
+    for (; cur_pos < end; cur_pos++) {
+        hash = (hash ^ *cur_pos) * HASH_FNV_PRIME;
+    }
+    return hash;
 }
 
 /**
- * @brief 进行哈希表的扩容
+ * @brief 64位乘法，a和b分别替换为128位结果的低64位和高64位
+ */
+static inline void __wy_mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t    ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t    rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t    t = rl + (rm0 << 32);
+    uint64_t    lo = t + (rm1 << 32);
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+    *a = lo;
+#endif
+}
+
+static inline uint64_t __wy_mix(uint64_t a, uint64_t b)
+{
+    __wy_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t __wy_read8(const uint8_t* p)
+{
+    uint64_t    v = 0;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t __wy_read4(const uint8_t* p)
+{
+    uint32_t    v = 0;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief wyhash哈希函数，每次读取8字节，长键每轮并行处理48字节
  * 
- * @param hash_table 哈希表描述结构体
+ * @param key 键
+ * @param keylen 键的长度
+ * @param seed 种子
+ * @return uint64_t 
  */
-static void __expand_array(ut_hash_t *hash_table)
+uint64_t __hashfunc_wy(const void* key, uint32_t keylen, uint64_t seed)
 {
-    hash_entry_t**   new_array = NULL;
-    uint32_t            new_max;
+    const uint8_t*  p = (const uint8_t *)key;
+    uint32_t        left = keylen;
+    uint64_t        a = 0;
+    uint64_t        b = 0;
 
-    new_max = hash_table->max * 2 + 1;
-    new_array = __alloc_array(hash_table, new_max);
+    seed ^= __wy_mix(seed ^ HASH_WY_S0, HASH_WY_S1);
+    if (keylen <= 16) {
+        if (keylen >= 4) {
+            a = (__wy_read4(p) << 32) | __wy_read4(p + ((keylen >> 3) << 2));
+            b = (__wy_read4(p + keylen - 4) << 32) | __wy_read4(p + keylen - 4 - ((keylen >> 3) << 2));
+        } else if (keylen > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[keylen >> 1] << 8) | p[keylen - 1];
+        }
+    } else {
+        if (left > 48) {
+            uint64_t    see1 = seed;
+            uint64_t    see2 = seed;
 
-    for (uint32_t i = 0; i <= hash_table->max; i++) {
-        hash_entry_t *entry = hash_table->array[i];
-        while (entry) {
-            hash_entry_t *next = entry->next;
-            uint32_t index = entry->hash & new_max;
-            entry->next = new_array[index];
-            new_array[index] = entry;
-            entry = next;
+            do {
+                seed = __wy_mix(__wy_read8(p) ^ HASH_WY_S1, __wy_read8(p + 8) ^ seed);
+                see1 = __wy_mix(__wy_read8(p + 16) ^ HASH_WY_S2, __wy_read8(p + 24) ^ see1);
+                see2 = __wy_mix(__wy_read8(p + 32) ^ HASH_WY_S3, __wy_read8(p + 40) ^ see2);
+                p += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= see1 ^ see2;
         }
+        while (left > 16) {
+            seed = __wy_mix(__wy_read8(p) ^ HASH_WY_S1, __wy_read8(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+        a = __wy_read8(p + left - 16);
+        b = __wy_read8(p + left - 8);
     }
-    free(hash_table->array);
-    hash_table->array = new_array;
-    hash_table->max = new_max;
+
+    a ^= HASH_WY_S1;
+    b ^= seed;
+    __wy_mum(&a, &b);
+    return __wy_mix(a ^ HASH_WY_S0 ^ keylen, b ^ HASH_WY_S1);
 }
 
+/**
+ * @brief 生成哈希表的随机种子，getrandom不可用时退化为时间和地址的组合
+ * 
+ * @return uint64_t 
+ */
+uint64_t __hash_random_seed(void)
+{
+    uint64_t        seed = 0;
+    struct timespec now;
 
-ut_errno_t ut_hash_create(ut_hash_t **out, uint32_t size, ut_hash_func ut_hash_func)
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) == sizeof(seed)) {
+        return seed;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    seed = ((uint64_t)now.tv_sec << 32) ^ (uint64_t)now.tv_nsec ^ ((uint64_t)getpid() << 16) ^ (uint64_t)(uintptr_t)&seed;
+    return __wy_mix(seed ^ HASH_WY_S2, HASH_WY_S3);
+}
+
+/**
+ * @brief 计算键的哈希值。用户指定的哈希函数只作用于字符串键，
+ *        其余情况按创建时的标志位选择内置的哈希函数
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @param key 键
+ * @param keylen 键的长度
+ * @param is_str 键是否是'\0'结尾的字符串
+ * @return uint32_t 
+ */
+static inline uint32_t __hash_key(const ut_hash_t *hash_table, const void* key, uint32_t keylen, ut_bool_t is_str)
 {
-    uint32_t    max_size = 0;
-    ut_hash_t*  hash_table = NULL;
-    ut_errno_t  retval = UT_ERRNO_OK;
+    if (is_str && hash_table->ut_hash_func != NULL) {
+        return hash_table->ut_hash_func((const char*)key);
+    }
+    if (hash_table->flags & UT_HASH_FLAG_HASH_WY) {
+        uint64_t    hash = __hashfunc_wy(key, keylen, hash_table->seed);
+        return (uint32_t)(hash ^ (hash >> 32));
+    }
+    if (hash_table->flags & UT_HASH_FLAG_HASH_FNV1A) {
+        return __hashfunc_fnv1a(key, keylen, hash_table->seed);
+    }
+    return __hashfunc_default(key, keylen);
+}
 
-    CHECK_PTR_RET(out, retval, UT_ERRNO_NULLPTR);
-    CHECK_VAL_EQ(size < 0, UT_TRUE, retval = UT_ERRNO_INVALID, TAG_OUT);
+/**
+ * @brief 计算arena块的大小级别，级别i的块大小为 HASH_ARENA_MIN_BLOCK << i
+ * 
+ * @param size 需要的大小
+ * @return int32_t 超出最大级别时返回-1
+ */
+static int32_t __arena_class(uint32_t size)
+{
+    int32_t     class = 0;
+    uint32_t    block = HASH_ARENA_MIN_BLOCK;
 
-    if (size == 0) {
-        max_size = INITIAL_MAX;
-    } else {
-        // 0.75 load factor.
-        size = size * 4 / 3;
-        max_size = 1;
-        while (max_size < size) {
-            max_size <<= 1;
-        }
-        max_size -= 1;
+    /* 超过最大级别时提前结束，避免block左移溢出 */
+    while (block < size && class < HASH_ARENA_CLASSES) {
+        block <<= 1;
+        class++;
+    }
+    return class < HASH_ARENA_CLASSES ? class : -1;
+}
+
+/**
+ * @brief 从arena中申请一块内存，用于存放长键。被释放的块按大小级别挂在空闲链表上复用
+ * 
+ * @param arena 哈希表的arena
+ * @param size 需要的大小
+ * @return void* 
+ */
+static void* __arena_alloc(hash_arena_t *arena, uint32_t size)
+{
+    hash_arena_chunk_t* chunk = NULL;
+    int32_t             class = __arena_class(size);
+    uint32_t            block = 0;
+    void*               mem = NULL;
+
+    /* 过长的键直接从堆上申请 */
+    if (class < 0) {
+        return malloc(size);
     }
 
-    if (ut_hash_func == NULL)
-        ut_hash_func = hashfunc_default;
+    if (arena->free_list[class] != NULL) {
+        mem = arena->free_list[class];
+        arena->free_list[class] = *(void**)mem;
+        return mem;
+    }
 
-    hash_table = ut_zero_alloc(sizeof(ut_hash_t));
-    *out = hash_table;
-    hash_table->count = 0;
-    hash_table->max = max_size;
-    hash_table->ut_hash_func = ut_hash_func;
-    hash_table->array = __alloc_array(hash_table, hash_table->max);
-    hash_table->free = NULL;
+    block = HASH_ARENA_MIN_BLOCK << class;
+    if (arena->left < block) {
+        chunk = malloc(sizeof(hash_arena_chunk_t) + HASH_ARENA_CHUNK_SIZE);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->cur = chunk->data;
+        arena->left = HASH_ARENA_CHUNK_SIZE;
+    }
+    mem = arena->cur;
+    arena->cur += block;
+    arena->left -= block;
 
-TAG_OUT:
-    return retval;
+    return mem;
 }
 
+static void __arena_free(hash_arena_t *arena, void* mem, uint32_t size)
+{
+    int32_t     class = __arena_class(size);
 
-ut_errno_t ut_hash_destroy(ut_hash_t *hash_table)
+    if (class < 0) {
+        free(mem);
+        return;
+    }
+    *(void**)mem = arena->free_list[class];
+    arena->free_list[class] = mem;
+}
+
+static void __arena_destroy(hash_arena_t *arena)
 {
-    ut_errno_t          retval = UT_ERRNO_OK;
-    hash_entry_t*    entry = NULL;
+    hash_arena_chunk_t* chunk = arena->chunks;
 
-    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+    while (chunk) {
+        hash_arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    memset(arena, 0, sizeof(hash_arena_t));
+}
 
-    for (uint32_t i = 0; i <= hash_table->max; i++) {
-        entry = hash_table->array[i];
-        while (entry) {
-            hash_entry_t *next = entry->next;
-            free(entry);
-            entry = next;
+ut_errno_t __key_store(ut_hash_t *hash_table, hash_key_t *dst, const void* key, uint32_t keylen)
+{
+    char*   data = dst->data;
+
+    if (keylen > HASH_KEY_MAX) {
+        return UT_ERRNO_INVALID;
+    }
+    if (!HASH_KEY_IS_INLINE(keylen)) {
+        data = __arena_alloc(&hash_table->arena, keylen + 1);
+        if (data == NULL) {
+            return UT_ERRNO_OUTOFMEM;
         }
+        dst->ptr = data;
     }
+    memcpy(data, key, keylen);
+    data[keylen] = '\0';
 
-    entry = hash_table->free;
-    while(entry) {
-        hash_entry_t *next = entry->next;
-        free(entry);
-        entry = next;
+    return UT_ERRNO_OK;
+}
+
+void __key_release(ut_hash_t *hash_table, hash_key_t *key, uint32_t keylen)
+{
+    if (!HASH_KEY_IS_INLINE(keylen)) {
+        __arena_free(&hash_table->arena, key->ptr, keylen + 1);
+        key->ptr = NULL;
     }
+}
 
-    free(hash_table->array);
-    free(hash_table);
+/**
+ * @brief 从系统映射一个按HASH_SLAB_SIZE对齐的slab，多映射一个slab大小再裁掉首尾
+ * 
+ * @return hash_slab_t* 
+ */
+static hash_slab_t* __slab_map(void)
+{
+    char*       mem = NULL;
+    uintptr_t   aligned = 0;
+    size_t      head = 0;
 
-TAG_OUT:
-    return retval;
+    mem = mmap(NULL, HASH_SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    aligned = ((uintptr_t)mem + HASH_SLAB_SIZE - 1) & ~(uintptr_t)(HASH_SLAB_SIZE - 1);
+    head = aligned - (uintptr_t)mem;
+    if (head > 0) {
+        munmap(mem, head);
+    }
+    munmap((char*)aligned + HASH_SLAB_SIZE, HASH_SLAB_SIZE - head);
+
+    return (hash_slab_t*)aligned;
 }
 
-static hash_entry_t **find_entry(ut_hash_t *hash_table, const char *key, const void* value)
+/**
+ * @brief 从slab链表中摘下一个slab
+ */
+static void __slab_unlink(hash_slab_t **list, hash_slab_t *slab)
 {
-    hash_entry_t**   retval = NULL;
-    hash_entry_t*    hash_entry = NULL;
-    uint32_t            hash = 0;
-    ut_bool_t           found = UT_FALSE;
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = slab->prev = NULL;
+}
 
-    CHECK_PTR(hash_table);
+static void __slab_link(hash_slab_t **list, hash_slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
 
-    hash = hash_table->ut_hash_func(key);
-    retval = &hash_table->array[hash & hash_table->max];
+static inline ut_bool_t __slab_full(const hash_slab_t *slab)
+{
+    return slab->free == NULL && slab->carved == HASH_SLAB_ENTRIES;
+}
 
-    for (hash_entry = *retval; hash_entry; retval = &hash_entry->next, hash_entry = *retval) {
-        if (hash_entry->hash == hash && strcmp(hash_entry->key, key) == 0) {
-            found = UT_TRUE;
-            break;
+/**
+ * @brief 从slab中申请一个元素，用完的slab移到slabs_full链表中
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @return hash_entry_t* 清零的元素
+ */
+static hash_entry_t* __slab_alloc(ut_hash_t *hash_table)
+{
+    hash_slab_t*    slab = hash_table->slabs;
+    hash_entry_t*   entry = NULL;
+
+    if (slab == NULL) {
+        slab = __slab_map();
+        if (slab == NULL) {
+            return NULL;
         }
+        __slab_link(&hash_table->slabs, slab);
     }
-    CHECK_VAL_NEQ(!value && !found, UT_FALSE, retval = NULL, TAG_OUT);
-    CHECK_VAL_NEQ(hash_entry || !value, UT_FALSE, NULL, TAG_OUT);
 
-    if ((hash_entry = hash_table->free) != NULL) {
-        hash_table->free = hash_entry->next;
+    if (slab->free != NULL) {
+        entry = slab->free;
+        slab->free = entry->next;
+        memset(entry, 0, sizeof(hash_entry_t));
     } else {
-        hash_entry = ut_zero_alloc(sizeof(*hash_entry));
+        /* 新映射的内存已经是0 */
+        entry = (hash_entry_t*)((char*)slab + HASH_SLAB_ENTRY_OFFSET) + slab->carved++;
     }
-    hash_entry->next = NULL;
-    hash_entry->hash = hash;
-    strncpy(hash_entry->key, key, sizeof(hash_entry->key) - 2);
-    *retval = hash_entry;
-    hash_table->count++;
+    slab->used++;
 
-TAG_OUT:
-    return retval;
+    if (__slab_full(slab)) {
+        __slab_unlink(&hash_table->slabs, slab);
+        __slab_link(&hash_table->slabs_full, slab);
+    }
+    return entry;
 }
 
-
-void* ut_hash_push(ut_hash_t *hash_table, const char *key, const void* value)
+/**
+ * @brief 将元素归还给所属的slab，slab中的元素全部归还后将slab释放给系统
+ */
+static void __slab_free(ut_hash_t *hash_table, hash_entry_t *entry)
 {
-    void* old_value = NULL;
-    hash_entry_t **hash_entry_addr;
+    hash_slab_t*    slab = (hash_slab_t*)((uintptr_t)entry & ~(uintptr_t)(HASH_SLAB_SIZE - 1));
+    ut_bool_t       was_full = __slab_full(slab);
 
-    if (key == NULL) {
-        return NULL;
+    entry->next = slab->free;
+    slab->free = entry;
+    if (was_full) {
+        __slab_unlink(&hash_table->slabs_full, slab);
+        __slab_link(&hash_table->slabs, slab);
     }
-
-    hash_entry_addr = find_entry(hash_table, key, value);
-    if (hash_entry_addr == NULL) {
-        /* 没有存储过却要删除key */
-        return old_value;
-    } else if (*hash_entry_addr) {
-        if (!value) {
-            /* delete entry */
-            hash_entry_t *old = *hash_entry_addr;
-            *hash_entry_addr = (*hash_entry_addr)->next;
-            old->next = hash_table->free;
-            old_value = old->value;
-            old->value = NULL;
-            //free指针指向被移除的节点，该节点将提供给下一个写入节点使用，避免频繁malloc
-            hash_table->free = old;
-            --hash_table->count;
-        } else {
-            /* replace entry */
-            old_value = (*hash_entry_addr)->value;
-            (*hash_entry_addr)->value = (void*)value;
-            /* check that the collision rate isn't too high */
-            if (hash_table->count > hash_table->max) {
-                __expand_array(hash_table);
-            }
-        }
+    if (--slab->used == 0) {
+        __slab_unlink(&hash_table->slabs, slab);
+        munmap(slab, HASH_SLAB_SIZE);
     }
-    return (void*)old_value;
 }
 
+static void __slab_destroy(hash_slab_t *slab)
+{
+    while (slab) {
+        hash_slab_t*    next = slab->next;
+        munmap(slab, HASH_SLAB_SIZE);
+        slab = next;
+    }
+}
 
-void* ut_hash_pop(ut_hash_t* hash_table, const char* key)
+/**
+ * @brief 申请一个元素，优先使用空闲链表中的元素
+ */
+static hash_entry_t* __entry_alloc(ut_hash_t *hash_table)
 {
-    return ut_hash_push(hash_table, key, NULL);
+    hash_entry_t*   entry = hash_table->free;
+
+    if (entry != NULL) {
+        hash_table->free = entry->next;
+        hash_table->free_count--;
+        entry->next = NULL;
+        return entry;
+    }
+    return __slab_alloc(hash_table);
 }
 
+/**
+ * @brief 释放一个元素。空闲链表未满时放入空闲链表，避免频繁的申请释放，否则直接归还给slab
+ */
+static void __entry_free(ut_hash_t *hash_table, hash_entry_t *entry)
+{
+    entry->value = NULL;
+    if (hash_table->free_count < hash_table->free_max) {
+        entry->next = hash_table->free;
+        hash_table->free = entry;
+        hash_table->free_count++;
+        return;
+    }
+    __slab_free(hash_table, entry);
+}
 
-void* ut_hash_peek(ut_hash_t *hash_table, const char *key)
+/**
+ * @brief 按预期的元素数量计算bucket数组大小，负载因子0.75
+ * 
+ * @param size 预期的元素数量
+ * @return uint32_t bucket数量 - 1
+ */
+static uint32_t __bucket_max(uint32_t size)
 {
-    hash_entry_t**   hash_entry_addr = NULL;
+    uint32_t    max_size = 1;
 
-    hash_entry_addr = find_entry(hash_table, key, NULL);
-    if (hash_entry_addr)
-        return (void*)((*hash_entry_addr)->value);
-    else
-        return NULL;
+    if (size == 0) {
+        return INITIAL_MAX;
+    }
+    size = size * 4 / 3;
+    while (max_size < size) {
+        max_size <<= 1;
+    }
+    return max_size - 1;
 }
 
-
-int32_t ut_hash_count(ut_hash_t *hash_table)
+/**
+ * @brief 分配哈希bucket
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @param max 哈希表最大值
+ * @return hash_entry_t** 
+ */
+static hash_entry_t** __alloc_array(ut_hash_t *hash_table, uint32_t max)
 {
-    return hash_table->count;
+    return ut_zero_alloc(sizeof(*hash_table->array) * (max + 1));
 }
 
-void ut_hash_foreach(ut_hash_t *hash_table, ut_hash_cb callback, void* context)
+/**
+ * @brief 重新分配bucket数组，并将所有元素放入新的bucket数组
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @param new_max 新的bucket数量 - 1
+ */
+static void __resize_array(ut_hash_t *hash_table, uint32_t new_max)
 {
-    uint32_t    i = 0;
+    hash_entry_t**   new_array = NULL;
 
-    for (i = 0; i <= hash_table->max; i++) {
-        hash_entry_t* entry = hash_table->array[i];
+    new_array = __alloc_array(hash_table, new_max);
+    if (new_array == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i <= hash_table->max; i++) {
+        hash_entry_t *entry = hash_table->array[i];
         while (entry) {
             hash_entry_t *next = entry->next;
-            if (!callback(entry->key, entry->value, context)) {
-                return;
-            }
+            uint32_t index = entry->hash & new_max;
+            entry->next = new_array[index];
+            new_array[index] = entry;
             entry = next;
         }
     }
+    free(hash_table->array);
+    hash_table->array = new_array;
+    hash_table->max = new_max;
+    HASH_STAT_INC(hash_table, resizes);
+}
+
+/**
+ * @brief 进行哈希表的扩容
+ * 
+ * @param hash_table 哈希表描述结构体
+ */
+static void __expand_array(ut_hash_t *hash_table)
+{
+    __resize_array(hash_table, hash_table->max * 2 + 1);
+}
+
+/**
+ * @brief 渐进式扩容：迁移若干个旧bucket到新的bucket数组中。
+ *        每次最多迁移buckets个非空bucket，并限制访问空bucket的次数，保证单次操作的耗时有上限
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @param buckets 本次迁移的非空bucket数量
+ */
+static void __rehash_step(ut_hash_t *hash_table, uint32_t buckets)
+{
+    uint32_t    empty_visits = buckets * HASH_REHASH_EMPTY_VISITS;
+
+    while (buckets > 0 && hash_table->rehash_idx <= hash_table->old_max) {
+        hash_entry_t *entry = hash_table->old_array[hash_table->rehash_idx];
+
+        if (entry == NULL) {
+            hash_table->rehash_idx++;
+            if (--empty_visits == 0) {
+                return;
+            }
+            continue;
+        }
+        while (entry) {
+            hash_entry_t *next = entry->next;
+            uint32_t index = entry->hash & hash_table->max;
+            entry->next = hash_table->array[index];
+            hash_table->array[index] = entry;
+            entry = next;
+        }
+        hash_table->old_array[hash_table->rehash_idx++] = NULL;
+        buckets--;
+    }
+
+    if (hash_table->rehash_idx > hash_table->old_max) {
+        CHECK_FREE(hash_table->old_array);
+        hash_table->old_max = 0;
+        hash_table->rehash_idx = 0;
+    }
+}
+
+/**
+ * @brief 哈希表元素过多时进行扩容。渐进式扩容模式下只分配新的bucket数组，
+ *        旧的bucket数组保留，由之后的每次操作逐步迁移
+ * 
+ * @param hash_table 哈希表描述结构体
+ */
+static void __grow(ut_hash_t *hash_table)
+{
+    hash_entry_t**  new_array = NULL;
+    uint32_t        new_max = 0;
+
+    if (!(hash_table->flags & UT_HASH_FLAG_INCREMENTAL)) {
+        __expand_array(hash_table);
+        return;
+    }
+
+    /* 上一次的迁移还没有完成，先完成它 */
+    while (hash_table->old_array != NULL) {
+        __rehash_step(hash_table, hash_table->old_max + 1);
+    }
+
+    new_max = hash_table->max * 2 + 1;
+    new_array = __alloc_array(hash_table, new_max);
+    if (new_array == NULL) {
+        return;
+    }
+    HASH_STAT_INC(hash_table, resizes);
+    hash_table->old_array = hash_table->array;
+    hash_table->old_max = hash_table->max;
+    hash_table->rehash_idx = 0;
+    hash_table->array = new_array;
+    hash_table->max = new_max;
+}
+
+/**
+ * @brief 在bucket数组中查找键
+ * 
+ * @param array bucket数组
+ * @param max bucket数组大小 - 1
+ * @return hash_entry_t** 找到时返回指向该元素的链接，找不到时返回链表末尾的链接
+ */
+static hash_entry_t **__chain_lookup(hash_entry_t **array, uint32_t max, const void *key, uint32_t keylen, uint32_t hash)
+{
+    hash_entry_t**  link = &array[hash & max];
+    hash_entry_t*   hash_entry = NULL;
+
+    for (hash_entry = *link; hash_entry; link = &hash_entry->next, hash_entry = *link) {
+        if (hash_entry->hash == hash && __key_equal(&hash_entry->key, hash_entry->keylen, key, keylen)) {
+            break;
+        }
+    }
+    return link;
+}
+
+/**
+ * @brief 在哈希表中查找键。渐进式扩容过程中，还没有迁移的bucket里的元素仍然在旧的bucket数组中，
+ *        新元素总是写入新的bucket数组
+ * 
+ * @return hash_entry_t** 找到时返回指向该元素的链接，找不到时返回新bucket数组中链表末尾的链接
+ */
+static hash_entry_t **__chain_find(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash)
+{
+    hash_entry_t**  link = NULL;
+
+    if (hash_table->old_array != NULL && (hash & hash_table->old_max) >= hash_table->rehash_idx) {
+        link = __chain_lookup(hash_table->old_array, hash_table->old_max, key, keylen, hash);
+        if (*link != NULL) {
+            return link;
+        }
+    }
+    return __chain_lookup(hash_table->array, hash_table->max, key, keylen, hash);
+}
+
+
+ut_errno_t ut_hash_create(ut_hash_t **out, uint32_t size, ut_hash_func ut_hash_func)
+{
+    return ut_hash_create_ex(out, size, ut_hash_func, UT_HASH_FLAG_NONE);
+}
+
+
+ut_errno_t ut_hash_create_ex(ut_hash_t **out, uint32_t size, ut_hash_func ut_hash_func, uint32_t flags)
+{
+    uint32_t    max_size = 0;
+    ut_hash_t*  hash_table = NULL;
+    ut_errno_t  retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(out, retval, UT_ERRNO_NULLPTR);
+    CHECK_VAL_EQ(size < 0, UT_TRUE, retval = UT_ERRNO_INVALID, TAG_OUT);
+
+    max_size = __bucket_max(size);
+
+    hash_table = ut_zero_alloc(sizeof(ut_hash_t));
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_OUTOFMEM);
+    hash_table->count = 0;
+    if ((flags & UT_HASH_FLAG_SEED) && !(flags & (UT_HASH_FLAG_HASH_WY | UT_HASH_FLAG_HASH_FNV1A))) {
+        flags |= UT_HASH_FLAG_HASH_WY;
+    }
+    hash_table->flags = flags;
+    hash_table->seed = (flags & UT_HASH_FLAG_SEED) ? __hash_random_seed() : 0;
+    hash_table->ut_hash_func = ut_hash_func;
+    hash_table->free = NULL;
+    hash_table->free_max = HASH_FREE_DEFAULT_MAX;
+
+    if (flags & UT_HASH_FLAG_FLAT) {
+        retval = __flat_init(hash_table, size);
+    } else {
+        hash_table->max = max_size;
+        hash_table->array = __alloc_array(hash_table, hash_table->max);
+        if (hash_table->array == NULL) {
+            retval = UT_ERRNO_OUTOFMEM;
+        }
+    }
+    CHECK_VAL_NEQ(retval, UT_ERRNO_OK, free(hash_table), TAG_OUT);
+    *out = hash_table;
+
+TAG_OUT:
+    return retval;
+}
+
+
+ut_errno_t ut_hash_destroy(ut_hash_t *hash_table)
+{
+    ut_errno_t          retval = UT_ERRNO_OK;
+    hash_entry_t*    entry = NULL;
+
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        __flat_fini(hash_table);
+        __arena_destroy(&hash_table->arena);
+        free(hash_table);
+        goto TAG_OUT;
+    }
+
+    /* 元素的内存随slab一起释放，这里只需要释放过长的键 */
+    for (uint32_t i = 0; i <= hash_table->max; i++) {
+        for (entry = hash_table->array[i]; entry; entry = entry->next) {
+            __key_release(hash_table, &entry->key, entry->keylen);
+        }
+    }
+    for (uint32_t i = 0; hash_table->old_array != NULL && i <= hash_table->old_max; i++) {
+        for (entry = hash_table->old_array[i]; entry; entry = entry->next) {
+            __key_release(hash_table, &entry->key, entry->keylen);
+        }
+    }
+    __slab_destroy(hash_table->slabs);
+    __slab_destroy(hash_table->slabs_full);
+
+    __arena_destroy(&hash_table->arena);
+    free(hash_table->old_array);
+    free(hash_table->array);
+    free(hash_table);
+
+TAG_OUT:
+    return retval;
+}
+
+static hash_entry_t **find_entry(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value)
+{
+    hash_entry_t**   retval = NULL;
+    hash_entry_t*    hash_entry = NULL;
+    ut_bool_t           found = UT_FALSE;
+
+    CHECK_PTR(hash_table);
+
+    retval = __chain_find(hash_table, key, keylen, hash);
+    hash_entry = *retval;
+    found = (hash_entry != NULL);
+    CHECK_VAL_NEQ(!value && !found, UT_FALSE, retval = NULL, TAG_OUT);
+    CHECK_VAL_NEQ(hash_entry || !value, UT_FALSE, NULL, TAG_OUT);
+
+    hash_entry = __entry_alloc(hash_table);
+    CHECK_PTR_RET(hash_entry, retval, NULL);
+    if (__key_store(hash_table, &hash_entry->key, key, keylen) != UT_ERRNO_OK) {
+        __entry_free(hash_table, hash_entry);
+        retval = NULL;
+        goto TAG_OUT;
+    }
+    hash_entry->next = NULL;
+    hash_entry->hash = hash;
+    hash_entry->keylen = keylen;
+    *retval = hash_entry;
+    hash_table->count++;
+    HASH_STAT_INC(hash_table, inserts);
+
+    /* check that the collision rate isn't too high */
+    if (hash_table->count > hash_table->max) {
+        __grow(hash_table);
+        retval = __chain_find(hash_table, key, keylen, hash);
+    }
+
+TAG_OUT:
+    return retval;
+}
+
+/**
+ * @brief 哈希表写入/删除的统一入口
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @param key 键
+ * @param keylen 键的长度
+ * @param hash 键的哈希值
+ * @param value 值，NULL表示删除
+ * @return void* 被替换或被删除的值
+ */
+static void* __hash_push(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value)
+{
+    void* old_value = NULL;
+    hash_entry_t **hash_entry_addr;
+
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        return __flat_push(hash_table, key, keylen, hash, value);
+    }
+    if (hash_table->old_array != NULL) {
+        __rehash_step(hash_table, HASH_REHASH_STEP);
+    }
+
+    hash_entry_addr = find_entry(hash_table, key, keylen, hash, value);
+    if (hash_entry_addr == NULL) {
+        /* 没有存储过却要删除key */
+        return old_value;
+    } else if (*hash_entry_addr) {
+        if (!value) {
+            /* delete entry */
+            hash_entry_t *old = *hash_entry_addr;
+            *hash_entry_addr = (*hash_entry_addr)->next;
+            old_value = old->value;
+            __key_release(hash_table, &old->key, old->keylen);
+            //被移除的节点优先放入空闲链表，提供给下一个写入节点使用，避免频繁申请
+            __entry_free(hash_table, old);
+            --hash_table->count;
+            HASH_STAT_INC(hash_table, deletes);
+        } else {
+            /* replace entry */
+            old_value = (*hash_entry_addr)->value;
+            (*hash_entry_addr)->value = (void*)value;
+        }
+    }
+    return (void*)old_value;
+}
+
+static void* __hash_peek(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash)
+{
+    hash_entry_t**   hash_entry_addr = NULL;
+    void*            value = NULL;
+
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        value = __flat_peek(hash_table, key, keylen, hash);
+        HASH_STAT_LOOKUP(hash_table, value != NULL);
+        return value;
+    }
+    if (hash_table->old_array != NULL) {
+        __rehash_step(hash_table, HASH_REHASH_STEP);
+    }
+
+    hash_entry_addr = find_entry(hash_table, key, keylen, hash, NULL);
+    if (hash_entry_addr)
+        value = (void*)((*hash_entry_addr)->value);
+    HASH_STAT_LOOKUP(hash_table, value != NULL);
+    return value;
+}
+
+/**
+ * @brief 查找键对应的值的存放位置，不存在且value不为NULL时插入，只查找一次
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @param key 键
+ * @param keylen 键的长度
+ * @param hash 键的哈希值
+ * @param value 键不存在时插入的值，为NULL时只查找
+ * @param inserted 传出参数，是否插入了新元素
+ * @return void** 值的存放位置，键不存在且没有插入时返回NULL
+ */
+static void** __hash_slot(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value, ut_bool_t *inserted)
+{
+    hash_entry_t**  hash_entry_addr = NULL;
+    hash_entry_t*   hash_entry = NULL;
+
+    *inserted = UT_FALSE;
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        return __flat_slot(hash_table, key, keylen, hash, value, inserted);
+    }
+    if (hash_table->old_array != NULL) {
+        __rehash_step(hash_table, HASH_REHASH_STEP);
+    }
+
+    hash_entry_addr = find_entry(hash_table, key, keylen, hash, value);
+    if (hash_entry_addr == NULL || (hash_entry = *hash_entry_addr) == NULL) {
+        return NULL;
+    }
+    /* 表中的值不会为NULL，值为NULL说明是刚刚插入的元素 */
+    if (hash_entry->value == NULL) {
+        hash_entry->value = (void*)value;
+        *inserted = UT_TRUE;
+    }
+    return &hash_entry->value;
+}
+
+
+uint32_t ut_hash_calc(ut_hash_t *hash_table, const char *key)
+{
+    if (hash_table == NULL || key == NULL) {
+        return 0;
+    }
+    return __hash_key(hash_table, key, strlen(key), UT_TRUE);
+}
+
+
+uint32_t ut_hash_calc_bin(ut_hash_t *hash_table, const void *key, uint32_t keylen)
+{
+    if (hash_table == NULL || key == NULL) {
+        return 0;
+    }
+    return __hash_key(hash_table, key, keylen, UT_FALSE);
+}
+
+
+void* ut_hash_push(ut_hash_t *hash_table, const char *key, const void* value)
+{
+    if (hash_table == NULL || key == NULL) {
+        return NULL;
+    }
+    return __hash_push(hash_table, key, strlen(key), ut_hash_calc(hash_table, key), value);
+}
+
+
+void* ut_hash_pop(ut_hash_t* hash_table, const char* key)
+{
+    return ut_hash_push(hash_table, key, NULL);
+}
+
+
+void* ut_hash_peek(ut_hash_t *hash_table, const char *key)
+{
+    if (hash_table == NULL || key == NULL) {
+        return NULL;
+    }
+    return __hash_peek(hash_table, key, strlen(key), ut_hash_calc(hash_table, key));
+}
+
+
+void* ut_hash_push_bin(ut_hash_t *hash_table, const void *key, uint32_t keylen, const void* value)
+{
+    return ut_hash_push_hashed(hash_table, key, keylen, ut_hash_calc_bin(hash_table, key, keylen), value);
+}
+
+
+void* ut_hash_pop_bin(ut_hash_t *hash_table, const void *key, uint32_t keylen)
+{
+    return ut_hash_push_bin(hash_table, key, keylen, NULL);
+}
+
+
+void* ut_hash_peek_bin(ut_hash_t *hash_table, const void *key, uint32_t keylen)
+{
+    return ut_hash_peek_hashed(hash_table, key, keylen, ut_hash_calc_bin(hash_table, key, keylen));
+}
+
+
+void* ut_hash_push_hashed(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value)
+{
+    if (hash_table == NULL || key == NULL || keylen > HASH_KEY_MAX) {
+        return NULL;
+    }
+    return __hash_push(hash_table, key, keylen, hash, value);
+}
+
+
+void* ut_hash_pop_hashed(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash)
+{
+    return ut_hash_push_hashed(hash_table, key, keylen, hash, NULL);
+}
+
+
+void* ut_hash_peek_hashed(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash)
+{
+    if (hash_table == NULL || key == NULL || keylen > HASH_KEY_MAX) {
+        return NULL;
+    }
+    return __hash_peek(hash_table, key, keylen, hash);
+}
+
+
+void** ut_hash_find_or_insert(ut_hash_t *hash_table, const char *key, const void* value, ut_bool_t *inserted)
+{
+    if (hash_table == NULL || key == NULL) {
+        return NULL;
+    }
+    return ut_hash_find_or_insert_hashed(hash_table, key, strlen(key), ut_hash_calc(hash_table, key), value, inserted);
+}
+
+
+void** ut_hash_find_or_insert_bin(ut_hash_t *hash_table, const void *key, uint32_t keylen, const void* value, ut_bool_t *inserted)
+{
+    return ut_hash_find_or_insert_hashed(hash_table, key, keylen, ut_hash_calc_bin(hash_table, key, keylen), value, inserted);
+}
+
+
+void** ut_hash_find_or_insert_hashed(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash,
+                                     const void* value, ut_bool_t *inserted)
+{
+    ut_bool_t   dummy = UT_FALSE;
+
+    if (hash_table == NULL || key == NULL || keylen > HASH_KEY_MAX) {
+        return NULL;
+    }
+    return __hash_slot(hash_table, key, keylen, hash, value, inserted != NULL ? inserted : &dummy);
+}
+
+
+void* ut_hash_emplace(ut_hash_t *hash_table, const char *key, const void* value)
+{
+    if (hash_table == NULL || key == NULL) {
+        return NULL;
+    }
+    return ut_hash_emplace_hashed(hash_table, key, strlen(key), ut_hash_calc(hash_table, key), value);
+}
+
+
+void* ut_hash_emplace_bin(ut_hash_t *hash_table, const void *key, uint32_t keylen, const void* value)
+{
+    return ut_hash_emplace_hashed(hash_table, key, keylen, ut_hash_calc_bin(hash_table, key, keylen), value);
+}
+
+
+void* ut_hash_emplace_hashed(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value)
+{
+    void**      slot = NULL;
+    ut_bool_t   inserted = UT_FALSE;
+
+    if (hash_table == NULL || key == NULL || value == NULL || keylen > HASH_KEY_MAX) {
+        return NULL;
+    }
+    slot = __hash_slot(hash_table, key, keylen, hash, value, &inserted);
+    return (slot == NULL || inserted) ? NULL : *slot;
+}
+
+
+/**
+ * @brief 批量查找。每一轮先计算所有键的哈希值并预取bucket，再预取链表的第一个元素，
+ *        最后逐个查找，使各个键的内存访问延迟互相重叠
+ * 
+ * @param hash_table 哈希表描述结构体
+ * @param keys 键数组
+ * @param keylens 键长度数组，为NULL表示键都是字符串
+ * @param num 键的数量
+ * @param values 传出参数，查找结果
+ */
+static void __hash_peek_batch(ut_hash_t *hash_table, const void* const keys[], const uint32_t keylens[], uint32_t num, void* values[])
+{
+    uint32_t    hashes[HASH_BATCH_WIDTH];
+    uint32_t    lens[HASH_BATCH_WIDTH];
+    ut_bool_t   flat = (hash_table->flags & UT_HASH_FLAG_FLAT) ? UT_TRUE : UT_FALSE;
+
+    if (hash_table->old_array != NULL) {
+        __rehash_step(hash_table, HASH_REHASH_STEP);
+    }
+
+    for (uint32_t base = 0; base < num; base += HASH_BATCH_WIDTH) {
+        uint32_t    width = (num - base < HASH_BATCH_WIDTH) ? num - base : HASH_BATCH_WIDTH;
+
+        for (uint32_t i = 0; i < width; i++) {
+            const void* key = keys[base + i];
+
+            if (key == NULL) {
+                continue;
+            }
+            lens[i] = keylens ? keylens[base + i] : (uint32_t)strlen(key);
+            hashes[i] = __hash_key(hash_table, key, lens[i], keylens == NULL);
+            if (flat) {
+                __flat_prefetch(hash_table, hashes[i], UT_FALSE);
+            } else {
+                __builtin_prefetch(&hash_table->array[hashes[i] & hash_table->max]);
+            }
+        }
+
+        for (uint32_t i = 0; i < width; i++) {
+            if (keys[base + i] == NULL) {
+                continue;
+            }
+            if (flat) {
+                __flat_prefetch(hash_table, hashes[i], UT_TRUE);
+            } else {
+                __builtin_prefetch(hash_table->array[hashes[i] & hash_table->max]);
+            }
+        }
+
+        for (uint32_t i = 0; i < width; i++) {
+            const void*     key = keys[base + i];
+            hash_entry_t*   entry = NULL;
+
+            if (key == NULL) {
+                values[base + i] = NULL;
+            } else if (flat) {
+                values[base + i] = __flat_peek(hash_table, key, lens[i], hashes[i]);
+            } else {
+                entry = *__chain_find(hash_table, key, lens[i], hashes[i]);
+                values[base + i] = entry ? entry->value : NULL;
+            }
+            HASH_STAT_LOOKUP(hash_table, values[base + i] != NULL);
+        }
+    }
+}
+
+
+void ut_hash_peek_batch(ut_hash_t *hash_table, const char* const keys[], uint32_t num, void* values[])
+{
+    if (hash_table == NULL || keys == NULL || values == NULL) {
+        return;
+    }
+    __hash_peek_batch(hash_table, (const void* const*)keys, NULL, num, values);
+}
+
+
+void ut_hash_peek_batch_bin(ut_hash_t *hash_table, const void* const keys[], const uint32_t keylens[], uint32_t num, void* values[])
+{
+    if (hash_table == NULL || keys == NULL || keylens == NULL || values == NULL) {
+        return;
+    }
+    __hash_peek_batch(hash_table, keys, keylens, num, values);
+}
+
+
+void ut_hash_set_free_max(ut_hash_t *hash_table, uint32_t free_max)
+{
+    if (hash_table == NULL) {
+        return;
+    }
+    hash_table->free_max = free_max;
+    while (hash_table->free_count > free_max) {
+        hash_entry_t*   entry = hash_table->free;
+
+        hash_table->free = entry->next;
+        hash_table->free_count--;
+        __slab_free(hash_table, entry);
+    }
+}
+
+
+ut_errno_t ut_hash_shrink(ut_hash_t *hash_table)
+{
+    ut_errno_t  retval = UT_ERRNO_OK;
+    uint32_t    free_max = 0;
+    uint32_t    new_max = 0;
+
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        retval = __flat_shrink(hash_table);
+        goto TAG_OUT;
+    }
+
+    /* 清空空闲链表，空出来的slab会被释放 */
+    free_max = hash_table->free_max;
+    ut_hash_set_free_max(hash_table, 0);
+    hash_table->free_max = free_max;
+
+    while (hash_table->old_array != NULL) {
+        __rehash_step(hash_table, hash_table->old_max + 1);
+    }
+    new_max = __bucket_max(hash_table->count);
+    if (new_max < hash_table->max) {
+        __resize_array(hash_table, new_max);
+    }
+
+TAG_OUT:
+    return retval;
+}
+
+
+ut_errno_t ut_hash_stats(ut_hash_t *hash_table, ut_hash_stats_t *stats)
+{
+    ut_errno_t  retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+    CHECK_PTR_RET(stats, retval, UT_ERRNO_NULLPTR);
+
+    memset(stats, 0, sizeof(ut_hash_stats_t));
+    stats->count = hash_table->count;
+    stats->free_count = hash_table->free_count;
+#ifdef ENABLE_HASH_STATS
+    stats->counter_enabled = UT_TRUE;
+    stats->hits = hash_table->counter.hits;
+    stats->misses = hash_table->counter.misses;
+    stats->inserts = hash_table->counter.inserts;
+    stats->deletes = hash_table->counter.deletes;
+    stats->resizes = hash_table->counter.resizes;
+#endif
+
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        __flat_stats(hash_table, stats);
+    } else {
+        for (hash_slab_t* slab = hash_table->slabs; slab; slab = slab->next) {
+            stats->slabs++;
+        }
+        for (hash_slab_t* slab = hash_table->slabs_full; slab; slab = slab->next) {
+            stats->slabs++;
+        }
+
+        /* 渐进式扩容过程中，还没有迁移的旧bucket也计入统计 */
+        stats->buckets = hash_table->max + 1;
+        stats->rehashing = (hash_table->old_array != NULL);
+        for (uint32_t pass = 0; pass < 2; pass++) {
+            hash_entry_t**  array = pass ? hash_table->old_array : hash_table->array;
+            uint32_t        begin = pass ? hash_table->rehash_idx : 0;
+            uint32_t        max = pass ? hash_table->old_max : hash_table->max;
+
+            for (uint32_t i = begin; array != NULL && i <= max; i++) {
+                uint32_t    length = 0;
+
+                for (hash_entry_t* entry = array[i]; entry; entry = entry->next) {
+                    length++;
+                }
+                if (pass && length == 0) {
+                    continue;
+                }
+                stats->histogram[length < UT_HASH_STATS_HIST ? length : UT_HASH_STATS_HIST - 1]++;
+                if (length > stats->max_length) {
+                    stats->max_length = length;
+                }
+            }
+        }
+    }
+    stats->load_factor = stats->buckets ? (double)stats->count / stats->buckets : 0;
+
+TAG_OUT:
+    return retval;
+}
+
+
+int32_t ut_hash_count(ut_hash_t *hash_table)
+{
+    return hash_table->count;
+}
+
+/**
+ * @brief 遍历一个bucket中的所有元素
+ * 
+ * @return ut_bool_t 回调要求停止遍历时返回UT_FALSE
+ */
+static ut_bool_t __chain_foreach_bucket(hash_entry_t *entry, ut_hash_cb callback, ut_hash_bin_cb bin_callback, void* context)
+{
+    while (entry) {
+        hash_entry_t *next = entry->next;
+        const char*   key = __key_data(&entry->key, entry->keylen);
+        ut_bool_t     go_on = callback ? callback(key, entry->value, context)
+                                       : bin_callback(key, entry->keylen, entry->value, context);
+        if (!go_on) {
+            return UT_FALSE;
+        }
+        entry = next;
+    }
+    return UT_TRUE;
+}
+
+/**
+ * @brief 遍历哈希表，callback与bin_callback只会使用其中非空的一个
+ */
+static void __hash_foreach(ut_hash_t *hash_table, ut_hash_cb callback, ut_hash_bin_cb bin_callback, void* context)
+{
+    uint32_t    i = 0;
+
+    if (hash_table == NULL || (callback == NULL && bin_callback == NULL)) {
+        return;
+    }
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        __flat_foreach(hash_table, 0, hash_table->flat.mask + 1, callback, bin_callback, context);
+        return;
+    }
+
+    /* 渐进式扩容过程中，先遍历旧bucket数组中还没有迁移的部分 */
+    for (i = hash_table->rehash_idx; hash_table->old_array != NULL && i <= hash_table->old_max; i++) {
+        if (!__chain_foreach_bucket(hash_table->old_array[i], callback, bin_callback, context)) {
+            return;
+        }
+    }
+    for (i = 0; i <= hash_table->max; i++) {
+        if (!__chain_foreach_bucket(hash_table->array[i], callback, bin_callback, context)) {
+            return;
+        }
+    }
+}
+
+void ut_hash_foreach(ut_hash_t *hash_table, ut_hash_cb callback, void* context)
+{
+    __hash_foreach(hash_table, callback, NULL, context);
+}
+
+void ut_hash_foreach_bin(ut_hash_t *hash_table, ut_hash_bin_cb callback, void* context)
+{
+    __hash_foreach(hash_table, NULL, callback, context);
+}
+
+typedef struct hash_par_task {
+    ut_hash_t* hash_table;      /* 哈希表 */
+    uint32_t begin;             /* 负责的bucket/槽位范围 [begin, end) */
+    uint32_t end;
+    ut_hash_bin_cb callback;    /* 回调 */
+    void* local;                /* 线程私有的上下文 */
+} hash_par_task_t;
+
+static void* __foreach_parallel_worker(void* arg)
+{
+    hash_par_task_t*    task = (hash_par_task_t*)arg;
+    ut_hash_t*          hash_table = task->hash_table;
+
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        __flat_foreach(hash_table, task->begin, task->end, NULL, task->callback, task->local);
+        return NULL;
+    }
+    for (uint32_t i = task->begin; i < task->end; i++) {
+        if (!__chain_foreach_bucket(hash_table->array[i], NULL, task->callback, task->local)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+ut_errno_t ut_hash_foreach_parallel(ut_hash_t *hash_table, uint32_t threads, ut_hash_bin_cb callback,
+                                    void* locals[], ut_hash_reduce_cb reduce, void* context)
+{
+    ut_errno_t          retval = UT_ERRNO_OK;
+    hash_par_task_t*    tasks = NULL;
+    pthread_t*          tids = NULL;
+    uint32_t            total = 0;
+    uint32_t            started = 0;
+
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+    CHECK_PTR_RET(callback, retval, UT_ERRNO_NULLPTR);
+    CHECK_VAL_EQ(threads, 0, retval = UT_ERRNO_INVALID, TAG_OUT);
+
+    /* 分段遍历只看一个bucket数组，先完成渐进式扩容 */
+    while (hash_table->old_array != NULL) {
+        __rehash_step(hash_table, hash_table->old_max + 1);
+    }
+    total = (hash_table->flags & UT_HASH_FLAG_FLAT) ? hash_table->flat.mask + 1 : hash_table->max + 1;
+    if (threads > total) {
+        threads = total;
+    }
+
+    tasks = ut_zero_alloc(sizeof(hash_par_task_t) * threads);
+    tids = ut_zero_alloc(sizeof(pthread_t) * threads);
+    if (tasks == NULL || tids == NULL) {
+        retval = UT_ERRNO_OUTOFMEM;
+        goto TAG_FREE;
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        tasks[i].hash_table = hash_table;
+        tasks[i].begin = (uint64_t)total * i / threads;
+        tasks[i].end = (uint64_t)total * (i + 1) / threads;
+        tasks[i].callback = callback;
+        tasks[i].local = locals ? locals[i] : NULL;
+    }
+
+    /* 第0段由调用线程自己完成，创建线程失败的段也由调用线程完成 */
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, __foreach_parallel_worker, &tasks[started]) != 0) {
+            break;
+        }
+    }
+    __foreach_parallel_worker(&tasks[0]);
+    for (uint32_t i = started; i < threads; i++) {
+        __foreach_parallel_worker(&tasks[i]);
+    }
+    for (uint32_t i = 1; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    for (uint32_t i = 0; reduce != NULL && i < threads; i++) {
+        reduce(tasks[i].local, context);
+    }
+
+TAG_FREE:
+    CHECK_FREE(tasks);
+    CHECK_FREE(tids);
+TAG_OUT:
+    return retval;
+}
+
+/**
+ * @brief 反转二进制位，游标按反转后的bucket序号递增
+ */
+static inline uint32_t __reverse_bits(uint32_t v)
+{
+    v = ((v >> 1) & 0x55555555U) | ((v & 0x55555555U) << 1);
+    v = ((v >> 2) & 0x33333333U) | ((v & 0x33333333U) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fU) | ((v & 0x0f0f0f0fU) << 4);
+    v = ((v >> 8) & 0x00ff00ffU) | ((v & 0x00ff00ffU) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+/**
+ * @brief 游标在mask的范围内加一：从高位向低位进位
+ */
+static inline uint32_t __scan_next(uint32_t cursor, uint32_t mask)
+{
+    cursor |= ~mask;
+    cursor = __reverse_bits(cursor);
+    cursor++;
+    return __reverse_bits(cursor);
+}
+
+static uint32_t __chain_count_bucket(hash_entry_t *entry)
+{
+    uint32_t    count = 0;
+
+    for (; entry; entry = entry->next) {
+        count++;
+    }
+    return count;
+}
+
+ut_bool_t ut_hash_scan(ut_hash_t *hash_table, uint64_t *cursor, uint32_t budget, ut_hash_bin_cb callback, void* context)
+{
+    uint32_t    v = 0;
+    uint32_t    empty_visits = 0;
+
+    if (hash_table == NULL || cursor == NULL || callback == NULL) {
+        return UT_FALSE;
+    }
+    if (budget == 0) {
+        budget = 1;
+    }
+    empty_visits = budget * HASH_SCAN_EMPTY_VISITS;
+    v = (uint32_t)*cursor;
+
+    /* 开放寻址：按槽位顺序遍历，游标即槽位序号 */
+    if (hash_table->flags & UT_HASH_FLAG_FLAT) {
+        uint32_t    slots = hash_table->flat.mask + 1;
+        uint32_t    end = 0;
+
+        if (v >= slots) {
+            *cursor = 0;
+            return UT_FALSE;
+        }
+        for (end = v; end < slots && budget > 0 && empty_visits > 0; end++) {
+            if (hash_table->flat.ctrl[end] >= 0) {
+                budget--;
+            } else {
+                empty_visits--;
+            }
+        }
+        __flat_foreach(hash_table, v, end, NULL, callback, context);
+        *cursor = (end >= slots) ? 0 : end;
+        return *cursor != 0;
+    }
+
+    /*
+        拉链法：游标按反转二进制位递增，bucket数组扩大或缩小之后，已经访问过的bucket
+        拆分/合并得到的bucket序号仍然在游标之前，因此遍历期间一直存在的元素至少会被访问一次（可能重复）
+     */
+    do {
+        if (hash_table->old_array == NULL) {
+            uint32_t    mask = hash_table->max;
+            uint32_t    count = __chain_count_bucket(hash_table->array[v & mask]);
+
+            __chain_foreach_bucket(hash_table->array[v & mask], NULL, callback, context);
+            v = __scan_next(v, mask);
+            if (count > 0) {
+                budget = (count >= budget) ? 0 : budget - count;
+            } else {
+                empty_visits--;
+            }
+        } else {
+            /* 渐进式扩容中：先访问小数组中的bucket，再访问大数组中由它拆分出来的所有bucket */
+            hash_entry_t**  small = hash_table->old_array;
+            hash_entry_t**  large = hash_table->array;
+            uint32_t        m0 = hash_table->old_max;
+            uint32_t        m1 = hash_table->max;
+            uint32_t        count = 0;
+
+            if (m0 > m1) {
+                small = hash_table->array;
+                large = hash_table->old_array;
+                m0 = hash_table->max;
+                m1 = hash_table->old_max;
+            }
+            count += __chain_count_bucket(small[v & m0]);
+            __chain_foreach_bucket(small[v & m0], NULL, callback, context);
+            do {
+                count += __chain_count_bucket(large[v & m1]);
+                __chain_foreach_bucket(large[v & m1], NULL, callback, context);
+                v = __scan_next(v, m1);
+            } while (v & (m0 ^ m1));
+            if (count > 0) {
+                budget = (count >= budget) ? 0 : budget - count;
+            } else {
+                empty_visits--;
+            }
+        }
+    } while (v != 0 && budget > 0 && empty_visits > 0);
+
+    *cursor = v;
+    return v != 0;
 }
 
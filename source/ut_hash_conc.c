@@ -0,0 +1,486 @@
+/**
+ * @file ut_hash_conc.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 线程安全的哈希表。
+ *        写者持有分片的互斥锁，并在修改期间把分片的顺序号置为奇数；读者不加锁，
+ *        读之前和读之后顺序号相同且为偶数时，读到的结果才有效，否则重试。
+ *        读者可能正在访问被删除的元素，因此元素和bucket数组在哈希表销毁之前都不会被释放，
+ *        被删除的元素按键空间大小分类回收，只会被同一个分片复用。
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ut/ut_hash_conc.h"
+#include "ut_hash_inn.h"
+
+#define CONC_DEFAULT_SHARDS     16
+#define CONC_MIN_BUCKETS        16
+#define CONC_KEY_MIN_CAPACITY   16
+#define CONC_KEY_CLASSES        28      /* 键空间大小 16B ~ 2GB */
+#define CONC_KEY_MAX            (((uint32_t)CONC_KEY_MIN_CAPACITY << (CONC_KEY_CLASSES - 1)) - 1)    /* 键空间还要放下结尾的'\0' */
+#define CONC_READ_CHECK_STEPS   64      /* 读者每走过这么多个元素就检查一次顺序号，避免在被复用的元素上死循环 */
+#define CONC_CACHE_LINE         64
+
+#define CONC_LOAD(ptr)          __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define CONC_STORE(ptr, val)    __atomic_store_n((ptr), (val), __ATOMIC_RELAXED)
+
+typedef struct conc_entry {
+    struct conc_entry* next;    /* 哈希链表下一个，回收后作为空闲链表使用 */
+    void* value;                /* 值 */
+    uint32_t hash;              /* 哈希值 */
+    uint32_t keylen;            /* 键的长度 */
+    uint32_t capacity;          /* 键空间的大小，元素申请后不再改变 */
+    char key[0];                /* 键 */
+} conc_entry_t;
+
+typedef struct conc_buckets {
+    uint32_t max;                       /* bucket数量 - 1 */
+    struct conc_buckets* retired;       /* 扩容后被替换掉的bucket数组，销毁时一起释放 */
+    conc_entry_t* heads[0];             /* bucket */
+} conc_buckets_t;
+
+typedef struct conc_shard {
+    uint32_t seq;                       /* 顺序号，奇数表示写者正在修改 */
+    uint32_t count;                     /* 分片内的元素数量 */
+    conc_buckets_t* buckets;            /* 当前的bucket数组 */
+    pthread_mutex_t lock;               /* 写者锁 */
+    conc_entry_t* free[CONC_KEY_CLASSES];   /* 按键空间大小回收的元素 */
+} __attribute__((aligned(CONC_CACHE_LINE))) conc_shard_t;
+
+struct ut_hash_conc_t {
+    conc_shard_t* shards;       /* 分片数组 */
+    uint32_t shard_bits;        /* 分片数量 = 2 ^ shard_bits */
+    uint32_t flags;             /* 创建时指定的ut_hash_flag_t，只有哈希函数相关的标志位有效 */
+    uint64_t seed;              /* 内置哈希函数的种子 */
+    ut_hash_func ut_hash_func;  /* 哈希函数 */
+};
+
+
+static inline uint32_t __conc_mix(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static inline uint32_t __conc_hash(const ut_hash_conc_t *hash_table, const void* key, uint32_t keylen, ut_bool_t is_str)
+{
+    if (is_str && hash_table->ut_hash_func != NULL) {
+        return __conc_mix(hash_table->ut_hash_func((const char*)key));
+    }
+    if (hash_table->flags & UT_HASH_FLAG_HASH_WY) {
+        uint64_t    hash = __hashfunc_wy(key, keylen, hash_table->seed);
+        return (uint32_t)(hash ^ (hash >> 32));
+    }
+    if (hash_table->flags & UT_HASH_FLAG_HASH_FNV1A) {
+        return __conc_mix(__hashfunc_fnv1a(key, keylen, hash_table->seed));
+    }
+    return __conc_mix(__hashfunc_default(key, keylen));
+}
+
+/**
+ * @brief 哈希值的高位用来选择分片，低位用来选择bucket
+ */
+static inline conc_shard_t* __conc_shard(const ut_hash_conc_t *hash_table, uint32_t hash)
+{
+    if (hash_table->shard_bits == 0) {
+        return hash_table->shards;
+    }
+    return &hash_table->shards[hash >> (32 - hash_table->shard_bits)];
+}
+
+/**
+ * @brief 键空间大小的级别，keylen不能超过CONC_KEY_MAX，否则capacity会溢出
+ */
+static inline int32_t __conc_key_class(uint32_t keylen, uint32_t* capacity)
+{
+    int32_t     class = 0;
+
+    *capacity = CONC_KEY_MIN_CAPACITY;
+    while (*capacity < keylen + 1) {
+        *capacity <<= 1;
+        class++;
+    }
+    return class;
+}
+
+static conc_buckets_t* __conc_buckets_alloc(uint32_t max)
+{
+    conc_buckets_t* buckets = ut_zero_alloc(sizeof(conc_buckets_t) + sizeof(conc_entry_t*) * (max + 1));
+
+    if (buckets != NULL) {
+        buckets->max = max;
+    }
+    return buckets;
+}
+
+static inline void __conc_write_begin(conc_shard_t *shard)
+{
+    CONC_STORE(&shard->seq, shard->seq + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void __conc_write_end(conc_shard_t *shard)
+{
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 分片扩容，需要持有写锁且在写区间内调用。旧的bucket数组挂在新数组上，不会释放
+ *
+ * @param shard 分片
+ */
+static void __conc_grow(conc_shard_t *shard)
+{
+    conc_buckets_t* old = shard->buckets;
+    conc_buckets_t* new = __conc_buckets_alloc(old->max * 2 + 1);
+
+    if (new == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i <= old->max; i++) {
+        conc_entry_t*   entry = old->heads[i];
+
+        while (entry) {
+            conc_entry_t*   next = entry->next;
+            uint32_t        index = entry->hash & new->max;
+
+            entry->next = new->heads[index];
+            new->heads[index] = entry;
+            entry = next;
+        }
+    }
+    new->retired = old;
+    __atomic_store_n(&shard->buckets, new, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 写入/删除的统一入口，持有分片的写锁
+ */
+static void* __conc_push(ut_hash_conc_t *hash_table, const void *key, uint32_t keylen, ut_bool_t is_str, const void* value)
+{
+    uint32_t        hash = 0;
+    conc_shard_t*   shard = NULL;
+    conc_buckets_t* buckets = NULL;
+    conc_entry_t**  link = NULL;
+    conc_entry_t*   entry = NULL;
+    void*           old_value = NULL;
+
+    if (hash_table == NULL || key == NULL || keylen > CONC_KEY_MAX) {
+        return NULL;
+    }
+    hash = __conc_hash(hash_table, key, keylen, is_str);
+    shard = __conc_shard(hash_table, hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    buckets = shard->buckets;
+    for (link = &buckets->heads[hash & buckets->max]; (entry = *link) != NULL; link = &entry->next) {
+        if (entry->hash == hash && entry->keylen == keylen && memcmp(entry->key, key, keylen) == 0) {
+            break;
+        }
+    }
+
+    if (entry != NULL && value != NULL) {
+        /* replace entry，值的替换是原子的，读者不需要重试 */
+        old_value = entry->value;
+        __atomic_store_n(&entry->value, (void*)value, __ATOMIC_RELEASE);
+
+    } else if (entry != NULL) {
+        /* delete entry，元素回收到分片的空闲链表，不释放内存 */
+        uint32_t    capacity = 0;
+        int32_t     class = __conc_key_class(entry->capacity - 1, &capacity);
+
+        old_value = entry->value;
+        __conc_write_begin(shard);
+        CONC_STORE(link, entry->next);
+        CONC_STORE(&entry->next, shard->free[class]);
+        shard->free[class] = entry;
+        shard->count--;
+        __conc_write_end(shard);
+
+    } else if (value != NULL) {
+        /* insert entry */
+        uint32_t    capacity = 0;
+        int32_t     class = 0;
+
+        if (keylen > CONC_KEY_MAX) {
+            goto TAG_UNLOCK;
+        }
+        class = __conc_key_class(keylen, &capacity);
+        entry = shard->free[class];
+        if (entry == NULL) {
+            entry = ut_zero_alloc(sizeof(conc_entry_t) + capacity);
+            if (entry == NULL) {
+                goto TAG_UNLOCK;
+            }
+            entry->capacity = capacity;
+        }
+
+        __conc_write_begin(shard);
+        if (entry == shard->free[class]) {
+            shard->free[class] = entry->next;
+        }
+        CONC_STORE(&entry->hash, hash);
+        CONC_STORE(&entry->keylen, keylen);
+        memcpy(entry->key, key, keylen);
+        entry->key[keylen] = '\0';
+        CONC_STORE(&entry->value, (void*)value);
+        CONC_STORE(&entry->next, buckets->heads[hash & buckets->max]);
+        CONC_STORE(&buckets->heads[hash & buckets->max], entry);
+        shard->count++;
+        if (shard->count > buckets->max) {
+            __conc_grow(shard);
+        }
+        __conc_write_end(shard);
+    }
+
+TAG_UNLOCK:
+    pthread_mutex_unlock(&shard->lock);
+    return old_value;
+}
+
+/**
+ * @brief 无锁读取。读取前后分片的顺序号不一致时说明有写者修改过分片，重新读取
+ */
+static void* __conc_peek(ut_hash_conc_t *hash_table, const void *key, uint32_t keylen, ut_bool_t is_str)
+{
+    uint32_t        hash = 0;
+    conc_shard_t*   shard = NULL;
+    void*           value = NULL;
+    uint32_t        seq = 0;
+
+    if (hash_table == NULL || key == NULL || keylen > CONC_KEY_MAX) {
+        return NULL;
+    }
+    hash = __conc_hash(hash_table, key, keylen, is_str);
+    shard = __conc_shard(hash_table, hash);
+
+    FOREVER {
+        conc_buckets_t* buckets = NULL;
+        conc_entry_t*   entry = NULL;
+        uint32_t        steps = 0;
+
+        seq = __atomic_load_n(&shard->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+
+        value = NULL;
+        buckets = __atomic_load_n(&shard->buckets, __ATOMIC_ACQUIRE);
+        entry = CONC_LOAD(&buckets->heads[hash & buckets->max]);
+        while (entry != NULL) {
+            uint32_t    entry_len = CONC_LOAD(&entry->keylen);
+
+            /* 元素可能正在被复用，键长度不能超过元素自己的键空间 */
+            if (CONC_LOAD(&entry->hash) == hash && entry_len == keylen
+                    && keylen < entry->capacity && memcmp(entry->key, key, keylen) == 0) {
+                value = __atomic_load_n(&entry->value, __ATOMIC_ACQUIRE);
+                break;
+            }
+            if (++steps % CONC_READ_CHECK_STEPS == 0 && CONC_LOAD(&shard->seq) != seq) {
+                break;
+            }
+            entry = CONC_LOAD(&entry->next);
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (CONC_LOAD(&shard->seq) == seq) {
+            break;
+        }
+    }
+
+    return value;
+}
+
+
+ut_errno_t ut_hash_conc_create(ut_hash_conc_t **out, uint32_t size, uint32_t shards, ut_hash_func ut_hash_func)
+{
+    return ut_hash_conc_create_ex(out, size, shards, ut_hash_func, UT_HASH_FLAG_NONE);
+}
+
+ut_errno_t ut_hash_conc_create_ex(ut_hash_conc_t **out, uint32_t size, uint32_t shards, ut_hash_func ut_hash_func, uint32_t flags)
+{
+    ut_hash_conc_t* hash_table = NULL;
+    ut_errno_t      retval = UT_ERRNO_OK;
+    uint32_t        shard_num = 1;
+    uint32_t        max = CONC_MIN_BUCKETS - 1;
+
+    CHECK_PTR_RET(out, retval, UT_ERRNO_NULLPTR);
+
+    if (shards == 0) {
+        shards = CONC_DEFAULT_SHARDS;
+    }
+    hash_table = ut_zero_alloc(sizeof(ut_hash_conc_t));
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_OUTOFMEM);
+    while (shard_num < shards && hash_table->shard_bits < 16) {
+        shard_num <<= 1;
+        hash_table->shard_bits++;
+    }
+    while (max + 1 < size / shard_num) {
+        max = max * 2 + 1;
+    }
+    if ((flags & UT_HASH_FLAG_SEED) && !(flags & (UT_HASH_FLAG_HASH_WY | UT_HASH_FLAG_HASH_FNV1A))) {
+        flags |= UT_HASH_FLAG_HASH_WY;
+    }
+    hash_table->flags = flags & (UT_HASH_FLAG_HASH_WY | UT_HASH_FLAG_HASH_FNV1A | UT_HASH_FLAG_SEED);
+    hash_table->seed = (flags & UT_HASH_FLAG_SEED) ? __hash_random_seed() : 0;
+    hash_table->ut_hash_func = ut_hash_func;
+
+    if (posix_memalign((void**)&hash_table->shards, CONC_CACHE_LINE, sizeof(conc_shard_t) * shard_num) != 0) {
+        free(hash_table);
+        retval = UT_ERRNO_OUTOFMEM;
+        goto TAG_OUT;
+    }
+    memset(hash_table->shards, 0, sizeof(conc_shard_t) * shard_num);
+    for (uint32_t i = 0; i < shard_num; i++) {
+        pthread_mutex_init(&hash_table->shards[i].lock, NULL);
+        hash_table->shards[i].buckets = __conc_buckets_alloc(max);
+        if (hash_table->shards[i].buckets == NULL) {
+            retval = UT_ERRNO_OUTOFMEM;
+        }
+    }
+    CHECK_VAL_NEQ(retval, UT_ERRNO_OK, ut_hash_conc_destroy(hash_table), TAG_OUT);
+    *out = hash_table;
+
+TAG_OUT:
+    return retval;
+}
+
+ut_errno_t ut_hash_conc_destroy(ut_hash_conc_t *hash_table)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+
+    for (uint32_t i = 0; i < (1U << hash_table->shard_bits); i++) {
+        conc_shard_t*   shard = &hash_table->shards[i];
+        conc_buckets_t* buckets = shard->buckets;
+
+        for (uint32_t j = 0; buckets != NULL && j <= buckets->max; j++) {
+            conc_entry_t*   entry = buckets->heads[j];
+
+            while (entry) {
+                conc_entry_t*   next = entry->next;
+                free(entry);
+                entry = next;
+            }
+        }
+        while (buckets != NULL) {
+            conc_buckets_t* retired = buckets->retired;
+            free(buckets);
+            buckets = retired;
+        }
+        for (uint32_t j = 0; j < CONC_KEY_CLASSES; j++) {
+            conc_entry_t*   entry = shard->free[j];
+
+            while (entry) {
+                conc_entry_t*   next = entry->next;
+                free(entry);
+                entry = next;
+            }
+        }
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(hash_table->shards);
+    free(hash_table);
+
+TAG_OUT:
+    return retval;
+}
+
+void* ut_hash_conc_push(ut_hash_conc_t *hash_table, const char *key, const void* value)
+{
+    size_t      keylen = 0;
+
+    if (key == NULL || (keylen = strlen(key)) > CONC_KEY_MAX) {
+        return NULL;
+    }
+    return __conc_push(hash_table, key, (uint32_t)keylen, UT_TRUE, value);
+}
+
+void* ut_hash_conc_peek(ut_hash_conc_t *hash_table, const char *key)
+{
+    size_t      keylen = 0;
+
+    if (key == NULL || (keylen = strlen(key)) > CONC_KEY_MAX) {
+        return NULL;
+    }
+    return __conc_peek(hash_table, key, (uint32_t)keylen, UT_TRUE);
+}
+
+void* ut_hash_conc_pop(ut_hash_conc_t *hash_table, const char *key)
+{
+    return ut_hash_conc_push(hash_table, key, NULL);
+}
+
+void* ut_hash_conc_push_bin(ut_hash_conc_t *hash_table, const void *key, uint32_t keylen, const void* value)
+{
+    if (keylen > CONC_KEY_MAX) {
+        return NULL;
+    }
+    return __conc_push(hash_table, key, keylen, UT_FALSE, value);
+}
+
+void* ut_hash_conc_peek_bin(ut_hash_conc_t *hash_table, const void *key, uint32_t keylen)
+{
+    if (keylen > CONC_KEY_MAX) {
+        return NULL;
+    }
+    return __conc_peek(hash_table, key, keylen, UT_FALSE);
+}
+
+void* ut_hash_conc_pop_bin(ut_hash_conc_t *hash_table, const void *key, uint32_t keylen)
+{
+    if (keylen > CONC_KEY_MAX) {
+        return NULL;
+    }
+    return __conc_push(hash_table, key, keylen, UT_FALSE, NULL);
+}
+
+int32_t ut_hash_conc_count(ut_hash_conc_t *hash_table)
+{
+    int32_t     count = 0;
+
+    if (hash_table == NULL) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < (1U << hash_table->shard_bits); i++) {
+        count += CONC_LOAD(&hash_table->shards[i].count);
+    }
+    return count;
+}
+
+void ut_hash_conc_foreach(ut_hash_conc_t *hash_table, ut_hash_bin_cb callback, void* context)
+{
+    if (hash_table == NULL || callback == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < (1U << hash_table->shard_bits); i++) {
+        conc_shard_t*   shard = &hash_table->shards[i];
+        conc_buckets_t* buckets = NULL;
+        ut_bool_t       go_on = UT_TRUE;
+
+        pthread_mutex_lock(&shard->lock);
+        buckets = shard->buckets;
+        for (uint32_t j = 0; go_on && j <= buckets->max; j++) {
+            for (conc_entry_t* entry = buckets->heads[j]; go_on && entry; entry = entry->next) {
+                go_on = callback(entry->key, entry->keylen, entry->value, context);
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+        if (!go_on) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,449 @@
+/**
+ * @file ut_hash_flat.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 开放寻址的哈希表引擎。元素平铺存放在槽位数组中，每个槽位对应一个控制字节，
+ *        控制字节按组对齐存放，查找时一次比较一整组控制字节（SSE2/AVX2），
+ *        只有控制字节匹配的槽位才会进行键的比较。
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "ut_hash_inn.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FLAT_GROUP_WIDTH    32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FLAT_GROUP_WIDTH    16
+#else
+#define FLAT_GROUP_WIDTH    8
+#endif
+
+#define FLAT_CTRL_EMPTY     ((int8_t)-128)  /* 0b10000000 空槽位 */
+#define FLAT_CTRL_DELETED   ((int8_t)-2)    /* 0b11111110 已删除的槽位 */
+#define FLAT_H2_MASK        0x7fU           /* 存放于控制字节中的哈希值低7位 */
+#define FLAT_CTRL_ALIGN     64
+
+/* 最大负载因子 7/8 */
+#define FLAT_MAX_LOAD(cap)  ((cap) - (cap) / 8)
+
+typedef uint32_t flat_mask_t;
+
+/**
+ * @brief 在一组控制字节中查找值为h2的槽位
+ *
+ * @param ctrl 组的起始控制字节，按组宽度对齐
+ * @param h2 待查找的控制字节
+ * @return flat_mask_t 每一位对应组内的一个槽位
+ */
+static inline flat_mask_t __group_match(const int8_t* ctrl, int8_t h2)
+{
+#if defined(__AVX2__)
+    __m256i group = _mm256_load_si256((const __m256i*)ctrl);
+    return (flat_mask_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(h2)));
+#elif defined(__SSE2__)
+    __m128i group = _mm_load_si128((const __m128i*)ctrl);
+    return (flat_mask_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+#else
+    flat_mask_t mask = 0;
+
+    for (int i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        mask |= (flat_mask_t)(ctrl[i] == h2) << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @brief 在一组控制字节中查找空槽位或已删除的槽位，即最高位为1的控制字节
+ *
+ * @param ctrl 组的起始控制字节，按组宽度对齐
+ * @return flat_mask_t 每一位对应组内的一个槽位
+ */
+static inline flat_mask_t __group_match_free(const int8_t* ctrl)
+{
+#if defined(__AVX2__)
+    return (flat_mask_t)_mm256_movemask_epi8(_mm256_load_si256((const __m256i*)ctrl));
+#elif defined(__SSE2__)
+    return (flat_mask_t)_mm_movemask_epi8(_mm_load_si128((const __m128i*)ctrl));
+#else
+    flat_mask_t mask = 0;
+
+    for (int i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        mask |= (flat_mask_t)(ctrl[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+static inline flat_mask_t __group_match_empty(const int8_t* ctrl)
+{
+    return __group_match(ctrl, FLAT_CTRL_EMPTY);
+}
+
+/**
+ * @brief 对用户哈希函数的结果再做一次混合，保证高低位都足够分散。
+ *        内置的fd、地址等哈希函数高位基本为0，不混合会导致控制字节失去过滤作用
+ *
+ * @param hash 用户哈希函数计算的哈希值
+ * @return uint32_t
+ */
+static inline uint32_t __flat_mix(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static inline int8_t __flat_h2(uint32_t hash)
+{
+    return (int8_t)(hash & FLAT_H2_MASK);
+}
+
+static inline uint32_t __flat_h1(uint32_t hash)
+{
+    return hash >> 7;
+}
+
+/**
+ * @brief 分配槽位数组以及控制字节数组，控制字节全部初始化为空
+ *
+ * @param flat 开放寻址引擎的数据
+ * @param capacity 槽位数量，必须是2的幂且不小于组宽度
+ * @return ut_errno_t
+ */
+static ut_errno_t __flat_alloc(hash_flat_t* flat, uint32_t capacity)
+{
+    void*   ctrl = NULL;
+
+    if (posix_memalign(&ctrl, FLAT_CTRL_ALIGN, capacity) != 0) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    flat->slots = ut_zero_alloc(sizeof(flat_slot_t) * capacity);
+    if (flat->slots == NULL) {
+        free(ctrl);
+        return UT_ERRNO_OUTOFMEM;
+    }
+    memset(ctrl, FLAT_CTRL_EMPTY, capacity);
+    flat->ctrl = ctrl;
+    flat->mask = capacity - 1;
+    flat->growth_left = FLAT_MAX_LOAD(capacity);
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * @brief 沿着探测序列查找第一个空槽位或已删除的槽位。
+ *        组的探测顺序为三角数序列，组数量为2的幂时可以遍历所有的组
+ *
+ * @param flat 开放寻址引擎的数据
+ * @param hash 混合后的哈希值
+ * @return uint32_t 槽位序号
+ */
+static uint32_t __flat_find_free(const hash_flat_t* flat, uint32_t hash)
+{
+    uint32_t    group_mask = flat->mask / FLAT_GROUP_WIDTH;
+    uint32_t    group = __flat_h1(hash) & group_mask;
+    flat_mask_t match = 0;
+
+    for (uint32_t step = 1; ; step++) {
+        match = __group_match_free(flat->ctrl + group * FLAT_GROUP_WIDTH);
+        if (match) {
+            return group * FLAT_GROUP_WIDTH + __builtin_ctz(match);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+/**
+ * @brief 重新分配槽位数组，并将所有元素重新放入。已删除的槽位会在此时被清理掉
+ *
+ * @param hash_table 哈希表描述结构体
+ * @param capacity 新的槽位数量
+ * @return ut_errno_t
+ */
+static ut_errno_t __flat_resize(ut_hash_t* hash_table, uint32_t capacity)
+{
+    hash_flat_t     old = hash_table->flat;
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    retval = __flat_alloc(&hash_table->flat, capacity);
+    if (retval != UT_ERRNO_OK) {
+        hash_table->flat = old;
+        return retval;
+    }
+
+    for (uint32_t i = 0; i <= old.mask; i++) {
+        uint32_t    index = 0;
+
+        if (old.ctrl[i] < 0) {
+            continue;
+        }
+        index = __flat_find_free(&hash_table->flat, old.slots[i].hash);
+        hash_table->flat.ctrl[index] = old.ctrl[i];
+        hash_table->flat.slots[index] = old.slots[i];
+    }
+    hash_table->flat.growth_left -= hash_table->count;
+    HASH_STAT_INC(hash_table, resizes);
+
+    free(old.ctrl);
+    free(old.slots);
+    return retval;
+}
+
+/**
+ * @brief 查找键所在的槽位
+ *
+ * @param hash_table 哈希表描述结构体
+ * @param key 元素的键
+ * @param keylen 键的长度
+ * @param hash 混合后的哈希值
+ * @return int64_t 找到返回槽位序号，找不到返回-1
+ */
+static int64_t __flat_find(const ut_hash_t* hash_table, const void* key, uint32_t keylen, uint32_t hash)
+{
+    const hash_flat_t*  flat = &hash_table->flat;
+    uint32_t            group_mask = flat->mask / FLAT_GROUP_WIDTH;
+    uint32_t            group = __flat_h1(hash) & group_mask;
+    int8_t              h2 = __flat_h2(hash);
+
+    for (uint32_t step = 1; step <= group_mask + 1; step++) {
+        const int8_t*   ctrl = flat->ctrl + group * FLAT_GROUP_WIDTH;
+        flat_mask_t     match = __group_match(ctrl, h2);
+
+        while (match) {
+            uint32_t            index = group * FLAT_GROUP_WIDTH + __builtin_ctz(match);
+            const flat_slot_t*  slot = &flat->slots[index];
+
+            if (slot->hash == hash && __key_equal(&slot->key, slot->keylen, key, keylen)) {
+                return index;
+            }
+            match &= match - 1;
+        }
+        /* 组内还有空槽位，说明键不可能被放到更后面的组中 */
+        if (__group_match_empty(ctrl)) {
+            break;
+        }
+        group = (group + step) & group_mask;
+    }
+
+    return -1;
+}
+
+
+ut_errno_t __flat_init(ut_hash_t *hash_table, uint32_t size)
+{
+    uint32_t    capacity = FLAT_GROUP_WIDTH;
+
+    while (FLAT_MAX_LOAD(capacity) < size) {
+        capacity <<= 1;
+    }
+
+    return __flat_alloc(&hash_table->flat, capacity);
+}
+
+ut_errno_t __flat_shrink(ut_hash_t *hash_table)
+{
+    uint32_t    capacity = FLAT_GROUP_WIDTH;
+
+    while (FLAT_MAX_LOAD(capacity) < hash_table->count) {
+        capacity <<= 1;
+    }
+    /* 容量不变时也重新整理一次，清理掉已删除的槽位 */
+    if (capacity > hash_table->flat.mask + 1) {
+        return UT_ERRNO_OK;
+    }
+    return __flat_resize(hash_table, capacity);
+}
+
+void __flat_fini(ut_hash_t *hash_table)
+{
+    hash_flat_t*    flat = &hash_table->flat;
+
+    for (uint32_t i = 0; flat->ctrl != NULL && i <= flat->mask; i++) {
+        if (flat->ctrl[i] >= 0) {
+            __key_release(hash_table, &flat->slots[i].key, flat->slots[i].keylen);
+        }
+    }
+    CHECK_FREE(hash_table->flat.ctrl);
+    CHECK_FREE(hash_table->flat.slots);
+}
+
+void** __flat_slot(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value, ut_bool_t *inserted)
+{
+    hash_flat_t*    flat = &hash_table->flat;
+    flat_slot_t*    slot = NULL;
+    int64_t         index = 0;
+
+    hash = __flat_mix(hash);
+    index = __flat_find(hash_table, key, keylen, hash);
+    if (index >= 0) {
+        return &flat->slots[index].value;
+    }
+    if (value == NULL) {
+        return NULL;
+    }
+
+    /* 插入新元素 */
+    index = __flat_find_free(flat, hash);
+    if (flat->growth_left == 0 && flat->ctrl[index] == FLAT_CTRL_EMPTY) {
+        uint32_t    capacity = flat->mask + 1;
+
+        /* 大量槽位是被删除的状态时，原地整理即可，否则扩容一倍 */
+        if (hash_table->count >= FLAT_MAX_LOAD(capacity) / 2) {
+            capacity <<= 1;
+        }
+        if (__flat_resize(hash_table, capacity) != UT_ERRNO_OK) {
+            return NULL;
+        }
+        index = __flat_find_free(flat, hash);
+    }
+    slot = &flat->slots[index];
+    if (__key_store(hash_table, &slot->key, key, keylen) != UT_ERRNO_OK) {
+        return NULL;
+    }
+    if (flat->ctrl[index] == FLAT_CTRL_EMPTY) {
+        flat->growth_left--;
+    }
+    flat->ctrl[index] = __flat_h2(hash);
+    slot->hash = hash;
+    slot->keylen = keylen;
+    slot->value = (void*)value;
+    hash_table->count++;
+    HASH_STAT_INC(hash_table, inserts);
+    *inserted = UT_TRUE;
+
+    return &slot->value;
+}
+
+void* __flat_push(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value)
+{
+    hash_flat_t*    flat = &hash_table->flat;
+    flat_slot_t*    slot = NULL;
+    void*           old_value = NULL;
+    void**          value_slot = NULL;
+    ut_bool_t       inserted = UT_FALSE;
+    int64_t         index = 0;
+
+    /* 删除元素 */
+    if (value == NULL) {
+        index = __flat_find(hash_table, key, keylen, __flat_mix(hash));
+        if (index >= 0) {
+            const int8_t*   group = flat->ctrl + (index & ~(int64_t)(FLAT_GROUP_WIDTH - 1));
+
+            slot = &flat->slots[index];
+            old_value = slot->value;
+            slot->value = NULL;
+            __key_release(hash_table, &slot->key, slot->keylen);
+            /* 如果所在的组里还有空槽位，探测序列不会越过这个组，可以直接置为空槽位 */
+            if (__group_match_empty(group)) {
+                flat->ctrl[index] = FLAT_CTRL_EMPTY;
+                flat->growth_left++;
+            } else {
+                flat->ctrl[index] = FLAT_CTRL_DELETED;
+            }
+            hash_table->count--;
+            HASH_STAT_INC(hash_table, deletes);
+        }
+        return old_value;
+    }
+
+    /* 替换或插入元素 */
+    value_slot = __flat_slot(hash_table, key, keylen, hash, value, &inserted);
+    if (value_slot == NULL || inserted) {
+        return NULL;
+    }
+    old_value = *value_slot;
+    *value_slot = (void*)value;
+    return old_value;
+}
+
+void* __flat_peek(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash)
+{
+    int64_t     index = 0;
+
+    hash = __flat_mix(hash);
+    index = __flat_find(hash_table, key, keylen, hash);
+
+    return index >= 0 ? hash_table->flat.slots[index].value : NULL;
+}
+
+void __flat_stats(ut_hash_t *hash_table, ut_hash_stats_t *stats)
+{
+    hash_flat_t*    flat = &hash_table->flat;
+    uint32_t        group_mask = flat->mask / FLAT_GROUP_WIDTH;
+
+    stats->buckets = flat->mask + 1;
+    for (uint32_t i = 0; i <= flat->mask; i++) {
+        uint32_t    group = 0;
+        uint32_t    probes = 0;
+
+        if (flat->ctrl[i] == FLAT_CTRL_DELETED) {
+            stats->deleted++;
+        }
+        if (flat->ctrl[i] < 0) {
+            continue;
+        }
+        /* 沿探测序列从起始组走到元素所在的组 */
+        group = __flat_h1(flat->slots[i].hash) & group_mask;
+        for (uint32_t step = 1; group != i / FLAT_GROUP_WIDTH; step++) {
+            group = (group + step) & group_mask;
+            probes++;
+        }
+        stats->histogram[probes < UT_HASH_STATS_HIST ? probes : UT_HASH_STATS_HIST - 1]++;
+        if (probes > stats->max_length) {
+            stats->max_length = probes;
+        }
+    }
+}
+
+void __flat_prefetch(const ut_hash_t *hash_table, uint32_t hash, ut_bool_t slot)
+{
+    const hash_flat_t*  flat = &hash_table->flat;
+    uint32_t            group = 0;
+    flat_mask_t         match = 0;
+
+    hash = __flat_mix(hash);
+    group = (__flat_h1(hash) & (flat->mask / FLAT_GROUP_WIDTH)) * FLAT_GROUP_WIDTH;
+    if (!slot) {
+        __builtin_prefetch(flat->ctrl + group);
+        return;
+    }
+    /* 控制字节已经预取过，预取第一个可能匹配的槽位 */
+    match = __group_match(flat->ctrl + group, __flat_h2(hash));
+    if (match) {
+        __builtin_prefetch(&flat->slots[group + __builtin_ctz(match)]);
+    }
+}
+
+ut_bool_t __flat_foreach(ut_hash_t *hash_table, uint32_t begin, uint32_t end, ut_hash_cb callback, ut_hash_bin_cb bin_callback, void* context)
+{
+    hash_flat_t*    flat = &hash_table->flat;
+
+    if (end > flat->mask + 1) {
+        end = flat->mask + 1;
+    }
+    for (uint32_t i = begin; i < end; i++) {
+        flat_slot_t*    slot = &flat->slots[i];
+        const char*     key = NULL;
+        ut_bool_t       go_on = UT_TRUE;
+
+        if (flat->ctrl[i] < 0) {
+            continue;
+        }
+        key = __key_data(&slot->key, slot->keylen);
+        go_on = callback ? callback(key, slot->value, context)
+                         : bin_callback(key, slot->keylen, slot->value, context);
+        if (!go_on) {
+            return UT_FALSE;
+        }
+    }
+    return UT_TRUE;
+}
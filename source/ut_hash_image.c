@@ -0,0 +1,323 @@
+/**
+ * @file ut_hash_image.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 哈希表的磁盘镜像。文件由文件头、索引和元素记录三部分组成，
+ *        索引是线性探测的槽位数组，槽位中保存元素记录相对于文件起始位置的偏移，因此文件与映射地址无关
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ut/ut_hash_image.h"
+#include "ut_hash_inn.h"
+
+#define IMAGE_MAGIC             "UTHIMG01"
+#define IMAGE_VERSION           1
+#define IMAGE_FLAG_RAW_VALUE    (1U << 0)   /* 值本身被保存，而不是值指向的内容 */
+#define IMAGE_MIN_SLOTS         16
+
+#define IMAGE_ALIGN8(len)       (((uint64_t)(len) + 7) & ~(uint64_t)7)
+/* 键连同结尾的'\0'占用的空间，按64位计算，keylen为UINT32_MAX时不会回绕 */
+#define IMAGE_KEY_SIZE(keylen)  IMAGE_ALIGN8((uint64_t)(keylen) + 1)
+
+typedef struct image_header {
+    char magic[8];              /* 文件标识 */
+    uint32_t version;           /* 格式版本 */
+    uint32_t flags;             /* IMAGE_FLAG_* */
+    uint64_t seed;              /* 哈希函数的种子 */
+    uint32_t count;             /* 元素数量 */
+    uint32_t mask;              /* 索引槽位数量 - 1 */
+    uint64_t index_off;         /* 索引的偏移 */
+    uint64_t size;              /* 文件大小 */
+} image_header_t;
+
+typedef struct image_slot {
+    uint32_t hash;              /* 键的哈希值 */
+    uint32_t reserved;
+    uint64_t offset;            /* 元素记录的偏移，0表示空槽位 */
+} image_slot_t;
+
+/* 元素记录：记录头之后是以'\0'结尾的键，再之后是按8字节对齐的值的内容 */
+typedef struct image_record {
+    uint32_t keylen;            /* 键的长度 */
+    uint32_t vallen;            /* 值的长度 */
+    uint64_t value;             /* IMAGE_FLAG_RAW_VALUE时保存的值 */
+    char key[0];                /* 键 */
+} image_record_t;
+
+struct ut_hash_image_t {
+    const char* base;           /* 映射的起始地址 */
+    uint64_t size;              /* 映射的大小 */
+    const image_header_t* header;   /* 文件头 */
+    const image_slot_t* slots;  /* 索引 */
+};
+
+typedef struct image_writer {
+    char* base;                 /* 输出文件的映射 */
+    uint64_t size;              /* 输出文件大小，第一遍遍历时累计 */
+    uint64_t cursor;            /* 下一个元素记录的写入位置 */
+    image_header_t* header;     /* 文件头 */
+    image_slot_t* slots;        /* 索引 */
+    ut_hash_value_len value_len;    /* 获取值长度的回调 */
+    void* context;              /* 回调的上下文 */
+    ut_errno_t error;           /* 写入过程中的错误 */
+} image_writer_t;
+
+
+static inline uint32_t __image_hash(uint64_t seed, const void *key, uint32_t keylen)
+{
+    uint64_t    hash = __hashfunc_wy(key, keylen, seed);
+
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static inline uint64_t __image_record_size(uint32_t keylen, uint32_t vallen)
+{
+    return sizeof(image_record_t) + IMAGE_KEY_SIZE(keylen) + IMAGE_ALIGN8(vallen);
+}
+
+/**
+ * @brief 第一遍遍历：计算元素记录占用的大小
+ */
+static ut_bool_t __image_measure(const void *key, uint32_t keylen, const void* value, void* context)
+{
+    image_writer_t* writer = (image_writer_t*)context;
+    uint32_t        vallen = writer->value_len ? writer->value_len(value, writer->context) : 0;
+
+    writer->size += __image_record_size(keylen, vallen);
+    return UT_TRUE;
+}
+
+/**
+ * @brief 第二遍遍历：写入元素记录以及索引
+ */
+static ut_bool_t __image_write(const void *key, uint32_t keylen, const void* value, void* context)
+{
+    image_writer_t* writer = (image_writer_t*)context;
+    image_record_t* record = (image_record_t*)(writer->base + writer->cursor);
+    uint32_t        vallen = writer->value_len ? writer->value_len(value, writer->context) : 0;
+    uint32_t        hash = 0;
+    uint32_t        index = 0;
+
+    /* 两次遍历得到的值长度不一致 */
+    if (writer->cursor + __image_record_size(keylen, vallen) > writer->size) {
+        writer->error = UT_ERRNO_INVALID;
+        return UT_FALSE;
+    }
+
+    record->keylen = keylen;
+    record->vallen = vallen;
+    memcpy(record->key, key, keylen);
+    if (writer->value_len) {
+        memcpy(record->key + IMAGE_KEY_SIZE(keylen), value, vallen);
+    } else {
+        record->value = (uint64_t)(uintptr_t)value;
+    }
+
+    hash = __image_hash(writer->header->seed, key, keylen);
+    index = hash & writer->header->mask;
+    while (writer->slots[index].offset != 0) {
+        index = (index + 1) & writer->header->mask;
+    }
+    writer->slots[index].hash = hash;
+    writer->slots[index].offset = writer->cursor;
+
+    writer->cursor += __image_record_size(keylen, vallen);
+    return UT_TRUE;
+}
+
+
+ut_errno_t ut_hash_save(ut_hash_t *hash_table, const char *path, ut_hash_value_len value_len, void* context)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+    image_writer_t  writer = {0};
+    uint32_t        slots = IMAGE_MIN_SLOTS;
+    uint64_t        index_off = IMAGE_ALIGN8(sizeof(image_header_t));
+    char*           tmp_path = NULL;
+    int             fd = -1;
+
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+    CHECK_PTR_RET(path, retval, UT_ERRNO_NULLPTR);
+
+    /* 索引的负载因子不超过0.75 */
+    while (slots - slots / 4 < (uint32_t)ut_hash_count(hash_table)) {
+        slots <<= 1;
+    }
+    writer.value_len = value_len;
+    writer.context = context;
+    writer.size = index_off + sizeof(image_slot_t) * slots;
+    writer.cursor = writer.size;
+    ut_hash_foreach_bin(hash_table, __image_measure, &writer);
+
+    tmp_path = malloc(strlen(path) + 32);
+    CHECK_PTR_RET(tmp_path, retval, UT_ERRNO_OUTOFMEM);
+    sprintf(tmp_path, "%s.tmp.%d", path, (int)getpid());
+
+    fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK_VAL_EQ(fd < 0, UT_TRUE, retval = UT_ERRNO_RESOURCE, TAG_FREE);
+    CHECK_VAL_NEQ(ftruncate(fd, writer.size), 0, retval = UT_ERRNO_RESOURCE, TAG_CLOSE);
+    writer.base = mmap(NULL, writer.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    CHECK_VAL_EQ(writer.base, MAP_FAILED, retval = UT_ERRNO_RESOURCE, TAG_CLOSE);
+
+    writer.header = (image_header_t*)writer.base;
+    writer.slots = (image_slot_t*)(writer.base + index_off);
+    memcpy(writer.header->magic, IMAGE_MAGIC, sizeof(writer.header->magic));
+    writer.header->version = IMAGE_VERSION;
+    writer.header->flags = value_len ? 0 : IMAGE_FLAG_RAW_VALUE;
+    writer.header->seed = __hash_random_seed();
+    writer.header->count = ut_hash_count(hash_table);
+    writer.header->mask = slots - 1;
+    writer.header->index_off = index_off;
+    writer.header->size = writer.size;
+    ut_hash_foreach_bin(hash_table, __image_write, &writer);
+    retval = writer.error;
+
+    munmap(writer.base, writer.size);
+    if (retval == UT_ERRNO_OK && fsync(fd) != 0) {
+        retval = UT_ERRNO_RESOURCE;
+    }
+
+TAG_CLOSE:
+    close(fd);
+    if (retval == UT_ERRNO_OK && rename(tmp_path, path) != 0) {
+        retval = UT_ERRNO_RESOURCE;
+    }
+    if (retval != UT_ERRNO_OK) {
+        unlink(tmp_path);
+    }
+TAG_FREE:
+    free(tmp_path);
+TAG_OUT:
+    return retval;
+}
+
+ut_errno_t ut_hash_open_mmap(ut_hash_image_t **out, const char *path)
+{
+    ut_errno_t              retval = UT_ERRNO_OK;
+    ut_hash_image_t*        img = NULL;
+    const image_header_t*   header = NULL;
+    struct stat             st;
+    void*                   base = MAP_FAILED;
+    int                     fd = -1;
+
+    CHECK_PTR_RET(out, retval, UT_ERRNO_NULLPTR);
+    CHECK_PTR_RET(path, retval, UT_ERRNO_NULLPTR);
+
+    fd = open(path, O_RDONLY);
+    CHECK_VAL_EQ(fd < 0, UT_TRUE, retval = UT_ERRNO_NOTEXSIT, TAG_OUT);
+    CHECK_VAL_NEQ(fstat(fd, &st), 0, retval = UT_ERRNO_RESOURCE, TAG_CLOSE);
+    CHECK_VAL_EQ((size_t)st.st_size < sizeof(image_header_t), UT_TRUE, retval = UT_ERRNO_INVALID, TAG_CLOSE);
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    CHECK_VAL_EQ(base, MAP_FAILED, retval = UT_ERRNO_RESOURCE, TAG_CLOSE);
+
+    /* 校验文件头，索引必须8字节对齐并完整地落在文件内。偏移来自文件，比较时用减法避免回绕 */
+    header = (const image_header_t*)base;
+    if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != IMAGE_VERSION
+            || header->size != (uint64_t)st.st_size
+            || (header->mask & (header->mask + 1)) != 0
+            || header->index_off < sizeof(image_header_t)
+            || (header->index_off & 7) != 0
+            || header->index_off > header->size
+            || sizeof(image_slot_t) * ((uint64_t)header->mask + 1) > header->size - header->index_off) {
+        retval = UT_ERRNO_INVALID;
+        goto TAG_UNMAP;
+    }
+
+    img = ut_zero_alloc(sizeof(ut_hash_image_t));
+    CHECK_VAL_EQ(img, NULL, retval = UT_ERRNO_OUTOFMEM, TAG_UNMAP);
+    img->base = base;
+    img->size = st.st_size;
+    img->header = header;
+    img->slots = (const image_slot_t*)(img->base + header->index_off);
+    *out = img;
+    /* 映射建立之后不再需要文件描述符 */
+    goto TAG_CLOSE;
+
+TAG_UNMAP:
+    munmap(base, st.st_size);
+TAG_CLOSE:
+    close(fd);
+TAG_OUT:
+    return retval;
+}
+
+ut_errno_t ut_hash_image_close(ut_hash_image_t *img)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(img, retval, UT_ERRNO_NULLPTR);
+    munmap((void*)img->base, img->size);
+    free(img);
+
+TAG_OUT:
+    return retval;
+}
+
+const void* ut_hash_image_peek(ut_hash_image_t *img, const char *key)
+{
+    if (key == NULL) {
+        return NULL;
+    }
+    return ut_hash_image_peek_bin(img, key, strlen(key), NULL);
+}
+
+const void* ut_hash_image_peek_bin(ut_hash_image_t *img, const void *key, uint32_t keylen, uint32_t *vallen)
+{
+    uint32_t    hash = 0;
+    uint32_t    mask = 0;
+    uint32_t    index = 0;
+
+    if (img == NULL || key == NULL) {
+        return NULL;
+    }
+
+    mask = img->header->mask;
+    hash = __image_hash(img->header->seed, key, keylen);
+    index = hash & mask;
+    for (uint32_t probe = 0; probe <= mask; probe++, index = (index + 1) & mask) {
+        const image_slot_t*     slot = &img->slots[index];
+        const image_record_t*   record = NULL;
+
+        if (slot->offset == 0) {
+            break;
+        }
+        if (slot->hash != hash) {
+            continue;
+        }
+        /* 记录必须8字节对齐并完整地落在文件内。文件至少有一个文件头，img->size减去记录头不会回绕 */
+        if ((slot->offset & 7) != 0 || slot->offset > img->size - sizeof(image_record_t)) {
+            break;
+        }
+        record = (const image_record_t*)(img->base + slot->offset);
+        if (__image_record_size(record->keylen, record->vallen) > img->size - slot->offset) {
+            break;
+        }
+        if (record->keylen != keylen || memcmp(record->key, key, keylen) != 0) {
+            continue;
+        }
+        if (vallen != NULL) {
+            *vallen = record->vallen;
+        }
+        if (img->header->flags & IMAGE_FLAG_RAW_VALUE) {
+            return (const void*)(uintptr_t)record->value;
+        }
+        return record->key + IMAGE_KEY_SIZE(keylen);
+    }
+
+    return NULL;
+}
+
+int32_t ut_hash_image_count(ut_hash_image_t *img)
+{
+    if (img == NULL) {
+        return 0;
+    }
+    return img->header->count;
+}
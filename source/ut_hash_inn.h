@@ -0,0 +1,146 @@
+/**
+ * @file ut_hash_inn.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 哈希表内部结构，仅供哈希表各个实现引擎之间共享使用
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_HASH_INN_H__
+#define __UTILS_HASH_INN_H__
+
+#include <string.h>
+#include "ut/ut_hash.h"
+
+#define HASH_KEY_INLINE_SIZE    16      /* 短键直接存放在元素内，包含结尾的'\0' */
+#define HASH_KEY_IS_INLINE(len) ((len) < HASH_KEY_INLINE_SIZE)
+#define HASH_ARENA_CLASSES      8       /* arena块的大小级别：16B ~ 2KB */
+#define HASH_KEY_MAX            (UINT32_MAX - 1)    /* 键的最大长度，加上结尾的'\0'不能超出uint32_t */
+
+/* 键的存放位置：短键直接存放，长键存放在哈希表的arena中。无论哪种都会以'\0'结尾 */
+typedef union hash_key {
+    char data[HASH_KEY_INLINE_SIZE];    /* 短键 */
+    char* ptr;                          /* 长键 */
+} hash_key_t;
+
+/*
+    拉链法元素，40字节，在slab中紧密排列，不按缓存行填充：填充到64字节会使每个元素多占用60%的内存，
+    而查找速度没有可测量的提升。沿链表查找时最常访问的hash、keylen、next放在最前面的16字节中，
+    这16字节跨越缓存行的概率为1/8
+ */
+typedef struct hash_entry {
+    uint32_t hash;              /* 哈希值 */
+    uint32_t keylen;            /* 键的长度，不包含结尾的'\0' */
+    struct hash_entry* next;    /* 哈希链表下一个 */
+    hash_key_t key;             /* 键 */
+    void* value;                /* 值 */
+} hash_entry_t;
+
+/* 拉链法元素的slab，直接从系统映射并按slab大小对齐，通过元素地址可以直接找到所属的slab */
+typedef struct hash_slab {
+    struct hash_slab* next;     /* slab链表 */
+    struct hash_slab* prev;
+    hash_entry_t* free;         /* slab内被归还的元素 */
+    uint32_t used;              /* 已经分配出去的元素数量，包括在哈希表空闲链表中的元素 */
+    uint32_t carved;            /* 已经切分出去过的元素数量 */
+} hash_slab_t;
+
+typedef struct flat_slot {
+    uint32_t hash;              /* 哈希值 */
+    uint32_t keylen;            /* 键的长度，不包含结尾的'\0' */
+    hash_key_t key;             /* 键 */
+    void* value;                /* 值 */
+} flat_slot_t;
+
+typedef struct hash_arena_chunk {
+    struct hash_arena_chunk* next;
+    char data[0];
+} hash_arena_chunk_t;
+
+typedef struct hash_arena {
+    hash_arena_chunk_t* chunks; /* 哈希表申请的所有内存块 */
+    char* cur;                  /* 当前内存块中未使用部分的起始位置 */
+    uint32_t left;              /* 当前内存块剩余的大小 */
+    void* free_list[HASH_ARENA_CLASSES];    /* 按大小级别回收的空闲块 */
+} hash_arena_t;
+
+typedef struct hash_flat {
+    int8_t* ctrl;               /* 控制字节，每个槽位一个，按组对齐 */
+    flat_slot_t* slots;         /* 平铺存放的槽位 */
+    uint32_t mask;              /* 槽位数量 - 1 */
+    uint32_t growth_left;       /* 在需要重新分配之前还能占用的空槽位数量 */
+} hash_flat_t;
+
+/* 操作计数，只有定义了ENABLE_HASH_STATS时才会计数 */
+typedef struct hash_counter {
+    uint64_t hits;              /* 查找命中 */
+    uint64_t misses;            /* 查找未命中 */
+    uint64_t inserts;           /* 插入新元素 */
+    uint64_t deletes;           /* 删除元素 */
+    uint64_t resizes;           /* 重新分配bucket/槽位数组 */
+} hash_counter_t;
+
+#ifdef ENABLE_HASH_STATS
+#define HASH_STAT_INC(ht, name)         ((ht)->counter.name++)
+#define HASH_STAT_LOOKUP(ht, found)     ((found) ? (ht)->counter.hits++ : (ht)->counter.misses++)
+#else
+#define HASH_STAT_INC(ht, name)         ((void)0)
+#define HASH_STAT_LOOKUP(ht, found)     ((void)0)
+#endif
+
+struct ut_hash_t {
+    hash_entry_t **array;       /* 哈希bucket */
+    uint32_t count;             /* 当前哈希表内的数据 */
+    uint32_t max;               /* 哈希表最大存储数据 */
+    ut_hash_func ut_hash_func;        /* 哈希函数 */
+    hash_entry_t *free;         /* 避免频繁free使用 */
+    uint32_t free_count;        /* 空闲链表中的元素数量 */
+    uint32_t free_max;          /* 空闲链表的上限，超出的元素归还给slab */
+    hash_slab_t *slabs;         /* 还有空闲元素的slab */
+    hash_slab_t *slabs_full;    /* 元素已经全部分配出去的slab */
+    hash_entry_t **old_array;   /* 渐进式扩容中的旧bucket，为NULL表示没有在扩容 */
+    uint32_t old_max;           /* 旧bucket数组大小 - 1 */
+    uint32_t rehash_idx;        /* 旧bucket数组中下一个需要迁移的bucket */
+    uint32_t flags;             /* 创建时指定的ut_hash_flag_t */
+    uint64_t seed;              /* 内置哈希函数的种子 */
+    hash_flat_t flat;           /* 开放寻址引擎的数据 */
+    hash_arena_t arena;         /* 长键的存放空间 */
+#ifdef ENABLE_HASH_STATS
+    hash_counter_t counter;     /* 操作计数 */
+#endif
+};
+
+/**
+ * @brief 获取元素中存放的键
+ */
+static inline const char* __key_data(const hash_key_t *key, uint32_t keylen)
+{
+    return HASH_KEY_IS_INLINE(keylen) ? key->data : key->ptr;
+}
+
+static inline ut_bool_t __key_equal(const hash_key_t *stored, uint32_t stored_len, const void* key, uint32_t keylen)
+{
+    return stored_len == keylen && memcmp(__key_data(stored, stored_len), key, keylen) == 0;
+}
+
+uint32_t __hashfunc_default(const void* key, uint32_t keylen);
+uint32_t __hashfunc_fnv1a(const void* key, uint32_t keylen, uint64_t seed);
+uint64_t __hashfunc_wy(const void* key, uint32_t keylen, uint64_t seed);
+uint64_t __hash_random_seed(void);
+ut_errno_t __key_store(ut_hash_t *hash_table, hash_key_t *dst, const void* key, uint32_t keylen);
+void __key_release(ut_hash_t *hash_table, hash_key_t *key, uint32_t keylen);
+
+
+ut_errno_t __flat_init(ut_hash_t *hash_table, uint32_t size);
+void __flat_fini(ut_hash_t *hash_table);
+ut_errno_t __flat_shrink(ut_hash_t *hash_table);
+void** __flat_slot(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value, ut_bool_t *inserted);
+void* __flat_push(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash, const void* value);
+void* __flat_peek(ut_hash_t *hash_table, const void *key, uint32_t keylen, uint32_t hash);
+void __flat_stats(ut_hash_t *hash_table, ut_hash_stats_t *stats);
+void __flat_prefetch(const ut_hash_t *hash_table, uint32_t hash, ut_bool_t slot);
+ut_bool_t __flat_foreach(ut_hash_t *hash_table, uint32_t begin, uint32_t end, ut_hash_cb callback, ut_hash_bin_cb bin_callback, void* context);
+
+#endif
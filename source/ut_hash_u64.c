@@ -0,0 +1,241 @@
+/**
+ * @file ut_hash_u64.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 整数键哈希表，线性探测，删除时后移归位而不留下墓碑
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "ut/ut_hash_u64.h"
+
+#define U64_INITIAL_CAPACITY    16
+
+/* 最大负载因子 3/4 */
+#define U64_MAX_LOAD(cap)       ((cap) - (cap) / 4)
+
+typedef struct u64_slot {
+    uint64_t key;               /* 键 */
+    void* value;                /* 值，为NULL表示空槽位 */
+} u64_slot_t;
+
+struct ut_hash_u64_t {
+    u64_slot_t* slots;          /* 槽位数组 */
+    uint32_t mask;              /* 槽位数量 - 1 */
+    uint32_t count;             /* 当前哈希表内的数据 */
+};
+
+/**
+ * @brief 整数混合函数（splitmix64的收尾部分），让相邻的fd、端口等键分散到不同的槽位
+ *
+ * @param key 键
+ * @return uint64_t
+ */
+static inline uint64_t __u64_mix(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+static inline uint32_t __u64_home(const ut_hash_u64_t *hash_table, uint64_t key)
+{
+    return (uint32_t)__u64_mix(key) & hash_table->mask;
+}
+
+/**
+ * @brief 查找键所在的槽位，或者键应当被放入的空槽位
+ *
+ * @param hash_table 哈希表描述结构体
+ * @param key 键
+ * @return uint32_t 槽位序号
+ */
+static uint32_t __u64_find(const ut_hash_u64_t *hash_table, uint64_t key)
+{
+    uint32_t    index = __u64_home(hash_table, key);
+
+    while (hash_table->slots[index].value != NULL && hash_table->slots[index].key != key) {
+        index = (index + 1) & hash_table->mask;
+    }
+    return index;
+}
+
+static ut_errno_t __u64_resize(ut_hash_u64_t *hash_table, uint32_t capacity)
+{
+    u64_slot_t* old_slots = hash_table->slots;
+    uint32_t    old_mask = hash_table->mask;
+
+    hash_table->slots = ut_zero_alloc(sizeof(u64_slot_t) * capacity);
+    if (hash_table->slots == NULL) {
+        hash_table->slots = old_slots;
+        return UT_ERRNO_OUTOFMEM;
+    }
+    hash_table->mask = capacity - 1;
+
+    for (uint32_t i = 0; old_slots != NULL && i <= old_mask; i++) {
+        if (old_slots[i].value != NULL) {
+            hash_table->slots[__u64_find(hash_table, old_slots[i].key)] = old_slots[i];
+        }
+    }
+    free(old_slots);
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * @brief 删除指定槽位的元素，并将后续探测链上的元素前移，保证探测链不会断开
+ *
+ * @param hash_table 哈希表描述结构体
+ * @param index 被删除的槽位
+ */
+static void __u64_erase(ut_hash_u64_t *hash_table, uint32_t index)
+{
+    uint32_t    hole = index;
+    uint32_t    next = index;
+
+    FOREVER {
+        uint32_t    home = 0;
+
+        next = (next + 1) & hash_table->mask;
+        if (hash_table->slots[next].value == NULL) {
+            break;
+        }
+        /* next处的元素的归属位置不在(hole, next]区间内时，才能移动到hole处 */
+        home = __u64_home(hash_table, hash_table->slots[next].key);
+        if (((next - home) & hash_table->mask) >= ((next - hole) & hash_table->mask)) {
+            hash_table->slots[hole] = hash_table->slots[next];
+            hole = next;
+        }
+    }
+    hash_table->slots[hole].key = 0;
+    hash_table->slots[hole].value = NULL;
+    hash_table->count--;
+}
+
+
+ut_errno_t ut_hash_u64_create(ut_hash_u64_t **out, uint32_t size)
+{
+    ut_hash_u64_t*  hash_table = NULL;
+    uint32_t        capacity = U64_INITIAL_CAPACITY;
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(out, retval, UT_ERRNO_NULLPTR);
+
+    while (U64_MAX_LOAD(capacity) < size) {
+        capacity <<= 1;
+    }
+
+    hash_table = ut_zero_alloc(sizeof(ut_hash_u64_t));
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_OUTOFMEM);
+    retval = __u64_resize(hash_table, capacity);
+    CHECK_VAL_NEQ(retval, UT_ERRNO_OK, free(hash_table), TAG_OUT);
+    *out = hash_table;
+
+TAG_OUT:
+    return retval;
+}
+
+ut_errno_t ut_hash_u64_destroy(ut_hash_u64_t *hash_table)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    CHECK_PTR_RET(hash_table, retval, UT_ERRNO_NULLPTR);
+    free(hash_table->slots);
+    free(hash_table);
+
+TAG_OUT:
+    return retval;
+}
+
+void* ut_hash_u64_push(ut_hash_u64_t *hash_table, uint64_t key, const void* value)
+{
+    void*       old_value = NULL;
+    uint32_t    index = 0;
+
+    if (hash_table == NULL) {
+        return NULL;
+    }
+    if (value == NULL) {
+        return ut_hash_u64_pop(hash_table, key);
+    }
+
+    index = __u64_find(hash_table, key);
+    if (hash_table->slots[index].value != NULL) {
+        /* replace entry */
+        old_value = hash_table->slots[index].value;
+        hash_table->slots[index].value = (void*)value;
+        return old_value;
+    }
+
+    if (hash_table->count + 1 > U64_MAX_LOAD(hash_table->mask + 1)) {
+        if (__u64_resize(hash_table, (hash_table->mask + 1) * 2) != UT_ERRNO_OK) {
+            return NULL;
+        }
+        index = __u64_find(hash_table, key);
+    }
+    hash_table->slots[index].key = key;
+    hash_table->slots[index].value = (void*)value;
+    hash_table->count++;
+
+    return NULL;
+}
+
+void* ut_hash_u64_peek(ut_hash_u64_t *hash_table, uint64_t key)
+{
+    if (hash_table == NULL) {
+        return NULL;
+    }
+    return hash_table->slots[__u64_find(hash_table, key)].value;
+}
+
+void* ut_hash_u64_pop(ut_hash_u64_t *hash_table, uint64_t key)
+{
+    void*       old_value = NULL;
+    uint32_t    index = 0;
+
+    if (hash_table == NULL) {
+        return NULL;
+    }
+
+    index = __u64_find(hash_table, key);
+    old_value = hash_table->slots[index].value;
+    if (old_value != NULL) {
+        __u64_erase(hash_table, index);
+    }
+    return old_value;
+}
+
+int32_t ut_hash_u64_count(ut_hash_u64_t *hash_table)
+{
+    return hash_table->count;
+}
+
+void ut_hash_u64_foreach(ut_hash_u64_t *hash_table, ut_hash_u64_cb callback, void* context)
+{
+    uint32_t    start = 0;
+    uint32_t    index = 0;
+
+    if (hash_table == NULL || callback == NULL || hash_table->count == 0) {
+        return;
+    }
+
+    /*
+        从一个空槽位开始倒序遍历：删除当前元素时，只有当前位置之后（已经遍历过）的元素
+        会前移，因此遍历过程中删除当前元素不会漏掉或重复遍历元素
+     */
+    while (hash_table->slots[start].value != NULL) {
+        start++;
+    }
+    for (index = (start - 1) & hash_table->mask; index != start; index = (index - 1) & hash_table->mask) {
+        u64_slot_t*     slot = &hash_table->slots[index];
+
+        if (slot->value != NULL && !callback(slot->key, slot->value, context)) {
+            return;
+        }
+    }
+}
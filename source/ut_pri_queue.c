@@ -9,48 +9,136 @@
  * 
  */
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
 #include <pthread.h>
 
 #include "ut/ut_pri_queue.h"
+#include "ut_pri_queue_inn.h"
 
 
-typedef struct heap_element {
-    void*               data;               /* 堆元素保存的数据 */
-} heap_element_t;
+#define QUEUE_SPIN_MAX      2000    /* 消费者等待前自旋的最大次数 */
+#define QUEUE_SPIN_MIN      16
 
-typedef struct internal_heap {
-    uint32_t            cur_size;           /* 堆当前的大小 */
-    uint32_t            max_size;           /* 堆最大的大小 */
-    ut_pri_comp_func       elem_compare_cb;    /* 堆元素比较 */
-    heap_element_t      *heap_mem[0];       /* 堆内存起始指针 */
-} inn_heap_t;
+#if defined(__x86_64__) || defined(__i386__)
+#define QUEUE_CPU_RELAX()   __builtin_ia32_pause()
+#else
+#define QUEUE_CPU_RELAX()   __asm__ __volatile__("" ::: "memory")
+#endif
 
 struct pri_queue {
     pthread_mutex_t     mutex;
-    pthread_cond_t      cond;
+    pthread_cond_t      cond;           /* 使用单调时钟 */
     ut_bool_t           adaption;       /* 堆大小自适应 */
-    inn_heap_t          *heap;
+    ut_bool_t           spin;           /* 消费者在等待前先自旋 */
+    uint32_t            spin_avg;       /* 最近自旋成功所用次数的平均值，决定下一次自旋的上限 */
+    uint32_t            waiters;        /* 正在条件变量上等待的消费者数量 */
+    uint32_t            count;          /* 元素个数的副本，在锁内原子写入，供不加锁的自旋和ut_pri_queue_get_size读取 */
+    ut_bool_t           bucketed;       /* 使用基数堆或桶队列，而不是堆 */
+    ut_bool_t           bounded;        /* 有界队列，堆按最小最大堆组织 */
+    inn_heap_t          heap[1];
+    inn_bucket_t        bucket[1];
 };
 
+/* 队列中元素的个数，按使用的引擎读取，只能在锁内使用 */
+#define QUEUE_SIZE(pri_queue)   (*((pri_queue)->bucketed ? &(pri_queue)->bucket->cur_size : &(pri_queue)->heap->cur_size))
 
+/* 修改了元素个数的操作在解锁前发布新的个数，堆内部的cur_size只在锁内读写 */
+#define QUEUE_UNLOCK_PUBLISH(pri_queue)     do {\
+        __atomic_store_n(&(pri_queue)->count, QUEUE_SIZE(pri_queue), __ATOMIC_RELAXED);\
+        pthread_mutex_unlock(&(pri_queue)->mutex);\
+    } while (0)
+
+
+static ut_pri_queue_t *__queue_create(int32_t initial_size, uint32_t flags, ut_pri_comp_func cb, int32_t levels);
 static ut_errno_t __queue_pop(ut_pri_queue_t* pri_queue, void** pdata, int32_t timeout);
+static int32_t __queue_pop_n(ut_pri_queue_t *pri_queue, void* out[], int64_t keys[], int32_t max, int32_t timeout);
+static void __queue_spin(ut_pri_queue_t *pri_queue);
+static ut_errno_t __queue_push(ut_pri_queue_t *pri_queue, void* data, int64_t key, ut_pri_handle_t *handle);
+static uint32_t __heap_sift_down(inn_heap_t *heap, uint32_t index, heap_element_t elem, uint32_t handle);
+static uint32_t __heap_handle_alloc(inn_heap_t *heap);
+static void __heap_handle_release(inn_heap_t *heap, uint32_t handle);
 
-static void __heap_sort(inn_heap_t *heap, int32_t index);
-static void* __heap_remove(inn_heap_t *heap, int32_t index);
-static ut_errno_t __heap_push(inn_heap_t *heap, void* data);
-static void* __heap_pop(inn_heap_t *heap);
-static void* __heap_peek(inn_heap_t *heap);
 
 
 
 
 ut_pri_queue_t *ut_pri_queue_create(int32_t initial_size, ut_bool_t size_adaption, ut_pri_comp_func cb)
+{
+    return ut_pri_queue_create_ex(initial_size, size_adaption ? UT_PRI_QUEUE_FLAG_ADAPTION : UT_PRI_QUEUE_FLAG_NONE, cb);
+}
+
+ut_pri_queue_t *ut_pri_queue_create_key(int32_t initial_size, uint32_t flags)
+{
+    if (initial_size <= 0) {
+        return NULL;
+    }
+
+    /* 不注册比较函数即为整数键队列 */
+    return __queue_create(initial_size, flags, NULL, 0);
+}
+
+ut_pri_queue_t *ut_pri_queue_create_bucket(int32_t initial_size, int32_t levels, uint32_t flags)
+{
+    if (initial_size <= 0 || levels <= 0 || (flags & UT_PRI_QUEUE_FLAG_RADIX)) {
+        return NULL;
+    }
+
+    return __queue_create(initial_size, flags, NULL, levels);
+}
+
+ut_pri_queue_t *ut_pri_queue_create_topk(int32_t max_size, uint32_t flags, ut_pri_comp_func cb)
 {
     ut_pri_queue_t *new_queue = NULL;
 
-    if (initial_size <= 0 || cb == NULL || cb == NULL) {
+    /* 容量固定，只支持二叉布局 */
+    if (flags & ~UT_PRI_QUEUE_FLAG_SPIN) {
+        return NULL;
+    }
+
+    new_queue = __queue_create(max_size, flags, cb, 0);
+    if (new_queue != NULL) {
+        new_queue->bounded = UT_TRUE;
+    }
+    return new_queue;
+}
+
+ut_pri_queue_t *ut_pri_queue_create_ex(int32_t initial_size, uint32_t flags, ut_pri_comp_func cb)
+{
+    if (cb == NULL) {
+        return NULL;
+    }
+
+    if (flags & UT_PRI_QUEUE_FLAG_RADIX) {
+        return NULL;    /* 基数堆只支持整数键 */
+    }
+
+    return __queue_create(initial_size, flags, cb, 0);
+}
+
+/**
+ * 创建优先级队列，cb为NULL时创建整数键队列
+ * @param [in] initial_size 初始大小
+ * @param [in] flags ut_pri_queue_flag_t标志位的组合
+ * @param [in] cb 需要注册的回调函数
+ * @param [in] levels 大于0时创建有levels个优先级的桶队列
+ * @retval ut_pri_queue_t* 
+ */
+static ut_pri_queue_t *__queue_create(int32_t initial_size, uint32_t flags, ut_pri_comp_func cb, int32_t levels)
+{
+    ut_pri_queue_t *new_queue = NULL;
+    pthread_condattr_t  attr;
+
+    if (initial_size <= 0) {
         goto _out;
     }
+    if ((flags & UT_PRI_QUEUE_FLAG_4ARY) && (flags & UT_PRI_QUEUE_FLAG_8ARY)) {
+        goto _out;
+    }
+    if ((flags & UT_PRI_QUEUE_FLAG_HANDLE) && ((flags & UT_PRI_QUEUE_FLAG_RADIX) || levels > 0)) {
+        goto _out;      /* 基数堆和桶队列不支持句柄 */
+    }
 
     new_queue = (ut_pri_queue_t*)ut_zero_alloc(sizeof(ut_pri_queue_t));
     if (new_queue == NULL) {
@@ -59,25 +147,44 @@ ut_pri_queue_t *ut_pri_queue_create(int32_t initial_size, ut_bool_t size_adaptio
 
     memset(new_queue, 0, sizeof(ut_pri_queue_t));
     pthread_mutex_init(&new_queue->mutex, NULL);
-    pthread_cond_init(&new_queue->cond, NULL);
 
-    /* 申请堆内存大小+1是因为堆首元素不使用，这样能够进行快速的上浮、下沉排序算法 */
-    new_queue->heap = (inn_heap_t*)ut_zero_alloc(sizeof(inn_heap_t) + ((initial_size + 1) * sizeof(heap_element_t)));
-    if (new_queue == NULL) {
+    /* 超时按单调时钟计算，不受系统时间调整的影响 */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&new_queue->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    new_queue->heap->arity = 2;
+    if (flags & UT_PRI_QUEUE_FLAG_4ARY) {
+        new_queue->heap->arity = 4;
+    } else if (flags & UT_PRI_QUEUE_FLAG_8ARY) {
+        new_queue->heap->arity = 8;
+    }
+    new_queue->heap->tracked = (flags & UT_PRI_QUEUE_FLAG_HANDLE) ? UT_TRUE : UT_FALSE;
+    new_queue->bucketed = ((flags & UT_PRI_QUEUE_FLAG_RADIX) || levels > 0) ? UT_TRUE : UT_FALSE;
+    if (new_queue->bucketed) {
+        if (__bucket_init(new_queue->bucket, initial_size, levels) != UT_ERRNO_OK) {
+            goto _free;
+        }
+    } else if (__heap_resize(new_queue->heap, initial_size) != UT_ERRNO_OK) {
         goto _free;
     }
-    new_queue->heap->max_size = initial_size;
     new_queue->heap->elem_compare_cb = cb;
-    new_queue->adaption = size_adaption;
+    new_queue->adaption = (flags & UT_PRI_QUEUE_FLAG_ADAPTION) ? UT_TRUE : UT_FALSE;
+
+    /* 只有一个CPU时自旋只会推迟生产者的运行 */
+    new_queue->spin = ((flags & UT_PRI_QUEUE_FLAG_SPIN) && sysconf(_SC_NPROCESSORS_ONLN) > 1) ? UT_TRUE : UT_FALSE;
+    new_queue->spin_avg = QUEUE_SPIN_MIN;
 
 _out:
     return new_queue;
 
 _free:
     if (new_queue != NULL) {
-        if (new_queue->heap != NULL) {
-            free(new_queue->heap);
-        }
+        __heap_free(new_queue->heap);
+        __bucket_free(new_queue->bucket);
+        pthread_mutex_destroy(&new_queue->mutex);
+        pthread_cond_destroy(&new_queue->cond);
         free(new_queue);
         new_queue = NULL;
     }
@@ -92,12 +199,8 @@ ut_errno_t ut_pri_queue_destroy(ut_pri_queue_t *pri_queue)
         pthread_mutex_destroy(&pri_queue->mutex);
         pthread_cond_destroy(&pri_queue->cond);
 
-        if (pri_queue->heap != NULL) {
-            for (int i = 1; i <= pri_queue->heap->cur_size; i++) {
-                free(pri_queue->heap->heap_mem[i]);
-            }
-            free(pri_queue->heap);
-        }
+        __heap_free(pri_queue->heap);
+        __bucket_free(pri_queue->bucket);
         free(pri_queue);
         retval = UT_ERRNO_OK;
     }
@@ -116,11 +219,11 @@ ut_errno_t ut_pri_queue_peek(ut_pri_queue_t * pri_queue, void** pdata)
     }
 
     pthread_mutex_lock(&pri_queue->mutex);
-    if (pri_queue->heap->cur_size > 0) {
-        heap_element_t*     elem = NULL;
-
-        elem = __heap_peek(pri_queue->heap);
-        *pdata = elem->data;
+    if (pri_queue->bucketed && pri_queue->bucket->cur_size > 0) {
+        *pdata = __bucket_peek(pri_queue->bucket)->data;
+        retval = UT_ERRNO_OK;
+    } else if (!pri_queue->bucketed && pri_queue->heap->cur_size > 0) {
+        *pdata = __heap_peek(pri_queue->heap);
         retval = UT_ERRNO_OK;
     } else {
         *pdata = NULL;
@@ -134,37 +237,302 @@ _out:
 }
 
 ut_errno_t ut_pri_queue_push(ut_pri_queue_t * pri_queue, void* data)
+{
+    if(pri_queue == NULL || data == NULL || pri_queue->heap->elem_compare_cb == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    return __queue_push(pri_queue, data, 0, NULL);
+}
+
+ut_errno_t ut_pri_queue_push_handle(ut_pri_queue_t *pri_queue, void* data, ut_pri_handle_t *handle)
+{
+    if (pri_queue == NULL || data == NULL || handle == NULL || !pri_queue->heap->tracked) {
+        return UT_ERRNO_INVALID;
+    }
+    if (pri_queue->heap->elem_compare_cb == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    return __queue_push(pri_queue, data, 0, handle);
+}
+
+ut_errno_t ut_pri_queue_push_key(ut_pri_queue_t *pri_queue, int64_t key, void* data, ut_pri_handle_t *handle)
+{
+    if (pri_queue == NULL || pri_queue->heap->elem_compare_cb != NULL) {
+        return UT_ERRNO_INVALID;
+    }
+    if (handle != NULL && !pri_queue->heap->tracked) {
+        return UT_ERRNO_INVALID;
+    }
+
+    return __queue_push(pri_queue, data, key, handle);
+}
+
+ut_errno_t ut_pri_queue_peek_key(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata)
 {
     ut_errno_t     retval = UT_ERRNO_OK;
 
-    if(pri_queue == NULL || data == NULL) {
-        retval = UT_ERRNO_INVALID;
-        goto _out;
+    if (pri_queue == NULL || pri_queue->heap->elem_compare_cb != NULL) {
+        return UT_ERRNO_INVALID;
     }
 
     pthread_mutex_lock(&pri_queue->mutex);
+    if (pri_queue->bucketed && pri_queue->bucket->cur_size > 0) {
+        const heap_element_t*   top = __bucket_peek(pri_queue->bucket);
 
-    retval = __heap_push(pri_queue->heap, data);
-    if (retval == UT_ERRNO_RESOURCE) {
-        /* 资源不足，原因为队列已满，如果开启大小自适应，将会进行自动扩容 */
-        if (pri_queue->adaption) {
-            int32_t  realloc_size = 0;
+        if (key != NULL) {
+            *key = top->key;
+        }
+        if (pdata != NULL) {
+            *pdata = top->data;
+        }
+    } else if (!pri_queue->bucketed && pri_queue->heap->cur_size > 0) {
+        heap_element_t*     top = &pri_queue->heap->heap_mem[HEAP_ROOT(pri_queue->heap)];
 
-            /* 扩容大小为原来的2倍 */
-            realloc_size = sizeof(inn_heap_t) + (pri_queue->heap->max_size * 2) + 1;
-            pri_queue->heap = realloc(pri_queue->heap, realloc_size);
+        if (key != NULL) {
+            *key = top->key;
+        }
+        if (pdata != NULL) {
+            *pdata = top->data;
         }
-        retval = __heap_push(pri_queue->heap, data);   /* 重新进行一次数据入堆 */
+    } else {
+        retval = UT_ERRNO_RESOURCE;
+    }
+    pthread_mutex_unlock(&pri_queue->mutex);
+
+    return retval;
+}
+
+ut_errno_t ut_pri_queue_peek_min(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata)
+{
+    ut_errno_t     retval = UT_ERRNO_OK;
+
+    if (pri_queue == NULL || !pri_queue->bounded) {
+        return UT_ERRNO_INVALID;
     }
 
-    pthread_cond_broadcast(&pri_queue->cond);
+    pthread_mutex_lock(&pri_queue->mutex);
+    if (pri_queue->heap->cur_size > 0) {
+        heap_element_t*     last = &pri_queue->heap->heap_mem[__minmax_last(pri_queue->heap)];
+
+        if (key != NULL) {
+            *key = last->key;
+        }
+        if (pdata != NULL) {
+            *pdata = last->data;
+        }
+    } else {
+        retval = UT_ERRNO_RESOURCE;
+    }
     pthread_mutex_unlock(&pri_queue->mutex);
-    UT_LOG_DEBUG("push data address %p\n", data);
 
-_out:
     return retval;
 }
 
+ut_errno_t ut_pri_queue_peek_max(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata)
+{
+    ut_errno_t     retval = UT_ERRNO_OK;
+
+    if (pri_queue == NULL || !pri_queue->bounded) {
+        return UT_ERRNO_INVALID;
+    }
+
+    pthread_mutex_lock(&pri_queue->mutex);
+    if (pri_queue->heap->cur_size > 0) {
+        heap_element_t*     top = &pri_queue->heap->heap_mem[HEAP_ROOT(pri_queue->heap)];
+
+        if (key != NULL) {
+            *key = top->key;
+        }
+        if (pdata != NULL) {
+            *pdata = top->data;
+        }
+    } else {
+        retval = UT_ERRNO_RESOURCE;
+    }
+    pthread_mutex_unlock(&pri_queue->mutex);
+
+    return retval;
+}
+
+ut_errno_t ut_pri_queue_push_evict(ut_pri_queue_t *pri_queue, int64_t key, void* data, void** evicted)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+    heap_element_t  old = {NULL, 0};
+
+    if (pri_queue == NULL || !pri_queue->bounded) {
+        return UT_ERRNO_INVALID;
+    }
+    if (pri_queue->heap->elem_compare_cb != NULL && data == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    pthread_mutex_lock(&pri_queue->mutex);
+    retval = __minmax_push(pri_queue->heap, data, key);
+    if (retval == UT_ERRNO_OK) {
+        if (pri_queue->waiters > 0) {
+            pthread_cond_signal(&pri_queue->cond);
+        }
+    } else {
+        /* 队列已满，替换掉优先级最低的元素，元素个数不变，不需要唤醒等待者 */
+        retval = __minmax_replace_last(pri_queue->heap, data, key, &old);
+    }
+    QUEUE_UNLOCK_PUBLISH(pri_queue);
+
+    if (evicted != NULL) {
+        *evicted = old.data;
+    }
+    return retval;
+}
+
+ut_errno_t ut_pri_queue_pop_key(ut_pri_queue_t *pri_queue, int64_t *key, void** pdata, int32_t timeout)
+{
+    void*       data = NULL;
+    int64_t     data_key = 0;
+
+    if (pri_queue == NULL || pri_queue->heap->elem_compare_cb != NULL || timeout < -1) {
+        return UT_ERRNO_INVALID;
+    }
+
+    if (__queue_pop_n(pri_queue, &data, &data_key, 1, timeout) != 1) {
+        return UT_ERRNO_RESOURCE;
+    }
+    if (key != NULL) {
+        *key = data_key;
+    }
+    if (pdata != NULL) {
+        *pdata = data;
+    }
+    return UT_ERRNO_OK;
+}
+
+ut_errno_t ut_pri_queue_remove(ut_pri_queue_t *pri_queue, ut_pri_handle_t handle, void** pdata)
+{
+    ut_errno_t     retval = UT_ERRNO_OK;
+    uint32_t       pos = 0;
+    void*          data = NULL;
+
+    if (pri_queue == NULL || !pri_queue->heap->tracked) {
+        return UT_ERRNO_INVALID;
+    }
+
+    pthread_mutex_lock(&pri_queue->mutex);
+    pos = __heap_handle_pos(pri_queue->heap, handle);
+    if (pos == HEAP_NO_HANDLE) {
+        retval = UT_ERRNO_NOTEXSIT;     /* 元素已经被取出或移除 */
+    } else {
+        data = __heap_remove(pri_queue->heap, pos);
+    }
+    QUEUE_UNLOCK_PUBLISH(pri_queue);
+
+    if (pdata != NULL) {
+        *pdata = data;
+    }
+    return retval;
+}
+
+ut_errno_t ut_pri_queue_update_key(ut_pri_queue_t *pri_queue, ut_pri_handle_t handle, int64_t key)
+{
+    ut_errno_t     retval = UT_ERRNO_OK;
+    uint32_t       pos = 0;
+
+    if (pri_queue == NULL || !pri_queue->heap->tracked || pri_queue->heap->elem_compare_cb != NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    pthread_mutex_lock(&pri_queue->mutex);
+    pos = __heap_handle_pos(pri_queue->heap, handle);
+    if (pos == HEAP_NO_HANDLE) {
+        retval = UT_ERRNO_NOTEXSIT;
+    } else {
+        pri_queue->heap->heap_mem[pos].key = key;
+        __heap_update(pri_queue->heap, pos);
+    }
+    pthread_mutex_unlock(&pri_queue->mutex);
+
+    return retval;
+}
+
+ut_errno_t ut_pri_queue_update(ut_pri_queue_t *pri_queue, ut_pri_handle_t handle)
+{
+    ut_errno_t     retval = UT_ERRNO_OK;
+    uint32_t       pos = 0;
+
+    if (pri_queue == NULL || !pri_queue->heap->tracked) {
+        return UT_ERRNO_INVALID;
+    }
+
+    pthread_mutex_lock(&pri_queue->mutex);
+    pos = __heap_handle_pos(pri_queue->heap, handle);
+    if (pos == HEAP_NO_HANDLE) {
+        retval = UT_ERRNO_NOTEXSIT;
+    } else {
+        __heap_update(pri_queue->heap, pos);
+    }
+    pthread_mutex_unlock(&pri_queue->mutex);
+
+    return retval;
+}
+
+ut_errno_t ut_pri_queue_push_n(ut_pri_queue_t *pri_queue, void* const datas[], int32_t num)
+{
+    ut_errno_t     retval = UT_ERRNO_OK;
+
+    if (pri_queue == NULL || datas == NULL || num < 0 || pri_queue->heap->elem_compare_cb == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+    for (int32_t i = 0; i < num; i++) {
+        if (datas[i] == NULL) {
+            return UT_ERRNO_INVALID;
+        }
+    }
+    if (num == 0) {
+        return UT_ERRNO_OK;
+    }
+
+    pthread_mutex_lock(&pri_queue->mutex);
+
+    /* 一次扩容到能放下整批数据，放不下时整批都不入堆 */
+    while (retval == UT_ERRNO_OK && pri_queue->heap->max_size - pri_queue->heap->cur_size < (uint32_t)num) {
+        retval = pri_queue->adaption ? __heap_grow(pri_queue->heap) : UT_ERRNO_RESOURCE;
+    }
+    if (retval == UT_ERRNO_OK) {
+        if (pri_queue->bounded) {
+            for (int32_t i = 0; i < num; i++) {
+                __minmax_push(pri_queue->heap, datas[i], 0);
+            }
+        } else {
+            __heap_push_n(pri_queue->heap, datas, num);
+        }
+
+        /* 整批数据只唤醒一次，没有等待者时不唤醒 */
+        if (pri_queue->waiters > 0) {
+            if (num == 1) {
+                pthread_cond_signal(&pri_queue->cond);
+            } else {
+                pthread_cond_broadcast(&pri_queue->cond);
+            }
+        }
+    }
+
+    QUEUE_UNLOCK_PUBLISH(pri_queue);
+
+    return retval;
+}
+
+int32_t ut_pri_queue_pop_n(ut_pri_queue_t *pri_queue, void* out[], int32_t max, int32_t timeout)
+{
+    if (pri_queue == NULL || out == NULL || max < 0 || timeout < -1) {
+        return -1;
+    }
+    if (max == 0) {
+        return 0;
+    }
+
+    return __queue_pop_n(pri_queue, out, NULL, max, timeout);
+}
+
 ut_errno_t ut_pri_queue_pop_wait(ut_pri_queue_t *pri_queue, void* *pdata)
 {
     if (pri_queue == NULL || pdata == NULL) {
@@ -197,12 +565,66 @@ int32_t ut_pri_queue_get_size(const ut_pri_queue_t *pri_queue)
 {
     if(pri_queue == NULL)
         return -1;
-    return pri_queue->heap->cur_size;
+    return __atomic_load_n(&pri_queue->count, __ATOMIC_RELAXED);
 }
 
 
 
 
+/**
+ * 将数据存入优先级队列，队列已满且开启大小自适应时自动扩容
+ * @param [in] pri_queue 优先级队列
+ * @param [in] data 数据指针
+ * @param [in] key 整数键队列的优先级
+ * @param [out] handle 传出元素的句柄，可以为NULL
+ * @retval ut_errno_t 
+ */
+static ut_errno_t __queue_push(ut_pri_queue_t *pri_queue, void* data, int64_t key, ut_pri_handle_t *handle)
+{
+    ut_errno_t     retval = UT_ERRNO_OK;
+    uint32_t       id = HEAP_NO_HANDLE;
+
+    pthread_mutex_lock(&pri_queue->mutex);
+
+    if (pri_queue->bucketed) {
+        retval = __bucket_push(pri_queue->bucket, data, key);
+        if (retval == UT_ERRNO_RESOURCE && pri_queue->adaption) {
+            retval = __bucket_grow(pri_queue->bucket);
+            if (retval == UT_ERRNO_OK) {
+                retval = __bucket_push(pri_queue->bucket, data, key);
+            }
+        }
+        goto _signal;
+    }
+
+    if (pri_queue->bounded) {
+        retval = __minmax_push(pri_queue->heap, data, key);
+        goto _signal;
+    }
+
+    retval = __heap_push(pri_queue->heap, data, key, &id);
+    if (retval == UT_ERRNO_RESOURCE && pri_queue->adaption) {
+        /* 资源不足，原因为队列已满，如果开启大小自适应，将会进行自动扩容 */
+        retval = __heap_grow(pri_queue->heap);
+        if (retval == UT_ERRNO_OK) {
+            retval = __heap_push(pri_queue->heap, data, key, &id);   /* 重新进行一次数据入堆 */
+        }
+    }
+    if (retval == UT_ERRNO_OK && handle != NULL) {
+        *handle = __heap_handle_encode(pri_queue->heap, id);
+    }
+
+_signal:
+    /* 只放入了一个元素，唤醒一个等待者即可 */
+    if (retval == UT_ERRNO_OK && pri_queue->waiters > 0) {
+        pthread_cond_signal(&pri_queue->cond);
+    }
+    QUEUE_UNLOCK_PUBLISH(pri_queue);
+    UT_LOG_DEBUG("push data address %p\n", data);
+
+    return retval;
+}
+
 /**
  * 
  * @param [in] pri_queue 优先级队列
@@ -212,77 +634,298 @@ int32_t ut_pri_queue_get_size(const ut_pri_queue_t *pri_queue)
  */
 static ut_errno_t __queue_pop(ut_pri_queue_t *pri_queue, void* *pdata, int32_t timeout)
 {
-    int32_t         retval = UT_ERRNO_OK;
-    struct timespec tm;
+    if (__queue_pop_n(pri_queue, pdata, NULL, 1, timeout) != 1) {
+        *pdata = NULL;
+        return UT_ERRNO_RESOURCE;
+    }
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 加锁一次，取出队列首部最多max个数据
+ * @param [in] pri_queue 优先级队列
+ * @param [out] out 保存取出的数据
+ * @param [out] keys 保存取出的数据的整数键，可以为NULL
+ * @param [in] max 最多取出的个数
+ * @param [in] timeout 超时时间，毫秒（ms）
+ * @retval int32_t 取出的个数
+ */
+static int32_t __queue_pop_n(ut_pri_queue_t *pri_queue, void* out[], int64_t keys[], int32_t max, int32_t timeout)
+{
+    int32_t         popped = 0;
+    int             wait_ret = 0;
+    struct timespec deadline;
+
+    /* 超时时间换算成单调时钟上的截止时间，被提前唤醒后继续等待剩余的时间 */
+    if (timeout > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000 * 1000;
+        if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000 * 1000 * 1000;
+        }
+    }
+    if (timeout != 0 && pri_queue->spin) {
+        __queue_spin(pri_queue);
+    }
 
     pthread_mutex_lock(&pri_queue->mutex);
 
-    /* 队列中没有元素，根据传入的超时时间进行等待处理 */
-    if (pri_queue->heap->cur_size == 0) {
+    /* 队列中没有元素，根据传入的超时时间进行等待处理，直到有元素或超时为止 */
+    while (QUEUE_SIZE(pri_queue) == 0 && timeout != 0 && wait_ret != ETIMEDOUT) {
+        pri_queue->waiters++;
         if (timeout == -1) {
             pthread_cond_wait(&pri_queue->cond, &pri_queue->mutex);
-        } else if (timeout > 0) {
-            tm.tv_sec = timeout / 1000;
-            tm.tv_nsec = (timeout % 1000) * 1000 * 1000;
-            pthread_cond_timedwait(&pri_queue->cond, &pri_queue->mutex, &tm);
         } else {
-            retval = UT_ERRNO_RESOURCE;
+            wait_ret = pthread_cond_timedwait(&pri_queue->cond, &pri_queue->mutex, &deadline);
         }
+        pri_queue->waiters--;
+    }
 
     /* 队列中有元素，取出 */
-    } else if (pri_queue->heap->cur_size > 0) {
-        *pdata = __heap_pop(pri_queue->heap);
-    } else {
-        *pdata = NULL;
-        retval = UT_ERRNO_UNKNOWN;
+    while (pri_queue->bucketed && popped < max && pri_queue->bucket->cur_size > 0) {
+        heap_element_t  elem;
+
+        if (__bucket_pop(pri_queue->bucket, &elem) != UT_ERRNO_OK) {
+            break;
+        }
+        if (keys != NULL) {
+            keys[popped] = elem.key;
+        }
+        out[popped++] = elem.data;
+    }
+    while (!pri_queue->bucketed && popped < max && pri_queue->heap->cur_size > 0) {
+        if (keys != NULL) {
+            keys[popped] = pri_queue->heap->heap_mem[HEAP_ROOT(pri_queue->heap)].key;
+        }
+        if (pri_queue->bounded) {
+            out[popped++] = __minmax_pop(pri_queue->heap).data;
+        } else {
+            out[popped++] = __heap_pop(pri_queue->heap);
+        }
     }
 
-    pthread_mutex_unlock(&pri_queue->mutex);
+    QUEUE_UNLOCK_PUBLISH(pri_queue);
 
-    return retval;
+    return popped;
+}
+
+/**
+ * 队列为空时在加锁等待之前短暂自旋，等到元素时可以省去一次睡眠和唤醒。
+ * 自旋的上限跟随最近成功自旋所用的次数调整，长时间等不到元素时逐渐减少自旋
+ * @param [in] pri_queue 优先级队列
+ */
+static void __queue_spin(ut_pri_queue_t *pri_queue)
+{
+    uint32_t    avg = __atomic_load_n(&pri_queue->spin_avg, __ATOMIC_RELAXED);
+    uint32_t    limit = avg * 2 < QUEUE_SPIN_MAX ? avg * 2 : QUEUE_SPIN_MAX;
+    uint32_t    spins = 0;
+
+    /* 不加锁读取元素数量只是一个提示，取元素之前会在锁内重新检查 */
+    for (spins = 0; spins < limit; spins++) {
+        if (__atomic_load_n(&pri_queue->count, __ATOMIC_RELAXED) > 0) {
+            break;
+        }
+        QUEUE_CPU_RELAX();
+    }
+
+    if (spins < limit) {
+        avg += ((int32_t)spins - (int32_t)avg) / 8;
+    } else {
+        avg /= 2;
+    }
+    if (avg < QUEUE_SPIN_MIN) {
+        avg = QUEUE_SPIN_MIN;
+    }
+    __atomic_store_n(&pri_queue->spin_avg, avg, __ATOMIC_RELAXED);
 }
 
 /**
  * 将数据存入堆中
  * @param [in] heap 堆指针
  * @param [in] data 存入的数据
+ * @param [in] key 整数键队列的优先级
+ * @param [out] handle 跟踪句柄时传出元素的句柄序号
  * @retval ut_errno_t 
  */
-static ut_errno_t __heap_push(inn_heap_t *heap, void* data)
+ut_errno_t __heap_push(inn_heap_t *heap, void* data, int64_t key, uint32_t *handle)
 {
-    ut_errno_t     retval = UT_ERRNO_OK;
-    heap_element_t  *new_elem = NULL;
+    ut_errno_t      retval = UT_ERRNO_OK;
+    heap_element_t  elem;
+    uint32_t        id = HEAP_NO_HANDLE;
 
     if (heap->cur_size >= heap->max_size) {
         retval = UT_ERRNO_RESOURCE;
         goto _out;
     }
 
-    /* 将数据放入堆，只能放在堆的底部。第0个不使用 */
-    new_elem = ut_zero_alloc(sizeof(heap_element_t));
-    if (new_elem == NULL) {
-        retval = UT_ERRNO_OUTOFMEM;
-        goto _out;
+    /* 将数据放入堆，只能放在堆的底部 */
+    elem.data = data;
+    elem.key = key;
+    if (heap->tracked) {
+        id = __heap_handle_alloc(heap);
     }
-    new_elem->data = data;
-    heap->cur_size++;   /* 先让堆当前大小+1保证首个元素不使用 */
-    heap->heap_mem[heap->cur_size] = new_elem;  /* 将新增的元素放在堆底部 */
+    heap->cur_size++;
+    __heap_place(heap, HEAP_TAIL(heap), elem, id);  /* 将新增的元素放在堆底部 */
 
     /* 对新放入在堆底部的元素进行上浮排序 */
-    __heap_sort(heap, heap->cur_size);
+    __heap_sort(heap, HEAP_TAIL(heap));
+    if (handle != NULL) {
+        *handle = id;
+    }
 
 _out:
     return retval;
 }
 
+/**
+ * 将一批数据存入堆中，调用者保证堆的容量足够
+ * @param [in] heap 堆指针
+ * @param [in] datas 存入的数据
+ * @param [in] num 数据的个数
+ */
+void __heap_push_n(inn_heap_t *heap, void* const datas[], uint32_t num)
+{
+    uint32_t        old_size = heap->cur_size;
+    heap_element_t  elem;
+
+    for (uint32_t i = 0; i < num; i++) {
+        elem.data = datas[i];
+        elem.key = 0;
+        __heap_place(heap, HEAP_TAIL(heap) + 1 + i, elem, heap->tracked ? __heap_handle_alloc(heap) : HEAP_NO_HANDLE);
+    }
+    heap->cur_size += num;
+
+    /* 批量不大时逐个上浮，每个元素平均只需要很少的比较 */
+    if (num < old_size) {
+        for (uint32_t i = HEAP_TAIL(heap) - num + 1; i <= HEAP_TAIL(heap); i++) {
+            __heap_sort(heap, i);
+        }
+        return;
+    }
+
+    /* 批量比原有的堆还大时，自底向上（Floyd）重建整个堆，代价为O(n) */
+    for (uint32_t i = HEAP_PARENT(heap, HEAP_TAIL(heap)) + 1; i-- > HEAP_ROOT(heap); ) {
+        __heap_sift_down(heap, i, heap->heap_mem[i], HEAP_HANDLE_AT(heap, i));
+    }
+}
+
+/**
+ * 重新申请按缓存行对齐的堆内存，保留原有的元素
+ * @param [in] heap 堆指针
+ * @param [in] max_size 新的堆最大的大小
+ * @retval ut_errno_t 
+ */
+ut_errno_t __heap_resize(inn_heap_t *heap, uint32_t max_size)
+{
+    heap_element_t* new_mem = NULL;
+    size_t          slots = (size_t)max_size + heap->arity - 1;
+
+    /* 句柄表和堆内存一起扩容，先扩容句柄表，失败时堆保持原样 */
+    if (heap->tracked) {
+        uint32_t*       new_slot_handle = NULL;
+        heap_handle_t*  new_handles = NULL;
+
+        new_slot_handle = realloc(heap->slot_handle, slots * sizeof(uint32_t));
+        if (new_slot_handle == NULL) {
+            return UT_ERRNO_OUTOFMEM;
+        }
+        heap->slot_handle = new_slot_handle;
+        new_handles = realloc(heap->handles, (size_t)max_size * sizeof(heap_handle_t));
+        if (new_handles == NULL) {
+            return UT_ERRNO_OUTOFMEM;
+        }
+        heap->handles = new_handles;
+    }
+
+    /* 前arity-1个元素不使用，保证每组子节点的起始位置按缓存行对齐 */
+    if (posix_memalign((void**)&new_mem, HEAP_CACHE_LINE, slots * sizeof(heap_element_t)) != 0) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    if (heap->heap_mem != NULL) {
+        memcpy(new_mem, heap->heap_mem, ((size_t)heap->cur_size + heap->arity - 1) * sizeof(heap_element_t));
+        free(heap->heap_mem);
+    } else {
+        heap->handle_free = HEAP_NO_HANDLE;
+    }
+    heap->heap_mem = new_mem;
+
+    /* 新增的句柄加入空闲链表 */
+    if (heap->tracked) {
+        for (uint32_t i = max_size; i-- > heap->max_size; ) {
+            heap->handles[i].gen = 1;
+            heap->handles[i].pos = heap->handle_free;
+            heap->handle_free = i;
+        }
+    }
+    heap->max_size = max_size;
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 将堆的容量扩大为原来的2倍
+ * @param [in] heap 堆指针
+ * @retval ut_errno_t 
+ */
+ut_errno_t __heap_grow(inn_heap_t *heap)
+{
+    uint32_t        new_size = heap->max_size * 2;
+
+    if (new_size <= heap->max_size || new_size > INT32_MAX) {
+        return UT_ERRNO_RESOURCE;
+    }
+
+    return __heap_resize(heap, new_size);
+}
+
+/**
+ * 释放堆内存和句柄表
+ * @param [in] heap 堆指针
+ */
+void __heap_free(inn_heap_t *heap)
+{
+    free(heap->heap_mem);
+    free(heap->slot_handle);
+    free(heap->handles);
+    heap->heap_mem = NULL;
+    heap->slot_handle = NULL;
+    heap->handles = NULL;
+}
+
+/**
+ * 从空闲链表中取出一个句柄，句柄表与堆的容量相同，因此总是能取到
+ */
+static uint32_t __heap_handle_alloc(inn_heap_t *heap)
+{
+    uint32_t    id = heap->handle_free;
+
+    heap->handle_free = heap->handles[id].pos;
+    return id;
+}
+
+/**
+ * 释放句柄，代数加1使外部持有的旧句柄失效
+ */
+static void __heap_handle_release(inn_heap_t *heap, uint32_t handle)
+{
+    heap->handles[handle].gen++;
+    if (heap->handles[handle].gen == 0) {
+        heap->handles[handle].gen = 1;
+    }
+    heap->handles[handle].pos = heap->handle_free;
+    heap->handle_free = handle;
+}
+
 /**
  * 查看堆顶部元素
  * @param [in] heap 堆指针
  * @return 存入堆时存放的数据
  */
-static void* __heap_peek(inn_heap_t *heap)
+void* __heap_peek(inn_heap_t *heap)
 {
-    return heap->heap_mem[1];
+    return heap->heap_mem[HEAP_ROOT(heap)].data;
 }
 
 /**
@@ -290,105 +933,155 @@ static void* __heap_peek(inn_heap_t *heap)
  * @param [in] heap 堆指针
  * @return 存入堆时存放的数据
  */
-static void* __heap_pop(inn_heap_t *heap)
+void* __heap_pop(inn_heap_t *heap)
 {
     /* pop就是移除堆的第一个数据 */
-    return __heap_remove(heap, 1);
+    return __heap_remove(heap, HEAP_ROOT(heap));
 }
 
 /**
  * 移除堆中指定位置的元素
  * @param [in] heap 堆指针
- * @param [in] index 移除堆中数据的序号
+ * @param [in] index 移除堆中数据的位置
  * @return 
  */
-static void* __heap_remove(inn_heap_t *heap, int32_t index)
-{
-    void*        data = NULL;
-    heap_element_t  *removed_elem = NULL;   /* 要被移除掉的元素 */
-    heap_element_t  *tail_elem = NULL;      /* 尾部的元素 */
-    int32_t      cur_pos_index = 0;      /* 当前节点的序号 */
-    int32_t      tail_parent_index = 0;  /* 尾部元素的父节点的序号 */
-    int32_t      left_child_index = 0;   /* 左子节点的序号 */
-    int32_t      right_child_index = 0;  /* 右子节点的序号 */
-    int32_t      winner_index = 0;       /* 左右子节点中大者的序号 */
-
-    if (!heap->cur_size || index > heap->cur_size || index <= 0) {  /* 堆空间的首个内存不使用，为空！ */
+void* __heap_remove(inn_heap_t *heap, uint32_t index)
+{
+    void*           data = NULL;
+    heap_element_t  tail_elem;              /* 尾部的元素 */
+    uint32_t        tail_handle = 0;        /* 尾部元素的句柄 */
+    uint32_t        cur_pos_index = 0;      /* 尾部元素最终存放的位置 */
+
+    if (!heap->cur_size || index > HEAP_TAIL(heap) || index < HEAP_ROOT(heap)) {
         goto _out;
     }
 
-    removed_elem = heap->heap_mem[index];       /* 保存记录堆中指定序号的元素 */
-    tail_elem = heap->heap_mem[heap->cur_size]; /* 保存记录堆中最后一个元素 */
-    heap->heap_mem[heap->cur_size] = NULL;      /* 删除堆中最后一个元素 */
+    data = heap->heap_mem[index].data;  /* 取出数据 */
+    if (heap->tracked) {
+        __heap_handle_release(heap, heap->slot_handle[index]);
+    }
+    tail_elem = heap->heap_mem[HEAP_TAIL(heap)];    /* 保存记录堆中最后一个元素 */
+    tail_handle = HEAP_HANDLE_AT(heap, HEAP_TAIL(heap));
     heap->cur_size--;
-    tail_parent_index = heap->cur_size / 2;
-    cur_pos_index = index;
-
-    /* 循环运行到当前节点已经到达二叉树的最后一层 */
-    while (cur_pos_index <= tail_parent_index) {
-        left_child_index = cur_pos_index * 2;
-        right_child_index = left_child_index + 1;
-
-        /* 获取左右子节点中的大者 */
-        winner_index = left_child_index;
-        if (left_child_index != heap->cur_size) {   /* 检查左子节点是不是堆中的最后一个 */
-            /* 左子节点不是堆中的最后一个，那么右子节点一定存在，比较两者大小 */
-            if (heap->elem_compare_cb(heap->heap_mem[right_child_index]->data, heap->heap_mem[left_child_index]->data)) {
-                winner_index = right_child_index;
-            }
-        }
+    if (index > HEAP_TAIL(heap)) {  /* 移除的就是堆尾元素，不需要调整 */
+        goto _out;
+    }
+
+    /* 将尾部节点从移除的位置开始下沉，移除的不是堆顶时该节点还可能需要上浮 */
+    cur_pos_index = __heap_sift_down(heap, index, tail_elem, tail_handle);
+    __heap_sort(heap, cur_pos_index);
+
+_out:
+    return data;
+}
+
+/**
+ * 位置index上的数据的优先级发生了变化，重新调整它在堆中的位置
+ * @param [in] heap 堆指针
+ * @param [in] index 数据在堆中的位置
+ */
+void __heap_update(inn_heap_t *heap, uint32_t index)
+{
+    /* 优先级提高时上浮，没有上浮说明优先级可能降低，再尝试下沉 */
+    if (__heap_sort(heap, index) == index) {
+        __heap_sift_down(heap, index, heap->heap_mem[index], HEAP_HANDLE_AT(heap, index));
+    }
+}
 
-        /* 将左右子节点中的大者与堆尾元素进行比较大小，如果大者并不比堆尾元素大，那就说明此时左右子节点已经是完全二叉树的最后一层，退出 */
-        if (heap->elem_compare_cb(tail_elem->data, heap->heap_mem[winner_index]->data)) {
+/**
+ * 从index位置开始将elem下沉，直到子节点的优先级都不比elem高为止，index位置原有的元素会被覆盖
+ * @param [in] heap 堆指针
+ * @param [in] index 开始下沉的位置
+ * @param [in] elem 下沉的元素
+ * @param [in] handle 下沉的元素的句柄
+ * @return 元素最终存放的位置
+ */
+static uint32_t __heap_sift_down(inn_heap_t *heap, uint32_t index, heap_element_t elem, uint32_t handle)
+{
+    heap_element_t* mem = heap->heap_mem;
+    uint32_t        tail_index = HEAP_TAIL(heap);
+    uint32_t        cur_pos_index = index;  /* 当前节点的位置 */
+    uint32_t        child_index = 0;        /* 第一个子节点的位置 */
+    uint32_t        child_end = 0;          /* 最后一个子节点之后的位置 */
+    uint32_t        winner_index = 0;       /* 子节点中优先级最高者的位置 */
+
+    /* 循环运行到当前节点已经没有子节点 */
+    FOREVER {
+        child_index = HEAP_CHILD(heap, cur_pos_index);
+        if (child_index > tail_index) {
             break;
         }
+        child_end = child_index + heap->arity;
+        if (child_end > tail_index + 1) {
+            child_end = tail_index + 1;
+        }
 
-        /* 如果左右子节点未到达完全二叉树的最后一层，将两者中的大者与当前位置即父节点进行位置交换。
-           因为父节点已经保存在select_elem中，因此只要将左右子节点中大者复制到父节点内即可。 */
-        heap->heap_mem[cur_pos_index] = heap->heap_mem[winner_index];
+        /* 子节点连续存放在同一个缓存行中，依次比较找出优先级最高者 */
+        winner_index = child_index;
+        if (heap->elem_compare_cb == NULL) {
+            /* 整数键直接比较，选择结果用条件传送代替分支 */
+            int64_t     winner_key = mem[child_index].key;
 
-        /* 经过一趟循环，相当于将需要移除的节点在二叉树中将往下移动了一层，继续进行这种操作 */
-        cur_pos_index = winner_index;
-    }
+            for (uint32_t i = child_index + 1; i < child_end; i++) {
+                ut_bool_t   less = mem[i].key < winner_key;
+
+                winner_index = less ? i : winner_index;
+                winner_key = less ? mem[i].key : winner_key;
+            }
+            if (elem.key <= winner_key) {
+                break;
+            }
+        } else {
+            for (uint32_t i = child_index + 1; i < child_end; i++) {
+                if (heap->elem_compare_cb(mem[i].data, mem[winner_index].data)) {
+                    winner_index = i;
+                }
+            }
 
-    /* 此时需要删除的节点已经下沉到最末端的节点相同/相邻的层，已经不需要再进行下沉操作了，此时将尾部节点存入当前下沉到的位置 */
-    heap->heap_mem[cur_pos_index] = tail_elem;
-    __heap_sort(heap, cur_pos_index);   /* 对存入的节点进行一次上浮排序 */
+            /* 子节点中的优先级最高者不比下沉的元素高，放在当前位置即可 */
+            if (heap->elem_compare_cb(elem.data, mem[winner_index].data)) {
+                break;
+            }
+        }
 
-    data = removed_elem->data;  /* 取出数据 */
-    free(removed_elem);      /* 释放内存！！该内存是在push的时候申请的！！ */
+        /* 将子节点中优先级最高者移动到当前位置，需要移除的节点在树中往下移动一层 */
+        __heap_place(heap, cur_pos_index, mem[winner_index], HEAP_HANDLE_AT(heap, winner_index));
+        cur_pos_index = winner_index;
+    }
 
-_out:
-    return data;
+    __heap_place(heap, cur_pos_index, elem, handle);
+    return cur_pos_index;
 }
 
 /**
  * 对堆中index位置的数据进行一次上浮排序，直到不能上浮或上浮到根节点为止
  * @param [in] heap 堆指针
- * @param [in] index 数据在堆中的序号
- * @return 成功返回
+ * @param [in] index 数据在堆中的位置
+ * @return 数据最终存放的位置
  */
-static void __heap_sort(inn_heap_t *heap, int32_t index)
+uint32_t __heap_sort(inn_heap_t *heap, uint32_t index)
 {
-    int32_t      parent_index = 0;
-    heap_element_t* tmp_element = NULL;
-
-    tmp_element = heap->heap_mem[index];    /* 保存当前节点信息 */
-
-    /* 上浮排序，比较第index节点和其父节点的大小，如果index节点大于其父节点，交换两者位置，循环进行直到根节点或index小于其父节点 */
-    while (index > 1) {
-        parent_index = index / 2;
-        if (heap->elem_compare_cb(heap->heap_mem[parent_index]->data, heap->heap_mem[index]->data)) {
-            break;    /* index元素小于父节点元素，排序停止 */
+    uint32_t        parent_index = 0;
+    heap_element_t  tmp_element;
+    uint32_t        tmp_handle = 0;
+    heap_element_t* mem = heap->heap_mem;
+
+    tmp_element = mem[index];    /* 保存当前节点信息 */
+    tmp_handle = HEAP_HANDLE_AT(heap, index);
+
+    /* 上浮排序，比较第index节点和其父节点的优先级，如果index节点更高，交换两者位置，循环进行直到根节点或index不高于其父节点 */
+    while (index > HEAP_ROOT(heap)) {
+        parent_index = HEAP_PARENT(heap, index);
+        if (__heap_higher(heap, &mem[parent_index], &tmp_element)) {
+            break;
         }
-        
+
         /* 由于已经保存了最初节点信息，仅需将父节点信息移动下来即可 */
-        heap->heap_mem[index] = heap->heap_mem[parent_index];
+        __heap_place(heap, index, mem[parent_index], HEAP_HANDLE_AT(heap, parent_index));
         index = parent_index;
     }
 
     /* 上浮结束，将初始节点放置下来 */
-    heap->heap_mem[index] = tmp_element;
-
-    return ;
-}
\ No newline at end of file
+    __heap_place(heap, index, tmp_element, tmp_handle);
+    return index;
+}
@@ -0,0 +1,336 @@
+/**
+ * @file ut_pri_queue_bucket.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 整数键优先级队列的两种桶式引擎，元素按键分散在若干个桶中，不需要堆的比较和交换：
+ *        基数堆：键只增不减（如定时器的超时时间）时使用，入队O(1)，出队均摊O(1)；
+ *        桶队列：键是范围很小的整数（如几个固定的优先级）时使用，入队出队都是O(1)，同一优先级内先进先出。
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "ut_pri_queue_inn.h"
+
+/* 有符号的键映射为无符号数，保持大小顺序 */
+#define RADIX_KEY(key)      ((uint64_t)(key) ^ ((uint64_t)1 << 63))
+
+static ut_errno_t __radix_reserve(radix_vec_t *vec, uint32_t num);
+static uint32_t __radix_index(const inn_bucket_t *bucket, uint64_t key);
+static ut_errno_t __radix_settle(inn_bucket_t *bucket);
+
+/**
+ * 初始化基数堆或桶队列
+ * @param [in] bucket 引擎指针，必须已经清零
+ * @param [in] max_size 最多存放的元素个数
+ * @param [in] levels 桶队列优先级的个数，键的范围是[0, levels)；为0时初始化为基数堆
+ * @retval ut_errno_t 
+ */
+ut_errno_t __bucket_init(inn_bucket_t *bucket, uint32_t max_size, uint32_t levels)
+{
+    bucket->radix = levels == 0 ? UT_TRUE : UT_FALSE;
+    bucket->node_free = BUCKET_NIL;
+
+    /* 基数堆的桶按需申请，最初的基准是最小的键 */
+    if (bucket->radix) {
+        bucket->levels = RADIX_BUCKETS;
+        bucket->last = 0;
+        bucket->max_size = max_size;
+        bucket->vecs = calloc(RADIX_BUCKETS, sizeof(radix_vec_t));
+        return bucket->vecs == NULL ? UT_ERRNO_OUTOFMEM : UT_ERRNO_OK;
+    }
+
+    bucket->levels = levels;
+    bucket->lists = malloc((size_t)levels * sizeof(bucket_list_t));
+    if (bucket->lists == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    for (uint32_t i = 0; i < levels; i++) {
+        bucket->lists[i].head = BUCKET_NIL;
+        bucket->lists[i].tail = BUCKET_NIL;
+    }
+
+    return __bucket_resize(bucket, max_size);
+}
+
+/**
+ * 扩大容量。桶队列的节点之间使用下标链接，扩容节点池时不需要修改链表
+ * @param [in] bucket 引擎指针
+ * @param [in] max_size 新的最大元素个数
+ * @retval ut_errno_t 
+ */
+ut_errno_t __bucket_resize(inn_bucket_t *bucket, uint32_t max_size)
+{
+    bucket_node_t*  new_nodes = NULL;
+
+    if (bucket->radix) {
+        bucket->max_size = max_size;
+        return UT_ERRNO_OK;
+    }
+
+    new_nodes = realloc(bucket->nodes, (size_t)max_size * sizeof(bucket_node_t));
+    if (new_nodes == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    bucket->nodes = new_nodes;
+
+    /* 新增的节点加入空闲链表 */
+    for (uint32_t i = max_size; i-- > bucket->max_size; ) {
+        bucket->nodes[i].next = bucket->node_free;
+        bucket->node_free = i;
+    }
+    bucket->max_size = max_size;
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 将容量扩大为原来的2倍
+ * @param [in] bucket 引擎指针
+ * @retval ut_errno_t 
+ */
+ut_errno_t __bucket_grow(inn_bucket_t *bucket)
+{
+    uint32_t        new_size = bucket->max_size * 2;
+
+    if (new_size <= bucket->max_size || new_size > INT32_MAX) {
+        return UT_ERRNO_RESOURCE;
+    }
+
+    return __bucket_resize(bucket, new_size);
+}
+
+/**
+ * 释放引擎申请的内存
+ * @param [in] bucket 引擎指针
+ */
+void __bucket_free(inn_bucket_t *bucket)
+{
+    if (bucket->vecs != NULL) {
+        for (uint32_t i = 0; i < RADIX_BUCKETS; i++) {
+            free(bucket->vecs[i].elems);
+        }
+    }
+    free(bucket->vecs);
+    free(bucket->nodes);
+    free(bucket->lists);
+    bucket->vecs = NULL;
+    bucket->nodes = NULL;
+    bucket->lists = NULL;
+}
+
+/**
+ * 存入一个元素
+ * @param [in] bucket 引擎指针
+ * @param [in] data 存入的数据
+ * @param [in] key 优先级
+ * @retval ut_errno_t 已满返回UT_ERRNO_RESOURCE；
+ *         桶队列的键超出范围、基数堆的键小于最近一次取出的键时返回UT_ERRNO_INVALID
+ */
+ut_errno_t __bucket_push(inn_bucket_t *bucket, void* data, int64_t key)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+    uint32_t        node = 0;
+    uint32_t        index = 0;
+    bucket_list_t*  list = NULL;
+    heap_element_t  elem = {data, key};
+
+    if (bucket->radix) {
+        if (RADIX_KEY(key) < bucket->last) {
+            return UT_ERRNO_INVALID;
+        }
+        if (bucket->cur_size >= bucket->max_size) {
+            return UT_ERRNO_RESOURCE;
+        }
+        index = __radix_index(bucket, RADIX_KEY(key));
+        retval = __radix_reserve(&bucket->vecs[index], 1);
+        if (retval == UT_ERRNO_OK) {
+            bucket->vecs[index].elems[bucket->vecs[index].size++] = elem;
+            if (index > 0) {
+                bucket->nonempty |= (uint64_t)1 << (index - 1);
+            }
+            bucket->cur_size++;
+        }
+        return retval;
+    }
+
+    if (key < 0 || key >= bucket->levels) {
+        return UT_ERRNO_INVALID;
+    }
+    if (bucket->node_free == BUCKET_NIL) {
+        return UT_ERRNO_RESOURCE;
+    }
+
+    /* 追加到链表尾部，同一优先级先进先出 */
+    node = bucket->node_free;
+    bucket->node_free = bucket->nodes[node].next;
+    bucket->nodes[node].elem = elem;
+    bucket->nodes[node].next = BUCKET_NIL;
+    list = &bucket->lists[key];
+    if (list->tail == BUCKET_NIL) {
+        list->head = node;
+    } else {
+        bucket->nodes[list->tail].next = node;
+    }
+    list->tail = node;
+
+    /* 记录可能不为空的最小优先级，出队时从这里向后查找 */
+    if (key < bucket->first) {
+        bucket->first = (uint32_t)key;
+    }
+    bucket->cur_size++;
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 查看优先级最高的元素，队列不能为空。基数堆不会因此调整基准，之后仍然可以存入不小于最近一次取出的键
+ * @param [in] bucket 引擎指针
+ * @return const heap_element_t* 优先级最高的元素
+ */
+const heap_element_t* __bucket_peek(inn_bucket_t *bucket)
+{
+    if (bucket->radix) {
+        radix_vec_t*    vec = &bucket->vecs[0];
+        uint32_t        top = 0;
+
+        if (vec->size > 0) {
+            return &vec->elems[vec->size - 1];
+        }
+
+        /* 最小的键在第一个不为空的桶中 */
+        vec = &bucket->vecs[__builtin_ctzll(bucket->nonempty) + 1];
+        for (uint32_t i = 1; i < vec->size; i++) {
+            if (RADIX_KEY(vec->elems[i].key) < RADIX_KEY(vec->elems[top].key)) {
+                top = i;
+            }
+        }
+        return &vec->elems[top];
+    }
+
+    while (bucket->lists[bucket->first].head == BUCKET_NIL) {
+        bucket->first++;
+    }
+    return &bucket->nodes[bucket->lists[bucket->first].head].elem;
+}
+
+/**
+ * 取出优先级最高的元素，队列不能为空
+ * @param [in] bucket 引擎指针
+ * @param [out] elem 取出的元素
+ * @retval ut_errno_t 基数堆重新分配桶时申请不到内存返回UT_ERRNO_OUTOFMEM
+ */
+ut_errno_t __bucket_pop(inn_bucket_t *bucket, heap_element_t *elem)
+{
+    bucket_list_t*          list = NULL;
+    uint32_t                node = 0;
+
+    if (bucket->radix) {
+        if (__radix_settle(bucket) != UT_ERRNO_OK) {
+            return UT_ERRNO_OUTOFMEM;
+        }
+
+        /* 0号桶中的键都等于基准，从尾部取出即可 */
+        *elem = bucket->vecs[0].elems[--bucket->vecs[0].size];
+    } else {
+        *elem = *__bucket_peek(bucket);
+        list = &bucket->lists[bucket->first];
+        node = list->head;
+        list->head = bucket->nodes[node].next;
+        if (list->head == BUCKET_NIL) {
+            list->tail = BUCKET_NIL;
+        }
+        bucket->nodes[node].next = bucket->node_free;
+        bucket->node_free = node;
+    }
+    bucket->cur_size--;
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 保证基数堆的桶至少还能放下num个元素，空间按2倍扩大
+ */
+static ut_errno_t __radix_reserve(radix_vec_t *vec, uint32_t num)
+{
+    uint32_t            new_cap = vec->cap == 0 ? RADIX_VEC_MIN : vec->cap;
+    heap_element_t*     new_elems = NULL;
+
+    if (vec->cap - vec->size >= num) {
+        return UT_ERRNO_OK;
+    }
+    while (new_cap - vec->size < num) {
+        new_cap *= 2;
+    }
+    new_elems = realloc(vec->elems, (size_t)new_cap * sizeof(heap_element_t));
+    if (new_elems == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    vec->elems = new_elems;
+    vec->cap = new_cap;
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 基数堆中键所在的桶：与基准相同的放在0号桶，否则按与基准不同的最高位放在1~64号桶，越靠前的桶中的键越小
+ */
+static uint32_t __radix_index(const inn_bucket_t *bucket, uint64_t key)
+{
+    uint64_t    diff = key ^ bucket->last;
+
+    return diff == 0 ? 0 : 64 - __builtin_clzll(diff);
+}
+
+/**
+ * 0号桶为空时，找到第一个不为空的桶，以其中最小的键作为新的基准，把整个桶重新分配到更靠前的桶中。
+ * 每个元素在被取出之前最多被重新分配64次，出队均摊O(1)
+ * @retval ut_errno_t 目标桶申请不到内存时返回UT_ERRNO_OUTOFMEM，基数堆保持原样
+ */
+static ut_errno_t __radix_settle(inn_bucket_t *bucket)
+{
+    radix_vec_t*    vec = NULL;
+    uint64_t        min = UINT64_MAX;
+    uint64_t        old_last = bucket->last;
+    uint32_t        index = 0;
+    uint32_t        counts[RADIX_BUCKETS] = {0};
+
+    if (bucket->vecs[0].size > 0) {
+        return UT_ERRNO_OK;
+    }
+
+    index = __builtin_ctzll(bucket->nonempty) + 1;
+    vec = &bucket->vecs[index];
+    for (uint32_t i = 0; i < vec->size; i++) {
+        if (RADIX_KEY(vec->elems[i].key) < min) {
+            min = RADIX_KEY(vec->elems[i].key);
+        }
+    }
+
+    /* 桶中的键与新基准的最高不同位一定低于index，而前面的桶都是空的，先一次申请好目标桶的空间 */
+    bucket->last = min;
+    for (uint32_t i = 0; i < vec->size; i++) {
+        counts[__radix_index(bucket, RADIX_KEY(vec->elems[i].key))]++;
+    }
+    for (uint32_t i = 0; i < index; i++) {
+        if (__radix_reserve(&bucket->vecs[i], counts[i]) != UT_ERRNO_OK) {
+            bucket->last = old_last;
+            return UT_ERRNO_OUTOFMEM;
+        }
+    }
+
+    for (uint32_t i = 0; i < vec->size; i++) {
+        heap_element_t  elem = vec->elems[i];
+        uint32_t        target = __radix_index(bucket, RADIX_KEY(elem.key));
+
+        bucket->vecs[target].elems[bucket->vecs[target].size++] = elem;
+        if (target > 0) {
+            bucket->nonempty |= (uint64_t)1 << (target - 1);
+        }
+    }
+    vec->size = 0;
+    bucket->nonempty &= ~((uint64_t)1 << (index - 1));
+
+    return UT_ERRNO_OK;
+}
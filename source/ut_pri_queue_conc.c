@@ -0,0 +1,382 @@
+/**
+ * @file ut_pri_queue_conc.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 线程安全的优先级队列（MultiQueue）。
+ *        每个分片是一个由互斥锁保护的堆，入队随机选择一个空闲的分片；出队随机选择两个分片，
+ *        比较两者的堆顶后从优先级更高的一个取出，两者都为空时依次查找其他分片。
+ *        元素总数单独计数，消费者只有在队列为空时才会在条件变量上等待，生产者只在有等待者时唤醒一个
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "ut/ut_pri_queue_conc.h"
+#include "ut_pri_queue_inn.h"
+
+#define CONC_POP_ATTEMPTS       4       /* 随机选择两个分片的尝试次数，之后按顺序查找所有分片 */
+#define CONC_MIN_SHARD_SIZE     16
+
+#define CONC_LOAD(ptr)          __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define CONC_STORE(ptr, val)    __atomic_store_n((ptr), (val), __ATOMIC_RELAXED)
+
+typedef struct conc_heap_shard {
+    pthread_mutex_t lock;       /* 分片锁 */
+    uint32_t count;             /* 分片内元素数量，不加锁读取，用于跳过空的分片 */
+    inn_heap_t heap;            /* 分片的堆 */
+} __attribute__((aligned(HEAP_CACHE_LINE))) conc_heap_shard_t;
+
+struct pri_queue_conc {
+    conc_heap_shard_t* shards;  /* 分片数组 */
+    uint32_t nshards;           /* 分片数量 */
+    ut_pri_comp_func compare;   /* 优先级比较 */
+    pthread_mutex_t wait_lock;  /* 等待队列非空的消费者使用 */
+    pthread_cond_t wait_cond;
+    int32_t count __attribute__((aligned(HEAP_CACHE_LINE)));   /* 元素总数 */
+    uint32_t waiters;           /* 正在等待的消费者数量 */
+};
+
+
+/**
+ * @brief 线程私有的随机数（xorshift64*），用于选择分片
+ */
+static inline uint32_t __conc_random(uint32_t range)
+{
+    static __thread uint64_t    state = 0;
+
+    if (state == 0) {
+        state = (uint64_t)(uintptr_t)&state ^ ((uint64_t)time(NULL) << 32) ^ 0x9e3779b97f4a7c15ULL;
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)(((state * 0x2545f4914f6cdd1dULL) >> 32) * range >> 32);
+}
+
+/**
+ * @brief 从已经加锁的分片中取出堆顶
+ */
+static inline void* __shard_pop_locked(conc_heap_shard_t *shard)
+{
+    void*   data = __heap_pop(&shard->heap);
+
+    CONC_STORE(&shard->count, shard->heap.cur_size);
+    return data;
+}
+
+/**
+ * @brief 从一个分片中取出堆顶，分片为空返回NULL
+ */
+static void* __shard_pop(conc_heap_shard_t *shard)
+{
+    void*   data = NULL;
+
+    if (CONC_LOAD(&shard->count) == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&shard->lock);
+    if (shard->heap.cur_size > 0) {
+        data = __shard_pop_locked(shard);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return data;
+}
+
+/**
+ * @brief 比较两个分片的堆顶，取出优先级更高的一个
+ */
+static void* __shard_pop_two(ut_pri_queue_conc_t *pri_queue, uint32_t first, uint32_t second)
+{
+    conc_heap_shard_t*  a = NULL;
+    conc_heap_shard_t*  b = NULL;
+    void*               data = NULL;
+
+    /* 按分片序号加锁，避免两个消费者互相等待 */
+    if (first > second) {
+        uint32_t    tmp = first;
+
+        first = second;
+        second = tmp;
+    }
+    a = &pri_queue->shards[first];
+    b = &pri_queue->shards[second];
+
+    if (CONC_LOAD(&a->count) == 0) {
+        return __shard_pop(b);
+    }
+    if (CONC_LOAD(&b->count) == 0) {
+        return __shard_pop(a);
+    }
+
+    pthread_mutex_lock(&a->lock);
+    pthread_mutex_lock(&b->lock);
+    if (a->heap.cur_size == 0) {
+        if (b->heap.cur_size > 0) {
+            data = __shard_pop_locked(b);
+        }
+    } else if (b->heap.cur_size == 0) {
+        data = __shard_pop_locked(a);
+    } else if (pri_queue->compare(__heap_peek(&b->heap), __heap_peek(&a->heap))) {
+        data = __shard_pop_locked(b);
+    } else {
+        data = __shard_pop_locked(a);
+    }
+    pthread_mutex_unlock(&b->lock);
+    pthread_mutex_unlock(&a->lock);
+
+    return data;
+}
+
+/**
+ * @brief 不等待地取出一个元素
+ */
+static void* __conc_try_pop(ut_pri_queue_conc_t *pri_queue)
+{
+    void*       data = NULL;
+    uint32_t    nshards = pri_queue->nshards;
+    uint32_t    start = 0;
+
+    if (__atomic_load_n(&pri_queue->count, __ATOMIC_SEQ_CST) <= 0) {
+        return NULL;
+    }
+
+    if (nshards > 1) {
+        for (int32_t i = 0; i < CONC_POP_ATTEMPTS && data == NULL; i++) {
+            uint32_t    first = __conc_random(nshards);
+            uint32_t    second = __conc_random(nshards - 1);
+
+            /* second取[0, nshards-1)，跳过first保证两个分片不同 */
+            if (second >= first) {
+                second++;
+            }
+            data = __shard_pop_two(pri_queue, first, second);
+        }
+    }
+
+    /* 随机选择的分片都为空，元素集中在少数分片上，依次查找 */
+    start = __conc_random(nshards);
+    for (uint32_t i = 0; i < nshards && data == NULL; i++) {
+        data = __shard_pop(&pri_queue->shards[(start + i) % nshards]);
+    }
+
+    if (data != NULL) {
+        __atomic_sub_fetch(&pri_queue->count, 1, __ATOMIC_SEQ_CST);
+    }
+    return data;
+}
+
+/**
+ * 
+ * @param [in] pri_queue 优先级队列
+ * @param [out] pdata 二级指针，取出数据
+ * @param [in] timeout 超时时间，毫秒（ms），-1表示一直等待
+ * @retval ut_errno_t 
+ */
+static ut_errno_t __conc_pop(ut_pri_queue_conc_t *pri_queue, void* *pdata, int32_t timeout)
+{
+    struct timespec deadline;
+    int             ret = 0;
+
+    if (timeout > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000 * 1000;
+        if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000 * 1000 * 1000;
+        }
+    }
+
+    FOREVER {
+        *pdata = __conc_try_pop(pri_queue);
+        if (*pdata != NULL) {
+            return UT_ERRNO_OK;
+        }
+        if (timeout == 0 || ret == ETIMEDOUT) {
+            return UT_ERRNO_RESOURCE;
+        }
+
+        /* 先登记为等待者再检查元素总数，与生产者先增加总数再检查等待者配合，不会丢失唤醒 */
+        pthread_mutex_lock(&pri_queue->wait_lock);
+        __atomic_add_fetch(&pri_queue->waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&pri_queue->count, __ATOMIC_SEQ_CST) <= 0) {
+            if (timeout < 0) {
+                pthread_cond_wait(&pri_queue->wait_cond, &pri_queue->wait_lock);
+            } else {
+                ret = pthread_cond_timedwait(&pri_queue->wait_cond, &pri_queue->wait_lock, &deadline);
+            }
+        }
+        __atomic_sub_fetch(&pri_queue->waiters, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pri_queue->wait_lock);
+    }
+}
+
+
+ut_pri_queue_conc_t *ut_pri_queue_conc_create(int32_t initial_size, uint32_t shards, ut_pri_comp_func cb)
+{
+    ut_pri_queue_conc_t*    new_queue = NULL;
+    pthread_condattr_t      attr;
+    uint32_t                shard_size = 0;
+    uint32_t                inited = 0;
+
+    if (initial_size <= 0 || cb == NULL) {
+        goto _out;
+    }
+    if (shards == 0) {
+        long    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        shards = (cpus > 0) ? (uint32_t)cpus * 2 : 2;
+    }
+    shard_size = initial_size / shards + 1;
+    if (shard_size < CONC_MIN_SHARD_SIZE) {
+        shard_size = CONC_MIN_SHARD_SIZE;
+    }
+
+    /* count按缓存行对齐，描述结构本身也必须按缓存行对齐申请，malloc只保证16字节对齐 */
+    if (posix_memalign((void**)&new_queue, HEAP_CACHE_LINE, sizeof(ut_pri_queue_conc_t)) != 0) {
+        new_queue = NULL;
+        goto _out;
+    }
+    memset(new_queue, 0, sizeof(ut_pri_queue_conc_t));
+    if (posix_memalign((void**)&new_queue->shards, HEAP_CACHE_LINE, sizeof(conc_heap_shard_t) * shards) != 0) {
+        goto _free;
+    }
+    memset(new_queue->shards, 0, sizeof(conc_heap_shard_t) * shards);
+    for (inited = 0; inited < shards; inited++) {
+        conc_heap_shard_t*  shard = &new_queue->shards[inited];
+
+        shard->heap.arity = 2;
+        shard->heap.elem_compare_cb = cb;
+        if (__heap_resize(&shard->heap, shard_size) != UT_ERRNO_OK) {
+            goto _free;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+    new_queue->nshards = shards;
+    new_queue->compare = cb;
+
+    /* 超时使用单调时钟，不受系统时间调整的影响 */
+    pthread_mutex_init(&new_queue->wait_lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&new_queue->wait_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+_out:
+    return new_queue;
+
+_free:
+    if (new_queue->shards != NULL) {
+        for (uint32_t i = 0; i < inited; i++) {
+            pthread_mutex_destroy(&new_queue->shards[i].lock);
+            __heap_free(&new_queue->shards[i].heap);
+        }
+        free(new_queue->shards);
+    }
+    free(new_queue);
+    new_queue = NULL;
+    goto _out;
+}
+
+ut_errno_t ut_pri_queue_conc_destroy(ut_pri_queue_conc_t *pri_queue)
+{
+    if (pri_queue == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    for (uint32_t i = 0; i < pri_queue->nshards; i++) {
+        pthread_mutex_destroy(&pri_queue->shards[i].lock);
+        __heap_free(&pri_queue->shards[i].heap);
+    }
+    free(pri_queue->shards);
+    pthread_mutex_destroy(&pri_queue->wait_lock);
+    pthread_cond_destroy(&pri_queue->wait_cond);
+    free(pri_queue);
+
+    return UT_ERRNO_OK;
+}
+
+ut_errno_t ut_pri_queue_conc_push(ut_pri_queue_conc_t *pri_queue, void* data)
+{
+    ut_errno_t          retval = UT_ERRNO_OK;
+    conc_heap_shard_t*  shard = NULL;
+
+    if (pri_queue == NULL || data == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    /* 随机选择一个没有被占用的分片，多次都没有选中时直接等待最后一个 */
+    for (uint32_t i = 0; i < pri_queue->nshards; i++) {
+        shard = &pri_queue->shards[__conc_random(pri_queue->nshards)];
+        if (pthread_mutex_trylock(&shard->lock) == 0) {
+            break;
+        }
+        shard = NULL;
+    }
+    if (shard == NULL) {
+        shard = &pri_queue->shards[__conc_random(pri_queue->nshards)];
+        pthread_mutex_lock(&shard->lock);
+    }
+
+    retval = __heap_push(&shard->heap, data, 0, NULL);
+    if (retval == UT_ERRNO_RESOURCE) {
+        retval = __heap_grow(&shard->heap);
+        if (retval == UT_ERRNO_OK) {
+            retval = __heap_push(&shard->heap, data, 0, NULL);
+        }
+    }
+    CONC_STORE(&shard->count, shard->heap.cur_size);
+    pthread_mutex_unlock(&shard->lock);
+
+    if (retval == UT_ERRNO_OK) {
+        __atomic_add_fetch(&pri_queue->count, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&pri_queue->waiters, __ATOMIC_SEQ_CST) > 0) {
+            pthread_mutex_lock(&pri_queue->wait_lock);
+            pthread_cond_signal(&pri_queue->wait_cond);
+            pthread_mutex_unlock(&pri_queue->wait_lock);
+        }
+    }
+
+    return retval;
+}
+
+ut_errno_t ut_pri_queue_conc_pop_wait(ut_pri_queue_conc_t *pri_queue, void* *pdata)
+{
+    if (pri_queue == NULL || pdata == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    return __conc_pop(pri_queue, pdata, -1);
+}
+
+ut_errno_t ut_pri_queue_conc_pop_trywait(ut_pri_queue_conc_t *pri_queue, void* *pdata)
+{
+    if (pri_queue == NULL || pdata == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    return __conc_pop(pri_queue, pdata, 0);
+}
+
+ut_errno_t ut_pri_queue_conc_pop_timedwait(ut_pri_queue_conc_t *pri_queue, void* *pdata, int32_t timeout)
+{
+    if (pri_queue == NULL || pdata == NULL || timeout < 0) {
+        return UT_ERRNO_INVALID;
+    }
+
+    return __conc_pop(pri_queue, pdata, timeout);
+}
+
+int32_t ut_pri_queue_conc_get_size(const ut_pri_queue_conc_t *pri_queue)
+{
+    if (pri_queue == NULL) {
+        return -1;
+    }
+    return __atomic_load_n(&pri_queue->count, __ATOMIC_RELAXED);
+}
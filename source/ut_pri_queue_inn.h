@@ -0,0 +1,229 @@
+/**
+ * @file ut_pri_queue_inn.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 优先级队列内部的堆结构，仅供优先级队列各个实现之间共享使用，堆本身不加锁
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_PRI_QUEUE_INN_H__
+#define __UTILS_PRI_QUEUE_INN_H__
+
+#include "ut/ut_pri_queue.h"
+
+/* 堆元素直接存放在堆数组中，入堆出堆不需要申请释放内存，比较时也少一次指针跳转 */
+typedef struct heap_element {
+    void*               data;               /* 堆元素保存的数据 */
+    int64_t             key;                /* 整数键队列的优先级，越小越优先；使用比较函数的队列不使用 */
+} heap_element_t;
+
+#define HEAP_CACHE_LINE     64      /* 堆数组按缓存行对齐 */
+#define HEAP_NO_HANDLE      UINT32_MAX
+
+/* 句柄表的表项。元素在堆中移动时同步更新位置，通过句柄可以在O(1)时间找到元素 */
+typedef struct heap_handle {
+    uint32_t            pos;                /* 元素在堆中的位置，空闲时为下一个空闲句柄 */
+    uint32_t            gen;                /* 代数，句柄释放时加1，使旧的句柄失效 */
+} heap_handle_t;
+
+/*
+    d叉堆：堆顶存放在heap_mem[arity-1]，位置p的子节点是heap_mem[arity*(p-arity+2)]开始的连续arity个元素，
+    子节点的起始位置总是arity的整数倍，配合按缓存行对齐的堆数组，4叉堆同一个父节点的子节点正好占满一个缓存行，
+    8叉堆占两个相邻的缓存行。arity为2时与普通的二叉堆（首元素不使用）完全相同。
+    elem_compare_cb为NULL时是整数键队列，直接比较元素中的key，不需要调用比较函数
+ */
+typedef struct internal_heap {
+    uint32_t            cur_size;           /* 堆当前的大小 */
+    uint32_t            max_size;           /* 堆最大的大小 */
+    uint32_t            arity;              /* 每个节点的子节点数量 */
+    ut_bool_t           tracked;            /* 是否跟踪元素的句柄，需要在第一次申请堆内存之前设置 */
+    ut_pri_comp_func       elem_compare_cb;    /* 堆元素比较，整数键队列为NULL */
+    heap_element_t      *heap_mem;          /* 堆内存起始指针，前arity-1个元素不使用 */
+    uint32_t            *slot_handle;       /* 与heap_mem一一对应，每个位置上元素的句柄，不跟踪时为NULL */
+    heap_handle_t       *handles;           /* 句柄表，大小与max_size相同，句柄总是够用 */
+    uint32_t            handle_free;        /* 空闲句柄链表 */
+} inn_heap_t;
+
+#define HEAP_ROOT(heap)             ((heap)->arity - 1)
+#define HEAP_TAIL(heap)             ((heap)->arity - 2 + (heap)->cur_size)
+#define HEAP_CHILD(heap, pos)       ((heap)->arity * ((pos) - (heap)->arity + 2))
+#define HEAP_PARENT(heap, pos)      ((pos) / (heap)->arity + (heap)->arity - 2)
+#define HEAP_HANDLE_AT(heap, pos)   ((heap)->slot_handle ? (heap)->slot_handle[pos] : HEAP_NO_HANDLE)
+
+#define BUCKET_NIL          UINT32_MAX
+#define RADIX_BUCKETS       65      /* 基数堆：0号桶存放与基准相同的键，1~64号按最高不同位存放 */
+#define RADIX_VEC_MIN       16
+
+/* 桶队列的元素，节点之间使用节点池中的下标链接 */
+typedef struct bucket_node {
+    heap_element_t      elem;               /* 元素的数据和优先级 */
+    uint32_t            next;               /* 同一链表中的下一个节点，空闲时为下一个空闲节点 */
+} bucket_node_t;
+
+typedef struct bucket_list {
+    uint32_t            head;
+    uint32_t            tail;
+} bucket_list_t;
+
+/* 基数堆的一个桶，元素连续存放，重新分配时顺序扫描 */
+typedef struct radix_vec {
+    heap_element_t      *elems;
+    uint32_t            size;
+    uint32_t            cap;
+} radix_vec_t;
+
+/*
+    基数堆和桶队列共用的结构，都只支持整数键，不支持句柄。
+    桶队列的第i个链表存放键为i的元素；基数堆的桶按与基准（最近一次取出的键）的最高不同位划分
+ */
+typedef struct internal_bucket {
+    uint32_t            cur_size;           /* 当前元素个数 */
+    uint32_t            max_size;           /* 节点池的大小 */
+    ut_bool_t           radix;              /* 是否为基数堆 */
+    uint32_t            levels;             /* 链表的个数 */
+    uint32_t            first;              /* 桶队列：可能不为空的最小优先级 */
+    uint64_t            last;               /* 基数堆：基准，即最近一次取出的键，映射为无符号数 */
+    uint64_t            nonempty;           /* 基数堆：1~64号桶是否不为空的位图 */
+    radix_vec_t         *vecs;              /* 基数堆的桶 */
+    bucket_list_t       *lists;             /* 桶队列的链表数组 */
+    bucket_node_t       *nodes;             /* 桶队列的节点池 */
+    uint32_t            node_free;          /* 空闲节点链表 */
+} inn_bucket_t;
+
+/**
+ * 元素a的优先级是否不低于元素b
+ */
+static inline ut_bool_t __heap_higher(const inn_heap_t *heap, const heap_element_t *a, const heap_element_t *b)
+{
+    if (heap->elem_compare_cb == NULL) {
+        return a->key <= b->key;
+    }
+    return heap->elem_compare_cb(a->data, b->data);
+}
+
+/**
+ * 将元素放在堆中的pos位置，跟踪句柄时同时更新句柄表
+ */
+static inline void __heap_place(inn_heap_t *heap, uint32_t pos, heap_element_t elem, uint32_t handle)
+{
+    heap->heap_mem[pos] = elem;
+    if (heap->slot_handle != NULL) {
+        heap->slot_handle[pos] = handle;
+        heap->handles[handle].pos = pos;
+    }
+}
+
+
+/**
+ * 将数据存入堆中
+ * @param [in] heap 堆指针
+ * @param [in] data 存入的数据
+ * @param [in] key 整数键队列的优先级
+ * @param [out] handle 跟踪句柄时传出元素的句柄序号，可以为NULL
+ * @retval ut_errno_t 堆已满时返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t __heap_push(inn_heap_t *heap, void* data, int64_t key, uint32_t *handle);
+
+/**
+ * 将一批数据存入堆中，调用者保证堆的容量足够。批量比原有的堆还大时自底向上重建整个堆
+ * @param [in] heap 堆指针
+ * @param [in] datas 存入的数据
+ * @param [in] num 数据的个数
+ */
+void __heap_push_n(inn_heap_t *heap, void* const datas[], uint32_t num);
+
+/**
+ * 重新申请按缓存行对齐的堆内存，保留原有的元素。首次申请前heap_mem必须为NULL，arity必须已经设置
+ * @param [in] heap 堆指针
+ * @param [in] max_size 新的堆最大的大小
+ * @retval ut_errno_t 
+ */
+ut_errno_t __heap_resize(inn_heap_t *heap, uint32_t max_size);
+
+/**
+ * 将堆的容量扩大为原来的2倍
+ * @param [in] heap 堆指针
+ * @retval ut_errno_t 
+ */
+ut_errno_t __heap_grow(inn_heap_t *heap);
+
+/**
+ * 释放堆内存和句柄表
+ * @param [in] heap 堆指针
+ */
+void __heap_free(inn_heap_t *heap);
+
+/**
+ * 将句柄序号和代数组合成外部使用的句柄
+ */
+static inline ut_pri_handle_t __heap_handle_encode(const inn_heap_t *heap, uint32_t handle)
+{
+    return ((uint64_t)heap->handles[handle].gen << 32) | handle;
+}
+
+/**
+ * 检查外部传入的句柄，有效时返回元素在堆中的位置，否则返回HEAP_NO_HANDLE
+ */
+static inline uint32_t __heap_handle_pos(const inn_heap_t *heap, ut_pri_handle_t handle)
+{
+    uint32_t    id = (uint32_t)handle;
+
+    if (heap->handles == NULL || id >= heap->max_size || heap->handles[id].gen != (uint32_t)(handle >> 32)) {
+        return HEAP_NO_HANDLE;
+    }
+    return heap->handles[id].pos;
+}
+
+/**
+ * 查看堆顶部元素，堆不能为空
+ * @param [in] heap 堆指针
+ * @return 存入堆时存放的数据
+ */
+void* __heap_peek(inn_heap_t *heap);
+
+/**
+ * 移除堆顶部的元素
+ * @param [in] heap 堆指针
+ * @return 存入堆时存放的数据，堆为空返回NULL
+ */
+void* __heap_pop(inn_heap_t *heap);
+
+/**
+ * 移除堆中指定位置的元素
+ * @param [in] heap 堆指针
+ * @param [in] index 移除堆中数据的位置
+ * @return 存入堆时存放的数据
+ */
+void* __heap_remove(inn_heap_t *heap, uint32_t index);
+
+/**
+ * 对堆中index位置的数据进行一次上浮排序
+ * @param [in] heap 堆指针
+ * @param [in] index 数据在堆中的位置
+ * @return 数据最终存放的位置
+ */
+uint32_t __heap_sort(inn_heap_t *heap, uint32_t index);
+
+/**
+ * 位置index上的数据的优先级发生了变化，重新调整它在堆中的位置
+ * @param [in] heap 堆指针
+ * @param [in] index 数据在堆中的位置
+ */
+void __heap_update(inn_heap_t *heap, uint32_t index);
+
+ut_errno_t __bucket_init(inn_bucket_t *bucket, uint32_t max_size, uint32_t levels);
+ut_errno_t __bucket_resize(inn_bucket_t *bucket, uint32_t max_size);
+ut_errno_t __bucket_grow(inn_bucket_t *bucket);
+void __bucket_free(inn_bucket_t *bucket);
+ut_errno_t __bucket_push(inn_bucket_t *bucket, void* data, int64_t key);
+const heap_element_t* __bucket_peek(inn_bucket_t *bucket);
+ut_errno_t __bucket_pop(inn_bucket_t *bucket, heap_element_t *elem);
+
+ut_errno_t __minmax_push(inn_heap_t *heap, void* data, int64_t key);
+heap_element_t __minmax_pop(inn_heap_t *heap);
+uint32_t __minmax_last(const inn_heap_t *heap);
+ut_errno_t __minmax_replace_last(inn_heap_t *heap, void* data, int64_t key, heap_element_t *evicted);
+
+#endif
@@ -0,0 +1,183 @@
+/**
+ * @file ut_pri_queue_minmax.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 有界优先级队列使用的最小最大堆。与二叉堆布局相同，堆顶存放在heap_mem[1]，
+ *        偶数层（堆顶为第0层）的节点不低于其子树中的所有节点，奇数层的节点不高于其子树中的所有节点，
+ *        优先级最高和最低的元素都可以在O(1)时间找到，入堆、取出最高或替换最低的元素都是O(log n)。
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ut_pri_queue_inn.h"
+
+/* 堆顶为1，下标为i的节点所在层数的奇偶 */
+#define MINMAX_IS_MIN_LEVEL(i)  ((31 - __builtin_clz(i)) & 1)
+
+static void __minmax_swap(inn_heap_t *heap, uint32_t a, uint32_t b);
+static ut_bool_t __minmax_better(const inn_heap_t *heap, uint32_t a, uint32_t b, ut_bool_t min_level);
+static void __minmax_bubble_up(inn_heap_t *heap, uint32_t index);
+static void __minmax_trickle_down(inn_heap_t *heap, uint32_t index);
+
+/**
+ * 将元素存入最小最大堆，堆的arity必须为2且不跟踪句柄
+ * @param [in] heap 堆指针
+ * @param [in] data 存入的数据
+ * @param [in] key 整数键队列的优先级
+ * @retval ut_errno_t 堆已满时返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t __minmax_push(inn_heap_t *heap, void* data, int64_t key)
+{
+    heap_element_t  elem = {data, key};
+
+    if (heap->cur_size >= heap->max_size) {
+        return UT_ERRNO_RESOURCE;
+    }
+
+    heap->cur_size++;
+    heap->heap_mem[heap->cur_size] = elem;
+    __minmax_bubble_up(heap, heap->cur_size);
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 取出优先级最高的元素，堆不能为空
+ * @param [in] heap 堆指针
+ * @return heap_element_t 取出的元素
+ */
+heap_element_t __minmax_pop(inn_heap_t *heap)
+{
+    heap_element_t  top = heap->heap_mem[1];
+
+    heap->heap_mem[1] = heap->heap_mem[heap->cur_size];
+    heap->cur_size--;
+    if (heap->cur_size > 1) {
+        __minmax_trickle_down(heap, 1);
+    }
+
+    return top;
+}
+
+/**
+ * 优先级最低的元素的位置，堆不能为空
+ * @param [in] heap 堆指针
+ * @return uint32_t 元素在heap_mem中的下标
+ */
+uint32_t __minmax_last(const inn_heap_t *heap)
+{
+    if (heap->cur_size <= 2) {
+        return heap->cur_size;
+    }
+
+    /* 在堆顶的两个子节点中 */
+    return __heap_higher(heap, &heap->heap_mem[3], &heap->heap_mem[2]) ? 2 : 3;
+}
+
+/**
+ * 用新元素替换优先级最低的元素，新元素的优先级不高于它时不替换
+ * @param [in] heap 堆指针，不能为空
+ * @param [in] data 存入的数据
+ * @param [in] key 整数键队列的优先级
+ * @param [out] evicted 被替换掉的元素
+ * @retval ut_errno_t 新元素的优先级不够高时返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t __minmax_replace_last(inn_heap_t *heap, void* data, int64_t key, heap_element_t *evicted)
+{
+    heap_element_t  elem = {data, key};
+    uint32_t        last = __minmax_last(heap);
+
+    /* 比较函数可能是严格小于，优先级相等时两个方向都不为真，因此需要双向判断才能保证相等时不替换 */
+    if (__heap_higher(heap, &heap->heap_mem[last], &elem) || !__heap_higher(heap, &elem, &heap->heap_mem[last])) {
+        return UT_ERRNO_RESOURCE;
+    }
+
+    *evicted = heap->heap_mem[last];
+    heap->heap_mem[last] = elem;
+
+    /* 最低的元素只可能在第0层或第1层，新元素比堆顶还高时与堆顶交换，换下来的堆顶仍然不低于该子树 */
+    if (last > 1) {
+        if (!__heap_higher(heap, &heap->heap_mem[1], &elem)) {
+            __minmax_swap(heap, 1, last);
+        }
+        __minmax_trickle_down(heap, last);
+    }
+
+    return UT_ERRNO_OK;
+}
+
+static void __minmax_swap(inn_heap_t *heap, uint32_t a, uint32_t b)
+{
+    heap_element_t  tmp = heap->heap_mem[a];
+
+    heap->heap_mem[a] = heap->heap_mem[b];
+    heap->heap_mem[b] = tmp;
+}
+
+/**
+ * 在最小层上a是否严格低于b，在最大层上a是否严格高于b
+ */
+static ut_bool_t __minmax_better(const inn_heap_t *heap, uint32_t a, uint32_t b, ut_bool_t min_level)
+{
+    if (min_level) {
+        return !__heap_higher(heap, &heap->heap_mem[a], &heap->heap_mem[b]);
+    }
+    return !__heap_higher(heap, &heap->heap_mem[b], &heap->heap_mem[a]);
+}
+
+/**
+ * 新加入的元素先与父节点比较确定应该在最大层还是最小层上浮，然后每次跳过一层与祖父节点比较
+ */
+static void __minmax_bubble_up(inn_heap_t *heap, uint32_t index)
+{
+    ut_bool_t   min_level = MINMAX_IS_MIN_LEVEL(index);
+
+    if (index == 1) {
+        return;
+    }
+    if (__minmax_better(heap, index / 2, index, min_level)) {
+        __minmax_swap(heap, index, index / 2);
+        index /= 2;
+        min_level = !min_level;
+    }
+    while (index >= 4 && __minmax_better(heap, index, index / 4, min_level)) {
+        __minmax_swap(heap, index, index / 4);
+        index /= 4;
+    }
+}
+
+/**
+ * 在子节点和孙节点中找到最高（最大层）或最低（最小层）的元素与当前元素交换，
+ * 交换到孙节点后再与其父节点比较，保证中间层的性质
+ */
+static void __minmax_trickle_down(inn_heap_t *heap, uint32_t index)
+{
+    ut_bool_t   min_level = MINMAX_IS_MIN_LEVEL(index);
+
+    while (index * 2 <= heap->cur_size) {
+        uint32_t    best = index * 2;
+        uint32_t    first = index * 4;
+
+        if (best + 1 <= heap->cur_size && __minmax_better(heap, best + 1, best, min_level)) {
+            best = best + 1;
+        }
+        for (uint32_t i = first; i < first + 4 && i <= heap->cur_size; i++) {
+            if (__minmax_better(heap, i, best, min_level)) {
+                best = i;
+            }
+        }
+
+        if (!__minmax_better(heap, best, index, min_level)) {
+            break;
+        }
+        __minmax_swap(heap, index, best);
+        if (best < first) {
+            break;      /* 交换到子节点，子节点没有更下面的同类层 */
+        }
+        if (__minmax_better(heap, best / 2, best, min_level)) {
+            __minmax_swap(heap, best, best / 2);
+        }
+        index = best;
+    }
+}
@@ -10,16 +10,24 @@
  */
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
 #include <pthread.h>
 #include <errno.h>
 #include <string.h>
 #include "ut/ut.h"
-#include "ut/ut_hash.h"
-#include "ut/ut_pri_queue.h"
+#include "ut/ut_hash_u64.h"
 #include "ut/ut_select.h"
+#include "ut_select_inn.h"
 
 
-#define PRI_QUEUE_SIZE      50
+#define WHEEL_RESOLUTION_US 1000    /* 定时器默认的刻度 */
+#define EPOLL_READY_MIN     64      /* 一次epoll_wait取出的就绪事件数，取满时加倍 */
+#define EPOLL_READY_MAX     4096
+
+/* epoll事件中同时携带fd和注册代数，同一批就绪事件中fd被关闭后又被重新注册时，旧的事件可以被识别出来 */
+#define EPOLL_DATA_MAKE(fd, gen)    ((uint64_t)(uint32_t)(fd) | ((uint64_t)(gen) << 32))
+#define EPOLL_DATA_FD(data)         ((ut_fd_t)(uint32_t)(data))
+#define EPOLL_DATA_GEN(data)        ((uint32_t)((data) >> 32))
 
 
 typedef enum {
@@ -27,36 +35,43 @@ typedef enum {
     ENGINE_EVENT_STOP,
 } engine_manage_event_t;
 
-typedef struct {
-    ut_select_schedule_cb  cb;
-    void*               context;
-    struct timeval      time;
-} engine_event_t;
-
 typedef struct {
     ut_fd_t             fd;
     ut_select_fd_cb     cb;
     ut_bool_t           temporary;
     void*               context;
+    uint32_t            gen;            /* 注册代数，与epoll事件中携带的一致时事件才属于这次注册 */
 } engine_fd_t;
 
 struct ut_select_engine_t {
-    ut_pri_queue_t      *event_queue;
-    ut_hash_t           *fd_poll;
+    ut_hash_u64_t       *fd_poll;
     fd_set              read_fds;
     ut_fd_t             max_fd;
     ut_bool_t           need_continue;
+    ut_bool_t           running;        /* 事件循环是否正在运行，运行时不能销毁 */
     ut_bool_t           has_reset;
     pthread_mutex_t     running_flag;   /* 是否在运行的标志位 */
     int32_t             manage_pipe[2];
+    ut_select_backend_t backend;
+    int32_t             epoll_fd;       /* epoll后端的实例，fd注册在这里，不需要每次等待前重新构造 */
+    struct epoll_event  *ready;         /* 就绪事件：epoll_wait取出的，或者select返回后从fd_set中收集的 */
+    int32_t             ready_max;
+    int32_t             ready_num;      /* select后端收集到的就绪事件个数 */
+    uint32_t            fd_gen;         /* 每注册一个fd加1 */
+    pthread_mutex_t     timer_lock;     /* 其他线程也可以增加删除定时器 */
+    inn_wheel_t         wheel[1];       /* 定时器的分层时间轮 */
 };
 
 
 static void __engine_destroy(ut_select_engine_t* engine);
-static uint32_t __fd_poll_hash_func(const char *key);
-static ut_bool_t __event_queue_pri_comp(void* event1, void* event2);
-static ut_bool_t __fd_set_foreach(const char *key, const void* value, void* context);
-static ut_bool_t __fd_isset_foreach(const char *key, const void* value, void* context);
+static ut_errno_t __engine_run_select(ut_select_engine_t* engine);
+static ut_errno_t __engine_run_epoll(ut_select_engine_t* engine);
+static void __engine_fd_dispatch(ut_select_engine_t* engine, int32_t ready_num);
+static void __engine_timer_dispatch(ut_select_engine_t* engine);
+static int64_t __engine_timer_wait_us(ut_select_engine_t* engine);
+static ut_bool_t __fd_set_foreach(uint64_t key, const void* value, void* context);
+static ut_bool_t __fd_isset_foreach(uint64_t key, const void* value, void* context);
+static ut_bool_t __fd_free_foreach(uint64_t key, const void* value, void* context);
 static void __manage_fd_callback(ut_fd_t manage_fd, void* context);
 static void __engine_reload(ut_select_engine_t* engine);
 static ut_errno_t __engine_fd_add(ut_select_engine_t* engine, ut_fd_t fd, ut_select_fd_cb callback, void* context, ut_bool_t temporary);
@@ -64,11 +79,16 @@ ut_errno_t __engine_fd_del(ut_select_engine_t* engine, ut_fd_t fd);
 
 
 ut_errno_t ut_select_engine_create(ut_select_engine_t **engine)
+{
+    return ut_select_engine_create_ex(engine, UT_SELECT_BACKEND_SELECT);
+}
+
+ut_errno_t ut_select_engine_create_ex(ut_select_engine_t **engine, ut_select_backend_t backend)
 {
     ut_errno_t          retval = UT_ERRNO_OK;
     ut_select_engine_t  *new_engine = NULL;
 
-    if (engine == NULL) {
+    if (engine == NULL || (backend != UT_SELECT_BACKEND_SELECT && backend != UT_SELECT_BACKEND_EPOLL)) {
         retval = UT_ERRNO_INVALID;
         goto _out;
     }
@@ -79,17 +99,32 @@ ut_errno_t ut_select_engine_create(ut_select_engine_t **engine)
         goto _out;
     }
     memset(new_engine, 0, sizeof(ut_select_engine_t));
+    new_engine->backend = backend;
+    new_engine->epoll_fd = -1;
+    new_engine->manage_pipe[0] = new_engine->manage_pipe[1] = -1;
+    new_engine->ready_max = EPOLL_READY_MIN;
+    new_engine->ready = malloc(EPOLL_READY_MIN * sizeof(struct epoll_event));
+    if (new_engine->ready == NULL) {
+        retval = UT_ERRNO_OUTOFMEM;
+        goto _destroy;
+    }
+    if (backend == UT_SELECT_BACKEND_EPOLL) {
+        new_engine->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (new_engine->epoll_fd < 0) {
+            retval = UT_ERRNO_UNKNOWN;
+            goto _destroy;
+        }
+    }
 
-
-    /* 创建优先级队列作为事件队列 */
-    new_engine->event_queue = ut_pri_queue_create(PRI_QUEUE_SIZE, UT_TRUE, __event_queue_pri_comp);
-    if (new_engine->event_queue == NULL) {
-        retval = UT_ERRNO_UNKNOWN;
+    /* 定时器放在时间轮中 */
+    pthread_mutex_init(&new_engine->timer_lock, NULL);
+    retval = __wheel_init(new_engine->wheel, WHEEL_RESOLUTION_US);
+    if (retval != UT_ERRNO_OK) {
         goto _destroy;
     }
 
     /* 创建哈希表作为fd池 */
-    retval = ut_hash_create(&new_engine->fd_poll, 100, __fd_poll_hash_func);
+    retval = ut_hash_u64_create(&new_engine->fd_poll, 100);
     if (retval != UT_ERRNO_OK) {
         goto _destroy;
     }
@@ -98,7 +133,10 @@ ut_errno_t ut_select_engine_create(ut_select_engine_t **engine)
     pthread_mutex_init(&new_engine->running_flag, NULL);
 
     pipe(new_engine->manage_pipe);
-    __engine_fd_add(new_engine, PIPE_RD_FD(new_engine->manage_pipe), __manage_fd_callback, new_engine, UT_FALSE);
+    retval = __engine_fd_add(new_engine, PIPE_RD_FD(new_engine->manage_pipe), __manage_fd_callback, new_engine, UT_FALSE);
+    if (retval != UT_ERRNO_OK) {
+        goto _destroy;
+    }
 
     *engine = new_engine;
 _out:
@@ -119,7 +157,9 @@ ut_errno_t ut_select_engine_fd_add_forever(ut_select_engine_t* engine, ut_fd_t f
     }
     UT_LOG_DEBUG("select engine add a fd=%d\n", fd);
     retval = __engine_fd_add(engine, fd, callback, context, UT_FALSE);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    if (engine->backend == UT_SELECT_BACKEND_SELECT) {
+        __engine_reload(engine);    /* 通知engine重新进行select，epoll的注册立即生效 */
+    }
 
 _out:
     return retval;
@@ -134,7 +174,9 @@ ut_errno_t ut_select_engine_fd_add_once(ut_select_engine_t* engine, ut_fd_t fd,
         goto _out;
     }
     retval = __engine_fd_add(engine, fd, callback, context, UT_TRUE);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    if (engine->backend == UT_SELECT_BACKEND_SELECT) {
+        __engine_reload(engine);    /* 通知engine重新进行select */
+    }
 
 _out:
     return retval;
@@ -149,53 +191,101 @@ ut_errno_t ut_select_engine_fd_del(ut_select_engine_t* engine, ut_fd_t fd)
         goto _out;
     }
 
-    __engine_fd_del(engine, fd);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    retval = __engine_fd_del(engine, fd);
+    if (engine->backend == UT_SELECT_BACKEND_SELECT) {
+        __engine_reload(engine);    /* 通知engine重新进行select */
+    }
 
 _out:
     return retval;
 }
 
 ut_errno_t ut_select_engine_schedule_add(ut_select_engine_t* engine, ut_select_schedule_cb callback, void* context, int64_t timeout_us)
+{
+    return ut_select_engine_schedule_add_ex(engine, callback, context, timeout_us, NULL);
+}
+
+ut_errno_t ut_select_engine_schedule_add_ex(ut_select_engine_t* engine, ut_select_schedule_cb callback, void* context, int64_t timeout_us, ut_select_timer_t *timer)
 {
     ut_errno_t      retval = UT_ERRNO_OK;
-    engine_event_t  *event = NULL;
 
     if (engine == NULL || callback == NULL || timeout_us < 0) {
         retval = UT_ERRNO_INVALID;
         goto _out;
     }
 
-    event = ut_zero_alloc(sizeof(engine_event_t));
-    event->cb = callback;
-    event->context = context;
-    gettimeofday(&event->time, NULL);
-    UT_LOG_DEBUG("current time:  %lds:%ldus\n", event->time.tv_sec, event->time.tv_usec);
+    UT_LOG_DEBUG("set timeout event %ldus\n", timeout_us);
+    pthread_mutex_lock(&engine->timer_lock);
+    retval = __wheel_add(engine->wheel, callback, context, timeout_us, timer);
+    pthread_mutex_unlock(&engine->timer_lock);
+    if (retval != UT_ERRNO_OK) {
+        goto _out;
+    }
+    __engine_reload(engine);    /* 通知engine重新进行select */
+
+_out:
+    return retval;
+}
+
+ut_errno_t ut_select_engine_schedule_del(ut_select_engine_t* engine, ut_select_timer_t timer)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
 
-    event->time.tv_sec += timeout_us / (1000 * 1000);
-    event->time.tv_usec += timeout_us % (1000 * 1000);
-    if (event->time.tv_usec < 0) {
-        event->time.tv_usec += 1000 * 1000;
-        event->time.tv_sec -= 1;
+    if (engine == NULL) {
+        retval = UT_ERRNO_INVALID;
+        goto _out;
     }
-    if (event->time.tv_sec < 0) {
-        event->time.tv_sec = 0;
-        event->time.tv_usec = 0;
+
+    /* 删除定时器只会让等待变长，不需要通知engine */
+    pthread_mutex_lock(&engine->timer_lock);
+    retval = __wheel_del(engine->wheel, timer);
+    pthread_mutex_unlock(&engine->timer_lock);
+
+_out:
+    return retval;
+}
+
+ut_errno_t ut_select_engine_set_resolution(ut_select_engine_t* engine, int64_t resolution_us)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    if (engine == NULL) {
+        retval = UT_ERRNO_INVALID;
+        goto _out;
     }
 
-    UT_LOG_DEBUG("set timeout event %lds:%ldus\n", event->time.tv_sec, event->time.tv_usec);;
-    ut_pri_queue_push(engine->event_queue, event);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    pthread_mutex_lock(&engine->timer_lock);
+    retval = __wheel_set_resolution(engine->wheel, resolution_us);
+    pthread_mutex_unlock(&engine->timer_lock);
 
 _out:
     return retval;
 }
 
 ut_errno_t ut_select_engine_run(ut_select_engine_t* engine)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    if (engine == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    engine->running = UT_TRUE;
+    if (engine->backend == UT_SELECT_BACKEND_EPOLL) {
+        retval = __engine_run_epoll(engine);
+    } else {
+        retval = __engine_run_select(engine);
+    }
+    engine->running = UT_FALSE;
+
+    return retval;
+}
+
+static ut_errno_t __engine_run_select(ut_select_engine_t* engine)
 {
     struct timeval  tm_wait;
     struct timeval* select_tm = NULL;
-    engine_event_t  *event = NULL;
+    int64_t         wait_us = 0;
     ut_errno_t      retval = UT_ERRNO_OK;
     int32_t         select_ret = 0;
 
@@ -213,31 +303,16 @@ ut_errno_t ut_select_engine_run(ut_select_engine_t* engine)
 
         /* 初始化需要监听的文件描述符 */
         FD_ZERO(&engine->read_fds);
-        ut_hash_foreach(engine->fd_poll, __fd_set_foreach, engine);
+        ut_hash_u64_foreach(engine->fd_poll, __fd_set_foreach, engine);
 
         /* 获取等待的时间 */
-        retval = ut_pri_queue_peek(engine->event_queue, (void**)&event);
-        if (retval == UT_ERRNO_RESOURCE) {   /* 说明此时没有事件需要处理 */
+        wait_us = __engine_timer_wait_us(engine);
+        if (wait_us < 0) {                  /* 说明此时没有事件需要处理 */
             select_tm = NULL;
             UT_LOG_DEBUG("no need to wait.\n");
-        } else if (retval != UT_ERRNO_OK) {
-            retval = UT_ERRNO_UNKNOWN;       /* 出错了 */
-            UT_LOG_ERROR("error occured!\n");
-            goto _out;
         } else {                            /* 说明此时有事件需要处理 */
-            gettimeofday(&tm_wait, NULL);
-            UT_LOG_DEBUG("current time:  %lds:%ldus\n", tm_wait.tv_sec, tm_wait.tv_usec);
-            UT_LOG_DEBUG("event time:  %lds:%ldus\n", event->time.tv_sec, event->time.tv_usec);
-            tm_wait.tv_sec = event->time.tv_sec - tm_wait.tv_sec;
-            tm_wait.tv_usec = event->time.tv_usec - tm_wait.tv_usec;
-            if (tm_wait.tv_usec < 0) {
-                tm_wait.tv_usec += 1000 * 1000;
-                tm_wait.tv_sec -= 1;
-            }
-            if (tm_wait.tv_sec < 0) {
-                tm_wait.tv_sec = 0;
-                tm_wait.tv_usec = 0;
-            }
+            tm_wait.tv_sec = wait_us / (1000 * 1000);
+            tm_wait.tv_usec = wait_us % (1000 * 1000);
             UT_LOG_DEBUG("waiting for timeout...%lds:%ldus\n", tm_wait.tv_sec, tm_wait.tv_usec);
             select_tm = &tm_wait;
         }
@@ -248,20 +323,18 @@ ut_errno_t ut_select_engine_run(ut_select_engine_t* engine)
         /* 解锁，此后将会执行回调函数。此时调整select引擎，则不需要进行reload */
         pthread_mutex_unlock(&engine->running_flag);
 
-        /* 定时器事件处理 */
-        if (!select_ret) {  
-            event->cb(event->context);
-            retval = ut_pri_queue_pop_trywait(engine->event_queue, (void**)&event);
-            if (retval != UT_ERRNO_OK) {
-                break;
-            }
-        /* fd可读 */
-        } else if (select_ret > 0) {
-            ut_hash_foreach(engine->fd_poll, __fd_isset_foreach, engine);
+        /* fd可读。先收集就绪的fd再统一回调，回调中增删fd不会影响正在进行的遍历 */
+        if (select_ret > 0) {
+            engine->ready_num = 0;
+            ut_hash_u64_foreach(engine->fd_poll, __fd_isset_foreach, engine);
+            __engine_fd_dispatch(engine, engine->ready_num);
         /* 被中断程序打断 */
-        } else {
+        } else if (select_ret < 0) {
             UT_LOG_INFO("select has been interrupted by system call.(%s)\n", strerror(errno));
         }
+
+        /* 定时器事件处理，fd一直可读时到期的定时器也能得到处理 */
+        __engine_timer_dispatch(engine);
     }
 
     engine->need_continue = UT_TRUE;
@@ -269,6 +342,122 @@ _out:
     return retval;
 }
 
+/**
+ * @brief epoll后端的事件循环。fd在添加时已经注册到epoll中，每次唤醒只处理就绪的fd，
+ *        通过fd在哈希表中找到注册信息，回调中删除其他fd也不会访问到已经释放的内存
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return ut_errno_t 
+ */
+static ut_errno_t __engine_run_epoll(ut_select_engine_t* engine)
+{
+    int64_t         wait_us = 0;
+    int32_t         timeout_ms = -1;
+    int32_t         ready_num = 0;
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+    while (engine->need_continue) {
+        pthread_mutex_lock(&engine->running_flag);
+
+        /* 获取等待的时间，向上取整到毫秒，避免定时器到期前被提前唤醒 */
+        wait_us = __engine_timer_wait_us(engine);
+        timeout_ms = wait_us < 0 ? -1 : (int32_t)min((wait_us + 999) / 1000, INT32_MAX);
+
+        ready_num = epoll_wait(engine->epoll_fd, engine->ready, engine->ready_max, timeout_ms);
+
+        pthread_mutex_unlock(&engine->running_flag);
+
+        if (ready_num < 0) {
+            UT_LOG_INFO("epoll_wait has been interrupted by system call.(%s)\n", strerror(errno));
+            continue;
+        }
+
+        __engine_fd_dispatch(engine, ready_num);
+
+        /* 就绪事件取满说明可能还有更多，下一次多取一些 */
+        if (ready_num == engine->ready_max && engine->ready_max < EPOLL_READY_MAX) {
+            struct epoll_event* new_ready = realloc(engine->ready, engine->ready_max * 2 * sizeof(struct epoll_event));
+
+            if (new_ready != NULL) {
+                engine->ready = new_ready;
+                engine->ready_max *= 2;
+            }
+        }
+
+        __engine_timer_dispatch(engine);
+    }
+
+    engine->need_continue = UT_TRUE;
+    return retval;
+}
+
+/**
+ * @brief 分发一批就绪事件。每个事件通过fd在哈希表中重新查找注册信息，回调中删除其他fd也不会访问到已经释放的内存；
+ *        回调中关闭一个fd后新打开的fd可能复用同一个数值并被重新注册，此时同一批事件中旧的事件注册代数不一致，直接丢弃
+ *
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] ready_num engine->ready中就绪事件的个数
+ */
+static void __engine_fd_dispatch(ut_select_engine_t* engine, int32_t ready_num)
+{
+    for (int32_t i = 0; i < ready_num; i++) {
+        ut_fd_t         fd = EPOLL_DATA_FD(engine->ready[i].data.u64);
+        engine_fd_t*    engine_fd = ut_hash_u64_peek(engine->fd_poll, fd);
+
+        /* 同一批事件中，之前的回调已经删除了这个fd，或者删除后又重新注册了同一个数值的fd */
+        if (engine_fd == NULL || engine_fd->gen != EPOLL_DATA_GEN(engine->ready[i].data.u64)) {
+            continue;
+        }
+        if (engine_fd->temporary) {     /* 只执行一次的fd，先删除再回调 */
+            ut_select_fd_cb     cb = engine_fd->cb;
+            void*               context = engine_fd->context;
+
+            __engine_fd_del(engine, fd);
+            cb(fd, context);
+        } else {
+            engine_fd->cb(fd, engine_fd->context);
+        }
+    }
+}
+
+/**
+ * @brief 处理所有已经到期的定时器事件。先取出再回调，回调中新加入的事件不会被误取出
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ */
+static void __engine_timer_dispatch(ut_select_engine_t* engine)
+{
+    ut_select_schedule_cb   cb = NULL;
+    void*                   context = NULL;
+
+    /* 回调时不持有锁，回调中可以增加或删除定时器，包括同一批中还没有回调的定时器 */
+    pthread_mutex_lock(&engine->timer_lock);
+    __wheel_advance(engine->wheel);
+    while (__wheel_pop_expired(engine->wheel, &cb, &context)) {
+        pthread_mutex_unlock(&engine->timer_lock);
+        cb(context);
+        pthread_mutex_lock(&engine->timer_lock);
+    }
+    pthread_mutex_unlock(&engine->timer_lock);
+}
+
+/**
+ * @brief 距离下一次需要处理定时器的时间
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return int64_t 单位微秒us，没有定时器时返回-1
+ */
+static int64_t __engine_timer_wait_us(ut_select_engine_t* engine)
+{
+    int64_t     wait_us = 0;
+
+    pthread_mutex_lock(&engine->timer_lock);
+    wait_us = __wheel_next_us(engine->wheel);
+    pthread_mutex_unlock(&engine->timer_lock);
+
+    return wait_us;
+}
+
 ut_errno_t ut_select_engine_stop(ut_select_engine_t* engine)
 {
     ut_errno_t              retval = UT_ERRNO_OK;
@@ -294,7 +483,7 @@ ut_errno_t ut_select_engine_destroy(ut_select_engine_t* engine)
         goto _out;
     }
 
-    if (engine->need_continue) {
+    if (engine->running) {
         retval = UT_ERRNO_INVALID;
         goto _out;
     }
@@ -325,9 +514,39 @@ static void __engine_reload(ut_select_engine_t* engine)
 
 static ut_errno_t __engine_fd_add(ut_select_engine_t* engine, ut_fd_t fd, ut_select_fd_cb callback, void* context, ut_bool_t temporary)
 {
-    ut_errno_t      retval = UT_ERRNO_OK;
-    char            buffer[32] = {0};
-    engine_fd_t*    engine_fd = NULL;
+    ut_errno_t          retval = UT_ERRNO_OK;
+    engine_fd_t*        engine_fd = NULL;
+    struct epoll_event  ev;
+
+    if (engine->backend == UT_SELECT_BACKEND_SELECT && fd >= FD_SETSIZE) {
+        retval = UT_ERRNO_INVALID;      /* fd_set放不下 */
+        goto _out;
+    }
+
+    /*
+        已经在监视的fd更新回调，并重新注册到epoll：调用者可能没有删除就关闭了fd，
+        同一个数值被新的fd复用，epoll中旧的注册已经随着关闭被移除。换一个注册代数，
+        同一批中还没有分发的旧事件不会交给新的回调
+     */
+    engine_fd = ut_hash_u64_peek(engine->fd_poll, fd);
+    if (engine_fd != NULL) {
+        if (engine->backend == UT_SELECT_BACKEND_EPOLL) {
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u64 = EPOLL_DATA_MAKE(fd, engine->fd_gen + 1);
+            if (epoll_ctl(engine->epoll_fd, EPOLL_CTL_MOD, fd, &ev) != 0
+                && (errno != ENOENT || epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)) {
+                UT_LOG_ERROR("epoll_ctl re-register fd=%d failed.(%s)\n", fd, strerror(errno));
+                retval = UT_ERRNO_UNKNOWN;
+                goto _out;
+            }
+        }
+        engine_fd->cb = callback;
+        engine_fd->temporary = temporary;
+        engine_fd->context = context;
+        engine_fd->gen = ++engine->fd_gen;
+        goto _out;
+    }
 
     engine_fd = ut_zero_alloc(sizeof(engine_fd_t));
     if (engine_fd == NULL) {
@@ -339,9 +558,29 @@ static ut_errno_t __engine_fd_add(ut_select_engine_t* engine, ut_fd_t fd, ut_sel
     engine_fd->cb = callback;
     engine_fd->temporary = temporary;
     engine_fd->context = context;
+    engine_fd->gen = ++engine->fd_gen;
+
+    if (engine->backend == UT_SELECT_BACKEND_EPOLL) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = EPOLL_DATA_MAKE(fd, engine_fd->gen);
+        if (epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            UT_LOG_ERROR("epoll_ctl add fd=%d failed.(%s)\n", fd, strerror(errno));
+            free(engine_fd);
+            retval = UT_ERRNO_UNKNOWN;
+            goto _out;
+        }
+    }
 
-    snprintf(buffer, 31, "%d", fd);
-    ut_hash_push(engine->fd_poll, buffer, engine_fd);
+    /* 哈希表扩容失败时push同样返回NULL，只能通过查找确认 */
+    ut_hash_u64_push(engine->fd_poll, fd, engine_fd);
+    if (ut_hash_u64_peek(engine->fd_poll, fd) != engine_fd) {
+        if (engine->backend == UT_SELECT_BACKEND_EPOLL) {
+            epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        }
+        free(engine_fd);
+        retval = UT_ERRNO_OUTOFMEM;
+    }
 
 _out:
     return retval;
@@ -350,11 +589,16 @@ _out:
 ut_errno_t __engine_fd_del(ut_select_engine_t* engine, ut_fd_t fd)
 {
     ut_errno_t              retval = UT_ERRNO_OK;
-    char                    buffer[UT_LEN_32] = {0};
+    engine_fd_t*            engine_fd = NULL;
 
-    snprintf(buffer, UT_LEN_32 - 1, "%d", fd);
-    if (ut_hash_pop(engine->fd_poll, buffer) == NULL) {
+    engine_fd = ut_hash_u64_pop(engine->fd_poll, fd);
+    if (engine_fd == NULL) {
         retval = UT_ERRNO_NOTEXSIT;
+    } else {
+        if (engine->backend == UT_SELECT_BACKEND_EPOLL) {
+            epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        }
+        free(engine_fd);
     }
 
     return retval;
@@ -363,39 +607,26 @@ ut_errno_t __engine_fd_del(ut_select_engine_t* engine, ut_fd_t fd)
 static inline void __engine_destroy(ut_select_engine_t* engine)
 {
     if (engine != NULL) {
-        if (engine->event_queue != NULL) {
-            ut_pri_queue_destroy(engine->event_queue);
-            engine->event_queue = NULL;
-        }
+        __wheel_free(engine->wheel);
+        pthread_mutex_destroy(&engine->timer_lock);
         if (engine->fd_poll != NULL) {
-            ut_hash_destroy(engine->fd_poll);
+            ut_hash_u64_foreach(engine->fd_poll, __fd_free_foreach, NULL);
+            ut_hash_u64_destroy(engine->fd_poll);
+        }
+        if (engine->manage_pipe[0] >= 0) {
+            close(PIPE_RD_FD(engine->manage_pipe));
+            close(PIPE_WR_FD(engine->manage_pipe));
+        }
+        if (engine->epoll_fd >= 0) {
+            close(engine->epoll_fd);
         }
+        free(engine->ready);
         pthread_mutex_destroy(&engine->running_flag);
         free(engine);
     }
 }
 
-static ut_bool_t __event_queue_pri_comp(void* event1, void* event2)
-{
-    int64_t    tmp_s = 0;
-    int64_t    tmp_us = 0;
-
-    tmp_s = PTR_CAST(event1, engine_event_t*)->time.tv_sec - PTR_CAST(event2, engine_event_t*)->time.tv_sec;
-    tmp_us = PTR_CAST(event1, engine_event_t*)->time.tv_usec - PTR_CAST(event2, engine_event_t*)->time.tv_usec;
-
-    if ((tmp_s < 0) || (!tmp_s && tmp_us <= 0)) {
-        return UT_TRUE;
-    } else {
-        return UT_FALSE;
-    }
-}
-
-static uint32_t __fd_poll_hash_func(const char *key)
-{
-    return PTR_CAST(atoi(key), uint32_t);
-}
-
-static ut_bool_t __fd_set_foreach(const char *key, const void* value, void* context)
+static ut_bool_t __fd_set_foreach(uint64_t key, const void* value, void* context)
 {
     ut_bool_t               retval = UT_TRUE;
     ut_select_engine_t*     engine = (ut_select_engine_t*)context;
@@ -433,7 +664,7 @@ static void __manage_fd_callback(ut_fd_t manage_fd, void* context)
     return ;
 }
 
-static ut_bool_t __fd_isset_foreach(const char *key, const void* value, void* context)
+static ut_bool_t __fd_isset_foreach(uint64_t key, const void* value, void* context)
 {
     ut_bool_t               retval = UT_TRUE;
     ut_select_engine_t*     engine = (ut_select_engine_t*)context;
@@ -444,17 +675,27 @@ static ut_bool_t __fd_isset_foreach(const char *key, const void* value, void* co
         goto _out;
     }
 
+    /* 只记录可读的fd和注册代数，回调在遍历结束后执行 */
     if (FD_ISSET(engine_fd->fd, &engine->read_fds)) {
-        if (engine_fd->temporary) {             /* 如果fd是只执行一次的，则从哈希表中移除 */
-            char            buffer[32] = {0};
+        if (engine->ready_num == engine->ready_max) {
+            struct epoll_event* new_ready = realloc(engine->ready, engine->ready_max * 2 * sizeof(struct epoll_event));
 
-            snprintf(buffer, 31, "%d", engine_fd->fd);
-            ut_hash_pop(engine->fd_poll, buffer);
+            if (new_ready == NULL) {
+                retval = UT_FALSE;          /* 本轮只处理已经收集到的，其余的下一轮仍然可读 */
+                goto _out;
+            }
+            engine->ready = new_ready;
+            engine->ready_max *= 2;
         }
-
-        engine_fd->cb(engine_fd->fd, engine_fd->context);   /* 如果fd可读，则执行回调 */
+        engine->ready[engine->ready_num++].data.u64 = EPOLL_DATA_MAKE(engine_fd->fd, engine_fd->gen);
     }
 
 _out:
     return retval;
 }
+
+static ut_bool_t __fd_free_foreach(uint64_t key, const void* value, void* context)
+{
+    free((void*)value);
+    return UT_TRUE;
+}
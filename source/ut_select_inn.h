@@ -0,0 +1,124 @@
+/**
+ * @file ut_select_inn.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 事件引擎内部的分层时间轮，定时器的增加和删除都是O(1)，时间轮本身不加锁
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_SELECT_INN_H__
+#define __UTILS_SELECT_INN_H__
+
+#include "ut/ut_select.h"
+
+#define WHEEL_BITS          8
+#define WHEEL_SLOTS         (1 << WHEEL_BITS)   /* 每一层的槽数 */
+#define WHEEL_MASK          (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS        4                   /* 四层共覆盖2^32个刻度，更远的定时器到达最高层后重新放置 */
+#define WHEEL_NIL           UINT32_MAX
+#define WHEEL_LIST_DUE      (WHEEL_LEVELS * WHEEL_SLOTS)        /* 超时为0，等待下一次处理 */
+#define WHEEL_LIST_EXPIRED  (WHEEL_LEVELS * WHEEL_SLOTS + 1)    /* 已经到期，等待回调 */
+#define WHEEL_LIST_NUM      (WHEEL_LEVELS * WHEEL_SLOTS + 2)
+#define WHEEL_LIST_FREE     UINT32_MAX
+
+/* 定时器节点，节点之间使用节点池中的下标链接，节点池扩容时不影响链表 */
+typedef struct wheel_timer {
+    ut_select_schedule_cb   cb;
+    void*               context;
+    uint64_t            expire;             /* 到期的刻度 */
+    uint32_t            prev;
+    uint32_t            next;               /* 空闲时为下一个空闲节点 */
+    uint32_t            list;               /* 所在的链表，空闲时为WHEEL_LIST_FREE */
+    uint32_t            gen;                /* 代数，节点释放时加1，使旧的定时器标识失效 */
+} wheel_timer_t;
+
+typedef struct wheel_list {
+    uint32_t            head;
+    uint32_t            tail;
+} wheel_list_t;
+
+/*
+    分层时间轮：第L层的每个槽覆盖2^(8L)个刻度，定时器按距离到期的刻度数放入对应的层，
+    低层转完一圈时把高一层当前槽中的定时器重新放到低层。cur是下一个要处理的刻度
+ */
+typedef struct internal_wheel {
+    int64_t             resolution_ns;      /* 一个刻度的长度 */
+    int64_t             base_ns;            /* 刻度0对应的CLOCK_MONOTONIC时间 */
+    uint64_t            cur;                /* 下一个要处理的刻度 */
+    uint32_t            pending;            /* 时间轮各层中定时器的个数，不包括DUE和EXPIRED链表 */
+    uint32_t            count;              /* 定时器总数 */
+    wheel_timer_t       *timers;            /* 节点池 */
+    uint32_t            timer_max;
+    uint32_t            timer_used;         /* 节点池中使用过的节点个数，之后的节点从未使用 */
+    uint32_t            timer_free;         /* 空闲节点链表 */
+    uint64_t            bitmap[WHEEL_LEVELS][WHEEL_SLOTS / 64];     /* 每一层不为空的槽 */
+    wheel_list_t        lists[WHEEL_LIST_NUM];
+} inn_wheel_t;
+
+
+/**
+ * 初始化时间轮
+ * @param [in] wheel 时间轮指针，必须已经清零
+ * @param [in] resolution_us 一个刻度的长度，单位微秒us
+ * @retval ut_errno_t
+ */
+ut_errno_t __wheel_init(inn_wheel_t *wheel, int64_t resolution_us);
+
+/**
+ * 释放时间轮的节点池，未到期的定时器直接丢弃
+ * @param [in] wheel 时间轮指针
+ */
+void __wheel_free(inn_wheel_t *wheel);
+
+/**
+ * 修改刻度的长度，只能在没有定时器时修改
+ * @param [in] wheel 时间轮指针
+ * @param [in] resolution_us 一个刻度的长度，单位微秒us
+ * @retval ut_errno_t 还有定时器时返回UT_ERRNO_RESOURCE
+ */
+ut_errno_t __wheel_set_resolution(inn_wheel_t *wheel, int64_t resolution_us);
+
+/**
+ * 增加一个定时器，到期的刻度向上取整，不会提前到期
+ * @param [in] wheel 时间轮指针
+ * @param [in] callback 到期的回调
+ * @param [in] context 回调的上下文
+ * @param [in] timeout_us 定时器时长，单位微秒us，为0时在下一次处理时到期
+ * @param [out] timer 传出定时器的标识，可以为NULL
+ * @retval ut_errno_t
+ */
+ut_errno_t __wheel_add(inn_wheel_t *wheel, ut_select_schedule_cb callback, void* context, int64_t timeout_us, ut_select_timer_t *timer);
+
+/**
+ * 删除一个还没有回调的定时器
+ * @param [in] wheel 时间轮指针
+ * @param [in] timer 定时器的标识
+ * @retval ut_errno_t 定时器已经回调或已经删除时返回UT_ERRNO_NOTEXSIT
+ */
+ut_errno_t __wheel_del(inn_wheel_t *wheel, ut_select_timer_t timer);
+
+/**
+ * 处理到当前时间为止的所有刻度，到期的定时器移入EXPIRED链表
+ * @param [in] wheel 时间轮指针
+ */
+void __wheel_advance(inn_wheel_t *wheel);
+
+/**
+ * 取出一个已经到期的定时器并释放节点
+ * @param [in] wheel 时间轮指针
+ * @param [out] callback 到期的回调
+ * @param [out] context 回调的上下文
+ * @retval ut_bool_t 没有到期的定时器时返回UT_FALSE
+ */
+ut_bool_t __wheel_pop_expired(inn_wheel_t *wheel, ut_select_schedule_cb *callback, void** context);
+
+/**
+ * 距离下一次需要处理时间轮的时间。高层的槽以转到低层的时刻为准，可能早于定时器真正到期
+ * @param [in] wheel 时间轮指针
+ * @retval int64_t 单位微秒us，没有定时器时返回-1
+ */
+int64_t __wheel_next_us(const inn_wheel_t *wheel);
+
+#endif
@@ -0,0 +1,390 @@
+/**
+ * @file ut_select_wheel.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 事件引擎的定时器：分层时间轮。定时器放在节点池中，增加和删除只是链表操作，
+ *        时间以CLOCK_MONOTONIC为准，按刻度处理，不受系统时间调整的影响
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <time.h>
+#include <string.h>
+#include "ut_select_inn.h"
+
+#define WHEEL_TIMER_MIN         64
+#define WHEEL_TIMEOUT_MAX_US    ((int64_t)1 << 50)  /* 更长的定时器按这个时长处理，避免换算成纳秒时溢出 */
+#define WHEEL_IS_SLOT(list)     ((list) < WHEEL_LIST_DUE)
+
+static int64_t __wheel_now_ns(void);
+static uint64_t __wheel_next_tick(const inn_wheel_t *wheel);
+static uint32_t __wheel_node_alloc(inn_wheel_t *wheel);
+static void __wheel_node_free(inn_wheel_t *wheel, uint32_t idx);
+static void __wheel_link(inn_wheel_t *wheel, uint32_t idx, uint32_t list);
+static void __wheel_unlink(inn_wheel_t *wheel, uint32_t idx);
+static void __wheel_place(inn_wheel_t *wheel, uint32_t idx);
+static void __wheel_move(inn_wheel_t *wheel, uint32_t from, uint32_t to);
+static void __wheel_cascade(inn_wheel_t *wheel, uint32_t level, uint32_t slot);
+static int32_t __wheel_bitmap_next(const uint64_t *bitmap, uint32_t start);
+
+
+ut_errno_t __wheel_init(inn_wheel_t *wheel, int64_t resolution_us)
+{
+    if (resolution_us <= 0) {
+        return UT_ERRNO_INVALID;
+    }
+
+    wheel->resolution_ns = resolution_us * 1000;
+    wheel->base_ns = __wheel_now_ns();
+    wheel->cur = 0;
+    wheel->timer_free = WHEEL_NIL;
+    for (uint32_t i = 0; i < WHEEL_LIST_NUM; i++) {
+        wheel->lists[i].head = WHEEL_NIL;
+        wheel->lists[i].tail = WHEEL_NIL;
+    }
+
+    return UT_ERRNO_OK;
+}
+
+void __wheel_free(inn_wheel_t *wheel)
+{
+    free(wheel->timers);
+    wheel->timers = NULL;
+    wheel->timer_max = 0;
+    wheel->timer_used = 0;
+}
+
+ut_errno_t __wheel_set_resolution(inn_wheel_t *wheel, int64_t resolution_us)
+{
+    if (resolution_us <= 0) {
+        return UT_ERRNO_INVALID;
+    }
+    if (wheel->count != 0) {
+        return UT_ERRNO_RESOURCE;
+    }
+
+    /* 没有定时器，直接以当前时间作为新的刻度0 */
+    wheel->resolution_ns = resolution_us * 1000;
+    wheel->base_ns = __wheel_now_ns();
+    wheel->cur = 0;
+
+    return UT_ERRNO_OK;
+}
+
+ut_errno_t __wheel_add(inn_wheel_t *wheel, ut_select_schedule_cb callback, void* context, int64_t timeout_us, ut_select_timer_t *timer)
+{
+    uint32_t        idx = 0;
+    wheel_timer_t*  node = NULL;
+
+    if (timeout_us < 0) {
+        return UT_ERRNO_INVALID;
+    }
+
+    idx = __wheel_node_alloc(wheel);
+    if (idx == WHEEL_NIL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    node = &wheel->timers[idx];
+    node->cb = callback;
+    node->context = context;
+
+    if (timeout_us == 0) {
+        __wheel_link(wheel, idx, WHEEL_LIST_DUE);
+    } else {
+        int64_t     expire_ns = __wheel_now_ns() - wheel->base_ns + min(timeout_us, WHEEL_TIMEOUT_MAX_US) * 1000;
+
+        node->expire = (uint64_t)((expire_ns + wheel->resolution_ns - 1) / wheel->resolution_ns);
+        __wheel_place(wheel, idx);
+    }
+    wheel->count++;
+
+    if (timer != NULL) {
+        *timer = ((uint64_t)node->gen << 32) | idx;
+    }
+    return UT_ERRNO_OK;
+}
+
+ut_errno_t __wheel_del(inn_wheel_t *wheel, ut_select_timer_t timer)
+{
+    uint32_t        idx = (uint32_t)timer;
+
+    if (idx >= wheel->timer_used || wheel->timers[idx].list == WHEEL_LIST_FREE || wheel->timers[idx].gen != (uint32_t)(timer >> 32)) {
+        return UT_ERRNO_NOTEXSIT;
+    }
+
+    __wheel_unlink(wheel, idx);
+    __wheel_node_free(wheel, idx);
+
+    return UT_ERRNO_OK;
+}
+
+void __wheel_advance(inn_wheel_t *wheel)
+{
+    uint64_t        now_tick = (uint64_t)((__wheel_now_ns() - wheel->base_ns) / wheel->resolution_ns);
+    uint32_t        idx = 0;
+
+    __wheel_move(wheel, WHEEL_LIST_DUE, WHEEL_LIST_EXPIRED);
+
+    while (wheel->cur <= now_tick && wheel->pending != 0) {
+        idx = wheel->cur & WHEEL_MASK;
+
+        /* 最低层转完一圈，把高层当前槽中的定时器放回低层；某一层的槽号不为0时更高层还没有转完 */
+        if (idx == 0) {
+            for (uint32_t level = 1; level < WHEEL_LEVELS; level++) {
+                uint32_t    level_slot = (wheel->cur >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+                __wheel_cascade(wheel, level, level_slot);
+                if (level_slot != 0) {
+                    break;
+                }
+            }
+        }
+        __wheel_move(wheel, idx, WHEEL_LIST_EXPIRED);
+        wheel->cur++;
+
+        /* 直接跳到下一个有定时器到期或需要放回低层的刻度，但不超过当前时间，否则之后加入的定时器会被推迟 */
+        if (wheel->pending != 0) {
+            wheel->cur = min(__wheel_next_tick(wheel), now_tick + 1);
+        }
+    }
+
+    /* 时间轮中没有定时器时刻度直接追上当前时间 */
+    if (wheel->cur <= now_tick) {
+        wheel->cur = now_tick + 1;
+    }
+}
+
+ut_bool_t __wheel_pop_expired(inn_wheel_t *wheel, ut_select_schedule_cb *callback, void** context)
+{
+    uint32_t        idx = wheel->lists[WHEEL_LIST_EXPIRED].head;
+
+    if (idx == WHEEL_NIL) {
+        return UT_FALSE;
+    }
+
+    *callback = wheel->timers[idx].cb;
+    *context = wheel->timers[idx].context;
+    __wheel_unlink(wheel, idx);
+    __wheel_node_free(wheel, idx);
+
+    return UT_TRUE;
+}
+
+int64_t __wheel_next_us(const inn_wheel_t *wheel)
+{
+    int64_t         wait_ns = 0;
+
+    if (wheel->lists[WHEEL_LIST_DUE].head != WHEEL_NIL || wheel->lists[WHEEL_LIST_EXPIRED].head != WHEEL_NIL) {
+        return 0;
+    }
+    if (wheel->pending == 0) {
+        return -1;
+    }
+
+    wait_ns = wheel->base_ns + (int64_t)__wheel_next_tick(wheel) * wheel->resolution_ns - __wheel_now_ns();
+    return wait_ns <= 0 ? 0 : (wait_ns + 999) / 1000;
+}
+
+
+
+
+static int64_t __wheel_now_ns(void)
+{
+    struct timespec     now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 * 1000 * 1000 + now.tv_nsec;
+}
+
+/**
+ * 下一个需要处理的刻度：最低层有定时器到期，或高层有不为空的槽需要放回低层。时间轮中必须有定时器
+ */
+static uint64_t __wheel_next_tick(const inn_wheel_t *wheel)
+{
+    uint64_t        best = UINT64_MAX;
+
+    /*
+        第L层的槽在刻度的低8L位为0时转到低层。cur正好在边界上时当前槽还没有转下去，
+        否则当前槽已经处理过，从下一个槽开始找
+     */
+    for (uint32_t level = 0; level < WHEEL_LEVELS; level++) {
+        uint32_t    shift = WHEEL_BITS * level;
+        uint64_t    base = wheel->cur >> shift;
+        uint32_t    off = (wheel->cur & (((uint64_t)1 << shift) - 1)) == 0 ? 0 : 1;
+        uint32_t    start = (base + off) & WHEEL_MASK;
+        int32_t     slot = __wheel_bitmap_next(wheel->bitmap[level], start);
+
+        if (slot < 0) {
+            slot = __wheel_bitmap_next(wheel->bitmap[level], 0);
+            if (slot < 0) {
+                continue;
+            }
+        }
+        best = min(best, (base + off + (((uint32_t)slot - start) & WHEEL_MASK)) << shift);
+    }
+
+    return best;
+}
+
+/**
+ * 从节点池中取一个节点，节点池用完时加倍
+ */
+static uint32_t __wheel_node_alloc(inn_wheel_t *wheel)
+{
+    uint32_t        idx = wheel->timer_free;
+
+    if (idx != WHEEL_NIL) {
+        wheel->timer_free = wheel->timers[idx].next;
+        return idx;
+    }
+
+    if (wheel->timer_used == wheel->timer_max) {
+        uint32_t        new_max = max(wheel->timer_max * 2, WHEEL_TIMER_MIN);
+        wheel_timer_t*  new_timers = NULL;
+
+        if (wheel->timer_max >= WHEEL_NIL / 2) {
+            return WHEEL_NIL;
+        }
+        new_timers = realloc(wheel->timers, (size_t)new_max * sizeof(wheel_timer_t));
+        if (new_timers == NULL) {
+            return WHEEL_NIL;
+        }
+        wheel->timers = new_timers;
+        wheel->timer_max = new_max;
+    }
+
+    idx = wheel->timer_used++;
+    wheel->timers[idx].gen = 1;
+    return idx;
+}
+
+static void __wheel_node_free(inn_wheel_t *wheel, uint32_t idx)
+{
+    wheel_timer_t*  node = &wheel->timers[idx];
+
+    node->list = WHEEL_LIST_FREE;
+    node->gen++;
+    node->next = wheel->timer_free;
+    wheel->timer_free = idx;
+    wheel->count--;
+}
+
+/**
+ * 把节点加到链表的尾部，同一个槽中的定时器按加入的顺序回调
+ */
+static void __wheel_link(inn_wheel_t *wheel, uint32_t idx, uint32_t list)
+{
+    wheel_timer_t*  node = &wheel->timers[idx];
+    wheel_list_t*   head = &wheel->lists[list];
+
+    node->list = list;
+    node->next = WHEEL_NIL;
+    node->prev = head->tail;
+    if (head->tail == WHEEL_NIL) {
+        head->head = idx;
+    } else {
+        wheel->timers[head->tail].next = idx;
+    }
+    head->tail = idx;
+
+    if (WHEEL_IS_SLOT(list)) {
+        wheel->bitmap[list >> WHEEL_BITS][(list & WHEEL_MASK) >> 6] |= (uint64_t)1 << (list & 63);
+        wheel->pending++;
+    }
+}
+
+static void __wheel_unlink(inn_wheel_t *wheel, uint32_t idx)
+{
+    wheel_timer_t*  node = &wheel->timers[idx];
+    wheel_list_t*   head = &wheel->lists[node->list];
+
+    if (node->prev == WHEEL_NIL) {
+        head->head = node->next;
+    } else {
+        wheel->timers[node->prev].next = node->next;
+    }
+    if (node->next == WHEEL_NIL) {
+        head->tail = node->prev;
+    } else {
+        wheel->timers[node->next].prev = node->prev;
+    }
+
+    if (WHEEL_IS_SLOT(node->list)) {
+        if (head->head == WHEEL_NIL) {
+            wheel->bitmap[node->list >> WHEEL_BITS][(node->list & WHEEL_MASK) >> 6] &= ~((uint64_t)1 << (node->list & 63));
+        }
+        wheel->pending--;
+    }
+}
+
+/**
+ * 按距离到期的刻度数选择层，放入到期刻度对应的槽；超出最高层范围的先放在最高层最远的槽
+ */
+static void __wheel_place(inn_wheel_t *wheel, uint32_t idx)
+{
+    uint64_t        expire = max(wheel->timers[idx].expire, wheel->cur);
+    uint64_t        delta = expire - wheel->cur;
+    uint32_t        level = 0;
+
+    if (delta >= (uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) {
+        delta = ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+        expire = wheel->cur + delta;
+    }
+    while (level < WHEEL_LEVELS - 1 && delta >= (uint64_t)1 << (WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+
+    __wheel_link(wheel, idx, level * WHEEL_SLOTS + ((expire >> (WHEEL_BITS * level)) & WHEEL_MASK));
+}
+
+/**
+ * 把一个链表中的节点全部按顺序移到另一个链表
+ */
+static void __wheel_move(inn_wheel_t *wheel, uint32_t from, uint32_t to)
+{
+    uint32_t        idx = wheel->lists[from].head;
+
+    while (idx != WHEEL_NIL) {
+        uint32_t    next = wheel->timers[idx].next;
+
+        __wheel_unlink(wheel, idx);
+        __wheel_link(wheel, idx, to);
+        idx = next;
+    }
+}
+
+/**
+ * 高层一个槽中的定时器按当前刻度重新放置，此时它们都会落到更低的层
+ */
+static void __wheel_cascade(inn_wheel_t *wheel, uint32_t level, uint32_t slot)
+{
+    uint32_t        list = level * WHEEL_SLOTS + slot;
+    uint32_t        idx = wheel->lists[list].head;
+
+    while (idx != WHEEL_NIL) {
+        uint32_t    next = wheel->timers[idx].next;
+
+        __wheel_unlink(wheel, idx);
+        __wheel_place(wheel, idx);
+        idx = next;
+    }
+}
+
+/**
+ * 在一层的位图中找下标不小于start的第一个不为空的槽
+ */
+static int32_t __wheel_bitmap_next(const uint64_t *bitmap, uint32_t start)
+{
+    uint32_t        word = start >> 6;
+    uint64_t        bits = bitmap[word] & (~(uint64_t)0 << (start & 63));
+
+    while (bits == 0) {
+        if (++word >= WHEEL_SLOTS / 64) {
+            return -1;
+        }
+        bits = bitmap[word];
+    }
+
+    return (int32_t)(word * 64 + __builtin_ctzll(bits));
+}
@@ -16,7 +16,7 @@
 #include <net/if.h>
 
 #include "ut/ut_socket.h"
-#include "ut/ut_hash.h"
+#include "ut/ut_hash_u64.h"
 #include "ut/ut_select.h"
 
 struct ut_socket_t {
@@ -26,7 +26,7 @@ struct ut_socket_t {
 
         } tcp;
         struct {
-            ut_hash_t*      hh;
+            ut_hash_u64_t*  hh;
             ut_bool_t       registered;         /* has registered to select engine or not */
             ut_select_engine_t* engine;         /* 如果已注册，则记录注册时使用的select引擎 */
             ut_fd_t         pipe[2];            /* make UDP similar to TCP. If it's origin socket, use it for new connection,
@@ -43,7 +43,12 @@ struct ut_socket_t {
 };
 
 
-static uint32_t __udp_hash_func(const char *key);
+/* UDP远端在哈希表中的键：高位为IPv4地址，低16位为端口 */
+static inline uint64_t __udp_peer_key(const struct sockaddr_in* addr)
+{
+    return ((uint64_t)addr->sin_addr.s_addr << 16) | addr->sin_port;
+}
+
 static void __udp_reg_callback(ut_fd_t fd, void* context);
 static void __udp_reg_callback2(ut_fd_t fd, void* context);
 
@@ -119,18 +124,16 @@ ut_errno_t ut_socket_destroy(ut_socket_t* sock)
         }
         /* 如果是accept所创建出来的socket，在父socket的哈希表中删除自己 */
         if (sock->diff.udp.belong_to != NULL) {
-            char addrbuffer[UT_LEN_128] = {0};
-            snprintf(addrbuffer, UT_LEN_32 - 1, "%d:%hd", 
-                     sock->st_remote_addr.sin_addr.s_addr, 
-                     sock->st_remote_addr.sin_port);
-            if (ut_hash_pop(sock->diff.udp.belong_to->diff.udp.hh, addrbuffer) == NULL) {
+            uint64_t    peer = __udp_peer_key(&sock->st_remote_addr);
+
+            if (ut_hash_u64_pop(sock->diff.udp.belong_to->diff.udp.hh, peer) == NULL) {
                 retval = UT_ERRNO_UNKNOWN;
             }
         }
         /* 如果哈希表已创建，则销毁所有已连接的子socket并销毁哈希表 */
         if (sock->diff.udp.hh) {
-            ut_hash_foreach(sock->diff.udp.hh, NULL, sock);   /* 销毁已连接的socket */
-            ut_hash_destroy(sock->diff.udp.hh);  /* 销毁哈希表 */
+            ut_hash_u64_foreach(sock->diff.udp.hh, NULL, sock);   /* 销毁已连接的socket */
+            ut_hash_u64_destroy(sock->diff.udp.hh);  /* 销毁哈希表 */
         }
         /* 如果管道已创建，则销毁管道 */
         if (PIPE_RD_FD(sock->diff.udp.pipe) != 0) {
@@ -240,13 +243,12 @@ ut_errno_t ut_socket_accept(ut_socket_t** out, ut_socket_t* sock, ut_select_engi
         }
         case UT_TRANS_UDP:
         {
-            char        addrbuffer[UT_LEN_32] = {0};
             size_t      readlen = 0;
 
             /* 首次调用，还未注册到select engine */
             if (!sock->diff.udp.registered) {
                 pipe(sock->diff.udp.pipe);   /* 这个管道用于新的连接时，会通过该管道传输过来 */
-                ut_hash_create(&sock->diff.udp.hh, sock->max_num, __udp_hash_func);
+                ut_hash_u64_create(&sock->diff.udp.hh, sock->max_num);
 
                 /* 将socket注册到select engine，如果不是新的连接，是旧的数据，那么就会发往对应的管道 */
                 retval = ut_select_engine_fd_add_forever(engine, sock->fd, __udp_reg_callback, sock);
@@ -266,10 +268,8 @@ ut_errno_t ut_socket_accept(ut_socket_t** out, ut_socket_t* sock, ut_select_engi
             CHECK_PTR_RET(accepted_sock, retval, UT_ERRNO_OUTOFMEM);
             memcpy(accepted_sock, &tmp_sock, sizeof(ut_socket_t));
 
-            snprintf(addrbuffer, UT_LEN_32 - 1, "%d:%hd", 
-                                                accepted_sock->st_remote_addr.sin_addr.s_addr, 
-                                                accepted_sock->st_remote_addr.sin_port);
-            ut_hash_push(sock->diff.udp.hh, addrbuffer, accepted_sock);   /* 将新的UDP连接放进哈希表中 */
+            /* 将新的UDP连接放进哈希表中 */
+            ut_hash_u64_push(sock->diff.udp.hh, __udp_peer_key(&accepted_sock->st_remote_addr), accepted_sock);
             break;
         }
         default:
@@ -408,21 +408,11 @@ TAG_OUT:
 
 
 
-static uint32_t __udp_hash_func(const char *key)
-{
-    in_addr_t   addr = 0;
-    in_port_t   port = 0;
-
-    sscanf(key, "%d:%hd", &addr, &port);
-    return (addr << 16) | port;
-}
-
 static void __udp_reg_callback(ut_fd_t fd, void* context)
 {
     ut_socket_t*        sock = (ut_socket_t*)context;
     ut_socket_t*        remote_sock = NULL;
     char                buffer[UT_LEN_1024 + 1] = {0};
-    char                addrbuffer[UT_LEN_32] = {0};
     struct sockaddr_in  sockaddr;
     socklen_t           socklen = sizeof(struct sockaddr_in);
     ssize_t             recvlen = 0;
@@ -439,8 +429,7 @@ static void __udp_reg_callback(ut_fd_t fd, void* context)
         goto TAG_OUT;
     }
 
-    snprintf(addrbuffer, UT_LEN_32 - 1, "%d:%hd", sockaddr.sin_addr.s_addr, sockaddr.sin_port);
-    remote_sock = (ut_socket_t*)ut_hash_peek(sock->diff.udp.hh, addrbuffer);
+    remote_sock = (ut_socket_t*)ut_hash_u64_peek(sock->diff.udp.hh, __udp_peer_key(&sockaddr));
     if (remote_sock != NULL) {      /* 如果消息不是第一次收到了，转发给消息管道 */
         write(PIPE_WR_FD(remote_sock->diff.udp.pipe), buffer, recvlen);
     } else {                        /* 消息第一次收到，构造新的远端结构体 */
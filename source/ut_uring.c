@@ -0,0 +1,1074 @@
+/**
+ * @file ut_uring.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief io_uring完成式事件引擎。通过io_uring_setup/io_uring_enter/io_uring_register三个系统调用直接操作
+ *        提交队列和完成队列；内核不支持时回退到epoll后端的select事件引擎，在fd可读时执行对应的操作
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#define _GNU_SOURCE         /* accept4 */
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+
+#include "ut/ut_uring.h"
+#include "ut/ut_select.h"
+#include "ut/ut_hash_u64.h"
+
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+#define URING_NATIVE        1
+#endif
+#endif
+#endif
+
+#define URING_ENTRIES_MAX   4096
+#define URING_BUFFERS_MAX   32768       /* 提供给内核的缓冲区环最多2^15个 */
+#define URING_BUF_GROUP     0
+
+typedef enum {
+    URING_OP_READ,
+    URING_OP_WRITE,
+    URING_OP_ACCEPT,
+    URING_OP_RECV,
+    URING_OP_TIMEOUT,
+    URING_OP_WAKEUP,                    /* 内部使用：ut_uring_stop唤醒事件循环 */
+} uring_op_type_t;
+
+/* 提交的操作，作为io_uring的user_data或回退时select事件引擎的上下文，操作结束时释放 */
+typedef struct uring_op {
+    uring_op_type_t     type;
+    ut_fd_t             fd;
+    void*               buf;
+    uint32_t            len;
+    int64_t             offset;
+    ut_uring_cb         cb;
+    void*               context;
+    ut_uring_t*         ring;
+    struct uring_op     *prev;          /* 所有未结束的操作串成链表，销毁时统一释放 */
+    struct uring_op     *next;
+#ifdef URING_NATIVE
+    struct __kernel_timespec    ts;     /* 定时器时长 */
+    ut_bool_t           multishot;      /* 以多次完成的方式提交，否则每次完成后由事件循环重新提交 */
+#endif
+} uring_op_t;
+
+struct ut_uring_t {
+    ut_bool_t           native;         /* 是否直接使用io_uring */
+    ut_bool_t           need_continue;
+    ut_fd_t             wake_fd;        /* eventfd，其他线程停止事件循环时写入 */
+    uring_op_t          *wake_op;
+    uring_op_t          *ops;           /* 未结束的操作 */
+
+    char                *buf_base;      /* 注册的缓冲区 */
+    uint32_t            buf_count;
+    uint32_t            buf_size;
+    uint32_t            *buf_free;      /* 回退时空闲缓冲区的栈 */
+    uint32_t            buf_free_num;
+
+#ifdef URING_NATIVE
+    ut_fd_t             ring_fd;
+    uint32_t            sq_entries;
+    uint32_t            *sq_head;
+    uint32_t            *sq_tail;
+    uint32_t            sq_mask;
+    uint32_t            sq_local_tail;  /* 已经填好但还没有交给内核的提交项 */
+    struct io_uring_sqe *sqes;
+    uint32_t            *cq_head;
+    uint32_t            *cq_tail;
+    uint32_t            cq_mask;
+    struct io_uring_cqe *cqes;
+    void*               sq_ring;
+    size_t              sq_ring_size;
+    void*               cq_ring;
+    size_t              cq_ring_size;
+    size_t              sqes_size;
+    struct io_uring_buf_ring    *buf_ring;  /* 提供给内核的缓冲区环 */
+    size_t              buf_ring_size;
+    uint16_t            buf_tail;
+    uint32_t            single_shot;    /* 内核不支持多次完成的操作类型，按1 << uring_op_type_t记录 */
+    ut_bool_t           wake_rearm;     /* 唤醒用的poll需要重新提交 */
+#endif
+
+    ut_select_engine_t  *engine;        /* 回退使用的select事件引擎 */
+    ut_hash_u64_t       *fd_ops;        /* 回退时每个fd上等待可读的操作 */
+};
+
+
+static uring_op_t* __op_alloc(ut_uring_t *ring, uring_op_type_t type, ut_fd_t fd, ut_uring_cb callback, void* context);
+static void __op_free(ut_uring_t *ring, uring_op_t *op);
+static ut_errno_t __op_submit(ut_uring_t *ring, uring_op_t *op);
+#ifdef URING_NATIVE
+static ut_errno_t __native_create(ut_uring_t *ring, uint32_t entries);
+static ut_errno_t __native_probe_pbuf(ut_uring_t *ring);
+static ut_errno_t __native_probe_cancel(ut_uring_t *ring);
+static void __native_destroy(ut_uring_t *ring);
+static struct io_uring_sqe* __native_get_sqe(ut_uring_t *ring);
+static int32_t __native_enter(ut_uring_t *ring, ut_bool_t wait);
+static ut_errno_t __native_submit(ut_uring_t *ring, uring_op_t *op);
+static void __native_dispatch(ut_uring_t *ring);
+static ut_errno_t __native_rearm_wakeup(ut_uring_t *ring);
+static ut_bool_t __native_complete_single(ut_uring_t *ring, uring_op_t *op, int32_t res);
+#endif
+static ut_errno_t __poll_submit(ut_uring_t *ring, uring_op_t *op);
+static void __poll_ready_cb(ut_fd_t fd, void* context);
+static void __poll_sync_cb(void* context);
+static void __poll_finish(ut_uring_t *ring, uring_op_t *op, int32_t res);
+
+
+ut_errno_t ut_uring_create(ut_uring_t **ring, uint32_t entries, uint32_t flags)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+    ut_uring_t      *new_ring = NULL;
+
+    if (ring == NULL || entries == 0) {
+        return UT_ERRNO_INVALID;
+    }
+
+    new_ring = ut_zero_alloc(sizeof(ut_uring_t));
+    if (new_ring == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    new_ring->need_continue = UT_TRUE;
+    new_ring->wake_fd = -1;
+
+#ifdef URING_NATIVE
+    new_ring->ring_fd = -1;
+    if (!(flags & UT_URING_FLAG_FORCE_POLL) && __native_create(new_ring, min(entries, URING_ENTRIES_MAX)) == UT_ERRNO_OK) {
+        new_ring->native = UT_TRUE;
+        if (flags & UT_URING_FLAG_SINGLE_SHOT) {
+            new_ring->single_shot = (1U << URING_OP_ACCEPT) | (1U << URING_OP_RECV);
+        }
+    }
+#endif
+
+    if (new_ring->native) {
+        /* 事件循环阻塞在io_uring_enter中，其他线程通过eventfd唤醒 */
+        new_ring->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        new_ring->wake_op = __op_alloc(new_ring, URING_OP_WAKEUP, new_ring->wake_fd, NULL, NULL);
+        if (new_ring->wake_fd < 0 || new_ring->wake_op == NULL) {
+            retval = UT_ERRNO_UNKNOWN;
+            goto _destroy;
+        }
+        retval = __op_submit(new_ring, new_ring->wake_op);
+        if (retval != UT_ERRNO_OK) {
+            goto _destroy;
+        }
+    } else {
+        if (flags & UT_URING_FLAG_FORCE_POLL) {
+            UT_LOG_INFO("io_uring is disabled by UT_URING_FLAG_FORCE_POLL, use epoll.\n");
+        } else {
+            UT_LOG_INFO("io_uring is not available, fall back to epoll.\n");
+        }
+        retval = ut_select_engine_create_ex(&new_ring->engine, UT_SELECT_BACKEND_EPOLL);
+        if (retval != UT_ERRNO_OK) {
+            goto _destroy;
+        }
+        retval = ut_hash_u64_create(&new_ring->fd_ops, 64);
+        if (retval != UT_ERRNO_OK) {
+            goto _destroy;
+        }
+    }
+
+    *ring = new_ring;
+    return UT_ERRNO_OK;
+
+_destroy:
+    ut_uring_destroy(new_ring);
+    return retval;
+}
+
+ut_errno_t ut_uring_destroy(ut_uring_t *ring)
+{
+    if (ring == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    /* 先关闭io_uring或select事件引擎，确保不会再有回调，再释放未结束的操作 */
+#ifdef URING_NATIVE
+    __native_destroy(ring);
+#endif
+    if (ring->engine != NULL) {
+        ut_select_engine_destroy(ring->engine);
+    }
+    if (ring->fd_ops != NULL) {
+        ut_hash_u64_destroy(ring->fd_ops);
+    }
+    while (ring->ops != NULL) {
+        __op_free(ring, ring->ops);
+    }
+    if (ring->wake_fd >= 0) {
+        close(ring->wake_fd);
+    }
+    free(ring->buf_base);
+    free(ring->buf_free);
+    free(ring);
+
+    return UT_ERRNO_OK;
+}
+
+ut_bool_t ut_uring_is_native(const ut_uring_t *ring)
+{
+    return ring != NULL && ring->native;
+}
+
+ut_errno_t ut_uring_buffer_register(ut_uring_t *ring, uint32_t count, uint32_t size)
+{
+    uint32_t        num = 1;
+
+    if (ring == NULL || count == 0 || count > URING_BUFFERS_MAX || size == 0 || ring->buf_base != NULL) {
+        return UT_ERRNO_INVALID;
+    }
+    while (num < count) {
+        num <<= 1;
+    }
+
+    if (posix_memalign((void**)&ring->buf_base, 4096, (size_t)num * size) != 0) {
+        ring->buf_base = NULL;
+        return UT_ERRNO_OUTOFMEM;
+    }
+    ring->buf_count = num;
+    ring->buf_size = size;
+
+#ifdef URING_NATIVE
+    if (ring->native) {
+        struct io_uring_buf_reg reg;
+
+        /* 缓冲区环必须按页对齐，环的尾指针与第一个缓冲区描述的保留字段重叠 */
+        ring->buf_ring_size = (size_t)num * sizeof(struct io_uring_buf);
+        ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (ring->buf_ring == MAP_FAILED) {
+            ring->buf_ring = NULL;
+            goto _free;
+        }
+
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+        reg.ring_entries = num;
+        reg.bgid = URING_BUF_GROUP;
+        if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            UT_LOG_ERROR("register buffer ring failed.(%s)\n", strerror(errno));
+            munmap(ring->buf_ring, ring->buf_ring_size);
+            ring->buf_ring = NULL;
+            goto _free;
+        }
+        for (uint32_t i = 0; i < num; i++) {
+            ut_uring_buffer_release(ring, ring->buf_base + (size_t)i * size);
+        }
+        return UT_ERRNO_OK;
+    }
+#endif
+
+    ring->buf_free = malloc(num * sizeof(uint32_t));
+    if (ring->buf_free == NULL) {
+        goto _free;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        ring->buf_free[i] = num - 1 - i;
+    }
+    ring->buf_free_num = num;
+    return UT_ERRNO_OK;
+
+_free:
+    free(ring->buf_base);
+    ring->buf_base = NULL;
+    ring->buf_count = 0;
+    return UT_ERRNO_UNKNOWN;
+}
+
+ut_errno_t ut_uring_buffer_release(ut_uring_t *ring, void* buf)
+{
+    size_t          offset = 0;
+    uint32_t        bid = 0;
+
+    if (ring == NULL || ring->buf_base == NULL || (char*)buf < ring->buf_base) {
+        return UT_ERRNO_INVALID;
+    }
+    offset = (size_t)((char*)buf - ring->buf_base);
+    if (offset % ring->buf_size != 0 || offset / ring->buf_size >= ring->buf_count) {
+        return UT_ERRNO_INVALID;
+    }
+    bid = (uint32_t)(offset / ring->buf_size);
+
+#ifdef URING_NATIVE
+    if (ring->native) {
+        struct io_uring_buf*    desc = &ring->buf_ring->bufs[ring->buf_tail & (ring->buf_count - 1)];
+
+        desc->addr = (uint64_t)(uintptr_t)buf;
+        desc->len = ring->buf_size;
+        desc->bid = (uint16_t)bid;
+        ring->buf_tail++;
+        __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+        return UT_ERRNO_OK;
+    }
+#endif
+
+    ring->buf_free[ring->buf_free_num++] = bid;
+    return UT_ERRNO_OK;
+}
+
+ut_errno_t ut_uring_read(ut_uring_t *ring, ut_fd_t fd, void* buf, uint32_t len, int64_t offset, ut_uring_cb callback, void* context)
+{
+    uring_op_t*     op = NULL;
+
+    if (ring == NULL || fd < 0 || buf == NULL || callback == NULL || offset < -1) {
+        return UT_ERRNO_INVALID;
+    }
+
+    op = __op_alloc(ring, URING_OP_READ, fd, callback, context);
+    if (op == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    op->buf = buf;
+    op->len = len;
+    op->offset = offset;
+
+    return __op_submit(ring, op);
+}
+
+ut_errno_t ut_uring_write(ut_uring_t *ring, ut_fd_t fd, const void* buf, uint32_t len, int64_t offset, ut_uring_cb callback, void* context)
+{
+    uring_op_t*     op = NULL;
+
+    if (ring == NULL || fd < 0 || buf == NULL || callback == NULL || offset < -1) {
+        return UT_ERRNO_INVALID;
+    }
+
+    op = __op_alloc(ring, URING_OP_WRITE, fd, callback, context);
+    if (op == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    op->buf = (void*)buf;
+    op->len = len;
+    op->offset = offset;
+
+    return __op_submit(ring, op);
+}
+
+ut_errno_t ut_uring_accept(ut_uring_t *ring, ut_fd_t fd, ut_uring_cb callback, void* context)
+{
+    uring_op_t*     op = NULL;
+
+    if (ring == NULL || fd < 0 || callback == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    op = __op_alloc(ring, URING_OP_ACCEPT, fd, callback, context);
+    if (op == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+
+    return __op_submit(ring, op);
+}
+
+ut_errno_t ut_uring_recv(ut_uring_t *ring, ut_fd_t fd, ut_uring_cb callback, void* context)
+{
+    uring_op_t*     op = NULL;
+
+    if (ring == NULL || fd < 0 || callback == NULL || ring->buf_base == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    op = __op_alloc(ring, URING_OP_RECV, fd, callback, context);
+    if (op == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+
+    return __op_submit(ring, op);
+}
+
+ut_errno_t ut_uring_timeout(ut_uring_t *ring, int64_t timeout_us, ut_uring_cb callback, void* context)
+{
+    uring_op_t*     op = NULL;
+
+    if (ring == NULL || timeout_us < 0 || callback == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+
+    op = __op_alloc(ring, URING_OP_TIMEOUT, -1, callback, context);
+    if (op == NULL) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+    op->offset = timeout_us;
+
+    return __op_submit(ring, op);
+}
+
+ut_errno_t ut_uring_cancel(ut_uring_t *ring, ut_fd_t fd)
+{
+    uring_op_t*     op = NULL;
+
+    if (ring == NULL || fd < 0) {
+        return UT_ERRNO_INVALID;
+    }
+
+#ifdef URING_NATIVE
+    if (ring->native) {
+        struct io_uring_sqe*    sqe = __native_get_sqe(ring);
+
+        if (sqe == NULL) {
+            return UT_ERRNO_RESOURCE;
+        }
+
+        /* 取消操作本身的完成项user_data为0，不需要回调 */
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = 0;
+        return UT_ERRNO_OK;
+    }
+#endif
+
+    op = ut_hash_u64_peek(ring->fd_ops, fd);
+    if (op == NULL) {
+        return UT_ERRNO_NOTEXSIT;
+    }
+    __poll_finish(ring, op, -ECANCELED);
+
+    return UT_ERRNO_OK;
+}
+
+int32_t ut_uring_submit(ut_uring_t *ring)
+{
+    if (ring == NULL) {
+        return -1;
+    }
+
+#ifdef URING_NATIVE
+    if (ring->native) {
+        return __native_enter(ring, UT_FALSE);
+    }
+#endif
+
+    return 0;   /* 回退时操作在提交时已经生效 */
+}
+
+ut_errno_t ut_uring_run(ut_uring_t *ring)
+{
+    if (ring == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+    if (!ring->native) {
+        return ut_select_engine_run(ring->engine);
+    }
+
+#ifdef URING_NATIVE
+    /* 一次io_uring_enter提交积攒的所有操作并等待至少一个完成 */
+    while (__atomic_load_n(&ring->need_continue, __ATOMIC_ACQUIRE)) {
+        /* 唤醒用的poll没有重新提交成功时不能阻塞等待，否则ut_uring_stop无法唤醒事件循环 */
+        if (ring->wake_rearm && __native_rearm_wakeup(ring) != UT_ERRNO_OK) {
+            __native_enter(ring, UT_FALSE);
+            __native_dispatch(ring);
+            continue;
+        }
+        if (__native_enter(ring, UT_TRUE) < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            UT_LOG_ERROR("io_uring_enter failed.(%s)\n", strerror(errno));
+            return UT_ERRNO_UNKNOWN;
+        }
+        __native_dispatch(ring);
+    }
+#endif
+
+    __atomic_store_n(&ring->need_continue, UT_TRUE, __ATOMIC_RELEASE);
+    return UT_ERRNO_OK;
+}
+
+ut_errno_t ut_uring_stop(ut_uring_t *ring)
+{
+    uint64_t        one = 1;
+
+    if (ring == NULL) {
+        return UT_ERRNO_INVALID;
+    }
+    if (!ring->native) {
+        return ut_select_engine_stop(ring->engine);
+    }
+
+    __atomic_store_n(&ring->need_continue, UT_FALSE, __ATOMIC_RELEASE);
+    if (write(ring->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        return UT_ERRNO_UNKNOWN;
+    }
+
+    return UT_ERRNO_OK;
+}
+
+
+
+
+static uring_op_t* __op_alloc(ut_uring_t *ring, uring_op_type_t type, ut_fd_t fd, ut_uring_cb callback, void* context)
+{
+    uring_op_t*     op = ut_zero_alloc(sizeof(uring_op_t));
+
+    if (op != NULL) {
+        op->type = type;
+        op->fd = fd;
+        op->cb = callback;
+        op->context = context;
+        op->ring = ring;
+        op->offset = -1;
+        op->next = ring->ops;
+        if (ring->ops != NULL) {
+            ring->ops->prev = op;
+        }
+        ring->ops = op;
+    }
+    return op;
+}
+
+static void __op_free(ut_uring_t *ring, uring_op_t *op)
+{
+    if (op->prev != NULL) {
+        op->prev->next = op->next;
+    } else {
+        ring->ops = op->next;
+    }
+    if (op->next != NULL) {
+        op->next->prev = op->prev;
+    }
+    free(op);
+}
+
+/**
+ * 提交操作，失败时释放操作
+ */
+static ut_errno_t __op_submit(ut_uring_t *ring, uring_op_t *op)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+
+#ifdef URING_NATIVE
+    if (ring->native) {
+        retval = __native_submit(ring, op);
+    } else
+#endif
+    {
+        retval = __poll_submit(ring, op);
+    }
+
+    if (retval != UT_ERRNO_OK) {
+        __op_free(ring, op);
+    }
+    return retval;
+}
+
+#ifdef URING_NATIVE
+
+/**
+ * 创建io_uring实例并映射提交队列、完成队列，检查内核是否支持需要的操作。
+ * 操作码在5.6就已经齐全，缓冲区环和按fd取消（5.19）只能实际注册、提交一次来检查；
+ * accept和recv是否支持多次完成在第一次提交返回-EINVAL时才知道，见__native_dispatch
+ * @param [in] ring 事件引擎
+ * @param [in] entries 提交队列的大小
+ * @retval ut_errno_t 不支持时返回错误，由调用者回退到epoll
+ */
+static ut_errno_t __native_create(ut_uring_t *ring, uint32_t entries)
+{
+    struct io_uring_params  params;
+    struct io_uring_probe*  probe = NULL;
+    const uint8_t           needed[] = {
+        IORING_OP_READ, IORING_OP_WRITE, IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_TIMEOUT,
+        IORING_OP_ASYNC_CANCEL, IORING_OP_POLL_ADD,
+    };
+    uint32_t*               sq_array = NULL;
+    uint8_t*                sq_ptr = NULL;
+    uint8_t*                cq_ptr = NULL;
+
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->ring_fd < 0) {
+        return UT_ERRNO_UNKNOWN;
+    }
+
+    probe = calloc(1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    if (probe == NULL || syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        goto _fail;
+    }
+    for (uint32_t i = 0; i < sizeof(needed); i++) {
+        if (needed[i] > probe->last_op || !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED)) {
+            goto _fail;
+        }
+    }
+    free(probe);
+    probe = NULL;
+
+    /* 老内核的提交队列和完成队列需要分别映射 */
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_ring_size = max(ring->sq_ring_size, ring->cq_ring_size);
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        goto _fail;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            goto _fail;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto _fail;
+    }
+
+    sq_ptr = ring->sq_ring;
+    cq_ptr = ring->cq_ring;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_head = (uint32_t*)(sq_ptr + params.sq_off.head);
+    ring->sq_tail = (uint32_t*)(sq_ptr + params.sq_off.tail);
+    ring->sq_mask = *(uint32_t*)(sq_ptr + params.sq_off.ring_mask);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (uint32_t*)(cq_ptr + params.cq_off.head);
+    ring->cq_tail = (uint32_t*)(cq_ptr + params.cq_off.tail);
+    ring->cq_mask = *(uint32_t*)(cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq_ptr + params.cq_off.cqes);
+
+    /* 提交项在数组中的位置固定与下标相同 */
+    sq_array = (uint32_t*)(sq_ptr + params.sq_off.array);
+    for (uint32_t i = 0; i < params.sq_entries; i++) {
+        sq_array[i] = i;
+    }
+
+    if (__native_probe_pbuf(ring) != UT_ERRNO_OK || __native_probe_cancel(ring) != UT_ERRNO_OK) {
+        goto _fail;
+    }
+
+    return UT_ERRNO_OK;
+
+_fail:
+    free(probe);
+    __native_destroy(ring);
+    return UT_ERRNO_UNKNOWN;
+}
+
+/**
+ * 注册再注销一个只有一项的缓冲区环，检查recv需要的IORING_REGISTER_PBUF_RING
+ */
+static ut_errno_t __native_probe_pbuf(ut_uring_t *ring)
+{
+    ut_errno_t              retval = UT_ERRNO_OK;
+    struct io_uring_buf_reg reg;
+    void*                   buf_ring = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+    if (buf_ring == MAP_FAILED) {
+        return UT_ERRNO_OUTOFMEM;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)buf_ring;
+    reg.ring_entries = 1;
+    reg.bgid = URING_BUF_GROUP;
+    if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        UT_LOG_INFO("io_uring does not support buffer rings.(%s)\n", strerror(errno));
+        retval = UT_ERRNO_UNKNOWN;
+    } else {
+        syscall(__NR_io_uring_register, ring->ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+
+    munmap(buf_ring, 4096);
+    return retval;
+}
+
+/**
+ * 在一个新的eventfd上提交按fd取消，检查ut_uring_cancel需要的IORING_ASYNC_CANCEL_FD。
+ * 支持时没有可以取消的操作，返回-ENOENT；老内核不认识取消标志，返回-EINVAL
+ */
+static ut_errno_t __native_probe_cancel(ut_uring_t *ring)
+{
+    ut_fd_t                 fd = eventfd(0, EFD_CLOEXEC);
+    struct io_uring_sqe*    sqe = NULL;
+    int32_t                 res = -EINVAL;
+    uint32_t                head = 0;
+
+    if (fd < 0) {
+        return UT_ERRNO_UNKNOWN;
+    }
+
+    sqe = __native_get_sqe(ring);
+    if (sqe == NULL) {
+        close(fd);
+        return UT_ERRNO_UNKNOWN;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = 0;
+
+    while (__native_enter(ring, UT_TRUE) < 0) {
+        if (errno != EINTR) {
+            close(fd);
+            return UT_ERRNO_UNKNOWN;
+        }
+    }
+
+    /* 还没有提交过其他操作，完成队列中只有这一项 */
+    head = *ring->cq_head;
+    if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        res = ring->cqes[head & ring->cq_mask].res;
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    }
+    close(fd);
+
+    if (res == -EINVAL) {
+        UT_LOG_INFO("io_uring does not support cancel by fd.\n");
+        return UT_ERRNO_UNKNOWN;
+    }
+    return UT_ERRNO_OK;
+}
+
+static void __native_destroy(ut_uring_t *ring)
+{
+    if (ring->buf_ring != NULL) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+        ring->buf_ring = NULL;
+    }
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+        ring->sqes = NULL;
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    ring->cq_ring = NULL;
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        ring->sq_ring = NULL;
+    }
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+        ring->ring_fd = -1;
+    }
+}
+
+/**
+ * 取得一个空闲的提交项，提交队列满时先把已经填好的提交给内核
+ * @return struct io_uring_sqe* 清零后的提交项，内核繁忙时返回NULL
+ */
+static struct io_uring_sqe* __native_get_sqe(ut_uring_t *ring)
+{
+    struct io_uring_sqe*    sqe = NULL;
+
+    if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        __native_enter(ring, UT_FALSE);
+        if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_local_tail++;
+
+    return sqe;
+}
+
+/**
+ * 把填好的提交项交给内核，需要时等待至少一个完成项
+ * @param [in] ring 事件引擎
+ * @param [in] wait 是否等待完成
+ * @return int32_t 内核接收的提交项个数，失败返回-1
+ */
+static int32_t __native_enter(ut_uring_t *ring, ut_bool_t wait)
+{
+    uint32_t    to_submit = 0;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    to_submit = ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (to_submit == 0 && !wait) {
+        return 0;
+    }
+
+    return syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+/**
+ * 按操作类型填写提交项，user_data指向操作本身
+ */
+static ut_errno_t __native_submit(ut_uring_t *ring, uring_op_t *op)
+{
+    struct io_uring_sqe*    sqe = __native_get_sqe(ring);
+
+    if (sqe == NULL) {
+        return UT_ERRNO_RESOURCE;
+    }
+
+    sqe->fd = op->fd;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    switch (op->type) {
+        case URING_OP_READ:
+        case URING_OP_WRITE:
+            sqe->opcode = op->type == URING_OP_READ ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = (uint64_t)(uintptr_t)op->buf;
+            sqe->len = op->len;
+            sqe->off = (uint64_t)op->offset;    /* -1表示使用文件当前的位置 */
+            break;
+        case URING_OP_ACCEPT:
+            op->multishot = !(ring->single_shot & (1U << op->type));
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->ioprio = op->multishot ? IORING_ACCEPT_MULTISHOT : 0;
+            sqe->accept_flags = SOCK_CLOEXEC;
+            break;
+        case URING_OP_RECV:
+            /* 不指定缓冲区，由内核从缓冲区环中选择 */
+            op->multishot = !(ring->single_shot & (1U << op->type));
+            sqe->opcode = IORING_OP_RECV;
+            sqe->ioprio = op->multishot ? IORING_RECV_MULTISHOT : 0;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = URING_BUF_GROUP;
+            break;
+        case URING_OP_TIMEOUT:
+            op->ts.tv_sec = op->offset / (1000 * 1000);
+            op->ts.tv_nsec = (op->offset % (1000 * 1000)) * 1000;
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = (uint64_t)(uintptr_t)&op->ts;
+            sqe->len = 1;
+            break;
+        case URING_OP_WAKEUP:
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->poll32_events = POLLIN;
+            sqe->len = IORING_POLL_ADD_MULTI;
+            break;
+    }
+
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 取出所有完成项并回调。先移动完成队列的头再回调，回调中可以继续提交操作
+ */
+static void __native_dispatch(ut_uring_t *ring)
+{
+    uint32_t    head = *ring->cq_head;
+
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe*    cqe = &ring->cqes[head & ring->cq_mask];
+        uring_op_t*             op = (uring_op_t*)(uintptr_t)cqe->user_data;
+        int32_t                 res = cqe->res;
+        uint32_t                flags = cqe->flags;
+        ut_bool_t               more = (flags & IORING_CQE_F_MORE) ? UT_TRUE : UT_FALSE;
+        void*                   buf = NULL;
+
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        if (op == NULL) {
+            continue;   /* 取消操作的完成项 */
+        }
+
+        switch (op->type) {
+            case URING_OP_WAKEUP: {
+                uint64_t    value = 0;
+
+                while (read(ring->wake_fd, &value, sizeof(value)) > 0) {
+                    ;
+                }
+                if (!more) {
+                    ring->wake_rearm = UT_TRUE;
+                    __native_rearm_wakeup(ring);
+                }
+                continue;
+            }
+            case URING_OP_TIMEOUT:
+                res = res == -ETIME ? 0 : res;
+                break;
+            case URING_OP_ACCEPT:
+            case URING_OP_RECV:
+                /* 内核不支持多次完成：记录下来，以后同类操作都按单次提交，这个操作重新提交 */
+                if (op->multishot && res == -EINVAL) {
+                    UT_LOG_INFO("multishot %s is not supported, resubmit as single shot.\n", op->type == URING_OP_RECV ? "recv" : "accept");
+                    ring->single_shot |= 1U << op->type;
+                    if (__native_submit(ring, op) == UT_ERRNO_OK) {
+                        continue;
+                    }
+                    break;
+                }
+                if (op->type == URING_OP_RECV && (flags & IORING_CQE_F_BUFFER)) {
+                    buf = ring->buf_base + (size_t)(flags >> IORING_CQE_BUFFER_SHIFT) * ring->buf_size;
+                }
+                if (!op->multishot) {
+                    more = __native_complete_single(ring, op, res);
+                }
+                break;
+            default:
+                break;
+        }
+
+        op->cb(ring, res, buf, more, op->context);
+        if (!more) {
+            __op_free(ring, op);
+        }
+    }
+}
+
+/**
+ * 重新提交唤醒用的poll。提交队列满且内核繁忙时失败，由事件循环在下一次等待之前重试
+ */
+static ut_errno_t __native_rearm_wakeup(ut_uring_t *ring)
+{
+    if (__native_submit(ring, ring->wake_op) != UT_ERRNO_OK) {
+        UT_LOG_DEBUG("rearm wakeup poll failed, retry later.\n");
+        return UT_ERRNO_RESOURCE;
+    }
+
+    ring->wake_rearm = UT_FALSE;
+    return UT_ERRNO_OK;
+}
+
+/**
+ * 单次提交的accept、recv完成一次后重新提交，对调用者表现得与多次完成相同
+ * @retval ut_bool_t 操作是否还会继续完成。出错、对端关闭或者重新提交失败时操作结束
+ */
+static ut_bool_t __native_complete_single(ut_uring_t *ring, uring_op_t *op, int32_t res)
+{
+    if (res < 0 || (res == 0 && op->type == URING_OP_RECV)) {
+        return UT_FALSE;
+    }
+
+    return __native_submit(ring, op) == UT_ERRNO_OK ? UT_TRUE : UT_FALSE;
+}
+
+#endif
+
+/**
+ * 回退实现：socket、管道等可以等待可读的fd注册到select事件引擎，可读时执行操作；
+ * 普通文件和写操作在事件循环的下一轮直接执行
+ */
+static ut_errno_t __poll_submit(ut_uring_t *ring, uring_op_t *op)
+{
+    ut_errno_t      retval = UT_ERRNO_OK;
+    struct stat     st;
+
+    switch (op->type) {
+        case URING_OP_TIMEOUT:
+            return ut_select_engine_schedule_add(ring->engine, __poll_sync_cb, op, op->offset);
+        case URING_OP_WRITE:
+            return ut_select_engine_schedule_add(ring->engine, __poll_sync_cb, op, 0);
+        case URING_OP_READ:
+            if (fstat(op->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                return ut_select_engine_schedule_add(ring->engine, __poll_sync_cb, op, 0);
+            }
+            break;
+        default:
+            break;
+    }
+
+    /* 每个fd只能有一个等待可读的操作 */
+    if (ut_hash_u64_peek(ring->fd_ops, op->fd) != NULL) {
+        return UT_ERRNO_RESOURCE;
+    }
+    if (op->type == URING_OP_READ) {
+        retval = ut_select_engine_fd_add_once(ring->engine, op->fd, __poll_ready_cb, op);
+    } else {
+        retval = ut_select_engine_fd_add_forever(ring->engine, op->fd, __poll_ready_cb, op);
+    }
+    if (retval == UT_ERRNO_OK) {
+        ut_hash_u64_push(ring->fd_ops, op->fd, op);
+    }
+
+    return retval;
+}
+
+/**
+ * 回退实现：fd可读，执行对应的操作
+ */
+static void __poll_ready_cb(ut_fd_t fd, void* context)
+{
+    uring_op_t*     op = (uring_op_t*)context;
+    ut_uring_t*     ring = op->ring;
+    ssize_t         res = 0;
+
+    switch (op->type) {
+        case URING_OP_READ:
+            res = read(fd, op->buf, op->len);
+            __poll_finish(ring, op, res < 0 ? -errno : (int32_t)res);
+            break;
+
+        case URING_OP_ACCEPT:
+            res = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+            if (res >= 0) {
+                op->cb(ring, (int32_t)res, NULL, UT_TRUE, op->context);
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                __poll_finish(ring, op, -errno);
+            }
+            break;
+
+        case URING_OP_RECV: {
+            char*       buf = NULL;
+
+            /* 与io_uring一致：缓冲区用完、对端关闭或出错时结束 */
+            if (ring->buf_free_num == 0) {
+                __poll_finish(ring, op, -ENOBUFS);
+                break;
+            }
+            buf = ring->buf_base + (size_t)ring->buf_free[--ring->buf_free_num] * ring->buf_size;
+            res = recv(fd, buf, ring->buf_size, MSG_DONTWAIT);
+            if (res > 0) {
+                op->cb(ring, (int32_t)res, buf, UT_TRUE, op->context);
+                break;
+            }
+            res = res < 0 ? -errno : 0;
+            ut_uring_buffer_release(ring, buf);
+            if (res != -EAGAIN && res != -EWOULDBLOCK) {
+                __poll_finish(ring, op, (int32_t)res);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * 回退实现：直接执行的操作和定时器，在事件循环中回调
+ */
+static void __poll_sync_cb(void* context)
+{
+    uring_op_t*     op = (uring_op_t*)context;
+    ssize_t         res = 0;
+
+    switch (op->type) {
+        case URING_OP_READ:
+            res = op->offset < 0 ? read(op->fd, op->buf, op->len) : pread(op->fd, op->buf, op->len, op->offset);
+            break;
+        case URING_OP_WRITE:
+            res = op->offset < 0 ? write(op->fd, op->buf, op->len) : pwrite(op->fd, op->buf, op->len, op->offset);
+            break;
+        default:
+            break;
+    }
+    if (res < 0) {
+        res = -errno;
+    }
+
+    op->cb(op->ring, (int32_t)res, NULL, UT_FALSE, op->context);
+    __op_free(op->ring, op);
+}
+
+/**
+ * 回退实现：结束一个等待可读的操作，从select事件引擎中移除后回调
+ */
+static void __poll_finish(ut_uring_t *ring, uring_op_t *op, int32_t res)
+{
+    ut_hash_u64_pop(ring->fd_ops, op->fd);
+    ut_select_engine_fd_del(ring->engine, op->fd);
+    op->cb(ring, res, NULL, UT_FALSE, op->context);
+    __op_free(ring, op);
+}
@@ -0,0 +1,123 @@
+/**
+ * @file test_cache.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_cache的单元测试：LRU淘汰顺序、替换、过期和回调
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <unistd.h>
+#include "ut/ut_cache.h"
+#include "ut_test.h"
+
+typedef struct {
+    uint32_t    count[UT_CACHE_EVICT_CLEAR + 1];
+    uintptr_t   last;               /* 最近一次被淘汰的值 */
+} evict_record_t;
+
+static void __evict_cb(const void *key, uint32_t keylen, void* value, ut_cache_reason_t reason, void* context)
+{
+    evict_record_t  *record = context;
+
+    record->count[reason]++;
+    record->last = (uintptr_t)value;
+}
+
+static void __put(ut_cache_t *cache, uint32_t key, uint32_t ttl_ms)
+{
+    UT_TEST_ASSERT(ut_cache_put_bin(cache, &key, sizeof(key), (void*)(uintptr_t)(key + 1), 1, ttl_ms) == UT_ERRNO_OK);
+}
+
+static void* __get(ut_cache_t *cache, uint32_t key)
+{
+    return ut_cache_get_bin(cache, &key, sizeof(key));
+}
+
+/* 容量为4，访问过的元素不会被优先淘汰 */
+static void test_cache_lru(void)
+{
+    ut_cache_t          *cache = NULL;
+    evict_record_t      record;
+    ut_cache_stats_t    stats;
+
+    memset(&record, 0, sizeof(record));
+    UT_TEST_ASSERT(ut_cache_create(&cache, 4, 0, __evict_cb, &record) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < 4; i++) {
+        __put(cache, i, UT_CACHE_TTL_DEFAULT);
+    }
+    UT_TEST_ASSERT(__get(cache, 0) == (void*)1);
+    __put(cache, 4, UT_CACHE_TTL_DEFAULT);
+    UT_TEST_ASSERT(record.count[UT_CACHE_EVICT_CAPACITY] == 1 && record.last == 2);
+    UT_TEST_ASSERT(__get(cache, 1) == NULL);
+    UT_TEST_ASSERT(__get(cache, 0) == (void*)1);
+
+    /* 替换旧值回调REPLACED，ut_cache_del不回调 */
+    UT_TEST_ASSERT(ut_cache_put_bin(cache, &(uint32_t){3}, sizeof(uint32_t), (void*)100, 1, UT_CACHE_TTL_DEFAULT) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(record.count[UT_CACHE_EVICT_REPLACED] == 1 && record.last == 4);
+    UT_TEST_ASSERT(__get(cache, 3) == (void*)100);
+    UT_TEST_ASSERT(ut_cache_del_bin(cache, &(uint32_t){4}, sizeof(uint32_t)) == (void*)5);
+    UT_TEST_ASSERT(record.count[UT_CACHE_EVICT_CAPACITY] == 1);
+
+    UT_TEST_ASSERT(ut_cache_stats(cache, &stats) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(stats.count == 3 && stats.usage == 3 && stats.evictions == 1);
+    UT_TEST_ASSERT(ut_cache_destroy(cache) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(record.count[UT_CACHE_EVICT_CLEAR] == 3);
+}
+
+/* 随机访问时占用始终不超过上限，元素数量与统计一致 */
+static void test_cache_budget(void)
+{
+    ut_cache_t          *cache = NULL;
+    ut_cache_stats_t    stats;
+    uint64_t            seed = 1;
+
+    UT_TEST_ASSERT(ut_cache_create(&cache, 1000, 0, NULL, NULL) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < 200000; i++) {
+        uint32_t    key = ut_test_rand(&seed) % 5000;
+        void*       value = __get(cache, key);
+
+        UT_TEST_ASSERT(value == NULL || value == (void*)(uintptr_t)(key + 1));
+        if (value == NULL) {
+            __put(cache, key, UT_CACHE_TTL_DEFAULT);
+        }
+    }
+    UT_TEST_ASSERT(ut_cache_stats(cache, &stats) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(stats.count == 1000 && stats.usage <= stats.budget);
+    UT_TEST_ASSERT(stats.hits + stats.misses == 200000 && stats.inserts == stats.misses);
+    UT_TEST_ASSERT(ut_cache_put_bin(cache, "big", 3, (void*)1, 1001, UT_CACHE_TTL_DEFAULT) == UT_ERRNO_RESOURCE);
+    ut_cache_destroy(cache);
+}
+
+/* 过期的元素在访问或清理时移除，UT_CACHE_TTL_NONE的元素一直保留 */
+static void test_cache_ttl(void)
+{
+    ut_cache_t          *cache = NULL;
+    evict_record_t      record;
+
+    memset(&record, 0, sizeof(record));
+    UT_TEST_ASSERT(ut_cache_create(&cache, 100, 20, __evict_cb, &record) == UT_ERRNO_OK);
+    __put(cache, 1, UT_CACHE_TTL_DEFAULT);
+    __put(cache, 2, UT_CACHE_TTL_DEFAULT);
+    __put(cache, 3, UT_CACHE_TTL_NONE);
+    __put(cache, 4, 10 * 1000);
+    usleep(50 * 1000);
+
+    UT_TEST_ASSERT(__get(cache, 1) == NULL);
+    UT_TEST_ASSERT(record.count[UT_CACHE_EVICT_EXPIRED] == 1);
+    UT_TEST_ASSERT(ut_cache_purge(cache) == 1);
+    UT_TEST_ASSERT(record.count[UT_CACHE_EVICT_EXPIRED] == 2);
+    UT_TEST_ASSERT(__get(cache, 3) == (void*)4);
+    UT_TEST_ASSERT(__get(cache, 4) == (void*)5);
+    ut_cache_destroy(cache);
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_cache_lru);
+    UT_TEST_RUN(test_cache_budget);
+    UT_TEST_RUN(test_cache_ttl);
+    return 0;
+}
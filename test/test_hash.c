@@ -0,0 +1,422 @@
+/**
+ * @file test_hash.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_hash的单元测试：随机的push/peek/pop/find_or_insert/emplace与一个数组模型逐步对比，覆盖各个引擎
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "ut/ut_hash.h"
+#include "ut_test.h"
+
+#define MODEL_KEYS      20000
+#define MODEL_STEPS     400000
+#define SCAN_STABLE     2000
+#define PAR_KEYS        100000
+
+typedef struct {
+    const char  *name;
+    uint32_t    flags;
+} test_engine_t;
+
+static const test_engine_t s_engines[] = {
+    {"chained", UT_HASH_FLAG_NONE},
+    {"flat",    UT_HASH_FLAG_FLAT},
+    {"incremental", UT_HASH_FLAG_INCREMENTAL},
+    {"chained wyhash seeded", UT_HASH_FLAG_SEED},
+    {"flat fnv1a seeded", UT_HASH_FLAG_FLAT | UT_HASH_FLAG_HASH_FNV1A | UT_HASH_FLAG_SEED},
+};
+
+static void* s_model[MODEL_KEYS];
+
+static ut_bool_t __count_cb(const char *key, const void* value, void* context)
+{
+    uint32_t    idx = (uint32_t)atoi(key + 1);
+
+    UT_TEST_ASSERT(idx < MODEL_KEYS && s_model[idx] == value);
+    (*(int32_t*)context)++;
+    return UT_TRUE;
+}
+
+/* 与数组模型对比：每一步之后返回值和元素数量都必须一致 */
+static void test_hash_model(void)
+{
+    for (uint32_t e = 0; e < sizeof(s_engines) / sizeof(s_engines[0]); e++) {
+        ut_hash_t       *ht = NULL;
+        uint64_t        seed = e + 1;
+        int32_t         count = 0;
+        int32_t         visited = 0;
+        uint32_t        keylen = 0;
+        uint32_t        hash = 0;
+        char            key[UT_LEN_32];
+
+        memset(s_model, 0, sizeof(s_model));
+        UT_TEST_ASSERT(ut_hash_create_ex(&ht, 0, NULL, s_engines[e].flags) == UT_ERRNO_OK);
+
+        for (uint32_t step = 0; step < MODEL_STEPS; step++) {
+            uint32_t    idx = ut_test_rand(&seed) % MODEL_KEYS;
+            void*       value = (void*)(uintptr_t)(step + 1);
+
+            snprintf(key, sizeof(key), "k%u", idx);
+            keylen = (uint32_t)strlen(key);
+            hash = ut_hash_calc(ht, key);
+            switch (ut_test_rand(&seed) % 7) {
+                case 0:
+                    UT_TEST_ASSERT(ut_hash_push(ht, key, value) == s_model[idx]);
+                    count += s_model[idx] == NULL;
+                    s_model[idx] = value;
+                    break;
+                case 1:
+                    UT_TEST_ASSERT(ut_hash_pop(ht, key) == s_model[idx]);
+                    count -= s_model[idx] != NULL;
+                    s_model[idx] = NULL;
+                    break;
+                case 2:
+                    UT_TEST_ASSERT(ut_hash_peek(ht, key) == s_model[idx]);
+                    break;
+                case 3:
+                    /* 预先计算哈希值的接口必须与普通接口操作同一个元素 */
+                    UT_TEST_ASSERT(ut_hash_peek_hashed(ht, key, keylen, hash) == s_model[idx]);
+                    if (ut_test_rand(&seed) % 2) {
+                        UT_TEST_ASSERT(ut_hash_push_hashed(ht, key, keylen, hash, value) == s_model[idx]);
+                        count += s_model[idx] == NULL;
+                        s_model[idx] = value;
+                    } else {
+                        UT_TEST_ASSERT(ut_hash_pop_hashed(ht, key, keylen, hash) == s_model[idx]);
+                        count -= s_model[idx] != NULL;
+                        s_model[idx] = NULL;
+                    }
+                    UT_TEST_ASSERT(ut_hash_peek(ht, key) == s_model[idx]);
+                    break;
+                case 4:
+                case 5: {
+                    /* 查找或插入：传入NULL只查找；找到时通过返回的指针直接修改值 */
+                    const void* val = (ut_test_rand(&seed) % 4 == 0) ? NULL : value;
+                    ut_bool_t   inserted = UT_TRUE;
+                    void**      pval = (ut_test_rand(&seed) % 2)
+                                       ? ut_hash_find_or_insert(ht, key, val, &inserted)
+                                       : ut_hash_find_or_insert_hashed(ht, key, keylen, hash, val, &inserted);
+
+                    if (s_model[idx] != NULL) {
+                        UT_TEST_ASSERT(pval != NULL && *pval == s_model[idx] && !inserted);
+                        if (val != NULL) {
+                            *pval = value;
+                            s_model[idx] = value;
+                        }
+                    } else if (val == NULL) {
+                        UT_TEST_ASSERT(pval == NULL && !inserted);
+                    } else {
+                        UT_TEST_ASSERT(pval != NULL && *pval == value && inserted);
+                        count++;
+                        s_model[idx] = value;
+                    }
+                    UT_TEST_ASSERT(ut_hash_peek_hashed(ht, key, keylen, hash) == s_model[idx]);
+                    break;
+                }
+                default: {
+                    /* 只在键不存在时插入，已有的值不被替换 */
+                    void*       old = (ut_test_rand(&seed) % 2)
+                                      ? ut_hash_emplace(ht, key, value)
+                                      : ut_hash_emplace_hashed(ht, key, keylen, hash, value);
+
+                    UT_TEST_ASSERT(old == s_model[idx]);
+                    if (old == NULL) {
+                        count++;
+                        s_model[idx] = value;
+                    }
+                    UT_TEST_ASSERT(ut_hash_peek(ht, key) == s_model[idx]);
+                    break;
+                }
+            }
+            UT_TEST_ASSERT(ut_hash_count(ht) == count);
+        }
+
+        ut_hash_foreach(ht, __count_cb, &visited);
+        UT_TEST_ASSERT(visited == count);
+        UT_TEST_ASSERT(ut_hash_destroy(ht) == UT_ERRNO_OK);
+        printf("  engine %s ok\n", s_engines[e].name);
+    }
+}
+
+/* 清空之后再次插入，删除留下的墓碑不能影响查找 */
+static void test_hash_refill(void)
+{
+    for (uint32_t e = 0; e < sizeof(s_engines) / sizeof(s_engines[0]); e++) {
+        ut_hash_t       *ht = NULL;
+        char            key[UT_LEN_32];
+
+        UT_TEST_ASSERT(ut_hash_create_ex(&ht, 16, NULL, s_engines[e].flags) == UT_ERRNO_OK);
+        for (uint32_t round = 0; round < 8; round++) {
+            for (uint32_t i = 0; i < 5000; i++) {
+                snprintf(key, sizeof(key), "r%u", i);
+                UT_TEST_ASSERT(ut_hash_push(ht, key, (void*)(uintptr_t)(i + 1)) == NULL);
+            }
+            for (uint32_t i = 0; i < 5000; i++) {
+                snprintf(key, sizeof(key), "r%u", i);
+                UT_TEST_ASSERT(ut_hash_pop(ht, key) == (void*)(uintptr_t)(i + 1));
+            }
+            UT_TEST_ASSERT(ut_hash_count(ht) == 0);
+        }
+        UT_TEST_ASSERT(ut_hash_peek(ht, "r0") == NULL);
+        ut_hash_destroy(ht);
+    }
+}
+
+/* 批量查找的结果必须与逐个查找相同，包括未命中和为NULL的键 */
+static void test_hash_peek_batch(void)
+{
+    for (uint32_t e = 0; e < sizeof(s_engines) / sizeof(s_engines[0]); e++) {
+        ut_hash_t       *ht = NULL;
+        uint64_t        seed = e + 1;
+        static char     keys[64][UT_LEN_32];
+        const char      *batch[64];
+        void*           values[64];
+
+        UT_TEST_ASSERT(ut_hash_create_ex(&ht, 0, NULL, s_engines[e].flags) == UT_ERRNO_OK);
+        for (uint32_t i = 0; i < 10000; i++) {
+            snprintf(keys[0], sizeof(keys[0]), "b%u", i);
+            ut_hash_push(ht, keys[0], (void*)(uintptr_t)(i + 1));
+        }
+        for (uint32_t round = 0; round < 1000; round++) {
+            uint32_t    num = 1 + ut_test_rand(&seed) % 64;
+
+            for (uint32_t i = 0; i < num; i++) {
+                snprintf(keys[i], sizeof(keys[i]), "b%u", (uint32_t)(ut_test_rand(&seed) % 12000));
+                batch[i] = (ut_test_rand(&seed) % 16 == 0) ? NULL : keys[i];
+            }
+            ut_hash_peek_batch(ht, batch, num, values);
+            for (uint32_t i = 0; i < num; i++) {
+                UT_TEST_ASSERT(values[i] == (batch[i] == NULL ? NULL : ut_hash_peek(ht, batch[i])));
+            }
+        }
+        ut_hash_destroy(ht);
+    }
+}
+
+/* 空闲链表不超过上限，全部删除并收缩之后slab都归还给系统，哈希表仍然可用 */
+static void test_hash_shrink(void)
+{
+    ut_hash_t       *ht = NULL;
+    ut_hash_stats_t stats;
+    char            key[UT_LEN_32];
+
+    UT_TEST_ASSERT(ut_hash_create(&ht, 0, NULL) == UT_ERRNO_OK);
+    ut_hash_set_free_max(ht, 16);
+    for (uint32_t i = 0; i < 50000; i++) {
+        snprintf(key, sizeof(key), "s%u", i);
+        ut_hash_push(ht, key, (void*)(uintptr_t)(i + 1));
+    }
+    for (uint32_t i = 0; i < 50000; i++) {
+        snprintf(key, sizeof(key), "s%u", i);
+        UT_TEST_ASSERT(ut_hash_pop(ht, key) == (void*)(uintptr_t)(i + 1));
+    }
+    UT_TEST_ASSERT(ut_hash_stats(ht, &stats) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(stats.free_count <= 16);
+
+    UT_TEST_ASSERT(ut_hash_shrink(ht) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(ut_hash_stats(ht, &stats) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(stats.slabs == 0 && stats.free_count == 0 && stats.count == 0);
+
+    UT_TEST_ASSERT(ut_hash_push(ht, "again", (void*)1) == NULL);
+    UT_TEST_ASSERT(ut_hash_peek(ht, "again") == (void*)1);
+    ut_hash_destroy(ht);
+}
+
+/* 二进制键：包含'\0'的键、只在'\0'之后不同的键，长度覆盖元素内、arena的各个级别以及超过2KB直接申请的情况 */
+static void test_hash_bin_keys(void)
+{
+    static const uint32_t   lens[] = {3, 15, 16, 300, 2047, 2048, 4096};
+    static uint8_t          keys[sizeof(lens) / sizeof(lens[0])][2][4096];
+    uint32_t                nkeys = sizeof(lens) / sizeof(lens[0]);
+
+    for (uint32_t e = 0; e < sizeof(s_engines) / sizeof(s_engines[0]); e++) {
+        ut_hash_t       *ht = NULL;
+        uint64_t        seed = e + 1;
+        ut_bool_t       inserted = UT_FALSE;
+
+        UT_TEST_ASSERT(ut_hash_create_ex(&ht, 0, NULL, s_engines[e].flags) == UT_ERRNO_OK);
+        for (uint32_t i = 0; i < nkeys; i++) {
+            /* 每个键以'\0'开头并且中间也有'\0'，两个变体只有最后一个字节不同 */
+            for (uint32_t j = 0; j < lens[i]; j++) {
+                keys[i][0][j] = (j % 5 == 0) ? 0 : (uint8_t)(ut_test_rand(&seed) | 1);
+            }
+            memcpy(keys[i][1], keys[i][0], lens[i]);
+            keys[i][1][lens[i] - 1] ^= 0x80;
+        }
+
+        /* 反复插入删除，arena的空闲块被复用之后内容仍然正确 */
+        for (uint32_t round = 0; round < 4; round++) {
+            for (uint32_t i = 0; i < nkeys; i++) {
+                for (uint32_t v = 0; v < 2; v++) {
+                    UT_TEST_ASSERT(ut_hash_push_bin(ht, keys[i][v], lens[i], (void*)(uintptr_t)(i * 2 + v + 1)) == NULL);
+                }
+            }
+            UT_TEST_ASSERT(ut_hash_count(ht) == (int32_t)nkeys * 2);
+            /* 字符串接口只能看到第一个'\0'之前的部分，即空键 */
+            UT_TEST_ASSERT(ut_hash_peek(ht, "") == NULL);
+            for (uint32_t i = 0; i < nkeys; i++) {
+                for (uint32_t v = 0; v < 2; v++) {
+                    UT_TEST_ASSERT(ut_hash_peek_bin(ht, keys[i][v], lens[i]) == (void*)(uintptr_t)(i * 2 + v + 1));
+                }
+                UT_TEST_ASSERT(ut_hash_peek_bin(ht, keys[i][0], lens[i] - 1) == NULL);
+            }
+            for (uint32_t i = 0; i < nkeys; i++) {
+                UT_TEST_ASSERT(ut_hash_pop_bin(ht, keys[i][round % 2], lens[i]) == (void*)(uintptr_t)(i * 2 + round % 2 + 1));
+                UT_TEST_ASSERT(ut_hash_peek_bin(ht, keys[i][round % 2], lens[i]) == NULL);
+                UT_TEST_ASSERT(ut_hash_pop_bin(ht, keys[i][1 - round % 2], lens[i]) == (void*)(uintptr_t)(i * 2 + 2 - round % 2));
+            }
+            UT_TEST_ASSERT(ut_hash_count(ht) == 0);
+        }
+
+        /* 超过最大长度的键不会被存入，也不会读取键的内容 */
+        UT_TEST_ASSERT(ut_hash_push_hashed(ht, keys[0][0], UINT32_MAX, 0, (void*)1) == NULL);
+        UT_TEST_ASSERT(ut_hash_emplace_hashed(ht, keys[0][0], UINT32_MAX, 0, (void*)1) == NULL);
+        UT_TEST_ASSERT(ut_hash_find_or_insert_hashed(ht, keys[0][0], UINT32_MAX, 0, (void*)1, &inserted) == NULL);
+        UT_TEST_ASSERT(ut_hash_peek_hashed(ht, keys[0][0], UINT32_MAX, 0) == NULL);
+        UT_TEST_ASSERT(ut_hash_count(ht) == 0);
+        ut_hash_destroy(ht);
+        printf("  engine %s ok\n", s_engines[e].name);
+    }
+}
+
+static ut_bool_t __scan_cb(const void *key, uint32_t keylen, const void* value, void* context)
+{
+    uintptr_t   idx = (uintptr_t)value - 1;
+
+    (void)key;
+    (void)keylen;
+    if (idx < SCAN_STABLE) {
+        ((uint32_t*)context)[idx]++;
+    }
+    return UT_TRUE;
+}
+
+/* 分步遍历期间不断插入和删除其他元素使哈希表扩容，遍历期间一直存在的元素至少被访问一次 */
+static void test_hash_scan(void)
+{
+    static uint32_t visits[SCAN_STABLE];
+
+    for (uint32_t e = 0; e < sizeof(s_engines) / sizeof(s_engines[0]); e++) {
+        ut_hash_t       *ht = NULL;
+        ut_hash_stats_t stats;
+        ut_bool_t       flat = (s_engines[e].flags & UT_HASH_FLAG_FLAT) != 0;
+        ut_bool_t       saw_rehash = UT_FALSE;
+        uint64_t        cursor = 0;
+        uint32_t        grown = 0;
+        uint32_t        calls = 0;
+        char            key[UT_LEN_32];
+
+        memset(visits, 0, sizeof(visits));
+        UT_TEST_ASSERT(ut_hash_create_ex(&ht, 16, NULL, s_engines[e].flags) == UT_ERRNO_OK);
+        for (uint32_t i = 0; i < SCAN_STABLE; i++) {
+            snprintf(key, sizeof(key), "st%u", i);
+            UT_TEST_ASSERT(ut_hash_push(ht, key, (void*)(uintptr_t)(i + 1)) == NULL);
+        }
+
+        /* 开放寻址哈希表在两次调用之间扩容可能遗漏元素，只在遍历期间不写入的情况下检查 */
+        while (ut_hash_scan(ht, &cursor, 16, __scan_cb, visits)) {
+            calls++;
+            if (flat) {
+                continue;
+            }
+            for (uint32_t i = 0; i < 64; i++, grown++) {
+                snprintf(key, sizeof(key), "gr%u", grown);
+                ut_hash_push(ht, key, (void*)(uintptr_t)(SCAN_STABLE + grown + 1));
+                if (grown % 3 == 0) {
+                    snprintf(key, sizeof(key), "gr%u", grown / 2);
+                    ut_hash_pop(ht, key);
+                }
+            }
+            UT_TEST_ASSERT(ut_hash_stats(ht, &stats) == UT_ERRNO_OK);
+            saw_rehash |= stats.rehashing;
+        }
+        UT_TEST_ASSERT(cursor == 0 && calls > 1);
+        if (s_engines[e].flags & UT_HASH_FLAG_INCREMENTAL) {
+            UT_TEST_ASSERT(saw_rehash);
+        }
+        for (uint32_t i = 0; i < SCAN_STABLE; i++) {
+            UT_TEST_ASSERT(flat ? visits[i] == 1 : visits[i] >= 1);
+        }
+        ut_hash_destroy(ht);
+        printf("  engine %s ok (%u calls, %u grown)\n", s_engines[e].name, calls, grown);
+    }
+}
+
+typedef struct {
+    uint64_t    sum;
+    uint32_t    count;
+} test_par_sum_t;
+
+static ut_bool_t __par_sum_cb(const void *key, uint32_t keylen, const void* value, void* context)
+{
+    test_par_sum_t  *local = context;
+
+    (void)key;
+    (void)keylen;
+    local->sum += (uintptr_t)value;
+    local->count++;
+    return UT_TRUE;
+}
+
+static void __par_reduce(void* local, void* context)
+{
+    test_par_sum_t  *total = context;
+
+    total->sum += ((test_par_sum_t*)local)->sum;
+    total->count += ((test_par_sum_t*)local)->count;
+}
+
+/* 并行遍历归并之后的结果必须与串行遍历相同，线程数覆盖1以及不是2的幂的情况 */
+static void test_hash_foreach_parallel(void)
+{
+    static const uint32_t   threads[] = {1, 2, 3, 4, 7, 16};
+    static test_par_sum_t   locals[16];
+    void*                   local_ptrs[16];
+
+    for (uint32_t i = 0; i < 16; i++) {
+        local_ptrs[i] = &locals[i];
+    }
+    for (uint32_t e = 0; e < sizeof(s_engines) / sizeof(s_engines[0]); e++) {
+        ut_hash_t       *ht = NULL;
+        test_par_sum_t  serial = {0, 0};
+        char            key[UT_LEN_32];
+
+        UT_TEST_ASSERT(ut_hash_create_ex(&ht, 0, NULL, s_engines[e].flags) == UT_ERRNO_OK);
+        for (uint32_t i = 0; i < PAR_KEYS; i++) {
+            snprintf(key, sizeof(key), "p%u", i);
+            ut_hash_push(ht, key, (void*)(uintptr_t)(i * 7 + 1));
+        }
+        for (uint32_t i = 0; i < PAR_KEYS; i += 5) {
+            snprintf(key, sizeof(key), "p%u", i);
+            ut_hash_pop(ht, key);
+        }
+        ut_hash_foreach_bin(ht, __par_sum_cb, &serial);
+        UT_TEST_ASSERT(serial.count == (uint32_t)ut_hash_count(ht));
+
+        for (uint32_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+            test_par_sum_t  total = {0, 0};
+
+            memset(locals, 0, sizeof(locals));
+            UT_TEST_ASSERT(ut_hash_foreach_parallel(ht, threads[t], __par_sum_cb, local_ptrs,
+                                                    __par_reduce, &total) == UT_ERRNO_OK);
+            UT_TEST_ASSERT(total.sum == serial.sum && total.count == serial.count);
+        }
+        ut_hash_destroy(ht);
+        printf("  engine %s ok\n", s_engines[e].name);
+    }
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_hash_model);
+    UT_TEST_RUN(test_hash_refill);
+    UT_TEST_RUN(test_hash_peek_batch);
+    UT_TEST_RUN(test_hash_shrink);
+    UT_TEST_RUN(test_hash_bin_keys);
+    UT_TEST_RUN(test_hash_scan);
+    UT_TEST_RUN(test_hash_foreach_parallel);
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file test_hash_conc.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_hash_conc的单元测试：多个写者各自修改不相交的键，读者同时检查不变的键
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <pthread.h>
+#include "ut/ut_hash_conc.h"
+#include "ut_test.h"
+
+#define WRITERS         4
+#define WRITER_KEYS     5000
+#define WRITER_STEPS    200000
+#define STABLE_KEYS     1000
+
+typedef struct {
+    ut_hash_conc_t  *ht;
+    uint32_t        id;
+    int32_t         count;
+    void*           model[WRITER_KEYS];
+} writer_t;
+
+static volatile int s_stop = 0;
+
+/* 每个写者只修改自己的键，所以可以各自与数组模型对比 */
+static void* __writer(void* arg)
+{
+    writer_t    *writer = arg;
+    uint64_t    seed = writer->id + 1;
+    char        key[UT_LEN_32];
+
+    for (uint32_t step = 0; step < WRITER_STEPS; step++) {
+        uint32_t    idx = ut_test_rand(&seed) % WRITER_KEYS;
+        void*       value = (void*)(uintptr_t)(step + 1);
+
+        snprintf(key, sizeof(key), "w%u-%u", writer->id, idx);
+        switch (ut_test_rand(&seed) % 3) {
+            case 0:
+                UT_TEST_ASSERT(ut_hash_conc_push(writer->ht, key, value) == writer->model[idx]);
+                writer->count += writer->model[idx] == NULL;
+                writer->model[idx] = value;
+                break;
+            case 1:
+                UT_TEST_ASSERT(ut_hash_conc_pop(writer->ht, key) == writer->model[idx]);
+                writer->count -= writer->model[idx] != NULL;
+                writer->model[idx] = NULL;
+                break;
+            default:
+                UT_TEST_ASSERT(ut_hash_conc_peek(writer->ht, key) == writer->model[idx]);
+                break;
+        }
+    }
+    return NULL;
+}
+
+/* 写者扩容和回收元素的同时，不变的键必须一直能读到正确的值 */
+static void* __reader(void* arg)
+{
+    ut_hash_conc_t  *ht = arg;
+    uint64_t        seed = 100;
+    char            key[UT_LEN_32];
+
+    while (!__atomic_load_n(&s_stop, __ATOMIC_RELAXED)) {
+        uint32_t    idx = ut_test_rand(&seed) % STABLE_KEYS;
+
+        snprintf(key, sizeof(key), "s%u", idx);
+        UT_TEST_ASSERT(ut_hash_conc_peek(ht, key) == (void*)(uintptr_t)(idx + 1));
+    }
+    return NULL;
+}
+
+static void test_hash_conc_mixed(void)
+{
+    ut_hash_conc_t  *ht = NULL;
+    static writer_t writers[WRITERS];
+    pthread_t       wtids[WRITERS];
+    pthread_t       rtid;
+    int32_t         count = STABLE_KEYS;
+    char            key[UT_LEN_32];
+
+    UT_TEST_ASSERT(ut_hash_conc_create(&ht, 16, 4, NULL) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < STABLE_KEYS; i++) {
+        snprintf(key, sizeof(key), "s%u", i);
+        ut_hash_conc_push(ht, key, (void*)(uintptr_t)(i + 1));
+    }
+
+    pthread_create(&rtid, NULL, __reader, ht);
+    for (uint32_t i = 0; i < WRITERS; i++) {
+        memset(&writers[i], 0, sizeof(writer_t));
+        writers[i].ht = ht;
+        writers[i].id = i;
+        pthread_create(&wtids[i], NULL, __writer, &writers[i]);
+    }
+    for (uint32_t i = 0; i < WRITERS; i++) {
+        pthread_join(wtids[i], NULL);
+        count += writers[i].count;
+    }
+    __atomic_store_n(&s_stop, 1, __ATOMIC_RELAXED);
+    pthread_join(rtid, NULL);
+
+    UT_TEST_ASSERT(ut_hash_conc_count(ht) == count);
+    UT_TEST_ASSERT(ut_hash_conc_destroy(ht) == UT_ERRNO_OK);
+}
+
+/* 每种内置哈希函数都要能正确地存取，带种子时两个哈希表的分布不同但结果相同 */
+static void test_hash_conc_hash_flags(void)
+{
+    static const uint32_t flags[] = {UT_HASH_FLAG_NONE, UT_HASH_FLAG_HASH_FNV1A, UT_HASH_FLAG_HASH_WY, UT_HASH_FLAG_SEED};
+    char            key[UT_LEN_32];
+
+    for (uint32_t f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+        ut_hash_conc_t  *ht = NULL;
+
+        UT_TEST_ASSERT(ut_hash_conc_create_ex(&ht, 0, 0, NULL, flags[f]) == UT_ERRNO_OK);
+        for (uint32_t i = 0; i < 20000; i++) {
+            snprintf(key, sizeof(key), "f%u", i);
+            UT_TEST_ASSERT(ut_hash_conc_push(ht, key, (void*)(uintptr_t)(i + 1)) == NULL);
+        }
+        for (uint32_t i = 0; i < 20000; i++) {
+            snprintf(key, sizeof(key), "f%u", i);
+            UT_TEST_ASSERT(ut_hash_conc_peek(ht, key) == (void*)(uintptr_t)(i + 1));
+            UT_TEST_ASSERT(ut_hash_conc_peek_bin(ht, key, (uint32_t)strlen(key)) == (void*)(uintptr_t)(i + 1));
+        }
+        UT_TEST_ASSERT(ut_hash_conc_count(ht) == 20000);
+        ut_hash_conc_destroy(ht);
+    }
+}
+
+/* 超过上限的键长度直接被拒绝，不会读取键的内容；较长的键可以正常存取；NULL的哈希表数量为0 */
+static void test_hash_conc_keylen(void)
+{
+    static const uint32_t bad_lens[] = {1U << 31, UINT32_MAX - 1, UINT32_MAX};
+    ut_hash_conc_t  *ht = NULL;
+    char            *long_key = malloc(5000);
+    char            key[UT_LEN_16] = "short";
+
+    UT_TEST_ASSERT(ut_hash_conc_create(&ht, 0, 0, NULL) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < sizeof(bad_lens) / sizeof(bad_lens[0]); i++) {
+        UT_TEST_ASSERT(ut_hash_conc_push_bin(ht, key, bad_lens[i], (void*)1) == NULL);
+        UT_TEST_ASSERT(ut_hash_conc_peek_bin(ht, key, bad_lens[i]) == NULL);
+        UT_TEST_ASSERT(ut_hash_conc_pop_bin(ht, key, bad_lens[i]) == NULL);
+    }
+    UT_TEST_ASSERT(ut_hash_conc_count(ht) == 0);
+
+    memset(long_key, 'x', 5000);
+    UT_TEST_ASSERT(ut_hash_conc_push_bin(ht, long_key, 5000, (void*)2) == NULL);
+    UT_TEST_ASSERT(ut_hash_conc_peek_bin(ht, long_key, 5000) == (void*)2);
+    UT_TEST_ASSERT(ut_hash_conc_peek_bin(ht, long_key, 4999) == NULL);
+    UT_TEST_ASSERT(ut_hash_conc_pop_bin(ht, long_key, 5000) == (void*)2);
+    UT_TEST_ASSERT(ut_hash_conc_count(ht) == 0);
+    UT_TEST_ASSERT(ut_hash_conc_count(NULL) == 0);
+
+    ut_hash_conc_destroy(ht);
+    free(long_key);
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_hash_conc_mixed);
+    UT_TEST_RUN(test_hash_conc_hash_flags);
+    UT_TEST_RUN(test_hash_conc_keylen);
+    return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file test_hash_image.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_hash_image的单元测试：保存后映射查找，以及被篡改的镜像文件不能导致越界访问
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ut/ut_hash_image.h"
+#include "ut_test.h"
+
+#define IMAGE_KEYS      5000
+#define IMAGE_HEADER    48      /* 文件头大小，索引紧跟在文件头之后 */
+#define IMAGE_SLOT      16      /* 槽位：hash(4) reserved(4) offset(8) */
+
+static char s_path[UT_LEN_64];
+
+static uint32_t __value_len(const void* value, void* context)
+{
+    return (uint32_t)strlen(value) + 1;
+}
+
+/* 值为字符串的哈希表，保存时复制值的内容 */
+static void __save_strings(void)
+{
+    ut_hash_t   *ht = NULL;
+    static char values[IMAGE_KEYS][UT_LEN_32];
+    char        key[UT_LEN_32];
+
+    UT_TEST_ASSERT(ut_hash_create(&ht, 0, NULL) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < IMAGE_KEYS; i++) {
+        snprintf(key, sizeof(key), "key-%u", i);
+        snprintf(values[i], sizeof(values[i]), "value-%u", i * 3);
+        ut_hash_push(ht, key, values[i]);
+    }
+    UT_TEST_ASSERT(ut_hash_save(ht, s_path, __value_len, NULL) == UT_ERRNO_OK);
+    ut_hash_destroy(ht);
+}
+
+static void test_hash_image_roundtrip(void)
+{
+    ut_hash_t       *ht = NULL;
+    ut_hash_image_t *img = NULL;
+    char            key[UT_LEN_32];
+    char            expect[UT_LEN_32];
+    uint32_t        vallen = 0;
+
+    __save_strings();
+    UT_TEST_ASSERT(ut_hash_open_mmap(&img, s_path) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(ut_hash_image_count(img) == IMAGE_KEYS);
+    for (uint32_t i = 0; i < IMAGE_KEYS; i++) {
+        snprintf(key, sizeof(key), "key-%u", i);
+        snprintf(expect, sizeof(expect), "value-%u", i * 3);
+        UT_TEST_ASSERT(strcmp(ut_hash_image_peek_bin(img, key, (uint32_t)strlen(key), &vallen), expect) == 0);
+        UT_TEST_ASSERT(vallen == strlen(expect) + 1);
+    }
+    UT_TEST_ASSERT(ut_hash_image_peek(img, "key-missing") == NULL);
+    ut_hash_image_close(img);
+
+    /* 不指定值长度时保存值本身 */
+    UT_TEST_ASSERT(ut_hash_create(&ht, 0, NULL) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < IMAGE_KEYS; i++) {
+        snprintf(key, sizeof(key), "raw-%u", i);
+        ut_hash_push(ht, key, (void*)(uintptr_t)(i + 1));
+    }
+    UT_TEST_ASSERT(ut_hash_save(ht, s_path, NULL, NULL) == UT_ERRNO_OK);
+    ut_hash_destroy(ht);
+    UT_TEST_ASSERT(ut_hash_open_mmap(&img, s_path) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < IMAGE_KEYS; i++) {
+        snprintf(key, sizeof(key), "raw-%u", i);
+        UT_TEST_ASSERT(ut_hash_image_peek(img, key) == (void*)(uintptr_t)(i + 1));
+    }
+    ut_hash_image_close(img);
+}
+
+static void test_hash_image_null(void)
+{
+    UT_TEST_ASSERT(ut_hash_image_count(NULL) == 0);
+    UT_TEST_ASSERT(ut_hash_image_peek(NULL, "key") == NULL);
+    UT_TEST_ASSERT(ut_hash_image_close(NULL) == UT_ERRNO_NULLPTR);
+    UT_TEST_ASSERT(ut_hash_open_mmap(NULL, s_path) == UT_ERRNO_NULLPTR);
+}
+
+/**
+ * @brief 修改镜像中每个已使用的槽位，或者槽位指向的记录
+ *
+ * @param slot_offset 不为0时替换槽位中的偏移
+ * @param keylen 不为0时替换记录中的键长度
+ */
+static void __corrupt(uint64_t slot_offset, uint32_t keylen)
+{
+    int         fd = open(s_path, O_RDWR);
+    uint32_t    mask = 0;
+
+    UT_TEST_ASSERT(fd >= 0);
+    UT_TEST_ASSERT(pread(fd, &mask, sizeof(mask), 28) == sizeof(mask));
+    for (uint64_t i = 0; i <= mask; i++) {
+        uint64_t    pos = IMAGE_HEADER + i * IMAGE_SLOT + 8;
+        uint64_t    offset = 0;
+
+        UT_TEST_ASSERT(pread(fd, &offset, sizeof(offset), pos) == sizeof(offset));
+        if (offset == 0) {
+            continue;
+        }
+        if (slot_offset != 0) {
+            UT_TEST_ASSERT(pwrite(fd, &slot_offset, sizeof(slot_offset), pos) == sizeof(slot_offset));
+        }
+        if (keylen != 0) {
+            UT_TEST_ASSERT(pwrite(fd, &keylen, sizeof(keylen), offset) == sizeof(keylen));
+        }
+    }
+    close(fd);
+}
+
+/* 查找被篡改的镜像时只能返回NULL，不能越界读取 */
+static void __peek_all_missing(void)
+{
+    ut_hash_image_t *img = NULL;
+    char            key[UT_LEN_32];
+
+    UT_TEST_ASSERT(ut_hash_open_mmap(&img, s_path) == UT_ERRNO_OK);
+    for (uint32_t i = 0; i < IMAGE_KEYS; i++) {
+        snprintf(key, sizeof(key), "key-%u", i);
+        UT_TEST_ASSERT(ut_hash_image_peek(img, key) == NULL);
+    }
+    ut_hash_image_close(img);
+}
+
+static void test_hash_image_corrupt(void)
+{
+    ut_hash_image_t *img = NULL;
+    int             fd = -1;
+    uint64_t        index_off = UINT64_MAX - 7;
+
+    /* 偏移加上记录头大小会回绕 */
+    __save_strings();
+    __corrupt(UINT64_MAX - 7, 0);
+    __peek_all_missing();
+
+    /* 偏移没有对齐 */
+    __save_strings();
+    __corrupt(IMAGE_HEADER + 1, 0);
+    __peek_all_missing();
+
+    /* 键长度加1在32位下会回绕 */
+    __save_strings();
+    __corrupt(0, UINT32_MAX);
+    __peek_all_missing();
+
+    /* 索引偏移加上索引大小会回绕 */
+    __save_strings();
+    fd = open(s_path, O_RDWR);
+    UT_TEST_ASSERT(pwrite(fd, &index_off, sizeof(index_off), 32) == sizeof(index_off));
+    close(fd);
+    UT_TEST_ASSERT(ut_hash_open_mmap(&img, s_path) == UT_ERRNO_INVALID);
+
+    /* 文件被截断 */
+    __save_strings();
+    UT_TEST_ASSERT(truncate(s_path, 100) == 0);
+    UT_TEST_ASSERT(ut_hash_open_mmap(&img, s_path) == UT_ERRNO_INVALID);
+}
+
+int main(void)
+{
+    snprintf(s_path, sizeof(s_path), "/tmp/test_hash_image.%d", (int)getpid());
+    UT_TEST_RUN(test_hash_image_roundtrip);
+    UT_TEST_RUN(test_hash_image_null);
+    UT_TEST_RUN(test_hash_image_corrupt);
+    unlink(s_path);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file test_hash_u64.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_hash_u64的单元测试：与数组模型逐步对比，以及遍历过程中删除当前元素
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include "ut/ut_hash_u64.h"
+#include "ut_test.h"
+
+#define MODEL_KEYS      20000
+#define MODEL_STEPS     400000
+
+static void* s_model[MODEL_KEYS];
+
+/* 键分布在高位和低位，覆盖地址<<16|端口这种形式 */
+static inline uint64_t __model_key(uint32_t idx)
+{
+    return ((uint64_t)(idx / 64) << 32) | (idx % 64);
+}
+
+static void test_hash_u64_model(void)
+{
+    ut_hash_u64_t   *ht = NULL;
+    uint64_t        seed = 1;
+    int32_t         count = 0;
+
+    UT_TEST_ASSERT(ut_hash_u64_create(&ht, 0) == UT_ERRNO_OK);
+    for (uint32_t step = 0; step < MODEL_STEPS; step++) {
+        uint32_t    idx = ut_test_rand(&seed) % MODEL_KEYS;
+        void*       value = (void*)(uintptr_t)(step + 1);
+
+        switch (ut_test_rand(&seed) % 3) {
+            case 0:
+                UT_TEST_ASSERT(ut_hash_u64_push(ht, __model_key(idx), value) == s_model[idx]);
+                count += s_model[idx] == NULL;
+                s_model[idx] = value;
+                break;
+            case 1:
+                UT_TEST_ASSERT(ut_hash_u64_pop(ht, __model_key(idx)) == s_model[idx]);
+                count -= s_model[idx] != NULL;
+                s_model[idx] = NULL;
+                break;
+            default:
+                UT_TEST_ASSERT(ut_hash_u64_peek(ht, __model_key(idx)) == s_model[idx]);
+                break;
+        }
+        UT_TEST_ASSERT(ut_hash_u64_count(ht) == count);
+    }
+    ut_hash_u64_destroy(ht);
+}
+
+static ut_bool_t __pop_cb(uint64_t key, const void* value, void* context)
+{
+    ut_hash_u64_t   *ht = context;
+
+    /* 删除奇数值的元素，偶数值的元素保留 */
+    if ((uintptr_t)value & 1) {
+        UT_TEST_ASSERT(ut_hash_u64_pop(ht, key) == value);
+    }
+    return UT_TRUE;
+}
+
+/* 遍历时删除当前元素，后移的元素不能被跳过 */
+static void test_hash_u64_foreach_pop(void)
+{
+    ut_hash_u64_t   *ht = NULL;
+
+    UT_TEST_ASSERT(ut_hash_u64_create(&ht, 16) == UT_ERRNO_OK);
+    for (uint32_t i = 1; i <= 10000; i++) {
+        ut_hash_u64_push(ht, (uint64_t)i << 20, (void*)(uintptr_t)i);
+    }
+    ut_hash_u64_foreach(ht, __pop_cb, ht);
+    UT_TEST_ASSERT(ut_hash_u64_count(ht) == 5000);
+    for (uint32_t i = 1; i <= 10000; i++) {
+        UT_TEST_ASSERT(ut_hash_u64_peek(ht, (uint64_t)i << 20) == ((i & 1) ? NULL : (void*)(uintptr_t)i));
+    }
+    ut_hash_u64_destroy(ht);
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_hash_u64_model);
+    UT_TEST_RUN(test_hash_u64_foreach_pop);
+    return 0;
+}
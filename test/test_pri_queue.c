@@ -0,0 +1,537 @@
+/**
+ * @file test_pri_queue.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_pri_queue的单元测试：各种堆的出队顺序和扩容
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <pthread.h>
+#include "ut/ut_pri_queue.h"
+#include "ut_test.h"
+
+#define QUEUE_ELEMS     100000
+
+typedef struct {
+    const char  *name;
+    uint32_t    flags;
+} test_heap_t;
+
+static const test_heap_t s_heaps[] = {
+    {"binary", UT_PRI_QUEUE_FLAG_NONE},
+    {"4-ary", UT_PRI_QUEUE_FLAG_4ARY},
+    {"8-ary", UT_PRI_QUEUE_FLAG_8ARY},
+};
+
+static ut_bool_t __value_compare(void* elem1, void* elem2)
+{
+    return (uintptr_t)elem1 < (uintptr_t)elem2;
+}
+
+/* 从很小的初始大小开始扩容，交替入队出队，出队的元素始终是当前最小的 */
+static void test_pri_queue_order(void)
+{
+    for (uint32_t h = 0; h < sizeof(s_heaps) / sizeof(s_heaps[0]); h++) {
+        ut_pri_queue_t  *queue = ut_pri_queue_create_ex(1, s_heaps[h].flags | UT_PRI_QUEUE_FLAG_ADAPTION, __value_compare);
+        uint64_t        seed = h + 1;
+        void*           data = NULL;
+        uintptr_t       last = 0;
+
+        UT_TEST_ASSERT(queue != NULL);
+        for (uint32_t i = 0; i < QUEUE_ELEMS; i++) {
+            UT_TEST_ASSERT(ut_pri_queue_push(queue, (void*)(uintptr_t)(ut_test_rand(&seed) % 1000000 + 1)) == UT_ERRNO_OK);
+            if (i % 3 == 0) {
+                UT_TEST_ASSERT(ut_pri_queue_pop_trywait(queue, &data) == UT_ERRNO_OK);
+            }
+        }
+        UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == QUEUE_ELEMS - (QUEUE_ELEMS + 2) / 3);
+        while (ut_pri_queue_get_size(queue) > 0) {
+            UT_TEST_ASSERT(ut_pri_queue_pop_trywait(queue, &data) == UT_ERRNO_OK);
+            UT_TEST_ASSERT((uintptr_t)data >= last);
+            last = (uintptr_t)data;
+        }
+        UT_TEST_ASSERT(ut_pri_queue_pop_trywait(queue, &data) != UT_ERRNO_OK);
+        ut_pri_queue_destroy(queue);
+        printf("  heap %s ok\n", s_heaps[h].name);
+    }
+}
+
+/* 不允许扩容的队列满了之后入队失败 */
+static void test_pri_queue_full(void)
+{
+    ut_pri_queue_t  *queue = ut_pri_queue_create(4, UT_FALSE, __value_compare);
+    void*           data = NULL;
+
+    for (uintptr_t i = 1; i <= 4; i++) {
+        UT_TEST_ASSERT(ut_pri_queue_push(queue, (void*)(5 - i)) == UT_ERRNO_OK);
+    }
+    UT_TEST_ASSERT(ut_pri_queue_push(queue, (void*)9) != UT_ERRNO_OK);
+    UT_TEST_ASSERT(ut_pri_queue_peek(queue, &data) == UT_ERRNO_OK && data == (void*)1);
+    UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == 4);
+    ut_pri_queue_destroy(queue);
+}
+
+#define BATCH_ELEMS     5000
+
+static int __value_sort(const void* a, const void* b)
+{
+    uintptr_t   x = *(const uintptr_t*)a;
+    uintptr_t   y = *(const uintptr_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* 用pop_n分多次取空队列，取出的顺序必须与排序后的输入相同 */
+static void __batch_drain(ut_pri_queue_t *queue, const uintptr_t *sorted, uint32_t num)
+{
+    void*       out[97];
+    uint32_t    popped = 0;
+    int32_t     got = 0;
+
+    while ((got = ut_pri_queue_pop_n(queue, out, 97, 0)) > 0) {
+        UT_TEST_ASSERT(popped + (uint32_t)got <= num);
+        for (int32_t i = 0; i < got; i++, popped++) {
+            UT_TEST_ASSERT((uintptr_t)out[i] == sorted[popped]);
+        }
+    }
+    UT_TEST_ASSERT(got == 0 && popped == num && ut_pri_queue_get_size(queue) == 0);
+}
+
+/* 批量入队：大批量进入小堆走自底向上建堆，小批量进入大堆走逐个上浮，两者的出队顺序都与逐个入队相同 */
+static void test_pri_queue_push_n(void)
+{
+    static uintptr_t    values[BATCH_ELEMS];
+    static uintptr_t    sorted[BATCH_ELEMS];
+
+    for (uint32_t h = 0; h < sizeof(s_heaps) / sizeof(s_heaps[0]); h++) {
+        uint32_t        flags = s_heaps[h].flags | UT_PRI_QUEUE_FLAG_ADAPTION;
+        ut_pri_queue_t  *single = ut_pri_queue_create_ex(1, flags, __value_compare);
+        ut_pri_queue_t  *floyd = ut_pri_queue_create_ex(1, flags, __value_compare);
+        ut_pri_queue_t  *sift = ut_pri_queue_create_ex(1, flags, __value_compare);
+        uint64_t        seed = h + 1;
+
+        UT_TEST_ASSERT(single != NULL && floyd != NULL && sift != NULL);
+        for (uint32_t i = 0; i < BATCH_ELEMS; i++) {
+            /* 取值范围较小，保证有重复的优先级 */
+            values[i] = ut_test_rand(&seed) % 1000 + 1;
+            UT_TEST_ASSERT(ut_pri_queue_push(single, (void*)values[i]) == UT_ERRNO_OK);
+        }
+        memcpy(sorted, values, sizeof(values));
+        qsort(sorted, BATCH_ELEMS, sizeof(sorted[0]), __value_sort);
+
+        /* 先放入少量元素，剩余的一整批远大于已有的堆 */
+        UT_TEST_ASSERT(ut_pri_queue_push_n(floyd, (void* const*)values, 8) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_pri_queue_push_n(floyd, (void* const*)values + 8, BATCH_ELEMS - 8) == UT_ERRNO_OK);
+
+        /* 先放入一半，剩余的按很小的批量放入 */
+        UT_TEST_ASSERT(ut_pri_queue_push_n(sift, (void* const*)values, BATCH_ELEMS / 2) == UT_ERRNO_OK);
+        for (uint32_t i = BATCH_ELEMS / 2; i < BATCH_ELEMS; i += 7) {
+            int32_t     num = (BATCH_ELEMS - i < 7) ? (int32_t)(BATCH_ELEMS - i) : 7;
+
+            UT_TEST_ASSERT(ut_pri_queue_push_n(sift, (void* const*)values + i, num) == UT_ERRNO_OK);
+        }
+
+        UT_TEST_ASSERT(ut_pri_queue_get_size(floyd) == BATCH_ELEMS && ut_pri_queue_get_size(sift) == BATCH_ELEMS);
+        __batch_drain(single, sorted, BATCH_ELEMS);
+        __batch_drain(floyd, sorted, BATCH_ELEMS);
+        __batch_drain(sift, sorted, BATCH_ELEMS);
+        ut_pri_queue_destroy(single);
+        ut_pri_queue_destroy(floyd);
+        ut_pri_queue_destroy(sift);
+        printf("  heap %s ok\n", s_heaps[h].name);
+    }
+}
+
+/* 不允许扩容的队列放不下整批数据时整批都不入队；pop_n按顺序取出请求的个数，队列取空后提前返回 */
+static void test_pri_queue_batch_bounds(void)
+{
+    ut_pri_queue_t  *queue = ut_pri_queue_create(16, UT_FALSE, __value_compare);
+    void*           batch[17];
+    void*           out[32];
+    void*           data = NULL;
+
+    UT_TEST_ASSERT(queue != NULL);
+    for (uintptr_t i = 0; i < 17; i++) {
+        batch[i] = (void*)(17 - i);
+    }
+    UT_TEST_ASSERT(ut_pri_queue_push_n(queue, batch, 10) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(ut_pri_queue_push_n(queue, batch + 10, 7) == UT_ERRNO_RESOURCE);
+    UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == 10);
+    UT_TEST_ASSERT(ut_pri_queue_peek(queue, &data) == UT_ERRNO_OK && data == (void*)8);
+    UT_TEST_ASSERT(ut_pri_queue_push_n(queue, batch + 10, 6) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == 16);
+    UT_TEST_ASSERT(ut_pri_queue_push_n(queue, batch, 1) == UT_ERRNO_RESOURCE);
+
+    UT_TEST_ASSERT(ut_pri_queue_pop_n(queue, out, 0, 0) == 0);
+    UT_TEST_ASSERT(ut_pri_queue_pop_n(queue, out, 5, 0) == 5);
+    for (uintptr_t i = 0; i < 5; i++) {
+        UT_TEST_ASSERT(out[i] == (void*)(i + 2));
+    }
+    UT_TEST_ASSERT(ut_pri_queue_pop_n(queue, out, 32, 0) == 11);
+    for (uintptr_t i = 0; i < 11; i++) {
+        UT_TEST_ASSERT(out[i] == (void*)(i + 7));
+    }
+    UT_TEST_ASSERT(ut_pri_queue_pop_n(queue, out, 32, 0) == 0);
+    UT_TEST_ASSERT(ut_pri_queue_pop_n(queue, out, 32, 10) == 0);
+    ut_pri_queue_destroy(queue);
+}
+
+/* 整数键队列：键可以为负数，取出的键非递减，数据与键一一对应 */
+static void test_pri_queue_key(void)
+{
+    for (uint32_t h = 0; h < sizeof(s_heaps) / sizeof(s_heaps[0]); h++) {
+        ut_pri_queue_t  *queue = ut_pri_queue_create_key(16, s_heaps[h].flags | UT_PRI_QUEUE_FLAG_ADAPTION);
+        uint64_t        seed = h + 1;
+        int64_t         key = 0;
+        int64_t         last = INT64_MIN;
+        void*           data = NULL;
+
+        UT_TEST_ASSERT(queue != NULL);
+        for (uint32_t i = 0; i < QUEUE_ELEMS; i++) {
+            key = (int64_t)(ut_test_rand(&seed) % 2000000) - 1000000;
+            UT_TEST_ASSERT(ut_pri_queue_push_key(queue, key, (void*)(intptr_t)(key * 2), NULL) == UT_ERRNO_OK);
+        }
+        UT_TEST_ASSERT(ut_pri_queue_peek_key(queue, &key, NULL) == UT_ERRNO_OK);
+        while (ut_pri_queue_pop_key(queue, &key, &data, 0) == UT_ERRNO_OK) {
+            UT_TEST_ASSERT(key >= last && (intptr_t)data == key * 2);
+            last = key;
+        }
+        UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == 0);
+        ut_pri_queue_destroy(queue);
+    }
+}
+
+#define HANDLE_IDS      1000
+#define HANDLE_STEPS    40000
+
+typedef struct {
+    int64_t     prio;
+    uint32_t    id;
+} test_elem_t;
+
+static ut_bool_t __elem_compare(void* elem1, void* elem2)
+{
+    return ((test_elem_t*)elem1)->prio < ((test_elem_t*)elem2)->prio;
+}
+
+/* 模型中优先级最小的存活元素，没有时返回-1 */
+static int32_t __model_min(const test_elem_t *elems, const ut_bool_t *live)
+{
+    int32_t     best = -1;
+
+    for (int32_t i = 0; i < HANDLE_IDS; i++) {
+        if (live[i] && (best < 0 || elems[i].prio < elems[best].prio)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* 整数键队列取出键和数据，比较函数队列只取出数据 */
+static ut_errno_t __handle_pop(ut_pri_queue_t *queue, uint32_t key_mode, int64_t *key, void** pdata)
+{
+    return key_mode ? ut_pri_queue_pop_key(queue, key, pdata, 0) : ut_pri_queue_pop_trywait(queue, pdata);
+}
+
+/* 句柄：随机的入队、出队、按句柄移除和修改优先级与模型对比；旧句柄的序号被复用之后必须失效，不能影响存活的元素 */
+static void test_pri_queue_handle(void)
+{
+    static test_elem_t      elems[HANDLE_IDS];
+    static ut_bool_t        live[HANDLE_IDS];
+    static ut_pri_handle_t  handles[HANDLE_IDS];
+    static ut_pri_handle_t  stale[HANDLE_STEPS];
+
+    for (uint32_t h = 0; h < sizeof(s_heaps) / sizeof(s_heaps[0]); h++) {
+        for (uint32_t key_mode = 0; key_mode < 2; key_mode++) {
+            uint32_t        flags = s_heaps[h].flags | UT_PRI_QUEUE_FLAG_HANDLE | UT_PRI_QUEUE_FLAG_ADAPTION;
+            ut_pri_queue_t  *queue = key_mode ? ut_pri_queue_create_key(16, flags) : ut_pri_queue_create_ex(16, flags, __elem_compare);
+            uint64_t        seed = h * 2 + key_mode + 1;
+            uint32_t        stale_num = 0;
+            int32_t         count = 0;
+            int64_t         key = 0;
+            void*           data = NULL;
+
+            UT_TEST_ASSERT(queue != NULL);
+            memset(live, 0, sizeof(live));
+            for (uint32_t step = 0; step < HANDLE_STEPS; step++) {
+                uint32_t        id = ut_test_rand(&seed) % HANDLE_IDS;
+                test_elem_t     *elem = &elems[id];
+                int32_t         min = __model_min(elems, live);
+
+                switch (ut_test_rand(&seed) % 5) {
+                    case 0:     /* 入队 */
+                    case 1:
+                        if (live[id]) {
+                            break;
+                        }
+                        elem->id = id;
+                        elem->prio = (int64_t)(ut_test_rand(&seed) % 100000);
+                        if (key_mode) {
+                            UT_TEST_ASSERT(ut_pri_queue_push_key(queue, elem->prio, elem, &handles[id]) == UT_ERRNO_OK);
+                        } else {
+                            UT_TEST_ASSERT(ut_pri_queue_push_handle(queue, elem, &handles[id]) == UT_ERRNO_OK);
+                        }
+                        live[id] = UT_TRUE;
+                        count++;
+                        break;
+                    case 2:     /* 出队，优先级与模型中最小的相同 */
+                        if (min < 0) {
+                            UT_TEST_ASSERT(__handle_pop(queue, key_mode, NULL, &data) != UT_ERRNO_OK);
+                            break;
+                        }
+                        UT_TEST_ASSERT(__handle_pop(queue, key_mode, &key, &data) == UT_ERRNO_OK);
+                        elem = data;
+                        UT_TEST_ASSERT(live[elem->id] && elem->prio == elems[min].prio);
+                        UT_TEST_ASSERT(!key_mode || key == elem->prio);
+                        live[elem->id] = UT_FALSE;
+                        stale[stale_num++] = handles[elem->id];
+                        count--;
+                        break;
+                    case 3:     /* 按句柄移除 */
+                        if (!live[id]) {
+                            break;
+                        }
+                        UT_TEST_ASSERT(ut_pri_queue_remove(queue, handles[id], &data) == UT_ERRNO_OK && data == elem);
+                        live[id] = UT_FALSE;
+                        stale[stale_num++] = handles[id];
+                        count--;
+                        break;
+                    default:    /* 修改优先级 */
+                        if (!live[id]) {
+                            break;
+                        }
+                        elem->prio = (int64_t)(ut_test_rand(&seed) % 100000);
+                        if (key_mode) {
+                            UT_TEST_ASSERT(ut_pri_queue_update_key(queue, handles[id], elem->prio) == UT_ERRNO_OK);
+                        } else {
+                            UT_TEST_ASSERT(ut_pri_queue_update(queue, handles[id]) == UT_ERRNO_OK);
+                        }
+                        break;
+                }
+
+                /* 旧句柄：移除和修改都返回不存在 */
+                if (stale_num > 0) {
+                    ut_pri_handle_t     old = stale[ut_test_rand(&seed) % stale_num];
+
+                    data = (void*)1;
+                    UT_TEST_ASSERT(ut_pri_queue_remove(queue, old, &data) == UT_ERRNO_NOTEXSIT && data == NULL);
+                    if (key_mode) {
+                        UT_TEST_ASSERT(ut_pri_queue_update_key(queue, old, -1) == UT_ERRNO_NOTEXSIT);
+                    } else {
+                        UT_TEST_ASSERT(ut_pri_queue_update(queue, old) == UT_ERRNO_NOTEXSIT);
+                    }
+                }
+                UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == count);
+            }
+
+            /* 全部取出，顺序与排序后的模型相同 */
+            while (count-- > 0) {
+                int32_t     min = __model_min(elems, live);
+
+                UT_TEST_ASSERT(__handle_pop(queue, key_mode, NULL, &data) == UT_ERRNO_OK);
+                UT_TEST_ASSERT(((test_elem_t*)data)->prio == elems[min].prio);
+                live[((test_elem_t*)data)->id] = UT_FALSE;
+            }
+            UT_TEST_ASSERT(__model_min(elems, live) < 0);
+            ut_pri_queue_destroy(queue);
+            printf("  heap %s %s ok\n", s_heaps[h].name, key_mode ? "key" : "comparator");
+        }
+    }
+}
+
+#define TOPK_INPUTS     3000
+
+/* 模型中优先级最低（prio最大）或最高（prio最小）的元素在kept中的下标 */
+static uint32_t __topk_extreme(test_elem_t* const kept[], uint32_t num, ut_bool_t lowest)
+{
+    uint32_t    best = 0;
+
+    for (uint32_t i = 1; i < num; i++) {
+        if (lowest ? kept[i]->prio > kept[best]->prio : kept[i]->prio < kept[best]->prio) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* 有界队列保留优先级最高的K个：与模型对比每一步的替换和拒绝，以及最高、最低的元素；最后按顺序全部取出 */
+static void test_pri_queue_topk(void)
+{
+    static const int32_t    ks[] = {1, 64, TOPK_INPUTS + 100};
+    static test_elem_t      elems[TOPK_INPUTS];
+    static test_elem_t      *kept[TOPK_INPUTS];
+
+    for (uint32_t k = 0; k < sizeof(ks) / sizeof(ks[0]); k++) {
+        for (uint32_t key_mode = 0; key_mode < 2; key_mode++) {
+            ut_pri_queue_t  *queue = ut_pri_queue_create_topk(ks[k], UT_PRI_QUEUE_FLAG_NONE, key_mode ? NULL : __elem_compare);
+            uint64_t        seed = k * 2 + key_mode + 1;
+            uint32_t        num = 0;
+            int64_t         key = 0;
+            void*           data = NULL;
+            void*           evicted = NULL;
+
+            UT_TEST_ASSERT(queue != NULL);
+            UT_TEST_ASSERT(ut_pri_queue_peek_min(queue, NULL, NULL) == UT_ERRNO_RESOURCE);
+            for (uint32_t i = 0; i < TOPK_INPUTS; i++) {
+                test_elem_t     *elem = &elems[i];
+                ut_errno_t      retval = UT_ERRNO_OK;
+
+                elem->id = i;
+                elem->prio = (int64_t)(ut_test_rand(&seed) % 1000);
+                evicted = (void*)1;
+                retval = ut_pri_queue_push_evict(queue, elem->prio, elem, &evicted);
+
+                if (num < (uint32_t)ks[k]) {
+                    /* 没有满，直接存入 */
+                    UT_TEST_ASSERT(retval == UT_ERRNO_OK && evicted == NULL);
+                    kept[num++] = elem;
+                } else {
+                    uint32_t    lowest = __topk_extreme(kept, num, UT_TRUE);
+
+                    if (elem->prio < kept[lowest]->prio) {
+                        /* 替换掉优先级最低的，相同优先级的元素中任意一个都可以 */
+                        UT_TEST_ASSERT(retval == UT_ERRNO_OK && evicted != NULL);
+                        UT_TEST_ASSERT(((test_elem_t*)evicted)->prio == kept[lowest]->prio);
+                        for (lowest = 0; kept[lowest] != evicted; lowest++) {
+                            UT_TEST_ASSERT(lowest + 1 < num);
+                        }
+                        kept[lowest] = elem;
+                    } else {
+                        /* 不比最低的好，拒绝 */
+                        UT_TEST_ASSERT(retval == UT_ERRNO_RESOURCE && evicted == NULL);
+                    }
+                }
+
+                UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == (int32_t)num);
+                UT_TEST_ASSERT(ut_pri_queue_peek_max(queue, &key, &data) == UT_ERRNO_OK);
+                UT_TEST_ASSERT(((test_elem_t*)data)->prio == kept[__topk_extreme(kept, num, UT_FALSE)]->prio);
+                UT_TEST_ASSERT(!key_mode || key == ((test_elem_t*)data)->prio);
+                UT_TEST_ASSERT(ut_pri_queue_peek_min(queue, &key, &data) == UT_ERRNO_OK);
+                UT_TEST_ASSERT(((test_elem_t*)data)->prio == kept[__topk_extreme(kept, num, UT_TRUE)]->prio);
+                UT_TEST_ASSERT(!key_mode || key == ((test_elem_t*)data)->prio);
+            }
+
+            /* 全部取出，顺序与排序后的模型相同 */
+            while (num > 0) {
+                uint32_t    best = __topk_extreme(kept, num, UT_FALSE);
+
+                UT_TEST_ASSERT(__handle_pop(queue, key_mode, NULL, &data) == UT_ERRNO_OK);
+                UT_TEST_ASSERT(((test_elem_t*)data)->prio == kept[best]->prio);
+                kept[best] = kept[--num];
+            }
+            UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == 0);
+            ut_pri_queue_destroy(queue);
+        }
+    }
+}
+
+/* 基数堆：按定时器的方式取出最早的键再放入更晚的键，取出的键与二叉堆完全相同，小于已取出的键不能入队 */
+static void test_pri_queue_radix(void)
+{
+    ut_pri_queue_t  *radix = ut_pri_queue_create_key(16, UT_PRI_QUEUE_FLAG_RADIX | UT_PRI_QUEUE_FLAG_ADAPTION);
+    ut_pri_queue_t  *heap = ut_pri_queue_create_key(16, UT_PRI_QUEUE_FLAG_ADAPTION);
+    uint64_t        seed = 1;
+    int64_t         key1 = 0;
+    int64_t         key2 = 0;
+    void*           data = NULL;
+
+    UT_TEST_ASSERT(radix != NULL && heap != NULL);
+    UT_TEST_ASSERT(ut_pri_queue_create_key(16, UT_PRI_QUEUE_FLAG_RADIX | UT_PRI_QUEUE_FLAG_HANDLE) == NULL);
+    for (uint32_t i = 0; i < 1000; i++) {
+        key1 = (int64_t)(ut_test_rand(&seed) % 100000);
+        ut_pri_queue_push_key(radix, key1, NULL, NULL);
+        ut_pri_queue_push_key(heap, key1, NULL, NULL);
+    }
+    for (uint32_t i = 0; i < QUEUE_ELEMS; i++) {
+        UT_TEST_ASSERT(ut_pri_queue_pop_key(radix, &key1, &data, 0) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_pri_queue_pop_key(heap, &key2, &data, 0) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(key1 == key2);
+        if (i % 7 != 0) {
+            key2 = key1 + (int64_t)(ut_test_rand(&seed) % 100000);
+            UT_TEST_ASSERT(ut_pri_queue_push_key(radix, key2, NULL, NULL) == UT_ERRNO_OK);
+            ut_pri_queue_push_key(heap, key2, NULL, NULL);
+        }
+        if (ut_pri_queue_get_size(heap) == 0) {
+            break;
+        }
+    }
+    UT_TEST_ASSERT(ut_pri_queue_push_key(radix, key1 - 1, NULL, NULL) == UT_ERRNO_INVALID);
+    UT_TEST_ASSERT(ut_pri_queue_get_size(radix) == ut_pri_queue_get_size(heap));
+    ut_pri_queue_destroy(radix);
+    ut_pri_queue_destroy(heap);
+}
+
+/* 桶队列：按优先级从小到大取出，同一优先级先进先出，超出范围的优先级不能入队 */
+static void test_pri_queue_bucket(void)
+{
+    ut_pri_queue_t  *queue = ut_pri_queue_create_bucket(16, 8, UT_PRI_QUEUE_FLAG_ADAPTION);
+    uintptr_t       last_seq[8] = {0};
+    uint64_t        seed = 1;
+    int64_t         key = 0;
+    int64_t         last = 0;
+    void*           data = NULL;
+
+    UT_TEST_ASSERT(queue != NULL);
+    UT_TEST_ASSERT(ut_pri_queue_push_key(queue, 8, NULL, NULL) == UT_ERRNO_INVALID);
+    UT_TEST_ASSERT(ut_pri_queue_push_key(queue, -1, NULL, NULL) == UT_ERRNO_INVALID);
+    for (uintptr_t i = 1; i <= QUEUE_ELEMS; i++) {
+        UT_TEST_ASSERT(ut_pri_queue_push_key(queue, (int64_t)(ut_test_rand(&seed) % 8), (void*)i, NULL) == UT_ERRNO_OK);
+    }
+    while (ut_pri_queue_pop_key(queue, &key, &data, 0) == UT_ERRNO_OK) {
+        UT_TEST_ASSERT(key >= last && (uintptr_t)data > last_seq[key]);
+        last = key;
+        last_seq[key] = (uintptr_t)data;
+    }
+    UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == 0);
+    ut_pri_queue_destroy(queue);
+}
+
+static void* __handoff_producer(void* arg)
+{
+    for (uintptr_t i = 1; i <= QUEUE_ELEMS; i++) {
+        UT_TEST_ASSERT(ut_pri_queue_push(arg, (void*)i) == UT_ERRNO_OK);
+    }
+    return NULL;
+}
+
+/* 消费者与生产者同时运行，自旋和睡眠等待都不能丢失或重复元素，等待超时能正确返回 */
+static void test_pri_queue_handoff(void)
+{
+    static const uint32_t flags[] = {UT_PRI_QUEUE_FLAG_ADAPTION, UT_PRI_QUEUE_FLAG_ADAPTION | UT_PRI_QUEUE_FLAG_SPIN};
+
+    for (uint32_t f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+        ut_pri_queue_t  *queue = ut_pri_queue_create_ex(16, flags[f], __value_compare);
+        pthread_t       tid;
+        void*           data = NULL;
+        uint64_t        sum = 0;
+
+        pthread_create(&tid, NULL, __handoff_producer, queue);
+        for (uint32_t i = 0; i < QUEUE_ELEMS; i++) {
+            UT_TEST_ASSERT(ut_pri_queue_pop_wait(queue, &data) == UT_ERRNO_OK);
+            sum += (uintptr_t)data;
+        }
+        pthread_join(tid, NULL);
+        UT_TEST_ASSERT(sum == (uint64_t)QUEUE_ELEMS * (QUEUE_ELEMS + 1) / 2);
+        UT_TEST_ASSERT(ut_pri_queue_get_size(queue) == 0);
+        UT_TEST_ASSERT(ut_pri_queue_pop_timedwait(queue, &data, 20) == UT_ERRNO_RESOURCE);
+        ut_pri_queue_destroy(queue);
+    }
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_pri_queue_order);
+    UT_TEST_RUN(test_pri_queue_full);
+    UT_TEST_RUN(test_pri_queue_key);
+    UT_TEST_RUN(test_pri_queue_push_n);
+    UT_TEST_RUN(test_pri_queue_batch_bounds);
+    UT_TEST_RUN(test_pri_queue_handle);
+    UT_TEST_RUN(test_pri_queue_topk);
+    UT_TEST_RUN(test_pri_queue_radix);
+    UT_TEST_RUN(test_pri_queue_bucket);
+    UT_TEST_RUN(test_pri_queue_handoff);
+    return 0;
+}
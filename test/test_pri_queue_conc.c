@@ -0,0 +1,98 @@
+/**
+ * @file test_pri_queue_conc.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_pri_queue_conc的单元测试：多个生产者和消费者同时访问时每个元素恰好被取出一次
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <pthread.h>
+#include "ut/ut_pri_queue_conc.h"
+#include "ut_test.h"
+
+#define PRODUCERS       4
+#define CONSUMERS       4
+#define PER_PRODUCER    50000
+
+static ut_pri_queue_conc_t  *s_queue = NULL;
+static uint8_t              s_seen[PRODUCERS * PER_PRODUCER + 1];
+
+static ut_bool_t __value_compare(void* elem1, void* elem2)
+{
+    return (uintptr_t)elem1 < (uintptr_t)elem2;
+}
+
+static void* __producer(void* arg)
+{
+    uintptr_t   base = (uintptr_t)arg * PER_PRODUCER;
+
+    for (uintptr_t i = 1; i <= PER_PRODUCER; i++) {
+        UT_TEST_ASSERT(ut_pri_queue_conc_push(s_queue, (void*)(base + i)) == UT_ERRNO_OK);
+    }
+    return NULL;
+}
+
+/* 超时没有取到元素说明生产者都已经结束 */
+static void* __consumer(void* arg)
+{
+    void*   data = NULL;
+
+    while (ut_pri_queue_conc_pop_timedwait(s_queue, &data, 200) == UT_ERRNO_OK) {
+        __atomic_fetch_add(&s_seen[(uintptr_t)data], 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void test_pri_queue_conc_exactly_once(void)
+{
+    pthread_t   tids[PRODUCERS + CONSUMERS];
+
+    s_queue = ut_pri_queue_conc_create(64, 0, __value_compare);
+    UT_TEST_ASSERT(s_queue != NULL);
+    /* count按缓存行对齐，描述结构也必须对齐 */
+    UT_TEST_ASSERT(((uintptr_t)s_queue & 63) == 0);
+
+    for (uintptr_t i = 0; i < CONSUMERS; i++) {
+        pthread_create(&tids[PRODUCERS + i], NULL, __consumer, NULL);
+    }
+    for (uintptr_t i = 0; i < PRODUCERS; i++) {
+        pthread_create(&tids[i], NULL, __producer, (void*)i);
+    }
+    for (uint32_t i = 0; i < PRODUCERS + CONSUMERS; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    for (uint32_t i = 1; i <= PRODUCERS * PER_PRODUCER; i++) {
+        UT_TEST_ASSERT(s_seen[i] == 1);
+    }
+    UT_TEST_ASSERT(ut_pri_queue_conc_get_size(s_queue) == 0);
+    ut_pri_queue_conc_destroy(s_queue);
+}
+
+/* 单线程入队出队，全部元素都能取出，队列为空时等待超时返回 */
+static void test_pri_queue_conc_single(void)
+{
+    ut_pri_queue_conc_t *queue = ut_pri_queue_conc_create(16, 4, __value_compare);
+    void*               data = NULL;
+    uint32_t            popped = 0;
+
+    for (uintptr_t i = 1000; i > 0; i--) {
+        UT_TEST_ASSERT(ut_pri_queue_conc_push(queue, (void*)i) == UT_ERRNO_OK);
+    }
+    UT_TEST_ASSERT(ut_pri_queue_conc_get_size(queue) == 1000);
+    while (ut_pri_queue_conc_pop_trywait(queue, &data) == UT_ERRNO_OK) {
+        popped++;
+    }
+    UT_TEST_ASSERT(popped == 1000);
+    UT_TEST_ASSERT(ut_pri_queue_conc_pop_timedwait(queue, &data, 10) != UT_ERRNO_OK);
+    ut_pri_queue_conc_destroy(queue);
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_pri_queue_conc_exactly_once);
+    UT_TEST_RUN(test_pri_queue_conc_single);
+    return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file test_select.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_select的单元测试：两种后端的fd分发，回调中关闭并复用fd，定时器的到期顺序和删除
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "ut/ut_select.h"
+#include "ut_test.h"
+
+#define TIMER_NUM       2000
+#define TIMER_ORDER_SLACK   1500    /* 一个刻度（1ms），加上记录到期时间与引擎读取时钟之间的误差 */
+
+typedef struct {
+    ut_select_engine_t  *engine;
+    ut_fd_t             fds[2];
+    int32_t             hits;
+    int32_t             stale;
+} test_reuse_t;
+
+static ut_select_engine_t *s_engine = NULL;
+
+static void __stop_cb(void* context)
+{
+    ut_select_engine_stop(context);
+}
+
+static void __stale_cb(ut_fd_t fd, void* context)
+{
+    ((test_reuse_t*)context)->stale++;
+}
+
+/* 第一个就绪的fd关闭另一个同样就绪的fd，新打开的fd复用同一个数值并注册 */
+static void __reuse_cb(ut_fd_t fd, void* context)
+{
+    test_reuse_t    *reuse = context;
+    ut_fd_t         other = reuse->fds[0] == fd ? reuse->fds[1] : reuse->fds[0];
+    uint64_t        value = 0;
+
+    UT_TEST_ASSERT(read(fd, &value, sizeof(value)) == sizeof(value));
+    reuse->hits++;
+    ut_select_engine_fd_del(reuse->engine, other);
+    close(other);
+    UT_TEST_ASSERT(eventfd(0, 0) == other);
+    UT_TEST_ASSERT(ut_select_engine_fd_add_forever(reuse->engine, other, __stale_cb, reuse) == UT_ERRNO_OK);
+}
+
+/* 同一批就绪事件中fd被关闭又被复用时，旧的事件不能分发给新的注册 */
+static void test_select_fd_reuse(void)
+{
+    for (ut_select_backend_t backend = UT_SELECT_BACKEND_SELECT; backend <= UT_SELECT_BACKEND_EPOLL; backend++) {
+        test_reuse_t    reuse;
+        uint64_t        one = 1;
+
+        memset(&reuse, 0, sizeof(reuse));
+        UT_TEST_ASSERT(ut_select_engine_create_ex(&reuse.engine, backend) == UT_ERRNO_OK);
+        for (uint32_t i = 0; i < 2; i++) {
+            reuse.fds[i] = eventfd(0, 0);
+            UT_TEST_ASSERT(write(reuse.fds[i], &one, sizeof(one)) == sizeof(one));
+            UT_TEST_ASSERT(ut_select_engine_fd_add_forever(reuse.engine, reuse.fds[i], __reuse_cb, &reuse) == UT_ERRNO_OK);
+        }
+        ut_select_engine_schedule_add(reuse.engine, __stop_cb, reuse.engine, 50 * 1000);
+        UT_TEST_ASSERT(ut_select_engine_run(reuse.engine) == UT_ERRNO_OK);
+
+        UT_TEST_ASSERT(reuse.hits == 1 && reuse.stale == 0);
+        for (uint32_t i = 0; i < 2; i++) {
+            ut_select_engine_fd_del(reuse.engine, reuse.fds[i]);
+            close(reuse.fds[i]);
+        }
+        ut_select_engine_destroy(reuse.engine);
+    }
+}
+
+static void __count_cb(ut_fd_t fd, void* context)
+{
+    uint64_t        value = 0;
+
+    UT_TEST_ASSERT(read(fd, &value, sizeof(value)) == sizeof(value));
+    (*(int32_t*)context)++;
+}
+
+/* 没有删除就关闭的fd，数值被新的fd复用后再次添加，新的fd可读时能够回调 */
+static void test_select_fd_reopen(void)
+{
+    for (ut_select_backend_t backend = UT_SELECT_BACKEND_SELECT; backend <= UT_SELECT_BACKEND_EPOLL; backend++) {
+        ut_select_engine_t  *engine = NULL;
+        ut_fd_t             fd = eventfd(0, 0);
+        int32_t             old_hits = 0;
+        int32_t             new_hits = 0;
+        uint64_t            one = 1;
+
+        UT_TEST_ASSERT(ut_select_engine_create_ex(&engine, backend) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_select_engine_fd_add_forever(engine, fd, __count_cb, &old_hits) == UT_ERRNO_OK);
+        close(fd);
+        UT_TEST_ASSERT(eventfd(0, 0) == fd);
+        UT_TEST_ASSERT(ut_select_engine_fd_add_forever(engine, fd, __count_cb, &new_hits) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(write(fd, &one, sizeof(one)) == sizeof(one));
+        ut_select_engine_schedule_add(engine, __stop_cb, engine, 50 * 1000);
+        UT_TEST_ASSERT(ut_select_engine_run(engine) == UT_ERRNO_OK);
+
+        UT_TEST_ASSERT(old_hits == 0 && new_hits == 1);
+        UT_TEST_ASSERT(ut_select_engine_fd_del(engine, fd) == UT_ERRNO_OK);
+        ut_select_engine_destroy(engine);
+        close(fd);
+    }
+}
+
+static void __once_cb(ut_fd_t fd, void* context)
+{
+    uint64_t        value = 0;
+
+    UT_TEST_ASSERT(read(fd, &value, sizeof(value)) == sizeof(value));
+    (*(int32_t*)context)++;
+    if (*(int32_t*)context < 3) {
+        UT_TEST_ASSERT(write(fd, &value, sizeof(value)) == sizeof(value));
+    }
+}
+
+/* 一次性的fd只回调一次，永久的fd每次可读都回调；删除不存在的fd返回错误 */
+static void test_select_once_forever(void)
+{
+    for (ut_select_backend_t backend = UT_SELECT_BACKEND_SELECT; backend <= UT_SELECT_BACKEND_EPOLL; backend++) {
+        ut_fd_t         once_fd = eventfd(0, 0);
+        ut_fd_t         forever_fd = eventfd(0, 0);
+        int32_t         once_hits = 0;
+        int32_t         forever_hits = 0;
+        uint64_t        one = 1;
+
+        UT_TEST_ASSERT(ut_select_engine_create_ex(&s_engine, backend) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_select_engine_fd_add_once(s_engine, once_fd, __once_cb, &once_hits) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_select_engine_fd_add_forever(s_engine, forever_fd, __once_cb, &forever_hits) == UT_ERRNO_OK);
+        write(once_fd, &one, sizeof(one));
+        write(forever_fd, &one, sizeof(one));
+        ut_select_engine_schedule_add(s_engine, __stop_cb, s_engine, 50 * 1000);
+        UT_TEST_ASSERT(ut_select_engine_run(s_engine) == UT_ERRNO_OK);
+
+        UT_TEST_ASSERT(once_hits == 1 && forever_hits == 3);
+        UT_TEST_ASSERT(ut_select_engine_fd_del(s_engine, once_fd) == UT_ERRNO_NOTEXSIT);
+        UT_TEST_ASSERT(ut_select_engine_fd_del(s_engine, forever_fd) == UT_ERRNO_OK);
+        ut_select_engine_destroy(s_engine);
+        close(once_fd);
+        close(forever_fd);
+    }
+}
+
+typedef struct {
+    ut_select_engine_t  *engine;
+    ut_select_timer_t   ids[TIMER_NUM];
+    int64_t             expire[TIMER_NUM];
+    int64_t             last;
+    int32_t             fired;
+    int32_t             expected;
+} test_timer_t;
+
+static test_timer_t s_timer;
+
+static int64_t __now_us(void)
+{
+    struct timespec     now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 * 1000 + now.tv_nsec / 1000;
+}
+
+/* 定时器不能早于到期时间回调，按到期时间的先后回调（同一个刻度内不区分先后）。
+   记录的到期时间在添加之前取得，不会晚于引擎中的到期时间 */
+static void __timer_cb(void* context)
+{
+    uint32_t    idx = (uint32_t)(uintptr_t)context;
+    int64_t     now = __now_us();
+
+    UT_TEST_ASSERT(now >= s_timer.expire[idx]);
+    UT_TEST_ASSERT(s_timer.expire[idx] + TIMER_ORDER_SLACK >= s_timer.last);
+    s_timer.last = s_timer.expire[idx];
+
+    /* 偶数号的定时器删除下一个偶数号的定时器 */
+    if (idx % 2 == 0 && idx + 2 < TIMER_NUM && ut_select_engine_schedule_del(s_timer.engine, s_timer.ids[idx + 2]) == UT_ERRNO_OK) {
+        s_timer.expected--;
+    }
+    if (++s_timer.fired == s_timer.expected) {
+        ut_select_engine_stop(s_timer.engine);
+    }
+}
+
+/* 随机时长的定时器按顺序到期，被删除的不再回调；删除已经删除的定时器返回错误，有定时器时不能修改刻度 */
+static void test_select_timer(void)
+{
+    uint64_t        seed = 1;
+
+    memset(&s_timer, 0, sizeof(s_timer));
+    UT_TEST_ASSERT(ut_select_engine_create_ex(&s_timer.engine, UT_SELECT_BACKEND_EPOLL) == UT_ERRNO_OK);
+    s_timer.expected = TIMER_NUM;
+    for (uint32_t i = 0; i < TIMER_NUM; i++) {
+        int64_t     timeout = (int64_t)(ut_test_rand(&seed) % 300000);
+
+        s_timer.expire[i] = __now_us() + timeout;
+        UT_TEST_ASSERT(ut_select_engine_schedule_add_ex(s_timer.engine, __timer_cb, (void*)(uintptr_t)i, timeout, &s_timer.ids[i]) == UT_ERRNO_OK);
+    }
+    for (uint32_t i = 1; i < TIMER_NUM; i += 4) {
+        UT_TEST_ASSERT(ut_select_engine_schedule_del(s_timer.engine, s_timer.ids[i]) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_select_engine_schedule_del(s_timer.engine, s_timer.ids[i]) == UT_ERRNO_NOTEXSIT);
+        s_timer.expected--;
+    }
+    UT_TEST_ASSERT(ut_select_engine_set_resolution(s_timer.engine, 10 * 1000) == UT_ERRNO_RESOURCE);
+
+    UT_TEST_ASSERT(ut_select_engine_run(s_timer.engine) == UT_ERRNO_OK);
+    UT_TEST_ASSERT(s_timer.fired == s_timer.expected);
+    UT_TEST_ASSERT(ut_select_engine_schedule_del(s_timer.engine, s_timer.ids[0]) == UT_ERRNO_NOTEXSIT);
+    UT_TEST_ASSERT(ut_select_engine_set_resolution(s_timer.engine, 10 * 1000) == UT_ERRNO_OK);
+    ut_select_engine_destroy(s_timer.engine);
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_select_fd_reuse);
+    UT_TEST_RUN(test_select_fd_reopen);
+    UT_TEST_RUN(test_select_once_forever);
+    UT_TEST_RUN(test_select_timer);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file test_uring.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief ut_uring的单元测试：io_uring、单次提交和回退到epoll三种方式的accept/recv、读写文件、定时器和停止
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "ut/ut_uring.h"
+#include "ut_test.h"
+
+#define CLIENT_WRITES   100
+
+typedef struct {
+    const char  *name;
+    uint32_t    flags;
+} test_mode_t;
+
+static const test_mode_t s_modes[] = {
+    {"io_uring", UT_URING_FLAG_NONE},
+    {"io_uring single shot", UT_URING_FLAG_SINGLE_SHOT},
+    {"epoll", UT_URING_FLAG_FORCE_POLL},
+};
+
+typedef struct {
+    ut_fd_t     listen_fd;
+    uint16_t    port;
+    int32_t     accepted;
+    int32_t     received;
+    int32_t     eof;
+    int32_t     cancelled;
+    int32_t     file_ok;
+    char        file_buf[UT_LEN_16];
+} test_conn_t;
+
+static void __recv_cb(ut_uring_t* ring, int32_t res, void* buf, ut_bool_t more, void* context)
+{
+    test_conn_t     *conn = context;
+
+    if (res > 0) {
+        UT_TEST_ASSERT(buf != NULL && more);
+        conn->received += res;
+        ut_uring_buffer_release(ring, buf);
+    } else {
+        UT_TEST_ASSERT(res == 0 && !more);
+        conn->eof++;
+    }
+}
+
+static void __accept_cb(ut_uring_t* ring, int32_t res, void* buf, ut_bool_t more, void* context)
+{
+    test_conn_t     *conn = context;
+
+    if (res >= 0) {
+        UT_TEST_ASSERT(more);
+        conn->accepted++;
+        UT_TEST_ASSERT(ut_uring_recv(ring, res, __recv_cb, conn) == UT_ERRNO_OK);
+    } else {
+        UT_TEST_ASSERT(res == -ECANCELED && !more);
+        conn->cancelled++;
+    }
+}
+
+static void __read_cb(ut_uring_t* ring, int32_t res, void* buf, ut_bool_t more, void* context)
+{
+    test_conn_t     *conn = context;
+
+    UT_TEST_ASSERT(res == 5 && memcmp(conn->file_buf, "hello", 5) == 0);
+    conn->file_ok++;
+}
+
+static void __write_cb(ut_uring_t* ring, int32_t res, void* buf, ut_bool_t more, void* context)
+{
+    UT_TEST_ASSERT(res == 5);
+}
+
+static void __cancel_cb(ut_uring_t* ring, int32_t res, void* buf, ut_bool_t more, void* context)
+{
+    UT_TEST_ASSERT(res == 0);
+    ut_uring_cancel(ring, ((test_conn_t*)context)->listen_fd);
+}
+
+static void __stop_cb(ut_uring_t* ring, int32_t res, void* buf, ut_bool_t more, void* context)
+{
+    ut_uring_stop(ring);
+}
+
+static void* __client(void* arg)
+{
+    test_conn_t         *conn = arg;
+    struct sockaddr_in  addr;
+    ut_fd_t             fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(conn->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    UT_TEST_ASSERT(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    for (uint32_t i = 0; i < CLIENT_WRITES; i++) {
+        UT_TEST_ASSERT(write(fd, "0123456789", 10) == 10);
+        usleep(100);
+    }
+    close(fd);
+    return NULL;
+}
+
+static void* __stopper(void* arg)
+{
+    usleep(20 * 1000);
+    ut_uring_stop(arg);
+    return NULL;
+}
+
+/* 一个连接上的数据全部收到、对端关闭后recv结束；取消之后accept结束；文件先写后读 */
+static void test_uring_ops(void)
+{
+    for (uint32_t m = 0; m < sizeof(s_modes) / sizeof(s_modes[0]); m++) {
+        ut_uring_t          *ring = NULL;
+        test_conn_t         conn;
+        struct sockaddr_in  addr;
+        socklen_t           addr_len = sizeof(addr);
+        pthread_t           tid;
+        char                path[] = "/tmp/test_uring_XXXXXX";
+        ut_fd_t             file_fd = mkstemp(path);
+
+        memset(&conn, 0, sizeof(conn));
+        memset(&addr, 0, sizeof(addr));
+        UT_TEST_ASSERT(ut_uring_create(&ring, 64, s_modes[m].flags) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_uring_buffer_register(ring, 16, 4096) == UT_ERRNO_OK);
+
+        conn.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        UT_TEST_ASSERT(bind(conn.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && listen(conn.listen_fd, 16) == 0);
+        getsockname(conn.listen_fd, (struct sockaddr*)&addr, &addr_len);
+        conn.port = ntohs(addr.sin_port);
+
+        UT_TEST_ASSERT(ut_uring_accept(ring, conn.listen_fd, __accept_cb, &conn) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_uring_write(ring, file_fd, "hello", 5, 0, __write_cb, &conn) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_uring_timeout(ring, 1000, __stop_cb, &conn) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_uring_run(ring) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_uring_read(ring, file_fd, conn.file_buf, sizeof(conn.file_buf), 0, __read_cb, &conn) == UT_ERRNO_OK);
+
+        pthread_create(&tid, NULL, __client, &conn);
+        UT_TEST_ASSERT(ut_uring_timeout(ring, 300 * 1000, __cancel_cb, &conn) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_uring_timeout(ring, 350 * 1000, __stop_cb, &conn) == UT_ERRNO_OK);
+        UT_TEST_ASSERT(ut_uring_run(ring) == UT_ERRNO_OK);
+        pthread_join(tid, NULL);
+
+        UT_TEST_ASSERT(conn.accepted == 1 && conn.received == CLIENT_WRITES * 10 && conn.eof == 1);
+        UT_TEST_ASSERT(conn.cancelled == 1 && conn.file_ok == 1);
+        ut_uring_destroy(ring);
+        close(conn.listen_fd);
+        close(file_fd);
+        unlink(path);
+        printf("  mode %s ok\n", s_modes[m].name);
+    }
+}
+
+/* 其他线程可以反复停止事件循环，唤醒用的poll在每次唤醒之后仍然有效 */
+static void test_uring_stop(void)
+{
+    for (uint32_t m = 0; m < sizeof(s_modes) / sizeof(s_modes[0]); m++) {
+        ut_uring_t      *ring = NULL;
+        pthread_t       tid;
+
+        UT_TEST_ASSERT(ut_uring_create(&ring, 8, s_modes[m].flags) == UT_ERRNO_OK);
+        for (uint32_t i = 0; i < 5; i++) {
+            pthread_create(&tid, NULL, __stopper, ring);
+            UT_TEST_ASSERT(ut_uring_run(ring) == UT_ERRNO_OK);
+            pthread_join(tid, NULL);
+        }
+        ut_uring_destroy(ring);
+    }
+}
+
+int main(void)
+{
+    UT_TEST_RUN(test_uring_ops);
+    UT_TEST_RUN(test_uring_stop);
+    return 0;
+}
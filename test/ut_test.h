@@ -0,0 +1,46 @@
+/**
+ * @file ut_test.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 单元测试共用的断言和随机数。每个测试是一个独立的可执行文件，由ctest运行，返回0表示通过
+ * @version 0.1
+ * @date 2022-07-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef __UTILS_TEST_H__
+#define __UTILS_TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* 断言失败时打印位置并以非0退出，不受NDEBUG影响 */
+#define UT_TEST_ASSERT(cond)    do {\
+        if (!(cond)) {\
+            fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond);\
+            exit(1);\
+        }\
+    } while (0)
+
+#define UT_TEST_RUN(func)       do {\
+        func();\
+        printf("%-40s ok\n", #func);\
+    } while (0)
+
+/**
+ * @brief 可复现的伪随机数（splitmix64），测试之间互不影响
+ *
+ * @param [inout] state 随机数状态
+ * @return uint64_t
+ */
+static inline uint64_t ut_test_rand(uint64_t *state)
+{
+    uint64_t    z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+#endif